@@ -0,0 +1,36 @@
+# Compares summing a series with Calc::Q#+ against Calc::Accumulator#add, and
+# a dot product with Calc::Q#* / #+ against Calc::Accumulator#addmul.
+#
+# usage: ruby bench/accumulator.rb [terms]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+n = (ARGV[0] || 20_000).to_i
+
+srand(1)
+terms = Array.new(n) { Calc::Q(rand(10**20), 10**rand(0..8)) }
+harmonic = (1..n / 10).map { |i| Calc::Q(1, i) }
+xs = Array.new(n) { Calc::Q(rand(10**20), 10**rand(0..8)) }
+ys = Array.new(n) { Calc::Q(rand(10**20), 10**rand(0..8)) }
+
+puts "#{ n } terms"
+Benchmark.bm(24) do |x|
+  s1 = s2 = nil
+  x.report("decimals: Q#+") { s1 = terms.inject(Calc::Q::ZERO) { |s, t| s + t } }
+  x.report("decimals: add") { s2 = terms.inject(Calc::Accumulator.new) { |a, t| a.add(t) }.value }
+  abort "sum mismatch" unless s1 == s2
+
+  x.report("harmonic/10: Q#+") { s1 = harmonic.inject(Calc::Q::ZERO) { |s, t| s + t } }
+  x.report("harmonic/10: add") { s2 = harmonic.inject(Calc::Accumulator.new) { |a, t| a.add(t) }.value }
+  abort "harmonic mismatch" unless s1 == s2
+
+  x.report("dot: Q#* Q#+") { s1 = xs.zip(ys).inject(Calc::Q::ZERO) { |s, (p, q)| s + p * q } }
+  x.report("dot: addmul") do
+    a = Calc::Accumulator.new
+    xs.each_with_index { |p, i| a.addmul(p, ys[i]) }
+    s2 = a.value
+  end
+  abort "dot mismatch" unless s1 == s2
+end
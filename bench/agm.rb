@@ -0,0 +1,34 @@
+# Compares AGM with the series methods (libcalc, or binary splitting above
+# config bsplit_digits) for ln, log and pi at increasing precision, then runs
+# Calc.tune_agm.
+#
+# usage: ruby bench/agm.rb [max_digits]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+max = (ARGV[0] || 1_000_000).to_i
+x = Calc::Q(10, 7)
+
+digits = 1000
+while digits <= max
+  eps = Calc::Epsilon.new(Rational(1, 10**digits))
+  # the constants are cached; don't time computing them the first time (AGM
+  # works with about 1.5 times as many digits)
+  Calc.prewarm_constants(Rational(1, 10**(2 * digits)))
+  puts "#{ digits } digits"
+  Benchmark.bm(20) do |b|
+    Calc.config(:agm_digits, 0)
+    b.report("series ln") { x.ln(eps) }
+    b.report("series log") { x.log(eps) }
+    Calc.config(:agm_digits, 1)
+    b.report("agm ln") { x.ln(eps) }
+    b.report("agm log") { x.log(eps) }
+  end
+  digits *= 10
+end
+
+# pi can't be timed through Calc.pi (it is cached), tune_agm times both
+# methods directly
+puts "Calc.tune_agm(#{ max }) => #{ Calc.tune_agm(max).inspect }"
@@ -0,0 +1,35 @@
+# Compares libcalc's recurrence for bernoulli numbers with the zeta function
+# formula, for a single large index and for Calc.bernoulli_range.  The
+# crossover is config option "bernoulli_zeta".  libcalc is skipped above
+# 5000, where it takes too long to be worth waiting for.
+#
+# usage: ruby bench/bernoulli.rb [max_index]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+max = (ARGV[0] || 20_000).to_i
+default = Calc.config(:bernoulli_zeta)
+
+n = 50
+while n <= max
+  puts "index #{ n }"
+  Benchmark.bm(20) do |b|
+    if n <= 5000
+      Calc.config(:bernoulli_zeta, 0)
+      Calc.freebernoulli
+      b.report("libcalc B(n)") { Calc::Q(n).bernoulli }
+      Calc.freebernoulli
+      b.report("libcalc B(0..n)") { Calc.bernoulli_range(0, n) }
+    end
+    Calc.config(:bernoulli_zeta, 2)
+    Calc.freebernoulli
+    b.report("zeta B(n)") { Calc::Q(n).bernoulli }
+    Calc.config(:bernoulli_zeta, default)
+    Calc.freebernoulli
+    b.report("default B(0..n)") { Calc.bernoulli_range(0, n) }
+  end
+  n *= 2
+end
+Calc.freebernoulli
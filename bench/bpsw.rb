@@ -0,0 +1,38 @@
+# Compares the Baillie-PSW test (count :bpsw) with 20 strong tests (count 20)
+# for ptest? on primes, where every test has to be done, for nextcand from
+# random starting points, and for Calc.ptest_many on one thread (which uses
+# the same arithmetic for both).
+#
+# usage: ruby bench/bpsw.rb [max_bits] [samples]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+max = (ARGV[0] || 2048).to_i
+samples = (ARGV[1] || 10).to_i
+srand(1)
+
+Benchmark.bm(32) do |b|
+  bits = 256
+  while bits <= max
+    starts = Array.new(samples) { Calc::Q(2**(bits - 1) + rand(2**(bits - 1))) }
+    primes = starts.map { |x| x.nextcand(:bpsw) }
+    [20, :bpsw].each do |count|
+      b.report("#{ bits } bits, ptest?(#{ count.inspect })") do
+        raise "composite?" unless primes.all? { |p| p.ptest?(count) }
+      end
+    end
+    [20, :bpsw].each do |count|
+      b.report("#{ bits } bits, nextcand(#{ count.inspect })") do
+        raise "wrong prime" unless starts.map { |x| x.nextcand(count) } == primes
+      end
+    end
+    [20, :bpsw].each do |count|
+      b.report("#{ bits } bits, ptest_many(#{ count.inspect })") do
+        raise "composite?" unless Calc.ptest_many(primes, count, 1, 1).all?
+      end
+    end
+    bits *= 2
+  end
+end
@@ -0,0 +1,33 @@
+# Compares libcalc's exp, ln and atan with the binary splitting versions at
+# increasing precision.  libcalc is skipped above 10,000 digits, where it
+# takes too long to be worth waiting for.
+#
+# usage: ruby bench/bsplit.rb [max_digits]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+max = (ARGV[0] || 1_000_000).to_i
+x = Calc::Q(1, 3)
+y = Calc::Q(3)
+
+digits = 100
+while digits <= max
+  eps = Calc::Epsilon.new(Rational(1, 10**digits))
+  puts "#{ digits } digits"
+  Benchmark.bm(20) do |b|
+    if digits <= 10_000
+      Calc.config(:bsplit_digits, 0)
+      b.report("libcalc exp") { x.exp(eps) }
+      b.report("libcalc ln") { y.ln(eps) }
+      b.report("libcalc atan") { x.atan(eps) }
+    end
+    Calc.config(:bsplit_digits, 1)
+    b.report("bsplit exp") { x.exp(eps) }
+    b.report("bsplit ln") { y.ln(eps) }
+    b.report("bsplit atan") { x.atan(eps) }
+    b.report("pi (extends cache)") { Calc.pi(eps) }
+  end
+  digits *= 10
+end
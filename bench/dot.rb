@@ -0,0 +1,33 @@
+# Compares a dot product done with Calc::Q#* and Calc::Q#+ against
+# Calc::Q#muladd and Calc.dot.
+#
+# usage: ruby bench/dot.rb [length] [digits]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+n = (ARGV[0] || 20_000).to_i
+digits = (ARGV[1] || 20).to_i
+
+srand(1)
+rnd = -> { Calc::Q(rand(10**digits) - 10**digits / 2, 10**rand(0..8)) }
+xs = Array.new(n) { rnd.call }
+ys = Array.new(n) { rnd.call }
+small = Array.new(n) { |i| Calc::Q(1, i % 50 + 1) }
+
+puts "vectors of #{ n } #{ digits } digit decimals"
+Benchmark.bm(22) do |x|
+  [["decimals", xs, ys], ["1/k (k <= 50)", small, small]].each do |name, as, bs|
+    expected = result = nil
+    x.report("#{ name }: * +") do
+      expected = as.zip(bs).inject(Calc::Q::ZERO) { |s, (p, q)| s + p * q }
+    end
+    x.report("#{ name }: muladd") do
+      result = as.zip(bs).inject(Calc::Q::ZERO) { |s, (p, q)| p.muladd(q, s) }
+    end
+    abort "muladd mismatch" unless result == expected
+    x.report("#{ name }: dot") { result = Calc.dot(as, bs) }
+    abort "dot mismatch" unless result == expected
+  end
+end
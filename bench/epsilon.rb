@@ -0,0 +1,28 @@
+# Times a cheap epsilon-taking function with the epsilon given as a String, a
+# Rational, a Calc::Epsilon and a Calc::Q.  Strings and Rationals are looked
+# up in the epsilon intern table instead of being converted on every call.
+#
+# usage: ruby bench/epsilon.rb [count] [epsilon]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+n = (ARGV[0] || 200_000).to_i
+eps = ARGV[1] || "1e-40"
+
+# sqrt of a perfect square is cheap, so the epsilon conversion dominates
+x = Calc::Q(4)
+forms = {
+  "String" => eps,
+  "Rational" => Calc::Q(eps).to_r,
+  "Calc::Q" => Calc::Q(eps),
+}
+forms["Calc::Epsilon"] = Calc::Epsilon.new(eps)
+
+puts "#{ n } calls of sqrt, epsilon #{ eps }"
+Benchmark.bm(14) do |b|
+  forms.each do |name, e|
+    b.report(name) { n.times { x.sqrt(e) } }
+  end
+end
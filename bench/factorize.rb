@@ -0,0 +1,33 @@
+# Times Calc::Q#factorize on products of two random primes of the same size
+# (the hardest case for rho and ecm, whose times depend on the size of the
+# smallest factor), with one thread and with the default number of threads,
+# and with the quadratic sieve (method: :qs), whose time depends only on the
+# size of the number.
+#
+# usage: ruby bench/factorize.rb [max_bits] [samples]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+max = (ARGV[0] || 120).to_i
+samples = (ARGV[1] || 3).to_i
+srand(1)
+
+def random_prime(bits)
+  Calc::Q(2**(bits - 1) + rand(2**(bits - 1))).nextcand
+end
+
+Benchmark.bm(34) do |b|
+  (60..max).step(10) do |bits|
+    ns = Array.new(samples) { random_prime(bits / 2) * random_prime(bits / 2) }
+    [[:ecm, 1], [:ecm, nil], [:qs, nil]].each do |method, threads|
+      b.report("#{ bits } bits, #{ method }, threads: #{ threads || "default" }") do
+        ns.each do |n|
+          f = n.factorize(method: method, threads: threads)
+          raise "bad factorization of #{ n }" unless f.size == 2 && f[0][0] * f[1][0] == n
+        end
+      end
+    end
+  end
+end
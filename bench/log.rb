@@ -0,0 +1,29 @@
+# Compares the native log2 and logn (which cache ln of the base) with the
+# previous ruby implementation, which computed ln of the base on every call.
+#
+# usage: ruby bench/log.rb [count] [epsilon]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+n = (ARGV[0] || 20_000).to_i
+eps = ARGV[1] || "1e-20"
+
+srand(1)
+values = Array.new(n) { Calc::Q(rand(1..10**6), rand(1..10**4)) }
+
+puts "#{ n } values, epsilon #{ eps }"
+Benchmark.bm(14) do |x|
+  [2, 3, 10].each do |b|
+    base = Calc::Q(b)
+    expected = result = nil
+    x.report("base #{ b }: ruby") { expected = values.map { |v| v.ln(eps) / base.ln(eps) } }
+    if b == 2
+      x.report("base #{ b }: log2") { result = values.map { |v| v.log2(eps) } }
+      abort "log2 result mismatch" unless result == expected
+    end
+    x.report("base #{ b }: logn") { result = values.map { |v| v.logn(b, eps) } }
+    abort "base #{ b } result mismatch" unless result == expected
+  end
+end
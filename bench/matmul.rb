@@ -0,0 +1,42 @@
+# Compares exact matrix multiplication with a plain ruby loop over Calc::Q,
+# then times Calc.matmul with 1 up to N native threads.
+#
+# Elements are decimal fractions (denominators are powers of 10), which is the
+# common case of exact data read from text.  Rows/columns of unrelated
+# denominators make the common denominators (and so the integer products)
+# much longer.
+#
+# usage: ruby bench/matmul.rb [size] [digits] [max threads]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+require "etc"
+
+size = (ARGV[0] || 60).to_i
+digits = (ARGV[1] || 30).to_i
+max_threads = (ARGV[2] || Etc.nprocessors).to_i
+
+srand(1)
+rnd = -> { Calc::Q(rand(10**digits) - 10**digits / 2, 10**rand(0..6)) }
+a = Array.new(size) { Array.new(size) { rnd.call } }
+b = Array.new(size) { Array.new(size) { rnd.call } }
+
+def ruby_matmul(a, b)
+  bt = b.transpose
+  a.map { |row| bt.map { |col| row.zip(col).inject(Calc::Q::ZERO) { |s, (x, y)| s + x * y } } }
+end
+
+puts "#{ size }x#{ size } matrices, #{ digits } digit decimals"
+expected = nil
+Benchmark.bm(12) do |x|
+  x.report("ruby loop") { expected = ruby_matmul(a, b) }
+  base = nil
+  1.upto(max_threads) do |t|
+    result = nil
+    time = x.report("threads=#{ t }") { result = Calc.matmul(a, b, t) }
+    base ||= time.real
+    puts format("%-12s speedup %.2fx", "", base / time.real)
+    abort "result mismatch with #{ t } threads" unless result == expected
+  end
+end
@@ -0,0 +1,31 @@
+# Times repeated transcendental functions of the same values with the memo
+# disabled and enabled (Calc.config(:memo, n)).
+#
+# usage: ruby bench/memo.rb [calls] [distinct values] [epsilon]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+n = (ARGV[0] || 100_000).to_i
+distinct = (ARGV[1] || 100).to_i
+eps = ARGV[2] || "1e-20"
+
+srand(1)
+pool = Array.new(distinct) { Calc::Q(rand(1..10**6), rand(1..10**4)) }
+values = Array.new(n) { pool.sample }
+epsilon = Calc::Q(eps)
+
+puts "#{ n } calls, #{ distinct } distinct values, epsilon #{ eps }"
+Benchmark.bm(16) do |x|
+  %i[exp ln sqrt].each do |f|
+    expected = result = nil
+    Calc.config(:memo, 0)
+    x.report("#{ f }: no memo") { expected = values.map { |v| v.__send__(f, epsilon) } }
+    Calc.config(:memo, distinct * 3)
+    x.report("#{ f }: memo") { result = values.map { |v| v.__send__(f, epsilon) } }
+    abort "#{ f } result mismatch" unless result == expected
+  end
+end
+p Calc.memo_stats
+Calc.config(:memo, 0)
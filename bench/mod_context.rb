@@ -0,0 +1,31 @@
+# Compares Calc::ModContext with Calc::Q#pmod and modular multiplication with
+# Calc::Q for a chain of operations modulo the same large odd modulus.
+#
+# usage: ruby bench/mod_context.rb [bits] [iterations]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+bits = (ARGV[0] || 1024).to_i
+n = (ARGV[1] || 1000).to_i
+srand(1)
+m = Calc::Q(2**(bits - 1) + rand(2**(bits - 1)) | 1)
+xs = Array.new(n) { Calc::Q(rand(2**bits)) }
+es = Array.new(n) { Calc::Q(rand(2**bits)) }
+ctx = Calc::ModContext.new(m)
+
+Benchmark.bm(32) do |b|
+  b.report("#{ bits } bits, pmod") do
+    xs.zip(es).each { |x, e| x.pmod(e, m) }
+  end
+  b.report("#{ bits } bits, ModContext#pow") do
+    xs.zip(es).each { |x, e| ctx.pow(x, e).to_q }
+  end
+  b.report("#{ bits } bits, mul then mod") do
+    xs.inject { |acc, x| (acc * x) % m }
+  end
+  b.report("#{ bits } bits, ModContext#mul") do
+    xs.inject(ctx.reduce(1)) { |acc, x| acc * x }.to_q
+  end
+end
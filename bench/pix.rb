@@ -0,0 +1,30 @@
+# Times Calc::Q#pix for powers of 10, checking the results against known
+# values of pi(x).  Below 2^24 pix is libcalc's sieve; above that it uses the
+# Lagarias-Miller-Odlyzko method, which takes time proportional to about
+# x^(2/3).  Calc.count_primes (a plain segmented sieve) is timed as well up to
+# 10^9 for comparison.
+#
+# usage: ruby bench/pix.rb [max_power]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+# pi(10^n), from OEIS A006880
+KNOWN = [
+  0, 4, 25, 168, 1229, 9592, 78498, 664_579, 5_761_455, 50_847_534, 455_052_511,
+  4_118_054_813, 37_607_912_018, 346_065_536_839, 3_204_941_750_802,
+  29_844_570_422_669, 279_238_341_033_925, 2_623_557_157_654_233,
+  24_739_954_287_740_860
+].freeze
+
+max = (ARGV[0] || 15).to_i
+Benchmark.bm(24) do |b|
+  (1..max).each do |n|
+    x = Calc::Q(10)**n
+    result = nil
+    b.report("pix(10^#{ n })") { result = x.pix }
+    raise "pix(10^#{ n }) = #{ result }, expected #{ KNOWN[n] }" if KNOWN[n] && result != KNOWN[n]
+    b.report("count_primes(0, 10^#{ n })") { Calc.count_primes(0, x) } if n <= 9
+  end
+end
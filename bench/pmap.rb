@@ -0,0 +1,24 @@
+# Compares applying a builtin to many values with Array#map against
+# Calc.pmap, which converts the values and epsilon once.
+#
+# usage: ruby bench/pmap.rb [count] [epsilon]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+n = (ARGV[0] || 100_000).to_i
+eps = ARGV[1] || "1e-20"
+
+srand(1)
+values = Array.new(n) { Rational(rand(1..10**6), rand(1..10**4)) }
+
+puts "#{ n } values, epsilon #{ eps }"
+Benchmark.bm(14) do |x|
+  %i[sqrt sin ln].each do |f|
+    expected = result = nil
+    x.report("#{ f }: map") { expected = values.map { |v| Calc::Q(v).__send__(f, eps) } }
+    x.report("#{ f }: pmap") { result = Calc.pmap(values, f, eps) }
+    abort "#{ f } result mismatch" unless result == expected
+  end
+end
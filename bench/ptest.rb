@@ -0,0 +1,31 @@
+# Times Calc.ptest_many against calling Calc::Q#ptest? on each value, for
+# random odd candidates of a few sizes, with 1, 2 and 4 threads and the
+# default number of threads.  Most candidates are rejected by the small prime
+# prefilter or the first test, so the times are dominated by composites, as
+# when screening candidates for primes.
+#
+# usage: ruby bench/ptest.rb [count] [values]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+count = (ARGV[0] || 20).to_i
+n = (ARGV[1] || 20_000).to_i
+srand(1)
+
+Benchmark.bm(30) do |b|
+  [64, 256, 1024, 2048].each do |bits|
+    values = Array.new(n * 64 / bits) { Calc::Q(2**(bits - 1) + rand(2**(bits - 1)) | 1) }
+    expected = nil
+    b.report("#{ bits } bits x #{ values.size }, ptest?") do
+      expected = values.map { |v| v.ptest?(count) }
+    end
+    [1, 2, 4, nil].each do |threads|
+      b.report("#{ bits } bits, threads: #{ threads || "default" }") do
+        r = Calc.ptest_many(values, count, 1, threads)
+        raise "ptest_many doesn't match ptest?" unless r == expected
+      end
+    end
+  end
+end
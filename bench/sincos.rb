@@ -0,0 +1,32 @@
+# Compares sincos, sinhcosh and cis with calling the separate functions, at
+# several epsilons.
+#
+# usage: ruby bench/sincos.rb [count] [epsilon ...]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+n = (ARGV[0] || 2_000).to_i
+epsilons = ARGV[1] ? ARGV[1..-1] : %w[1e-20 1e-100 1e-500]
+
+srand(1)
+reals = Array.new(n) { Calc::Q(rand(-10**6..10**6), rand(1..10**5)) }
+complexes = Array.new(n) { Calc::C(Calc::Q(rand(-10**4..10**4), 1000), Calc::Q(rand(-10**4..10**4), 1000)) }
+
+epsilons.each do |e|
+  eps = Calc::Epsilon.new(e)
+  puts "#{ n } values, epsilon #{ e }"
+  Benchmark.bm(20) do |x|
+    x.report("Q sin, cos") { reals.each { |v| v.sin(eps); v.cos(eps) } }
+    x.report("Q sincos") { reals.each { |v| v.sincos(eps) } }
+    x.report("Q sinh, cosh") { reals.each { |v| v.sinh(eps); v.cosh(eps) } }
+    x.report("Q sinhcosh") { reals.each { |v| v.sinhcosh(eps) } }
+    x.report("C sin, cos") { complexes.each { |v| v.sin(eps); v.cos(eps) } }
+    x.report("C sincos") { complexes.each { |v| v.sincos(eps) } }
+    x.report("C sinh, cosh") { complexes.each { |v| v.sinh(eps); v.cosh(eps) } }
+    x.report("C sinhcosh") { complexes.each { |v| v.sinhcosh(eps) } }
+    x.report("C (v * 1i).exp") { complexes.each { |v| (v * Calc::C(0, 1)).exp(eps) } }
+    x.report("C cis") { complexes.each { |v| v.cis(eps) } }
+  end
+end
@@ -0,0 +1,42 @@
+# Compares Calc::SpecialMod#pow with Calc::Q#pmod for moduli of the form
+# h * 2^n + r (Mersenne, Proth and Fermat numbers) and exponents as large as
+# the modulus, and the native Lucas-Lehmer test with the same loop written
+# with Calc::Q operators.
+#
+# usage: ruby bench/special_mod.rb [n] [samples]
+
+$LOAD_PATH.unshift File.expand_path("../../lib", __FILE__)
+require "calc"
+require "benchmark"
+
+n = (ARGV[0] || 4423).to_i
+samples = (ARGV[1] || 5).to_i
+srand(1)
+
+Benchmark.bm(36) do |b|
+  [[1, n, -1], [3, n, 1], [1, 2**Math.log2(n).round, 1]].each do |h, k, r|
+    sm = Calc::SpecialMod.new(h, k, r)
+    m = sm.modulus
+    xs = Array.new(samples) { Calc::Q(rand(2**k)) }
+    es = Array.new(samples) { Calc::Q(rand(2**k)) }
+    results = nil
+    b.report("#{ sm }, pmod") do
+      results = xs.zip(es).map { |x, e| x.pmod(e, m) }
+    end
+    b.report("#{ sm }, SpecialMod#pow") do
+      raise "wrong result" unless xs.zip(es).map { |x, e| sm.pow(x, e) } == results
+    end
+  end
+
+  sm = Calc::SpecialMod.new(1, n, -1)
+  m = sm.modulus
+  expected = nil
+  b.report("2^#{ n }-1, lucas-lehmer with Calc::Q") do
+    s = Calc::Q(4)
+    (n - 2).times { s = (s * s - 2) % m }
+    expected = s.zero?
+  end
+  b.report("2^#{ n }-1, lucas_lehmer?") do
+    raise "wrong result" unless sm.lucas_lehmer? == expected
+  end
+end
@@ -0,0 +1,407 @@
+#include "calc.h"
+
+/* Document-class: Calc::Accumulator
+ *
+ * Mutable accumulator for sums and products of rational numbers.
+ *
+ * Arithmetic on Calc::Q always returns a new object, and every result is
+ * reduced to lowest terms.  In a long loop (eg, summing millions of terms)
+ * most of the time goes to allocation and gcd reductions of intermediate
+ * values nobody looks at.  An accumulator instead updates its own numerator
+ * and denominator in place and only reduces them when the value is read.
+ *
+ * When adding a term whose denominator differs from the accumulator's, the
+ * new denominator is the lcm of the two, so sums of terms with related
+ * denominators stay small.  Products are not reduced at all until read.
+ *
+ * @example
+ *  acc = Calc::Accumulator.new
+ *  1.upto(10) { |i| acc.add(Calc::Q(1, i)) }
+ *  acc.value  #=> Calc::Q(7381/2520)
+ */
+VALUE cAccumulator;
+
+static void
+ca_free(void *p)
+{
+    accum_free((calc_accum *) p);
+    xfree(p);
+}
+
+static size_t
+ca_memsize(const void *p)
+{
+    const calc_accum *a = p;
+    return sizeof(calc_accum) + (a->num.len + a->den.len) * sizeof(HALF);
+}
+
+const rb_data_type_t calc_accumulator_type = {
+    "Calc::Accumulator",
+    {0, ca_free, ca_memsize},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY   /* flags is in 2.1+ */
+#endif
+};
+
+/*****************************************************************************
+ * unreduced numerator/denominator arithmetic.  also used by other kernels   *
+ * (see matrix.c) which want to skip intermediate reductions.                *
+ *****************************************************************************/
+
+/* replace *z with v, freeing the old value */
+static void
+zreplace(ZVALUE * z, ZVALUE v)
+{
+    zfree(*z);
+    *z = v;
+}
+
+void
+accum_init(calc_accum * a)
+{
+    itoz(0, &a->num);
+    itoz(1, &a->den);
+}
+
+void
+accum_free(calc_accum * a)
+{
+    if (a->num.v)
+        zfree(a->num);
+    if (a->den.v)
+        zfree(a->den);
+    a->num.v = a->den.v = NULL;
+}
+
+/* a = n/d.  d must be positive. */
+void
+accum_set(calc_accum * a, ZVALUE n, ZVALUE d)
+{
+    ZVALUE tn, td;
+
+    zcopy(n, &tn);
+    zcopy(d, &td);
+    zreplace(&a->num, tn);
+    zreplace(&a->den, td);
+}
+
+/* a += n/d.  d must be positive; n/d need not be in lowest terms. */
+void
+accum_add(calc_accum * a, ZVALUE n, ZVALUE d)
+{
+    ZVALUE t1, t2, g, f1, f2;
+
+    if (ziszero(n))
+        return;
+    if (zisunit(d) || zcmp(d, a->den) == 0) {
+        /* same denominator, or an integer */
+        if (zisunit(d) && !zisunit(a->den)) {
+            zmul(n, a->den, &t1);
+            zadd(a->num, t1, &t2);
+            zfree(t1);
+        }
+        else {
+            zadd(a->num, n, &t2);
+        }
+        zreplace(&a->num, t2);
+        return;
+    }
+    if (zisunit(a->den)) {
+        /* integer so far, take the new denominator */
+        zmul(a->num, d, &t1);
+        zadd(t1, n, &t2);
+        zfree(t1);
+        zreplace(&a->num, t2);
+        zcopy(d, &t1);
+        zreplace(&a->den, t1);
+        return;
+    }
+    /* different denominators: scale both to their lcm */
+    zgcd(a->den, d, &g);
+    zequo(d, g, &f1);           /* a->den * f1 is the lcm */
+    zequo(a->den, g, &f2);      /* d * f2 is the lcm */
+    zfree(g);
+    if (zisunit(f1)) {
+        /* d divides a->den */
+        zmul(n, f2, &t1);
+        zadd(a->num, t1, &t2);
+        zfree(t1);
+        zreplace(&a->num, t2);
+    }
+    else {
+        zmul(a->num, f1, &t1);
+        zmul(n, f2, &t2);
+        zadd(t1, t2, &g);
+        zfree(t1);
+        zfree(t2);
+        zreplace(&a->num, g);
+        zmul(a->den, f1, &t2);
+        zreplace(&a->den, t2);
+    }
+    zfree(f1);
+    zfree(f2);
+}
+
+/* a *= n/d.  d must be positive.  nothing is reduced. */
+void
+accum_mul(calc_accum * a, ZVALUE n, ZVALUE d)
+{
+    ZVALUE t;
+
+    if (ziszero(n) || ziszero(a->num)) {
+        itoz(0, &t);
+        zreplace(&a->num, t);
+        itoz(1, &t);
+        zreplace(&a->den, t);
+        return;
+    }
+    if (!zisunit(n) || n.sign) {
+        zmul(a->num, n, &t);
+        zreplace(&a->num, t);
+    }
+    if (!zisunit(d)) {
+        zmul(a->den, d, &t);
+        zreplace(&a->den, t);
+    }
+}
+
+/* a += (n1/d1) * (n2/d2) */
+void
+accum_addmul(calc_accum * a, ZVALUE n1, ZVALUE d1, ZVALUE n2, ZVALUE d2)
+{
+    ZVALUE n, d;
+
+    if (ziszero(n1) || ziszero(n2))
+        return;
+    zmul(n1, n2, &n);
+    if (zisunit(d1) && zisunit(d2)) {
+        accum_add(a, n, _one_);
+    }
+    else {
+        zmul(d1, d2, &d);
+        accum_add(a, n, d);
+        zfree(d);
+    }
+    zfree(n);
+}
+
+/* reduce a to lowest terms (in place) */
+void
+accum_reduce(calc_accum * a)
+{
+    ZVALUE g, t;
+
+    if (ziszero(a->num)) {
+        if (!zisunit(a->den)) {
+            itoz(1, &t);
+            zreplace(&a->den, t);
+        }
+        return;
+    }
+    if (zisunit(a->den))
+        return;
+    zgcd(a->num, a->den, &g);
+    if (!zisunit(g)) {
+        zequo(a->num, g, &t);
+        zreplace(&a->num, t);
+        zequo(a->den, g, &t);
+        zreplace(&a->den, t);
+    }
+    zfree(g);
+}
+
+/* reduce a and return its value as a new NUMBER */
+NUMBER *
+accum_to_number(calc_accum * a)
+{
+    NUMBER *q;
+
+    accum_reduce(a);
+    if (ziszero(a->num))
+        return qlink(&_qzero_);
+    q = qalloc();
+    zcopy(a->num, &q->num);
+    if (!zisunit(a->den))
+        zcopy(a->den, &q->den);
+    return q;
+}
+
+/*****************************************************************************
+ * Calc::Accumulator                                                         *
+ *****************************************************************************/
+
+static VALUE
+ca_alloc(VALUE klass)
+{
+    calc_accum *a;
+    VALUE obj;
+
+    obj = TypedData_Make_Struct(klass, calc_accum, &calc_accumulator_type, a);
+    accum_init(a);
+    return obj;
+}
+
+/* Creates a new accumulator
+ *
+ * @param value [Numeric,Calc::Q] (optional) initial value, defaults to 0
+ * @return [Calc::Accumulator]
+ * @example
+ *  Calc::Accumulator.new        #=> Calc::Accumulator(0)
+ *  Calc::Accumulator.new("1/3") #=> Calc::Accumulator(1/3)
+ */
+static VALUE
+ca_initialize(int argc, VALUE * argv, VALUE self)
+{
+    NUMBER *q;
+    VALUE value;
+    setup_math_error();
+
+    if (rb_scan_args(argc, argv, "01", &value) == 1) {
+        q = value_to_number(value, 1);
+        accum_set((calc_accum *) DATA_PTR(self), q->num, q->den);
+        qfree(q);
+    }
+    return self;
+}
+
+static VALUE
+ca_initialize_copy(VALUE obj, VALUE orig)
+{
+    calc_accum *a;
+
+    rb_check_frozen(obj);
+    if (obj == orig) {
+        return obj;
+    }
+    if (!rb_typeddata_is_kind_of(orig, &calc_accumulator_type)) {
+        rb_raise(rb_eTypeError, "wrong argument type");
+    }
+    a = DATA_PTR(orig);
+    accum_set((calc_accum *) DATA_PTR(obj), a->num, a->den);
+    return obj;
+}
+
+/* Adds a number to the accumulator
+ *
+ * @param y [Numeric,Calc::Q]
+ * @return [Calc::Accumulator] self
+ * @example
+ *  Calc::Accumulator.new(1).add(Calc::Q(1, 2)).value #=> Calc::Q(1.5)
+ */
+static VALUE
+ca_add(VALUE self, VALUE y)
+{
+    NUMBER *qy;
+    setup_math_error();
+    rb_check_frozen(self);
+
+    if (FIXNUM_P(y) && FIX2LONG(y) == 0) {
+        return self;
+    }
+    qy = value_to_number(y, 0);
+    accum_add((calc_accum *) DATA_PTR(self), qy->num, qy->den);
+    qfree(qy);
+    return self;
+}
+
+/* Adds the product of two numbers to the accumulator
+ *
+ * Equivalent to `add(y * z)` but skips reducing the product.
+ *
+ * @param y [Numeric,Calc::Q]
+ * @param z [Numeric,Calc::Q]
+ * @return [Calc::Accumulator] self
+ * @example
+ *  Calc::Accumulator.new(1).addmul(2, Calc::Q(1, 4)).value #=> Calc::Q(1.5)
+ */
+static VALUE
+ca_addmul(VALUE self, VALUE y, VALUE z)
+{
+    NUMBER *qy, *qz;
+    setup_math_error();
+    rb_check_frozen(self);
+
+    qy = value_to_number(y, 0);
+    qz = value_to_number(z, 0);
+    accum_addmul((calc_accum *) DATA_PTR(self), qy->num, qy->den, qz->num, qz->den);
+    qfree(qy);
+    qfree(qz);
+    return self;
+}
+
+/* Multiplies the accumulator by a number
+ *
+ * The numerator and denominator are not reduced until the value is read.
+ *
+ * @param y [Numeric,Calc::Q]
+ * @return [Calc::Accumulator] self
+ * @example
+ *  Calc::Accumulator.new(3).mul(Calc::Q(2, 3)).value #=> Calc::Q(2)
+ */
+static VALUE
+ca_mul(VALUE self, VALUE y)
+{
+    NUMBER *qy;
+    setup_math_error();
+    rb_check_frozen(self);
+
+    qy = value_to_number(y, 0);
+    accum_mul((calc_accum *) DATA_PTR(self), qy->num, qy->den);
+    qfree(qy);
+    return self;
+}
+
+/* Subtracts a number from the accumulator
+ *
+ * @param y [Numeric,Calc::Q]
+ * @return [Calc::Accumulator] self
+ * @example
+ *  Calc::Accumulator.new(1).sub(Calc::Q(1, 4)).value #=> Calc::Q(0.75)
+ */
+static VALUE
+ca_sub(VALUE self, VALUE y)
+{
+    NUMBER *qy;
+    ZVALUE n;
+    setup_math_error();
+    rb_check_frozen(self);
+
+    qy = value_to_number(y, 0);
+    n = qy->num;
+    n.sign = !n.sign;
+    accum_add((calc_accum *) DATA_PTR(self), n, qy->den);
+    qfree(qy);
+    return self;
+}
+
+/* Returns the current value of the accumulator
+ *
+ * The internal numerator and denominator are reduced to lowest terms.
+ *
+ * @return [Calc::Q]
+ * @example
+ *  Calc::Accumulator.new.add(Calc::Q(1, 6)).add(Calc::Q(1, 3)).value
+ *    #=> Calc::Q(0.5)
+ */
+static VALUE
+ca_value(VALUE self)
+{
+    setup_math_error();
+    return wrap_number(accum_to_number((calc_accum *) DATA_PTR(self)));
+}
+
+void
+define_calc_accumulator(VALUE m)
+{
+    cAccumulator = rb_define_class_under(m, "Accumulator", rb_cObject);
+    rb_define_alloc_func(cAccumulator, ca_alloc);
+    rb_define_method(cAccumulator, "initialize", ca_initialize, -1);
+    rb_define_method(cAccumulator, "initialize_copy", ca_initialize_copy, 1);
+    rb_define_method(cAccumulator, "add", ca_add, 1);
+    rb_define_method(cAccumulator, "addmul", ca_addmul, 2);
+    rb_define_method(cAccumulator, "mul", ca_mul, 1);
+    rb_define_method(cAccumulator, "sub", ca_sub, 1);
+    rb_define_method(cAccumulator, "value", ca_value, 0);
+    rb_define_alias(cAccumulator, "to_q", "value");
+}
@@ -0,0 +1,380 @@
+#include <math.h>
+#include <time.h>
+#include "calc.h"
+
+/* arithmetic-geometric mean evaluation of pi and ln for huge precision.
+ *
+ * each AGM step is a full precision multiplication and square root, and
+ * about log2(bits) steps are needed, so for a million digits these beat
+ * summing a series (even by binary splitting, see bsplit.c), depending on how
+ * fast libcalc's multiplication is.  the crossovers are config options
+ * "agm_digits" (ln and log) and "agm_pi_digits" (pi), which Calc.tune_agm
+ * sets by timing both methods on this machine.
+ *
+ * pi uses Brent-Salamin (Gauss-Legendre):
+ *   a = 1, b = 1/sqrt(2), t = 1/4, then repeatedly
+ *   a' = (a + b)/2, b' = sqrt(ab), t' = t - 2^j (a - a')^2
+ *   pi ~= (a + b)^2 / 4t
+ *
+ * ln uses, for s > 2^(bits/2):
+ *   ln(s) ~= pi / 2 AGM(1, 4/s)
+ * with the argument scaled by a power of 2 to make it big enough.
+ *
+ * everything runs with the GVL held, like the rest of libcalc.
+ */
+
+/* bits computed beyond those implied by epsilon */
+#define AGM_GUARD_BITS 32
+
+/* rounding of results to epsilon (round to nearest, like qln) */
+#define AGM_ROUNDING 24L
+
+/* bits per decimal digit */
+#define BITS_PER_DIGIT 3.321928094887362
+
+/* use AGM when epsilon is smaller than 10^-agm_digits (or pi is wanted to
+ * more than agm_pi_digits); 0 to never use it */
+static long agm_digits = 100000;
+static long agm_pi_digits = 0;
+
+/* returns 2^-bits */
+static NUMBER *
+bit_epsilon(long bits)
+{
+    return qscale(&_qone_, -bits);
+}
+
+/* returns z * 2^-bits as a NUMBER; frees z */
+static NUMBER *
+fixed_to_number(ZVALUE z, long bits)
+{
+    NUMBER *q, *result;
+
+    q = qalloc();
+    q->num = z;
+    result = qscale(q, -bits);
+    qfree(q);
+    return result;
+}
+
+/* res = one of the cached constants times 2^bits, within a few units */
+static void
+constant_fixed(int which, long bits, ZVALUE * res)
+{
+    NUMBER *eps, *c;
+    ZVALUE t;
+
+    eps = bit_epsilon(bits + 2);
+    c = constant_value(which, eps);
+    qfree(eps);
+    zshift(c->num, bits, &t);
+    zquo(t, c->den, res, 0);
+    zfree(t);
+    qfree(c);
+}
+
+/* replaces a and b (fixed point, scaled by 2^w) with their AGM */
+static void
+agm_fixed(ZVALUE * a, ZVALUE * b, long w)
+{
+    ZVALUE d, t1, t2;
+
+    for (;;) {
+        zsub(*a, *b, &d);
+        /* the square roots are truncated, so a and b can end up differing in
+         * the last few bits without converging */
+        if (ziszero(d) || zhighbit(d) < 4) {
+            zfree(d);
+            break;
+        }
+        zfree(d);
+        zadd(*a, *b, &t1);
+        zmul(*a, *b, &t2);
+        zfree(*a);
+        zfree(*b);
+        zshift(t1, -1, a);
+        zfree(t1);
+        zsqrt(t2, b, 0);
+        zfree(t2);
+    }
+}
+
+/* res = pi * 2^bits, within a few units */
+void
+agm_pi_fixed(long bits, ZVALUE * res)
+{
+    ZVALUE a, b, t, an, d, t1, t2;
+    long w, j;
+
+    w = bits + AGM_GUARD_BITS;
+    zbitvalue(w, &a);
+    zbitvalue(2 * w - 1, &t1);
+    zsqrt(t1, &b, 0);
+    zfree(t1);
+    zbitvalue(w - 2, &t);
+    for (j = 0;; j++) {
+        zsub(a, b, &d);
+        if (ziszero(d) || zhighbit(d) < 4) {
+            zfree(d);
+            break;
+        }
+        zfree(d);
+        zadd(a, b, &t1);
+        zshift(t1, -1, &an);
+        zfree(t1);
+        zmul(a, b, &t1);
+        zfree(b);
+        zsqrt(t1, &b, 0);
+        zfree(t1);
+        /* t -= 2^j (a - a')^2 */
+        zsub(a, an, &d);
+        zfree(a);
+        a = an;
+        zsquare(d, &t1);
+        zfree(d);
+        zshift(t1, j - w, &t2);
+        zfree(t1);
+        zsub(t, t2, &t1);
+        zfree(t2);
+        zfree(t);
+        t = t1;
+    }
+    /* pi = (a + b)^2 / 4t */
+    zadd(a, b, &t1);
+    zfree(a);
+    zfree(b);
+    zsquare(t1, &t2);
+    zfree(t1);
+    zshift(t, 2 + AGM_GUARD_BITS, &t1);
+    zfree(t);
+    zquo(t2, t1, res, 0);
+    zfree(t1);
+    zfree(t2);
+}
+
+/* res = ln(q) * 2^bits, within a few units.  q must be positive. */
+static void
+agm_ln_fixed(NUMBER * q, long bits, ZVALUE * res)
+{
+    ZVALUE a, b, pi, ln2, t1, t2;
+    long k, m, w, e;
+
+    /* s = q * 2^(m-k) is in [2^m, 2^(m+1)), big enough that the error in
+     * pi / 2 AGM(1, 4/s) (about ln(s) / s^2) is below 2^-bits.  4/s needs
+     * bits significant bits, so the AGM works with m more. */
+    k = qilog2(q);
+    m = bits / 2 + 8;
+    w = bits + m + 8;
+
+    /* b = 4/s = 2^(2-m+k) / q */
+    zbitvalue(w, &a);
+    e = w + 2 - m + k;
+    if (e >= 0) {
+        zshift(q->den, e, &t1);
+        zquo(t1, q->num, &b, 0);
+    }
+    else {
+        zshift(q->num, -e, &t1);
+        zquo(q->den, t1, &b, 0);
+    }
+    zfree(t1);
+    agm_fixed(&a, &b, w);
+    zfree(b);
+
+    /* ln(q) = pi / 2 AGM - (m-k) ln(2) */
+    constant_fixed(CONST_PI, w, &pi);
+    zshift(pi, w - 1, &t1);
+    zfree(pi);
+    zquo(t1, a, &t2, 0);
+    zfree(t1);
+    zfree(a);
+    constant_fixed(CONST_LN2, w, &ln2);
+    zmuli(ln2, m - k, &t1);
+    zfree(ln2);
+    zsub(t2, t1, &a);
+    zfree(t1);
+    zfree(t2);
+    zshift(a, bits - w, res);
+    zfree(a);
+}
+
+/* bits of accuracy implied by epsilon, or 0 if AGM shouldn't be used for it */
+static long
+agm_bits(NUMBER * epsilon)
+{
+    long bits;
+
+    /* libcalc reports invalid epsilons */
+    if (agm_digits <= 0 || qiszero(epsilon) || qisneg(epsilon)) {
+        return 0;
+    }
+    bits = -qilog2(epsilon);
+    if (bits <= agm_digits * BITS_PER_DIGIT) {
+        return 0;
+    }
+    return bits + AGM_GUARD_BITS;
+}
+
+/* ln(q) rounded to epsilon.  uses bsplit_ln (and so maybe libcalc's qln)
+ * unless epsilon is smaller than config("agm_digits") */
+NUMBER *
+agm_ln(NUMBER * q, NUMBER * epsilon)
+{
+    NUMBER *t, *result;
+    ZVALUE z;
+    long bits;
+
+    bits = agm_bits(epsilon);
+    if (!bits || qisneg(q) || qiszero(q) || qisone(q)) {
+        return bsplit_ln(q, epsilon);
+    }
+    agm_ln_fixed(q, bits, &z);
+    t = fixed_to_number(z, bits);
+    result = qmappr(t, epsilon, AGM_ROUNDING);
+    qfree(t);
+    return result;
+}
+
+/* log10(q) rounded to epsilon.  uses libcalc's qlog unless epsilon is smaller
+ * than config("agm_digits") */
+NUMBER *
+agm_log(NUMBER * q, NUMBER * epsilon)
+{
+    NUMBER *t, *result;
+    ZVALUE ln, ln10, t1, t2;
+    long bits;
+
+    bits = agm_bits(epsilon);
+    if (!bits || qisneg(q) || qiszero(q) || qisone(q)) {
+        return qlog(q, epsilon);
+    }
+    /* ln(10) > 2, so dividing by it doesn't increase the error */
+    agm_ln_fixed(q, bits, &ln);
+    constant_fixed(CONST_LN10, bits, &ln10);
+    zshift(ln, bits, &t1);
+    zfree(ln);
+    zquo(t1, ln10, &t2, 0);
+    zfree(t1);
+    zfree(ln10);
+    t = fixed_to_number(t2, bits);
+    result = qmappr(t, epsilon, AGM_ROUNDING);
+    qfree(t);
+    return result;
+}
+
+/* whether the constant cache should compute pi to bits using AGM */
+BOOL
+agm_pi_wanted(long bits)
+{
+    return agm_pi_digits > 0 && bits > agm_pi_digits * BITS_PER_DIGIT;
+}
+
+long
+agm_get_digits(void)
+{
+    return agm_digits;
+}
+
+void
+agm_set_digits(long n)
+{
+    agm_digits = n;
+}
+
+long
+agm_get_pi_digits(void)
+{
+    return agm_pi_digits;
+}
+
+void
+agm_set_pi_digits(long n)
+{
+    agm_pi_digits = n;
+}
+
+/* returns seconds of cpu time used since start */
+static double
+seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Sets the AGM crossovers by timing both methods on this machine
+ *
+ * ln (of 10/7) and pi are computed to 1000, 2000, 4000 ... digits, up to
+ * max_digits, with and without AGM.  Config "agm_digits" is set to the first
+ * precision at which AGM was faster for ln, and "agm_pi_digits" for pi; if
+ * AGM was never faster the option is set to 0 (never use AGM).
+ *
+ * This can take a while (several seconds for the default max_digits).
+ *
+ * @param max_digits [Integer] (optional) highest precision to try (default 100000)
+ * @return [Hash] the new values of :agm_digits and :agm_pi_digits
+ * @example
+ *  Calc.tune_agm #=> {:agm_digits=>16000, :agm_pi_digits=>0}
+ */
+VALUE
+calc_tune_agm(int argc, VALUE * argv, VALUE self)
+{
+    VALUE max, result;
+    NUMBER *q, *eps, *eps2, *t;
+    ZVALUE z;
+    clock_t start;
+    double series, agm;
+    long max_digits, digits, bits, ln_digits, pi_digits;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "01", &max);
+    max_digits = NIL_P(max) ? 100000 : NUM2LONG(max);
+    q = iitoq(10, 7);
+    ln_digits = pi_digits = 0;
+    for (digits = 1000; digits <= max_digits && !(ln_digits && pi_digits); digits *= 2) {
+        bits = (long) (digits * BITS_PER_DIGIT);
+        eps = bit_epsilon(bits);
+        /* don't count the time to compute the constants the first time (AGM
+         * ln works with about 1.5 times as many bits) */
+        eps2 = bit_epsilon(2 * bits);
+        qfree(constant_value(CONST_PI, eps2));
+        qfree(constant_value(CONST_LN2, eps2));
+        qfree(constant_value(CONST_LN10, eps2));
+        qfree(eps2);
+        if (!ln_digits) {
+            agm_digits = 0;
+            start = clock();
+            t = agm_ln(q, eps);
+            series = seconds_since(start);
+            qfree(t);
+            agm_digits = 1;
+            start = clock();
+            t = agm_ln(q, eps);
+            agm = seconds_since(start);
+            qfree(t);
+            if (agm < series) {
+                ln_digits = digits;
+            }
+        }
+        if (!pi_digits) {
+            start = clock();
+            constant_pi_series(bits, &z);
+            series = seconds_since(start);
+            zfree(z);
+            start = clock();
+            agm_pi_fixed(bits, &z);
+            agm = seconds_since(start);
+            zfree(z);
+            if (agm < series) {
+                pi_digits = digits;
+            }
+        }
+        qfree(eps);
+    }
+    qfree(q);
+    agm_digits = ln_digits;
+    agm_pi_digits = pi_digits;
+
+    result = rb_hash_new();
+    rb_hash_aset(result, ID2SYM(rb_intern("agm_digits")), LONG2NUM(agm_digits));
+    rb_hash_aset(result, ID2SYM(rb_intern("agm_pi_digits")), LONG2NUM(agm_pi_digits));
+    return result;
+}
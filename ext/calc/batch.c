@@ -0,0 +1,278 @@
+#include "calc.h"
+
+/* applying one builtin to many values.
+ *
+ * Calc.pmap converts the inputs and the epsilon once, then calls the libcalc
+ * routine for each value directly, skipping method dispatch and argument
+ * parsing.  the code paths per value are the same as the corresponding
+ * instance methods (see trans_function in q.c and c.c, log_function and
+ * cn_sqrt in numeric.c) so results are identical.
+ *
+ * the values are processed in order in the calling thread.  libcalc can't be
+ * used from more than one native thread at a time (it has global state such
+ * as the NUMBER free list, the config and cached constants), so there is no
+ * way to split this work across native threads.
+ */
+
+/* how the functions in batch_funcs are called */
+#define BATCH_TRANS 0           /* f(x, eps), like trans_function */
+#define BATCH_LOG   1           /* complex version if x <= 0, like log_function */
+#define BATCH_SQRT  2           /* f(x, eps, R), like cn_sqrt */
+
+typedef struct {
+    const char *name;
+    int kind;
+    NUMBER *(*fq) (NUMBER *, NUMBER *); /* real version */
+    COMPLEX *(*fqc) (COMPLEX *, NUMBER *);      /* if fq returns NULL (non-real result) */
+    COMPLEX *(*fc) (COMPLEX *, NUMBER *);       /* complex version for Calc::C values */
+} batch_func;
+
+/* functions which Calc::C implements in ruby (eg, cot) have no complex
+ * version here, those values are passed to the method instead. */
+static const batch_func batch_funcs[] = {
+    {"acos", BATCH_TRANS, qacos, c_acos, c_acos},
+    {"acosh", BATCH_TRANS, qacosh, c_acosh, c_acosh},
+    {"acot", BATCH_TRANS, qacot, NULL, c_acot},
+    {"acoth", BATCH_TRANS, qacoth, c_acoth, c_acoth},
+    {"acsc", BATCH_TRANS, qacsc, c_acsc, c_acsc},
+    {"acsch", BATCH_TRANS, qacsch, c_acsch, c_acsch},
+    {"asec", BATCH_TRANS, qasec, c_asec, c_asec},
+    {"asech", BATCH_TRANS, qasech, c_asech, c_asech},
+    {"asin", BATCH_TRANS, qasin, c_asin, c_asin},
+    {"asinh", BATCH_TRANS, qasinh, NULL, c_asinh},
+    {"atan", BATCH_TRANS, bsplit_atan, NULL, c_atan},
+    {"atanh", BATCH_TRANS, qatanh, c_atanh, c_atanh},
+    {"cos", BATCH_TRANS, qcos, NULL, c_cos},
+    {"cosh", BATCH_TRANS, qcosh, NULL, c_cosh},
+    {"cot", BATCH_TRANS, qcot, NULL, NULL},
+    {"coth", BATCH_TRANS, qcoth, NULL, NULL},
+    {"csc", BATCH_TRANS, qcsc, NULL, NULL},
+    {"csch", BATCH_TRANS, qcsch, NULL, NULL},
+    {"exp", BATCH_TRANS, bsplit_exp, NULL, c_exp},
+    {"ln", BATCH_LOG, agm_ln, c_ln, c_ln},
+    {"log", BATCH_LOG, agm_log, c_log, c_log},
+    {"sec", BATCH_TRANS, qsec, NULL, NULL},
+    {"sech", BATCH_TRANS, qsech, NULL, NULL},
+    {"sin", BATCH_TRANS, qsin, NULL, c_sin},
+    {"sinh", BATCH_TRANS, qsinh, NULL, c_sinh},
+    {"sqrt", BATCH_SQRT, NULL, NULL, NULL},
+    {"tan", BATCH_TRANS, qtan, NULL, NULL},
+    {"tanh", BATCH_TRANS, qtanh, NULL, NULL},
+    {NULL, 0, NULL, NULL, NULL}
+};
+
+/* check for interrupts every this many values */
+#define BATCH_CHECK_INTS 256
+
+static const batch_func *
+find_batch_func(const char *name)
+{
+    const batch_func *f;
+
+    for (f = batch_funcs; f->name; f++) {
+        if (strcmp(f->name, name) == 0)
+            return f;
+    }
+    return NULL;
+}
+
+/* one value of a BATCH_TRANS or BATCH_LOG function */
+static VALUE
+batch_trans(const batch_func * f, VALUE x, NUMBER * qepsilon)
+{
+    NUMBER *qx, *qresult;
+    COMPLEX *cx, *cresult;
+
+    if (CALC_Q_P(x)) {
+        qx = DATA_PTR(x);
+        if (f->kind == BATCH_LOG && (qisneg(qx) || qiszero(qx))) {
+            qresult = NULL;
+        }
+        else {
+            qresult = (*f->fq) (qx, qepsilon);
+        }
+        if (qresult) {
+            return wrap_number(qresult);
+        }
+        if (!f->fqc) {
+            rb_raise(e_MathError, "Unhandled NULL from transcendental function");
+        }
+        cx = comalloc();
+        qfree(cx->real);
+        cx->real = qlink(qx);
+        cresult = (*f->fqc) (cx, qepsilon);
+        comfree(cx);
+    }
+    else {
+        cresult = (*f->fc) (DATA_PTR(x), qepsilon);
+    }
+    if (!cresult) {
+        rb_raise(e_MathError, "Complex transcendental function returned NULL");
+    }
+    return wrap_complex(cresult);
+}
+
+/* one value of sqrt */
+static VALUE
+batch_sqrt(VALUE x, NUMBER * qepsilon, long R)
+{
+    NUMBER *qx, *qtmp;
+    COMPLEX *cresult;
+
+    if (CALC_Q_P(x)) {
+        qx = DATA_PTR(x);
+        if (!qisneg(qx)) {
+            return wrap_number(newton_sqrt(qx, qepsilon, R));
+        }
+        qtmp = qneg(qx);
+        cresult = comalloc();
+        qfree(cresult->imag);
+        cresult->imag = newton_sqrt(qtmp, qepsilon, R);
+        qfree(qtmp);
+        return wrap_complex(cresult);
+    }
+    return wrap_complex(c_sqrt(DATA_PTR(x), qepsilon, R));
+}
+
+/* convert x the same way klass.new(x) would.  if klass is nil, use Calc::C
+ * for complex values and Calc::Q for anything else. */
+static VALUE
+batch_element(VALUE klass, VALUE x)
+{
+    VALUE result;
+    NUMBER *q;
+    COMPLEX *c;
+
+    if (klass == cQ) {
+        return CALC_Q_P(x) ? x : wrap_number(value_to_number(x, 1));
+    }
+    if (klass == cC) {
+        if (CALC_C_P(x)) {
+            return x;
+        }
+        if (RB_TYPE_P(x, T_COMPLEX)) {
+            c = value_to_complex(x);
+        }
+        else {
+            q = value_to_number(x, 1);
+            c = qqtoc(q, &_qzero_);
+            qfree(q);
+        }
+        result = cc_new();
+        DATA_PTR(result) = c;
+        return result;
+    }
+    return value_to_calc(x);
+}
+
+/* apply the builtin called name to each of values.  args are the extra
+ * arguments for the builtin (eg, epsilon).  values are converted to klass
+ * (Calc::Q or Calc::C), or either if klass is nil.  returns an Array. */
+VALUE
+calc_batch(VALUE klass, VALUE values, VALUE name, int argc, VALUE * argv)
+{
+    const batch_func *f;
+    VALUE result, x, epsilon;
+    NUMBER *qepsilon;
+    ID id;
+    long i, n, R = 0;
+    int direct;
+    setup_math_error();
+
+    if (!RB_TYPE_P(values, T_ARRAY)) {
+        values = rb_convert_type(values, T_ARRAY, "Array", "to_a");
+    }
+    if (SYMBOL_P(name)) {
+        name = rb_sym2str(name);
+    }
+    id = rb_intern_str(StringValue(name));
+    f = find_batch_func(StringValueCStr(name));
+    direct = f && (argc <= 1 || (f->kind == BATCH_SQRT && argc == 2));
+
+    /* epsilon is parsed once and kept in a Calc::Q so the GC frees it if
+     * anything below raises */
+    epsilon = Qnil;
+    qepsilon = conf->epsilon;
+    if (direct && argc >= 1) {
+        epsilon = wrap_number(value_to_epsilon(argv[0]));
+        qepsilon = DATA_PTR(epsilon);
+    }
+    if (direct && f->kind == BATCH_SQRT) {
+        R = (argc == 2) ? FIX2LONG(argv[1]) : conf->sqrt;
+    }
+
+    n = RARRAY_LEN(values);
+    result = rb_ary_new2(n);
+    for (i = 0; i < n; i++) {
+        x = batch_element(klass, RARRAY_AREF(values, i));
+        if (!direct || (CALC_C_P(x) && f->kind != BATCH_SQRT && !f->fc)) {
+            x = rb_funcall2(x, id, argc, argv);
+        }
+        else if (f->kind == BATCH_SQRT) {
+            x = batch_sqrt(x, qepsilon, R);
+        }
+        else {
+            x = batch_trans(f, x, qepsilon);
+        }
+        rb_ary_push(result, x);
+        if (i % BATCH_CHECK_INTS == BATCH_CHECK_INTS - 1) {
+            rb_thread_check_ints();
+        }
+    }
+    RB_GC_GUARD(epsilon);
+    return result;
+}
+
+/* Applies a builtin function to every element of an array
+ *
+ * Equivalent to `values.map { |x| Calc::Q(x).name(*args) }` (or Calc::C for
+ * complex values), but converts the inputs and the arguments (eg, epsilon)
+ * once for the whole array.  For the transcendental functions, ln, log and
+ * sqrt libcalc is called directly instead of through the instance method.
+ * Results are identical to calling the method on each value.
+ *
+ * The values are processed in order in the calling thread; libcalc isn't
+ * safe to use from multiple native threads.
+ *
+ * @param values [Array] values to process; anything with `to_a` is accepted
+ * @param name [Symbol,String] name of a Calc::Q/Calc::C instance method
+ * @param args optional arguments passed to each call (eg, epsilon)
+ * @return [Array]
+ * @example
+ *  Calc.pmap([1, 2, 3], :sqrt, "0.001") #=> [Calc::Q(1), Calc::Q(1.414), Calc::Q(1.732)]
+ *  Calc.pmap([-1, 1], :ln)              #=> [Calc::C(3.14159265358979323846i), Calc::Q(0)]
+ */
+VALUE
+calc_pmap(int argc, VALUE * argv, VALUE self)
+{
+    if (argc < 2) {
+        rb_raise(rb_eArgError, "wrong number of arguments (given %d, expected 2+)", argc);
+    }
+    return calc_batch(Qnil, argv[0], argv[1], argc - 2, argv + 2);
+}
+
+/* Applies an instance method to every element of an array
+ *
+ * Equivalent to `values.map { |x| klass.new(x).name(*args) }`, see Calc.pmap.
+ * The transcendental functions also have shortcuts named like the function
+ * with `_many` appended (eg, Calc::Q.sin_many).
+ *
+ * @param values [Array] values to process; anything with `to_a` is accepted
+ * @param name [Symbol,String] name of the instance method
+ * @param args optional arguments passed to each call (eg, epsilon)
+ * @return [Array]
+ * @example
+ *  Calc::Q.many([1, 2], :exp, "0.01") #=> [Calc::Q(2.72), Calc::Q(7.39)]
+ *  Calc::C.many([1, 2], :exp, "0.01") #=> [Calc::Q(2.72), Calc::Q(7.39)]
+ */
+VALUE
+cn_s_many(int argc, VALUE * argv, VALUE klass)
+{
+    if (argc < 2) {
+        rb_raise(rb_eArgError, "wrong number of arguments (given %d, expected 2+)", argc);
+    }
+    if (klass != cQ && klass != cC) {
+        klass = Qnil;
+    }
+    return calc_batch(klass, argv[0], argv[1], argc - 2, argv + 2);
+}
@@ -0,0 +1,365 @@
+#include <math.h>
+#include "calc.h"
+
+/* bernoulli numbers with large indexes from the zeta function.
+ *
+ * libcalc's qbern uses a recurrence in which each number depends on all of
+ * the previous ones, so the first B(n) for large n costs O(n^2) big number
+ * operations.  for even n >= 2:
+ *   B(n) = (-1)^(n/2+1) 2 n! zeta(n) / (2 pi)^n
+ * and the denominator is known exactly (von Staudt-Clausen): D is the product
+ * of the primes p where p-1 divides n.  so B(n) D is an integer which can be
+ * found by computing the right hand side to a little more than its number of
+ * bits and rounding.  zeta(n) is the euler product over primes, of which only
+ * those with p^n < 2^bits matter.
+ *
+ * config "bernoulli_zeta" is the smallest index computed this way (0 for
+ * never); anything smaller, and odd indexes, are left to libcalc.
+ *
+ * everything runs with the GVL held, like the rest of libcalc.
+ */
+
+/* bits computed beyond those in B(n) D (plus 2 log2(n), for the errors in
+ * raising 2 pi to the power n) */
+#define BERNOULLI_GUARD_BITS 32
+
+/* use the zeta formula for even indexes >= this; 0 for never */
+static long bernoulli_zeta = 100;
+
+/* res = z^e */
+static void
+zpowl(ZVALUE z, long e, ZVALUE * res)
+{
+    ZVALUE ze;
+
+    itoz(e, &ze);
+    zpowi(z, ze, res);
+    zfree(ze);
+}
+
+/* whether n is prime (n is small, so trial division is fine) */
+static BOOL
+is_small_prime(long n)
+{
+    long d;
+
+    if (n < 2) {
+        return FALSE;
+    }
+    for (d = 2; d * d <= n; d++) {
+        if (n % d == 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* res = the product of the primes p where p-1 divides n */
+static void
+bernoulli_denominator(long n, ZVALUE * res)
+{
+    ZVALUE t;
+    long d;
+
+    itoz(1, res);
+    for (d = 1; d * d <= n; d++) {
+        if (n % d) {
+            continue;
+        }
+        if (is_small_prime(d + 1)) {
+            zmuli(*res, d + 1, &t);
+            zfree(*res);
+            *res = t;
+        }
+        if (n / d != d && is_small_prime(n / d + 1)) {
+            zmuli(*res, n / d + 1, &t);
+            zfree(*res);
+            *res = t;
+        }
+    }
+}
+
+/* keeps the top w bits of m, adding the number of bits dropped to *e */
+static void
+normalize(ZVALUE * m, long *e, long w)
+{
+    ZVALUE t;
+    long drop;
+
+    drop = zhighbit(*m) + 1 - w;
+    if (drop > 0) {
+        zshift(*m, -drop, &t);
+        zfree(*m);
+        *m = t;
+        *e += drop;
+    }
+}
+
+/* res = 2 pi 2^w, truncated */
+static void
+two_pi_fixed(long w, ZVALUE * res)
+{
+    NUMBER *eps, *pi;
+    ZVALUE t;
+
+    eps = qscale(&_qone_, -(w + 2));
+    pi = constant_value(CONST_PI, eps);
+    qfree(eps);
+    zshift(pi->num, w + 1, &t);
+    zquo(t, pi->den, res, 0);
+    zfree(t);
+    qfree(pi);
+}
+
+/* sets m and e so that m 2^e is (2 pi)^n, with m having w bits which are
+ * correct to within about n units.  two_pi is 2 pi 2^bits, bits >= w. */
+static void
+two_pi_power(long n, long w, ZVALUE two_pi, long bits, ZVALUE * m, long *e)
+{
+    ZVALUE base, t;
+    long bit;
+
+    /* left to right binary powering, keeping w bits */
+    zshift(two_pi, w - bits, &base);
+    zcopy(base, m);
+    *e = -w;
+    for (bit = 0; (n >> bit) > 1; bit++);
+    while (--bit >= 0) {
+        zsquare(*m, &t);
+        zfree(*m);
+        *m = t;
+        *e *= 2;
+        normalize(m, e, w);
+        if ((n >> bit) & 1) {
+            zmul(*m, base, &t);
+            zfree(*m);
+            *m = t;
+            *e -= w;
+            normalize(m, e, w);
+        }
+    }
+    zfree(base);
+}
+
+/* res = 2^w / zeta(n), truncated (n >= 2) */
+static void
+inverse_zeta(long n, long w, ZVALUE * res)
+{
+    ZVALUE pz, pn, t1, t2;
+    long p;
+
+    zbitvalue(w, res);
+    for (p = 2; n * log2((double) p) <= w + 1; p++) {
+        if (!is_small_prime(p)) {
+            continue;
+        }
+        /* res *= 1 - p^-n */
+        itoz(p, &pz);
+        zpowl(pz, n, &pn);
+        zfree(pz);
+        zquo(*res, pn, &t1, 0);
+        zfree(pn);
+        zsub(*res, t1, &t2);
+        zfree(t1);
+        zfree(*res);
+        *res = t2;
+    }
+}
+
+/* bits needed to find B(n) D for even n >= 2; d is D */
+static long
+zeta_bits(long n, ZVALUE d)
+{
+    long b;
+
+    /* b ~= log2 |B(n) D| = log2(2 n! D) - n log2(2 pi), as zeta(n) ~= 1 */
+    b = (long) ((lgamma((double) n + 1) + M_LN2) / M_LN2 + zhighbit(d) + 1
+                - n * log2(2 * M_PI)) + 1;
+    return (b > 0 ? b : 0) + 2 * (long) log2((double) n) + BERNOULLI_GUARD_BITS;
+}
+
+/* B(n) for even n >= 2, by the zeta formula.  fact is n!, and two_pi is
+ * 2 pi 2^bits with bits at least zeta_bits(n). */
+static NUMBER *
+zeta_number(long n, ZVALUE fact, ZVALUE two_pi, long bits)
+{
+    NUMBER *result;
+    ZVALUE d, f, m, iz, num, den, t1, t2;
+    long w, e, s;
+
+    bernoulli_denominator(n, &d);
+    w = zeta_bits(n, d);
+
+    /* |B(n) D| = 2 n! D zeta(n) / (2 pi)^n = f 2^w / (iz m 2^e) */
+    zmul(fact, d, &t1);
+    zshift(t1, 1, &f);
+    zfree(t1);
+    two_pi_power(n, w, two_pi, bits, &m, &e);
+    inverse_zeta(n, w, &iz);
+    zmul(iz, m, &den);
+    zfree(iz);
+    zfree(m);
+    s = w - e;
+    if (s >= 0) {
+        zshift(f, s, &num);
+    }
+    else {
+        zshift(den, -s, &t1);
+        zfree(den);
+        den = t1;
+        zcopy(f, &num);
+    }
+    zfree(f);
+
+    /* round to the nearest integer: floor((2 num + den) / 2 den) */
+    zshift(num, 1, &t1);
+    zfree(num);
+    zadd(t1, den, &t2);
+    zfree(t1);
+    zshift(den, 1, &t1);
+    zfree(den);
+    result = qalloc();
+    zquo(t2, t1, &result->num, 0);
+    zfree(t1);
+    zfree(t2);
+    result->den = d;
+    if ((n / 2) % 2 == 0) {
+        result->num.sign = 1;
+    }
+    return result;
+}
+
+/* whether B(n) should be computed here rather than by libcalc */
+static BOOL
+zeta_wanted(long n)
+{
+    return bernoulli_zeta > 0 && n >= 2 && n >= bernoulli_zeta && !(n & 1);
+}
+
+/* returns the bernoulli number with index z, or NULL if libcalc can't compute
+ * it.  this is what the table in tables.c calls on a miss. */
+NUMBER *
+bernoulli_number(ZVALUE z)
+{
+    NUMBER *result;
+    ZVALUE d, fact, two_pi;
+    long n, bits;
+
+    if (zisneg(z) || zge31b(z) || !zeta_wanted(ztoi(z))) {
+        return qbern(z);
+    }
+    n = ztoi(z);
+    bernoulli_denominator(n, &d);
+    bits = zeta_bits(n, d);
+    zfree(d);
+    zfact(z, &fact);
+    two_pi_fixed(bits, &two_pi);
+    result = zeta_number(n, fact, two_pi, bits);
+    zfree(fact);
+    zfree(two_pi);
+    return result;
+}
+
+long
+bernoulli_get_zeta(void)
+{
+    return bernoulli_zeta;
+}
+
+void
+bernoulli_set_zeta(long n)
+{
+    bernoulli_zeta = n;
+}
+
+/* Returns the bernoulli numbers with indexes a to b
+ *
+ * This is the same as (a..b).map { |n| Calc::Q(n).bernoulli }, except that
+ * what the zeta formula needs for all of the numbers (pi to enough digits for
+ * the largest index, and factorials) is only computed once.  The results are
+ * stored like those of Calc::Q#bernoulli.
+ *
+ * Indexes of at least config("bernoulli_zeta") (default 100) are computed
+ * from the zeta function, which is much faster than libcalc's recurrence for
+ * large indexes (see bench/bernoulli.rb).
+ *
+ * @param a [Integer] first index
+ * @param b [Integer] last index
+ * @return [Array<Calc::Q>]
+ * @raise [Calc::MathError] if a is negative
+ * @example
+ *  Calc.bernoulli_range(10, 14) #=> [Calc::Q(5/66), Calc::Q(0), Calc::Q(-691/2730), Calc::Q(0), Calc::Q(7/6)]
+ */
+VALUE
+calc_bernoulli_range(VALUE self, VALUE a, VALUE b)
+{
+    VALUE result;
+    NUMBER *q;
+    ZVALUE z, d, fact, two_pi, t;
+    long first, last, i, bits, w, fact_n;
+    setup_math_error();
+
+    first = NUM2LONG(a);
+    last = NUM2LONG(b);
+    if (first < 0) {
+        rb_raise(e_MathError, "Bad argument for bernoulli_range");
+    }
+    result = rb_ary_new_capa(last >= first ? last - first + 1 : 0);
+    if (last < first) {
+        return result;
+    }
+    /* zeta_bits isn't monotonic (D(n) varies from one index to the next),
+     * so 2 pi is needed to the most bits any index in the range wants */
+    bits = 0;
+    fact_n = -1;
+    for (i = first + (first & 1); i <= last; i += 2) {
+        if (zeta_wanted(i)) {
+            bernoulli_denominator(i, &d);
+            w = zeta_bits(i, d);
+            zfree(d);
+            if (w > bits) {
+                bits = w;
+            }
+        }
+    }
+    if (bits) {
+        two_pi_fixed(bits, &two_pi);
+    }
+    for (i = first; i <= last; i++) {
+        q = table_bernoulli_stored(i);
+        if (!q && zeta_wanted(i)) {
+            /* fact = i!, from the previous one if there was one */
+            if (fact_n < 0) {
+                itoz(i, &z);
+                zfact(z, &fact);
+                zfree(z);
+            }
+            else {
+                for (fact_n++; fact_n <= i; fact_n++) {
+                    zmuli(fact, fact_n, &t);
+                    zfree(fact);
+                    fact = t;
+                }
+            }
+            fact_n = i;
+            q = zeta_number(i, fact, two_pi, bits);
+            table_bernoulli_store(i, q);
+        }
+        else if (!q) {
+            itoz(i, &z);
+            q = table_bernoulli(z);
+            zfree(z);
+        }
+        if (!q) {
+            rb_raise(e_MathError, "Bad argument for bern");
+        }
+        rb_ary_push(result, wrap_number(q));
+    }
+    if (fact_n >= 0) {
+        zfree(fact);
+    }
+    if (bits) {
+        zfree(two_pi);
+    }
+    return result;
+}
@@ -0,0 +1,551 @@
+#include <math.h>
+#include "calc.h"
+
+/* binary splitting evaluation of series, and exp, ln and atan built on it for
+ * very small epsilons.
+ *
+ * a series with terms
+ *   t(k) = a(k)/b(k) * p(0)p(1)...p(k) / q(0)q(1)...q(k)
+ * where p, q, a and b are small integers is summed by splitting the terms in
+ * half recursively, so that most of the work is a few multiplications of
+ * large, balanced integers (see constants.c for pi, e, ln2 and ln10).
+ *
+ * libcalc's qexp, qln and qatan sum their series one full precision term at a
+ * time, which becomes quadratic (or worse) in the number of digits.  above
+ * config "bsplit_digits" these use the "bit-burst" method instead: the
+ * argument is split into pieces of 16, 32, 64 ... bits, and the function of
+ * each piece (which is a rational with a small numerator) is summed by binary
+ * splitting, then the pieces are combined:
+ *   exp(x + y) = exp(x) exp(y)
+ *   atan(x) = atan(t) + atan((x - t) / (1 + xt))
+ *   atanh(x) = atanh(t) + atanh((x - t) / (1 - xt))
+ *
+ * everything runs with the GVL held, like the rest of libcalc.
+ */
+
+/* bits computed beyond those implied by epsilon */
+#define BSPLIT_GUARD_BITS 32
+
+/* bits in the first piece of an argument; each piece after that doubles */
+#define BSPLIT_FIRST_PIECE 16
+
+/* rounding of results to epsilon (round to nearest, like qexp) */
+#define BSPLIT_ROUNDING 24L
+
+/* bits per decimal digit */
+#define BITS_PER_DIGIT 3.321928094887362
+
+/* use binary splitting when epsilon is smaller than 10^-bsplit_digits; 0 to
+ * never use it */
+static long bsplit_digits = 1000;
+
+/*****************************************************************************
+ * binary splitting                                                          *
+ *****************************************************************************/
+
+void
+bs_free(bs_state * s)
+{
+    zfree(s->P);
+    zfree(s->Q);
+    zfree(s->B);
+    zfree(s->T);
+}
+
+/* s = terms of l followed by terms of r */
+void
+bs_combine(bs_state * l, bs_state * r, bs_state * s)
+{
+    ZVALUE t1, t2, t3;
+
+    /* T = Br*Qr*Tl + Bl*Pl*Tr */
+    zmul(r->B, r->Q, &t1);
+    zmul(t1, l->T, &t2);
+    zfree(t1);
+    zmul(l->B, l->P, &t1);
+    zmul(t1, r->T, &t3);
+    zfree(t1);
+    zadd(t2, t3, &s->T);
+    zfree(t2);
+    zfree(t3);
+    zmul(l->P, r->P, &s->P);
+    zmul(l->Q, r->Q, &s->Q);
+    zmul(l->B, r->B, &s->B);
+}
+
+/* state for terms [n1, n2) of the series f */
+void
+bs_split(bs_term f, void *ctx, long n1, long n2, bs_state * s)
+{
+    bs_state l, r;
+    ZVALUE a;
+    long m;
+
+    if (n2 - n1 == 1) {
+        f(ctx, n1, &s->P, &s->Q, &a, &s->B);
+        zmul(a, s->P, &s->T);
+        zfree(a);
+        return;
+    }
+    m = (n1 + n2) / 2;
+    bs_split(f, ctx, n1, m, &l);
+    bs_split(f, ctx, m, n2, &r);
+    bs_combine(&l, &r, s);
+    bs_free(&l);
+    bs_free(&r);
+}
+
+/* res = floor(sum * 2^bits), where s is the state of a series */
+void
+bs_fixed(bs_state * s, long bits, ZVALUE * res)
+{
+    ZVALUE t1, t2;
+
+    zshift(s->T, bits, &t1);
+    zmul(s->B, s->Q, &t2);
+    zquo(t1, t2, res, 0);
+    zfree(t1);
+    zfree(t2);
+}
+
+/*****************************************************************************
+ * series of the pieces of an argument                                       *
+ *****************************************************************************/
+
+/* a piece of an argument, t = a / 2^e */
+typedef struct {
+    ZVALUE a;
+    ZVALUE a2;                  /* a^2 (negated for atan), for atan and atanh */
+    long e;
+} bs_piece;
+
+/* exp(t) = sum of t^k/k! */
+static void
+exp_piece_term(void *ctx, long k, ZVALUE * p, ZVALUE * q, ZVALUE * a, ZVALUE * b)
+{
+    bs_piece *t = ctx;
+    ZVALUE k1;
+
+    itoz(1, a);
+    itoz(1, b);
+    if (k == 0) {
+        itoz(1, p);
+        itoz(1, q);
+        return;
+    }
+    zcopy(t->a, p);
+    itoz(k, &k1);
+    zshift(k1, t->e, q);
+    zfree(k1);
+}
+
+/* atan(t) = sum of (-1)^k t^(2k+1)/(2k+1), atanh(t) the same without the
+ * alternating sign */
+static void
+atan_piece_term(void *ctx, long k, ZVALUE * p, ZVALUE * q, ZVALUE * a, ZVALUE * b)
+{
+    bs_piece *t = ctx;
+
+    itoz(1, a);
+    itoz(2 * k + 1, b);
+    if (k == 0) {
+        zcopy(t->a, p);
+        zbitvalue(t->e, q);
+        return;
+    }
+    zcopy(t->a2, p);
+    zbitvalue(2 * t->e, q);
+}
+
+/* number of leading zero bits after the point in t = a / 2^e */
+static long
+piece_zero_bits(bs_piece * t)
+{
+    return t->e - zhighbit(t->a) - 1;
+}
+
+/* res = exp(t) * 2^bits */
+static void
+exp_piece(bs_piece * t, long bits, ZVALUE * res)
+{
+    bs_state s;
+    double lg;
+    long n, z;
+
+    /* t < 2^-z; the remainder after n terms is about t^n/n! */
+    z = piece_zero_bits(t);
+    lg = 0;
+    for (n = 1; lg < bits + 4; n++) {
+        lg += z + log2((double) n);
+    }
+    bs_split(exp_piece_term, t, 0, n, &s);
+    bs_fixed(&s, bits, res);
+    bs_free(&s);
+}
+
+/* res = atan(t) * 2^bits (or atanh) */
+static void
+atan_piece(bs_piece * t, BOOL hyperbolic, long bits, ZVALUE * res)
+{
+    bs_state s;
+    ZVALUE a2;
+    long n, z;
+
+    zsquare(t->a, &a2);
+    if (!hyperbolic) {
+        a2.sign = 1;
+    }
+    t->a2 = a2;
+    /* t < 2^-z, each term is smaller than the last by t^2; z >= 2 here */
+    z = piece_zero_bits(t);
+    n = (bits + 4) / (2 * z) + 2;
+    bs_split(atan_piece_term, t, 0, n, &s);
+    bs_fixed(&s, bits, res);
+    bs_free(&s);
+    zfree(a2);
+}
+
+/*****************************************************************************
+ * fixed point functions                                                     *
+ *****************************************************************************/
+
+/* res = exp(x / 2^bits) * 2^bits, for |x| < 2^(bits-1) */
+static void
+exp_fixed(ZVALUE x, long bits, ZVALUE * res)
+{
+    bs_piece t;
+    ZVALUE ax, t1, t2, e;
+    long lo, hi;
+
+    ax = x;
+    ax.sign = 0;
+    zbitvalue(bits, res);
+    for (lo = 0, hi = BSPLIT_FIRST_PIECE; lo < bits; lo = hi, hi *= 2) {
+        if (hi > bits) {
+            hi = bits;
+        }
+        /* bits lo .. hi after the point */
+        zshift(ax, hi - bits, &t1);
+        zshift(ax, lo - bits, &e);
+        zshift(e, hi - lo, &t2);
+        zfree(e);
+        zsub(t1, t2, &t.a);
+        zfree(t1);
+        zfree(t2);
+        if (ziszero(t.a)) {
+            zfree(t.a);
+            continue;
+        }
+        t.a.sign = x.sign;
+        t.e = hi;
+        exp_piece(&t, bits, &e);
+        zfree(t.a);
+        zmul(*res, e, &t1);
+        zfree(e);
+        zfree(*res);
+        zshift(t1, -bits, res);
+        zfree(t1);
+    }
+}
+
+/* res = atan(x / 2^bits) * 2^bits (or atanh), for |x| < 2^(bits-2) */
+static void
+atan_fixed(ZVALUE x, BOOL hyperbolic, long bits, ZVALUE * res)
+{
+    bs_piece t;
+    ZVALUE r, t1, t2, t3;
+    long hi;
+
+    zcopy(x, &r);
+    itoz(0, res);
+    for (hi = BSPLIT_FIRST_PIECE; !ziszero(r); hi *= 2) {
+        if (hi >= bits) {
+            /* the rest of r is the last piece */
+            hi = bits;
+            zcopy(r, &t.a);
+        }
+        else {
+            zshift(r, hi - bits, &t.a);
+        }
+        if (ziszero(t.a)) {
+            zfree(t.a);
+            continue;
+        }
+        t.e = hi;
+        atan_piece(&t, hyperbolic, bits, &t1);
+        zadd(*res, t1, &t2);
+        zfree(t1);
+        zfree(*res);
+        *res = t2;
+        if (hi == bits) {
+            zfree(t.a);
+            break;
+        }
+
+        /* r = (r - t) / (1 +- r t) */
+        zshift(t.a, bits - hi, &t1);
+        zsub(r, t1, &t2);
+        zfree(t1);
+        zshift(t2, bits, &t3);
+        zfree(t2);
+        zmul(r, t.a, &t1);
+        zshift(t1, -hi, &t2);
+        zfree(t1);
+        if (hyperbolic) {
+            t2.sign = !t2.sign;
+        }
+        zbitvalue(bits, &t1);
+        zfree(r);
+        zadd(t1, t2, &r);
+        zfree(t1);
+        zfree(t2);
+        zquo(t3, r, &t1, 0);
+        zfree(t3);
+        zfree(r);
+        r = t1;
+        zfree(t.a);
+    }
+    zfree(r);
+}
+
+/*****************************************************************************
+ * exp, ln and atan                                                          *
+ *****************************************************************************/
+
+/* returns 2^-bits */
+static NUMBER *
+bit_epsilon(long bits)
+{
+    return qscale(&_qone_, -bits);
+}
+
+/* returns floor(q * 2^bits) */
+static void
+number_to_fixed(NUMBER * q, long bits, ZVALUE * res)
+{
+    ZVALUE t;
+
+    zshift(q->num, bits, &t);
+    zquo(t, q->den, res, 0);
+    zfree(t);
+}
+
+/* returns z * 2^-bits as a NUMBER; frees z */
+static NUMBER *
+fixed_to_number(ZVALUE z, long bits)
+{
+    NUMBER *q, *result;
+
+    q = qalloc();
+    q->num = z;
+    result = qscale(q, -bits);
+    qfree(q);
+    return result;
+}
+
+/* returns q + k * ln(2) (within 2^-bits) rounded to epsilon; frees q */
+static NUMBER *
+add_ln2_multiple(NUMBER * q, long k, long bits, NUMBER * epsilon)
+{
+    NUMBER *eps, *ln2, *t1, *t2;
+
+    if (k) {
+        eps = bit_epsilon(bits + (long) log2((double) labs(k)) + 2);
+        ln2 = constant_value(CONST_LN2, eps);
+        qfree(eps);
+        t1 = qmuli(ln2, k);
+        qfree(ln2);
+        t2 = qqadd(q, t1);
+        qfree(t1);
+        qfree(q);
+        q = t2;
+    }
+    t1 = qmappr(q, epsilon, BSPLIT_ROUNDING);
+    qfree(q);
+    return t1;
+}
+
+/* bits of accuracy implied by epsilon, or 0 if binary splitting shouldn't be
+ * used for it */
+static long
+bsplit_bits(NUMBER * epsilon)
+{
+    long bits;
+
+    /* libcalc reports invalid epsilons */
+    if (bsplit_digits <= 0 || qiszero(epsilon) || qisneg(epsilon)) {
+        return 0;
+    }
+    bits = -qilog2(epsilon);
+    if (bits <= bsplit_digits * BITS_PER_DIGIT) {
+        return 0;
+    }
+    return bits + BSPLIT_GUARD_BITS;
+}
+
+/* exp(q) rounded to epsilon.  uses libcalc's qexp unless epsilon is smaller
+ * than config("bsplit_digits") */
+NUMBER *
+bsplit_exp(NUMBER * q, NUMBER * epsilon)
+{
+    NUMBER *eps, *ln2, *t1, *t2;
+    ZVALUE x, res;
+    long bits, k;
+
+    bits = bsplit_bits(epsilon);
+    if (!bits || qiszero(q) || qilog2(q) > 40) {
+        return qexp(q, epsilon);
+    }
+    /* exp(q) = 2^k exp(r), where r = q - k ln(2) and |r| <= ln(2)/2 */
+    eps = bit_epsilon(64);
+    ln2 = constant_value(CONST_LN2, eps);
+    qfree(eps);
+    t1 = qqdiv(q, ln2);
+    qfree(ln2);
+    t2 = qisneg(t1) ? qsub(t1, &_qonehalf_) : qqadd(t1, &_qonehalf_);
+    qfree(t1);
+    k = qtoi(t2);
+    qfree(t2);
+    if (k < -bits) {
+        /* less than epsilon */
+        return qlink(&_qzero_);
+    }
+    /* exp(r) is needed to bits+k bits */
+    bits += k;
+    eps = bit_epsilon(bits + (long) log2((double) labs(k) + 1) + 2);
+    ln2 = constant_value(CONST_LN2, eps);
+    qfree(eps);
+    t1 = qmuli(ln2, k);
+    qfree(ln2);
+    t2 = qsub(q, t1);
+    qfree(t1);
+    number_to_fixed(t2, bits, &x);
+    qfree(t2);
+
+    exp_fixed(x, bits, &res);
+    zfree(x);
+    t1 = fixed_to_number(res, bits - k);
+    t2 = qmappr(t1, epsilon, BSPLIT_ROUNDING);
+    qfree(t1);
+    return t2;
+}
+
+/* ln(q) rounded to epsilon, for q > 0.  uses libcalc's qln unless epsilon is
+ * smaller than config("bsplit_digits") */
+NUMBER *
+bsplit_ln(NUMBER * q, NUMBER * epsilon)
+{
+    ZVALUE m, one, t1, t2, z, res;
+    long bits, k;
+
+    bits = bsplit_bits(epsilon);
+    if (!bits || qisneg(q) || qiszero(q) || qisone(q)) {
+        return qln(q, epsilon);
+    }
+    /* ln(q) = k ln(2) + ln(m) where 3/4 <= m = q/2^k <= 3/2, and
+     * ln(m) = 2 atanh((m-1)/(m+1)) */
+    k = qilog2(q);
+    number_to_fixed(q, bits - k, &m);
+    zbitvalue(bits, &one);
+    zmuli(one, 3, &t1);
+    zshift(t1, -1, &t2);
+    zfree(t1);
+    if (zrel(m, t2) > 0) {
+        k++;
+        zshift(m, -1, &t1);
+        zfree(m);
+        m = t1;
+    }
+    zfree(t2);
+    zsub(m, one, &t1);
+    zshift(t1, bits, &t2);
+    zfree(t1);
+    zadd(m, one, &t1);
+    zquo(t2, t1, &z, 0);
+    zfree(t1);
+    zfree(t2);
+    zfree(m);
+    zfree(one);
+
+    atan_fixed(z, TRUE, bits, &res);
+    zfree(z);
+    return add_ln2_multiple(fixed_to_number(res, bits - 1), k, bits, epsilon);
+}
+
+/* atan(q) rounded to epsilon.  uses libcalc's qatan unless epsilon is smaller
+ * than config("bsplit_digits") */
+NUMBER *
+bsplit_atan(NUMBER * q, NUMBER * epsilon)
+{
+    NUMBER *y, *eps, *pi, *t1, *t2;
+    ZVALUE x, t, one, res;
+    long bits, halvings;
+    BOOL inverted;
+
+    bits = bsplit_bits(epsilon);
+    if (!bits || qiszero(q)) {
+        return qatan(q, epsilon);
+    }
+    /* atan(q) = +-pi/2 - atan(1/q) for |q| > 1 */
+    inverted = (qrel(q, &_qone_) > 0 || qrel(q, &_qnegone_) < 0);
+    y = inverted ? qinv(q) : qlink(q);
+    number_to_fixed(y, bits, &x);
+    qfree(y);
+
+    /* atan(x) = 2 atan(x / (1 + sqrt(1 + x^2))); twice makes |x| < 0.2 */
+    zbitvalue(bits, &one);
+    for (halvings = 0; halvings < 2; halvings++) {
+        zsquare(x, &t);
+        zshift(one, bits, &res);
+        zfree(one);
+        zadd(res, t, &one);
+        zfree(t);
+        zfree(res);
+        zsqrt(one, &t, 0);
+        zfree(one);
+        zbitvalue(bits, &one);
+        zadd(one, t, &res);
+        zfree(t);
+        zshift(x, bits, &t);
+        zfree(x);
+        zquo(t, res, &x, 0);
+        zfree(t);
+        zfree(res);
+    }
+    zfree(one);
+
+    atan_fixed(x, FALSE, bits, &res);
+    zfree(x);
+    t1 = fixed_to_number(res, bits - halvings);
+    if (inverted) {
+        eps = bit_epsilon(bits);
+        pi = constant_value(CONST_PI, eps);
+        qfree(eps);
+        t2 = qscale(pi, -1);
+        qfree(pi);
+        if (qisneg(q)) {
+            pi = qneg(t2);
+            qfree(t2);
+            t2 = pi;
+        }
+        pi = qsub(t2, t1);
+        qfree(t1);
+        qfree(t2);
+        t1 = pi;
+    }
+    t2 = qmappr(t1, epsilon, BSPLIT_ROUNDING);
+    qfree(t1);
+    return t2;
+}
+
+long
+bsplit_get_digits(void)
+{
+    return bsplit_digits;
+}
+
+void
+bsplit_set_digits(long n)
+{
+    bsplit_digits = n;
+}
@@ -120,20 +120,31 @@ trans_function(int argc, VALUE * argv, VALUE self, COMPLEX * (*f) (COMPLEX *, NU
     VALUE result, epsilon;
     COMPLEX *cresult;
     NUMBER *qepsilon;
+    memo_key key;
     setup_math_error();
 
-    if (rb_scan_args(argc, argv, "01", &epsilon) == 0) {
-        cresult = (*f) (DATA_PTR(self), conf->epsilon);
-    }
-    else {
-        qepsilon = value_to_number(epsilon, 1);
-        cresult = (*f) (DATA_PTR(self), qepsilon);
-        qfree(qepsilon);
+    rb_scan_args(argc, argv, "01", &epsilon);
+    qepsilon = NIL_P(epsilon) ? qlink(conf->epsilon) : value_to_epsilon(epsilon);
+    if (memo_enabled()) {
+        memo_key_init(&key, (memo_fn) f, 0);
+        memo_key_complex(&key, DATA_PTR(self));
+        memo_key_number(&key, qepsilon);
+        result = memo_lookup(&key);
+        if (result != Qundef) {
+            qfree(qepsilon);
+            return result;
+        }
     }
+    cresult = (*f) (DATA_PTR(self), qepsilon);
     if (!cresult) {
+        qfree(qepsilon);
         rb_raise(e_MathError, "Complex transcendental function returned NULL");
     }
     result = wrap_complex(cresult);
+    if (memo_enabled()) {
+        memo_store(&key, result);
+    }
+    qfree(qepsilon);
     return result;
 }
 
@@ -141,27 +152,40 @@ static VALUE
 trans_function2(int argc, VALUE * argv, VALUE self,
                 COMPLEX * (f) (COMPLEX *, COMPLEX *, NUMBER *))
 {
-    VALUE arg, epsilon;
+    VALUE arg, epsilon, result;
     COMPLEX *carg, *cresult;
     NUMBER *qepsilon;
+    memo_key key;
     setup_math_error();
 
-    if (rb_scan_args(argc, argv, "11", &arg, &epsilon) == 1) {
-        carg = value_to_complex(arg);
-        cresult = (*f) (DATA_PTR(self), carg, conf->epsilon);
-        comfree(carg);
-    }
-    else {
-        carg = value_to_complex(arg);
-        qepsilon = value_to_number(epsilon, 1);
-        cresult = (*f) (DATA_PTR(self), carg, qepsilon);
-        qfree(qepsilon);
-        comfree(carg);
+    rb_scan_args(argc, argv, "11", &arg, &epsilon);
+    carg = value_to_complex(arg);
+    qepsilon = NIL_P(epsilon) ? qlink(conf->epsilon) : value_to_epsilon(epsilon);
+    if (memo_enabled()) {
+        memo_key_init(&key, (memo_fn) f, 0);
+        memo_key_complex(&key, DATA_PTR(self));
+        memo_key_complex(&key, carg);
+        memo_key_number(&key, qepsilon);
+        result = memo_lookup(&key);
+        if (result != Qundef) {
+            comfree(carg);
+            qfree(qepsilon);
+            return result;
+        }
     }
+    cresult = (*f) (DATA_PTR(self), carg, qepsilon);
     if (!cresult) {
+        comfree(carg);
+        qfree(qepsilon);
         rb_raise(e_MathError, "Complex transcendental function returned NULL");
     }
-    return wrap_complex(cresult);
+    result = wrap_complex(cresult);
+    if (memo_enabled()) {
+        memo_store(&key, result);
+    }
+    comfree(carg);
+    qfree(qepsilon);
+    return result;
 }
 
 /*****************************************************************************
@@ -1,7 +1,8 @@
 #include "calc.h"
 
-/* Frees memory used to store calculated bernoulli numbers.
- * 
+/* Frees memory used to store calculated bernoulli numbers, and removes any
+ * table loaded with Calc.load_bernoulli.
+ *
  * @return [nil]
  * @example
  *  Calc.freebernoulli  #=> nil
@@ -11,10 +12,12 @@ calc_freebernoulli(VALUE self)
 {
     setup_math_error();
     qfreebern();
+    table_free_bernoulli();
     return Qnil;
 }
 
-/* Frees memory used to store calculated euler numbers.
+/* Frees memory used to store calculated euler numbers, and removes any table
+ * loaded with Calc.load_euler.
  *
  * @return [nil]
  * @example
@@ -25,6 +28,7 @@ calc_freeeuler(VALUE self)
 {
     setup_math_error();
     qfreeeuler();
+    table_free_euler();
     return Qnil;
 }
 
@@ -88,11 +92,13 @@ calc_hnrmod(VALUE self, VALUE v, VALUE h, VALUE n, VALUE r)
 }
 
 /* Evaluates п (pi) to a specified accuracy
+ *
+ * The value is cached (see Calc.constant), so repeated calls, and calls for
+ * less accuracy than a previous call, don't compute it again.
  *
  * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
  * @return [Calc::Q]
- * @raise [Calc::MathError] if v, h, n or r are non-integer or h or v < 1
- * @raise [Calc::MathError] if r is not -1, 0 or 1
+ * @raise [Calc::MathError] if eps is not positive
  * @example
  *  Calc.pi          #=> Calc::Q(3.14159265358979323846)
  *  Calc.pi("1e-40") #=> Calc::Q(3.1415926535897932384626433832795028841972)
@@ -104,14 +110,10 @@ calc_pi(int argc, VALUE * argv, VALUE self)
     VALUE epsilon;
     setup_math_error();
 
-    if (rb_scan_args(argc, argv, "01", &epsilon) == 0) {
-        qresult = qpi(conf->epsilon);
-    }
-    else {
-        qepsilon = value_to_number(epsilon, 1);
-        qresult = qpi(qepsilon);
-        qfree(qepsilon);
-    }
+    rb_scan_args(argc, argv, "01", &epsilon);
+    qepsilon = constant_epsilon(epsilon);
+    qresult = constant_value(CONST_PI, qepsilon);
+    qfree(qepsilon);
     return wrap_number(qresult);
 }
 
@@ -135,7 +137,7 @@ calc_polar(int argc, VALUE * argv, VALUE self)
     setup_math_error();
 
     if (rb_scan_args(argc, argv, "21", &radius, &angle, &epsilon) == 3) {
-        qepsilon = value_to_number(epsilon, 1);
+        qepsilon = value_to_epsilon(epsilon);
         if (qisneg(qepsilon) || qiszero(qepsilon)) {
             qfree(qepsilon);
             rb_raise(e_MathError, "Negative or zero epsilon for polar");
@@ -178,15 +180,41 @@ Init_calc(void)
     libcalc_call_me_first();
 
     m = rb_define_module("Calc");
+    rb_define_module_function(m, "bernoulli_cache_size", calc_bernoulli_cache_size, 0);
+    rb_define_module_function(m, "bernoulli_cache_stats", calc_bernoulli_cache_stats, 0);
+    rb_define_module_function(m, "bernoulli_range", calc_bernoulli_range, 2);
     rb_define_module_function(m, "config", calc_config, -1);
+    rb_define_module_function(m, "constant", calc_constant, -1);
+    rb_define_module_function(m, "constant_cache_stats", calc_constant_cache_stats, 0);
+    rb_define_module_function(m, "count_primes", calc_count_primes, -1);
+    rb_define_module_function(m, "dot", calc_dot, 2);
+    rb_define_module_function(m, "each_prime", calc_each_prime, -1);
+    rb_define_module_function(m, "euler_cache_size", calc_euler_cache_size, 0);
+    rb_define_module_function(m, "euler_cache_stats", calc_euler_cache_stats, 0);
+    rb_define_module_function(m, "export_bernoulli", calc_export_bernoulli, -1);
+    rb_define_module_function(m, "export_euler", calc_export_euler, -1);
     rb_define_module_function(m, "freebernoulli", calc_freebernoulli, 0);
     rb_define_module_function(m, "freeeuler", calc_freeeuler, 0);
     rb_define_module_function(m, "hnrmod", calc_hnrmod, 4);
+    rb_define_module_function(m, "load_bernoulli", calc_load_bernoulli, 1);
+    rb_define_module_function(m, "load_euler", calc_load_euler, 1);
+    rb_define_module_function(m, "matmul", calc_matmul, -1);
+    rb_define_module_function(m, "memo_clear", calc_memo_clear, 0);
+    rb_define_module_function(m, "memo_stats", calc_memo_stats, 0);
     rb_define_module_function(m, "pi", calc_pi, -1);
+    rb_define_module_function(m, "pmap", calc_pmap, -1);
     rb_define_module_function(m, "polar", calc_polar, -1);
+    rb_define_module_function(m, "prewarm_constants", calc_prewarm_constants, -1);
+    rb_define_module_function(m, "primes", calc_primes, -1);
+    rb_define_module_function(m, "ptest_many", calc_ptest_many, -1);
+    rb_define_module_function(m, "tune_agm", calc_tune_agm, -1);
     rb_define_module_function(m, "version", calc_version, 0);
     define_calc_math_error(m);
     define_calc_numeric(m);
     define_calc_q(m);
+    define_calc_epsilon(m);
     define_calc_c(m);
+    define_calc_accumulator(m);
+    define_calc_mod_context(m);
+    define_calc_special_mod(m);
 }
@@ -2,6 +2,7 @@
 #define CALC_H 1
 
 #include "ruby.h"
+#include <stdint.h>
 
 /* cannot include calc/calc.h, which contains some things we need, because it
  * includes calc/value.h which defines VALUE, a name already used by ruby.
@@ -14,17 +15,106 @@ extern char *version(void);
 #include <calc/config.h>
 #include <calc/lib_calc.h>
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* accumulator.c */
+typedef struct calc_accum {
+    ZVALUE num;                 /* not necessarily in lowest terms */
+    ZVALUE den;                 /* always positive */
+} calc_accum;
+
+extern const rb_data_type_t calc_accumulator_type;
+extern VALUE cAccumulator;      /* Calc::Accumulator class */
+
+extern void accum_init(calc_accum * a);
+extern void accum_free(calc_accum * a);
+extern void accum_set(calc_accum * a, ZVALUE n, ZVALUE d);
+extern void accum_add(calc_accum * a, ZVALUE n, ZVALUE d);
+extern void accum_mul(calc_accum * a, ZVALUE n, ZVALUE d);
+extern void accum_addmul(calc_accum * a, ZVALUE n1, ZVALUE d1, ZVALUE n2, ZVALUE d2);
+extern void accum_reduce(calc_accum * a);
+extern NUMBER *accum_to_number(calc_accum * a);
+extern void define_calc_accumulator(VALUE m);
+
+/* agm.c */
+extern void agm_pi_fixed(long bits, ZVALUE * res);
+extern NUMBER *agm_ln(NUMBER * q, NUMBER * epsilon);
+extern NUMBER *agm_log(NUMBER * q, NUMBER * epsilon);
+extern BOOL agm_pi_wanted(long bits);
+extern long agm_get_digits(void);
+extern void agm_set_digits(long n);
+extern long agm_get_pi_digits(void);
+extern void agm_set_pi_digits(long n);
+extern VALUE calc_tune_agm(int argc, VALUE * argv, VALUE self);
+
+/* batch.c */
+extern VALUE calc_batch(VALUE klass, VALUE values, VALUE name, int argc, VALUE * argv);
+extern VALUE cn_s_many(int argc, VALUE * argv, VALUE klass);
+extern VALUE calc_pmap(int argc, VALUE * argv, VALUE self);
+
+/* bernoulli.c */
+extern NUMBER *bernoulli_number(ZVALUE z);
+extern long bernoulli_get_zeta(void);
+extern void bernoulli_set_zeta(long n);
+extern VALUE calc_bernoulli_range(VALUE self, VALUE a, VALUE b);
+
+/* bsplit.c */
+typedef void (*bs_term) (void *ctx, long k, ZVALUE * p, ZVALUE * q, ZVALUE * a, ZVALUE * b);
+
+typedef struct {
+    ZVALUE P, Q, B, T;
+} bs_state;
+
+extern void bs_free(bs_state * s);
+extern void bs_combine(bs_state * l, bs_state * r, bs_state * s);
+extern void bs_split(bs_term f, void *ctx, long n1, long n2, bs_state * s);
+extern void bs_fixed(bs_state * s, long bits, ZVALUE * res);
+extern NUMBER *bsplit_exp(NUMBER * q, NUMBER * epsilon);
+extern NUMBER *bsplit_ln(NUMBER * q, NUMBER * epsilon);
+extern NUMBER *bsplit_atan(NUMBER * q, NUMBER * epsilon);
+extern long bsplit_get_digits(void);
+extern void bsplit_set_digits(long n);
+
 /* config.c */
 extern VALUE calc_config(int argc, VALUE * argv, VALUE klass);
 extern long value_to_mode(VALUE v);
 
+/* constants.c */
+#define CONST_PI   0
+#define CONST_E    1
+#define CONST_LN2  2
+#define CONST_LN10 3
+
+extern NUMBER *constant_value(int which, NUMBER * epsilon);
+extern NUMBER *constant_epsilon(VALUE epsilon);
+extern void constant_pi_series(long bits, ZVALUE * res);
+extern VALUE calc_constant(int argc, VALUE * argv, VALUE self);
+extern VALUE calc_constant_cache_stats(VALUE self);
+extern VALUE calc_prewarm_constants(int argc, VALUE * argv, VALUE self);
+
 /* convert.c */
 extern NUMBER *value_to_number(VALUE arg, int string_allowed);
 extern COMPLEX *value_to_complex(VALUE arg);
+extern VALUE value_to_calc(VALUE arg);
 extern long value_to_long(VALUE n);
 extern VALUE wrap_complex(COMPLEX * c);
 extern VALUE wrap_number(NUMBER * n);
 
+/* matrix.c */
+extern VALUE calc_dot(VALUE self, VALUE as, VALUE bs);
+extern VALUE calc_matmul(int argc, VALUE * argv, VALUE self);
+
+/* epsilon.c */
+extern VALUE cEpsilon;          /* Calc::Epsilon class */
+
+extern NUMBER *value_to_epsilon(VALUE arg);
+extern void define_calc_epsilon(VALUE m);
+
+/* factorize.c */
+extern VALUE cq_factorize(int argc, VALUE * argv, VALUE self);
+
 /* math_error.c */
 extern VALUE e_MathError;       /* Calc::MathError class (exception) */
 extern void define_calc_math_error();
@@ -35,13 +125,147 @@ extern void setup_math_error();
 #define setup_math_error() ((void)0)
 #endif
 
+/* memo.c */
+#define MEMO_MAX_KEYS 5
+
+typedef void (*memo_fn) (void);
+
+typedef struct {
+    memo_fn fn;                 /* libcalc function */
+    long extra;                 /* extra non-number argument, or 0 */
+    int n;                      /* operands in k (the last is epsilon) */
+    NUMBER *k[MEMO_MAX_KEYS];
+    unsigned long hash;
+} memo_key;
+
+extern long memo_capacity;
+#define memo_enabled() (memo_capacity > 0)
+
+extern void memo_key_init(memo_key * key, memo_fn fn, long extra);
+extern void memo_key_number(memo_key * key, NUMBER * q);
+extern void memo_key_complex(memo_key * key, COMPLEX * c);
+extern void memo_key_value(memo_key * key, VALUE x);
+extern VALUE memo_lookup(memo_key * key);
+extern void memo_store(memo_key * key, VALUE result);
+extern long memo_get_capacity(void);
+extern void memo_set_capacity(long n);
+extern long memo_get_max_bytes(void);
+extern void memo_set_max_bytes(long n);
+extern VALUE calc_memo_clear(VALUE self);
+extern VALUE calc_memo_stats(VALUE self);
+
+/* mod_context.c */
+extern VALUE cModContext;       /* Calc::ModContext class */
+extern VALUE cResidue;          /* Calc::ModContext::Residue class */
+extern void define_calc_mod_context(VALUE m);
+
+/* mont.c */
+typedef struct {
+    LEN len;
+    HALF *n;
+    HALF ninv;                  /* -1/n mod 2^BASEB */
+    HALF *one;                  /* R mod n, ie 1 in montgomery form */
+    HALF *r2;                   /* R^2 mod n, for converting to montgomery form */
+} mont_t;
+
+/* mont_pow uses windows of up to this many bits, and needs this much scratch
+ * space */
+#define MONT_WINDOW 5
+#define MONT_POW_WORK(len) (((1 << (MONT_WINDOW - 1)) + 1) * (len) + 2)
+
+extern int limbs_less(const HALF * a, const HALF * b, LEN len);
+extern HALF limbs_sub(const HALF * a, const HALF * b, HALF * r, LEN len);
+extern HALF limbs_add(const HALF * a, const HALF * b, HALF * r, LEN len);
+extern void limbs_from_z(ZVALUE z, HALF * r, LEN len);
+extern void limbs_to_z(const HALF * a, LEN len, ZVALUE * res);
+extern void limbs_gcd(const HALF * a, LEN len, ZVALUE n, ZVALUE * g);
+extern void mont_add(const mont_t * m, const HALF * a, const HALF * b, HALF * r);
+extern void mont_sub(const mont_t * m, const HALF * a, const HALF * b, HALF * r);
+extern void mont_half(const mont_t * m, HALF * x);
+extern void mont_mul(const mont_t * m, const HALF * a, const HALF * b, HALF * r, HALF * t);
+extern void mont_small(const mont_t * m, HALF c, HALF * r, HALF * t);
+extern void mont_pow(const mont_t * m, const HALF * a, const HALF * e, LEN elen, HALF * r,
+                     HALF * w);
+extern void mont_setup(mont_t * m);
+extern void mont_init(mont_t * m, ZVALUE n);
+extern void mont_free(mont_t * m);
+
+/* newton.c */
+extern NUMBER *newton_sqrt(NUMBER * q, NUMBER * epsilon, long R);
+extern NUMBER *newton_root(NUMBER * q, NUMBER * n, NUMBER * epsilon);
+extern NUMBER *newton_isqrt(NUMBER * q);
+extern NUMBER *newton_iroot(NUMBER * q, NUMBER * n);
+
 /* numeric.c */
 extern VALUE cNumeric;          /* Calc::Numeric module */
 extern void define_calc_numeric(VALUE m);
 
+/* parallel.c */
+typedef struct calc_parallel {
+    long ntasks;                /* tasks are numbered 0 .. ntasks-1 */
+    void (*task) (struct calc_parallel * p, long id);
+    void *data;                 /* caller's state, shared by all tasks */
+    long next;                  /* next task to hand out */
+    long nthreads;
+    volatile int cancelled;     /* set when ruby wants to interrupt us */
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t lock;
+#endif
+} calc_parallel_t;
+
+extern long calc_get_threads(void);
+extern void calc_set_threads(long n);
+extern long calc_thread_count(VALUE v);
+extern void calc_parallel_run(calc_parallel_t * p, long nthreads);
+
+/* pix.c */
+extern uint64_t pix_lmo(uint64_t x);
+
+/* ptest.c */
+extern BOOL ptest_bpsw(ZVALUE z);
+extern void zmod_nonneg(ZVALUE a, ZVALUE m, ZVALUE * r);
+extern BOOL ptest_bpsw_cand(ZVALUE z, ZVALUE residue, ZVALUE modulus, BOOL next, ZVALUE * cand);
+extern VALUE calc_ptest_many(int argc, VALUE * argv, VALUE self);
+
+/* qs.c */
+extern BOOL qs_split(ZVALUE n, long nthreads, ZVALUE * f);
+
+/* sieve.c */
+extern VALUE calc_count_primes(int argc, VALUE * argv, VALUE self);
+extern VALUE calc_each_prime(int argc, VALUE * argv, VALUE self);
+extern VALUE calc_primes(int argc, VALUE * argv, VALUE self);
+
+/* special_mod.c */
+extern VALUE cSpecialMod;       /* Calc::SpecialMod class */
+extern void define_calc_special_mod(VALUE m);
+
+/* tables.c */
+extern NUMBER *table_bernoulli(ZVALUE z);
+extern NUMBER *table_bernoulli_stored(long i);
+extern void table_bernoulli_store(long i, NUMBER * q);
+extern NUMBER *table_euler(ZVALUE z);
+extern void table_free_bernoulli(void);
+extern void table_free_euler(void);
+extern VALUE calc_bernoulli_cache_size(VALUE self);
+extern VALUE calc_bernoulli_cache_stats(VALUE self);
+extern VALUE calc_euler_cache_size(VALUE self);
+extern VALUE calc_euler_cache_stats(VALUE self);
+extern VALUE calc_export_bernoulli(int argc, VALUE * argv, VALUE self);
+extern VALUE calc_export_euler(int argc, VALUE * argv, VALUE self);
+extern VALUE calc_load_bernoulli(VALUE self, VALUE path);
+extern VALUE calc_load_euler(VALUE self, VALUE path);
+
+/* trig.c */
+extern void sincos_number(NUMBER * x, NUMBER * epsilon, NUMBER ** s, NUMBER ** c);
+extern void sinhcosh_number(NUMBER * x, NUMBER * epsilon, NUMBER ** s, NUMBER ** c);
+extern void sincos_complex(COMPLEX * z, NUMBER * epsilon, COMPLEX ** s, COMPLEX ** c);
+extern void sinhcosh_complex(COMPLEX * z, NUMBER * epsilon, COMPLEX ** s, COMPLEX ** c);
+extern COMPLEX *cis_complex(COMPLEX * z, NUMBER * epsilon);
+
 /* q.c (rational numbers) */
 extern const rb_data_type_t calc_q_type;
 extern VALUE cQ;                /* Calc::Q class */
+extern VALUE cArithmeticSequence;       /* Calc::ArithmeticSequence class */
 
 extern VALUE cq_alloc(VALUE klass);
 extern void define_calc_q(VALUE m);
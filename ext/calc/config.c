@@ -28,6 +28,16 @@ static nametype2 modes[] = {
     {NULL, 0}
 };
 
+/* ruby-calc's own config types (not in libcalc), numbered clear of libcalc's
+ * CONFIG_* values */
+#define RCONFIG_THREADS 1000
+#define RCONFIG_MEMO 1001
+#define RCONFIG_MEMO_BYTES 1002
+#define RCONFIG_BSPLIT_DIGITS 1003
+#define RCONFIG_AGM_DIGITS 1004
+#define RCONFIG_AGM_PI_DIGITS 1005
+#define RCONFIG_BERNOULLI_ZETA 1006
+
 /* config types we support - a subset of "configs[]" in calc's config.c */
 
 static nametype2 configs[] = {
@@ -42,6 +52,13 @@ static nametype2 configs[] = {
     {"cfappr", CONFIG_CFAPPR},
     {"cfsim", CONFIG_CFSIM},
     {"round", CONFIG_ROUND},
+    {"threads", RCONFIG_THREADS},
+    {"memo", RCONFIG_MEMO},
+    {"memo_bytes", RCONFIG_MEMO_BYTES},
+    {"bsplit_digits", RCONFIG_BSPLIT_DIGITS},
+    {"agm_digits", RCONFIG_AGM_DIGITS},
+    {"agm_pi_digits", RCONFIG_AGM_PI_DIGITS},
+    {"bernoulli_zeta", RCONFIG_BERNOULLI_ZETA},
     {NULL, 0}
 };
 
@@ -154,6 +171,27 @@ value_to_len(VALUE v, const char *name)
  */
 
 /* Gets or sets a libcalc configuration type.
+ *
+ * "threads" is specific to ruby-calc: it is the number of native threads used
+ * by methods which can split up their work (such as Calc.matmul).  0 (the
+ * default) means one per online processor.
+ *
+ * "memo" and "memo_bytes" are also specific to ruby-calc: the number of
+ * results of transcendental functions to remember (0, the default, disables
+ * this) and the most memory those results may use (0 for no limit).  see
+ * Calc.memo_stats.
+ *
+ * "bsplit_digits" is the number of digits (of epsilon) above which exp, ln
+ * and atan of rational numbers are computed by binary splitting instead of
+ * libcalc's series.  the default is 1000; 0 means never.
+ *
+ * "agm_digits" and "agm_pi_digits" are the number of digits above which ln
+ * and log (default 100000), and pi (default 0, never) are computed using the
+ * arithmetic-geometric mean.  Calc.tune_agm sets both by timing.
+ *
+ * "bernoulli_zeta" is the smallest index for which Calc::Q#bernoulli uses
+ * the zeta function instead of libcalc's recurrence.  the default is 100; 0
+ * means never.
  */
 VALUE
 calc_config(int argc, VALUE * argv, VALUE klass)
@@ -232,6 +270,48 @@ calc_config(int argc, VALUE * argv, VALUE klass)
             conf->round = value_to_len(new_value, "round");
         break;
 
+    case RCONFIG_THREADS:
+        old_value = LONG2FIX(calc_get_threads());
+        if (args == 2)
+            calc_set_threads(value_to_len(new_value, "threads"));
+        break;
+
+    case RCONFIG_MEMO:
+        old_value = LONG2FIX(memo_get_capacity());
+        if (args == 2)
+            memo_set_capacity(value_to_len(new_value, "memo"));
+        break;
+
+    case RCONFIG_MEMO_BYTES:
+        old_value = LONG2FIX(memo_get_max_bytes());
+        if (args == 2)
+            memo_set_max_bytes(value_to_len(new_value, "memo_bytes"));
+        break;
+
+    case RCONFIG_BSPLIT_DIGITS:
+        old_value = LONG2FIX(bsplit_get_digits());
+        if (args == 2)
+            bsplit_set_digits(value_to_len(new_value, "bsplit_digits"));
+        break;
+
+    case RCONFIG_AGM_DIGITS:
+        old_value = LONG2FIX(agm_get_digits());
+        if (args == 2)
+            agm_set_digits(value_to_len(new_value, "agm_digits"));
+        break;
+
+    case RCONFIG_AGM_PI_DIGITS:
+        old_value = LONG2FIX(agm_get_pi_digits());
+        if (args == 2)
+            agm_set_pi_digits(value_to_len(new_value, "agm_pi_digits"));
+        break;
+
+    case RCONFIG_BERNOULLI_ZETA:
+        old_value = LONG2FIX(bernoulli_get_zeta());
+        if (args == 2)
+            bernoulli_set_zeta(value_to_len(new_value, "bernoulli_zeta"));
+        break;
+
     default:
         rb_raise(rb_eArgError, "Invalid or unsupported config parameter");
     }
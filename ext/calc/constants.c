@@ -0,0 +1,453 @@
+#include <math.h>
+#include "calc.h"
+
+/* process-wide cache of the constants pi, e, ln(2) and ln(10).
+ *
+ * libcalc's qpi() only remembers the value for the last epsilon it was
+ * called with, anything else is computed from scratch.  here each constant is
+ * kept as an integer V ~= constant * 2^bits, and any request for an epsilon
+ * coarser than that is answered by rounding V.
+ *
+ * the constants are sums of series computed by binary splitting (bsplit.c).
+ * the sum of the first n terms is T/(B*Q) for four integers P, Q, B, T, and
+ * the state for terms [n, m) can be folded into the state for [0, n), so when
+ * more precision is wanted only the extra terms are summed.  above config
+ * "agm_pi_digits", pi is computed by AGM instead (agm.c).
+ *
+ * everything here runs with the GVL held, like the rest of libcalc.
+ */
+
+/* extra bits computed beyond those implied by epsilon, so that rounding V to
+ * epsilon gives the same result as rounding the exact value */
+#define CONST_GUARD_BITS 32
+#define CONST_MIN_BITS   64
+
+/* rounding used for the result (round to nearest, as qpi does by default) */
+#define CONST_ROUNDING 24L
+
+typedef struct {
+    bs_term term;
+    long terms;                 /* number of terms summed in st */
+    bs_state st;
+} bs_series;
+
+typedef struct {
+    const char *name;
+    void (*compute) (long bits, ZVALUE * res);
+    long bits;                  /* precision of value, 0 if not computed yet */
+    ZVALUE value;               /* floor(constant * 2^bits) */
+    NUMBER *last_epsilon;       /* most recent request and its result */
+    NUMBER *last;
+    long hits;                  /* requests answered from value */
+    long misses;                /* requests which needed more bits */
+} cached_constant;
+
+/*****************************************************************************
+ * series terms                                                              *
+ *****************************************************************************/
+
+/* Chudnovsky: sum = 426880 * sqrt(10005) / pi */
+static void
+pi_term(void *ctx, long k, ZVALUE * p, ZVALUE * q, ZVALUE * a, ZVALUE * b)
+{
+    ZVALUE t1, t2;
+
+    itoz(1, b);
+    if (k == 0) {
+        itoz(1, p);
+        itoz(1, q);
+        itoz(13591409, a);
+        return;
+    }
+    /* p = -(6k-5)(2k-1)(6k-1) */
+    itoz(-(6 * k - 5), &t1);
+    zmuli(t1, 2 * k - 1, &t2);
+    zfree(t1);
+    zmuli(t2, 6 * k - 1, p);
+    zfree(t2);
+    /* q = k^3 * 640320^3 / 24 = k^3 * 26680 * 640320^2 */
+    itoz(k, &t1);
+    zmuli(t1, k, &t2);
+    zfree(t1);
+    zmuli(t2, k, &t1);
+    zfree(t2);
+    zmuli(t1, 26680, &t2);
+    zfree(t1);
+    zmuli(t2, 640320, &t1);
+    zfree(t2);
+    zmuli(t1, 640320, q);
+    zfree(t1);
+    /* a = 13591409 + 545140134k */
+    itoz(k, &t1);
+    zmuli(t1, 545140134, &t2);
+    zfree(t1);
+    itoz(13591409, &t1);
+    zadd(t1, t2, a);
+    zfree(t1);
+    zfree(t2);
+}
+
+/* sum of 1/k! = e */
+static void
+e_term(void *ctx, long k, ZVALUE * p, ZVALUE * q, ZVALUE * a, ZVALUE * b)
+{
+    itoz(1, p);
+    itoz(k == 0 ? 1 : k, q);
+    itoz(1, a);
+    itoz(1, b);
+}
+
+/* sum of 1/((2k+1) x^2k) = x * atanh(1/x) */
+static void
+atanh_term(long x, long k, ZVALUE * p, ZVALUE * q, ZVALUE * a, ZVALUE * b)
+{
+    itoz(1, p);
+    itoz(k == 0 ? 1 : x * x, q);
+    itoz(1, a);
+    itoz(2 * k + 1, b);
+}
+
+static void
+atanh3_term(void *ctx, long k, ZVALUE * p, ZVALUE * q, ZVALUE * a, ZVALUE * b)
+{
+    atanh_term(3, k, p, q, a, b);
+}
+
+static void
+atanh9_term(void *ctx, long k, ZVALUE * p, ZVALUE * q, ZVALUE * a, ZVALUE * b)
+{
+    atanh_term(9, k, p, q, a, b);
+}
+
+/* make sure at least the first n terms of s are summed */
+static void
+series_extend(bs_series * s, long n)
+{
+    bs_state r, t;
+
+    if (n <= s->terms) {
+        return;
+    }
+    bs_split(s->term, NULL, s->terms, n, &r);
+    if (s->terms == 0) {
+        s->st = r;
+    }
+    else {
+        bs_combine(&s->st, &r, &t);
+        bs_free(&s->st);
+        bs_free(&r);
+        s->st = t;
+    }
+    s->terms = n;
+}
+
+/* res = floor(sum * num / den * 2^bits) */
+static void
+series_fixed(bs_series * s, long bits, long num, long den, ZVALUE * res)
+{
+    ZVALUE t1, t2, t3;
+
+    zmuli(s->st.T, num, &t1);
+    zshift(t1, bits, &t2);
+    zfree(t1);
+    zmul(s->st.B, s->st.Q, &t1);
+    zmuli(t1, den, &t3);
+    zfree(t1);
+    zquo(t2, t3, res, 0);
+    zfree(t2);
+    zfree(t3);
+}
+
+/*****************************************************************************
+ * the constants                                                             *
+ *****************************************************************************/
+
+static bs_series pi_series = { pi_term, 0 };
+static bs_series e_series = { e_term, 0 };
+static bs_series atanh3_series = { atanh3_term, 0 };
+static bs_series atanh9_series = { atanh9_term, 0 };
+
+/* number of terms of 1/((2k+1) x^2k) needed for bits */
+static long
+atanh_terms(long x, long bits)
+{
+    return (long) (bits / (2 * log2((double) x))) + 2;
+}
+
+/* pi from the first terms of the Chudnovsky series, extending s as needed */
+static void
+series_pi(bs_series * s, long bits, ZVALUE * res)
+{
+    ZVALUE t1, t2;
+
+    /* each term adds log2(640320^3/1728) ~= 47.11 bits */
+    series_extend(s, bits / 47 + 2);
+    /* pi = 426880 * sqrt(10005) * B * Q / T */
+    zbitvalue(2 * bits, &t1);
+    zmuli(t1, 10005, &t2);
+    zfree(t1);
+    zsqrt(t2, &t1, 0);
+    zfree(t2);
+    zmuli(t1, 426880, &t2);
+    zfree(t1);
+    zmul(t2, s->st.B, &t1);
+    zfree(t2);
+    zmul(t1, s->st.Q, &t2);
+    zfree(t1);
+    zquo(t2, s->st.T, res, 0);
+    zfree(t2);
+}
+
+static void
+compute_pi(long bits, ZVALUE * res)
+{
+    if (agm_pi_wanted(bits)) {
+        agm_pi_fixed(bits, res);
+    }
+    else {
+        series_pi(&pi_series, bits, res);
+    }
+}
+
+/* res = pi * 2^bits, summing the series from scratch (for timing it against
+ * agm_pi_fixed) */
+void
+constant_pi_series(long bits, ZVALUE * res)
+{
+    bs_series s = { pi_term, 0 };
+
+    series_pi(&s, bits, res);
+    bs_free(&s.st);
+}
+
+static void
+compute_e(long bits, ZVALUE * res)
+{
+    double lg = 0;
+    long n = 1;
+
+    /* the remainder after n terms is less than 2/n! */
+    while (lg < bits + 2) {
+        lg += log2((double) ++n);
+    }
+    series_extend(&e_series, n);
+    series_fixed(&e_series, bits, 1, 1, res);
+}
+
+static void
+compute_ln2(long bits, ZVALUE * res)
+{
+    /* ln(2) = 2 atanh(1/3) */
+    series_extend(&atanh3_series, atanh_terms(3, bits));
+    series_fixed(&atanh3_series, bits, 2, 3, res);
+}
+
+static void
+compute_ln10(long bits, ZVALUE * res)
+{
+    ZVALUE t1, t2, t3;
+
+    /* ln(10) = 3 ln(2) + ln(5/4) = 3 ln(2) + 2 atanh(1/9) */
+    compute_ln2(bits, &t1);
+    zmuli(t1, 3, &t2);
+    zfree(t1);
+    series_extend(&atanh9_series, atanh_terms(9, bits));
+    series_fixed(&atanh9_series, bits, 2, 9, &t3);
+    zadd(t2, t3, res);
+    zfree(t2);
+    zfree(t3);
+}
+
+/* in the order of the CONST_ values in calc.h */
+static cached_constant constants[] = {
+    {"pi", compute_pi},
+    {"e", compute_e},
+    {"ln2", compute_ln2},
+    {"ln10", compute_ln10},
+};
+
+#define CONST_COUNT ((int) (sizeof(constants) / sizeof(constants[0])))
+
+/* returns one of the constants rounded to a multiple of epsilon (which must be
+ * positive).  the result is a new reference. */
+NUMBER *
+constant_value(int which, NUMBER * epsilon)
+{
+    cached_constant *c = &constants[which];
+    NUMBER *q, *approx, *result;
+    ZVALUE value;
+    long need;
+
+    if (c->last && !qcmp(epsilon, c->last_epsilon)) {
+        c->hits++;
+        return qlink(c->last);
+    }
+    need = CONST_GUARD_BITS - qilog2(epsilon);
+    if (need < CONST_MIN_BITS) {
+        need = CONST_MIN_BITS;
+    }
+    if (need <= c->bits) {
+        c->hits++;
+    }
+    else {
+        /* grow by at least half again, so a series of slightly more precise
+         * requests doesn't recompute the final division every time */
+        if (need < c->bits + c->bits / 2) {
+            need = c->bits + c->bits / 2;
+        }
+        /* compute into a temporary, so if compute raises the cache still
+         * holds the old value */
+        c->compute(need, &value);
+        if (c->bits) {
+            zfree(c->value);
+        }
+        c->value = value;
+        c->bits = need;
+        c->misses++;
+    }
+    q = qalloc();
+    zcopy(c->value, &q->num);
+    approx = qscale(q, -c->bits);
+    qfree(q);
+    result = qmappr(approx, epsilon, CONST_ROUNDING);
+    qfree(approx);
+
+    if (c->last) {
+        qfree(c->last);
+        qfree(c->last_epsilon);
+    }
+    c->last = qlink(result);
+    c->last_epsilon = qlink(epsilon);
+    return result;
+}
+
+/* find a constant by name (String or Symbol) */
+static int
+constant_index(VALUE name)
+{
+    const char *s;
+    int i;
+
+    if (SYMBOL_P(name)) {
+        name = rb_sym2str(name);
+    }
+    s = StringValueCStr(name);
+    for (i = 0; i < CONST_COUNT; i++) {
+        if (strcmp(constants[i].name, s) == 0) {
+            return i;
+        }
+    }
+    rb_raise(rb_eArgError, "unknown constant: %s", s);
+    return -1;
+}
+
+/* converts an optional epsilon argument (nil for the config epsilon), raising
+ * if it isn't positive.  the result is a new reference. */
+NUMBER *
+constant_epsilon(VALUE epsilon)
+{
+    NUMBER *qepsilon;
+
+    if (NIL_P(epsilon)) {
+        return qlink(conf->epsilon);
+    }
+    qepsilon = value_to_epsilon(epsilon);
+    if (qisneg(qepsilon) || qiszero(qepsilon)) {
+        qfree(qepsilon);
+        rb_raise(e_MathError, "Epsilon value must be greater than zero");
+    }
+    return qepsilon;
+}
+
+/* Evaluates a mathematical constant to a specified accuracy
+ *
+ * The constants are cached for the life of the process.  Once a constant has
+ * been computed, requests for the same or less accuracy are answered by
+ * rounding the cached value, and requests for more accuracy extend the
+ * cached series instead of starting again.
+ *
+ * @param name [Symbol,String] one of :pi, :e, :ln2 or :ln10
+ * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
+ * @return [Calc::Q]
+ * @raise [ArgumentError] if name isn't a known constant
+ * @raise [Calc::MathError] if eps is not positive
+ * @example
+ *  Calc.constant(:e)           #=> Calc::Q(2.71828182845904523536)
+ *  Calc.constant(:ln2, "1e-5") #=> Calc::Q(0.69315)
+ */
+VALUE
+calc_constant(int argc, VALUE * argv, VALUE self)
+{
+    NUMBER *qepsilon, *qresult;
+    VALUE name, epsilon;
+    int which;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "11", &name, &epsilon);
+    which = constant_index(name);
+    qepsilon = constant_epsilon(epsilon);
+    qresult = constant_value(which, qepsilon);
+    qfree(qepsilon);
+    return wrap_number(qresult);
+}
+
+/* Returns statistics about the constant cache
+ *
+ * For each constant: the number of bits held (bits, 0 if it hasn't been
+ * computed), the equivalent number of decimal digits (digits), requests
+ * answered from the cache (hits) and requests which needed more precision
+ * (misses).
+ *
+ * @return [Hash]
+ * @example
+ *  Calc.pi("1e-100")
+ *  Calc.constant_cache_stats[:pi] #=> {:bits=>365, :digits=>109, :hits=>0, :misses=>1}
+ */
+VALUE
+calc_constant_cache_stats(VALUE self)
+{
+    VALUE result, stats;
+    cached_constant *c;
+    int i;
+
+    result = rb_hash_new();
+    for (i = 0; i < CONST_COUNT; i++) {
+        c = &constants[i];
+        stats = rb_hash_new();
+        rb_hash_aset(stats, ID2SYM(rb_intern("bits")), LONG2NUM(c->bits));
+        rb_hash_aset(stats, ID2SYM(rb_intern("digits")), LONG2NUM((long) (c->bits * log10(2.0))));
+        rb_hash_aset(stats, ID2SYM(rb_intern("hits")), LONG2NUM(c->hits));
+        rb_hash_aset(stats, ID2SYM(rb_intern("misses")), LONG2NUM(c->misses));
+        rb_hash_aset(result, ID2SYM(rb_intern(c->name)), stats);
+    }
+    return result;
+}
+
+/* Computes all cached constants to a specified accuracy
+ *
+ * Calling this while an application boots moves the cost of computing pi,
+ * e, ln(2) and ln(10) out of the first requests which need them.  Later
+ * requests for the same or less accuracy are answered from the cache.
+ *
+ * @param eps [Numeric,Calc::Q] (optional) accuracy to prepare for
+ * @return [nil]
+ * @raise [Calc::MathError] if eps is not positive
+ * @example
+ *  Calc.prewarm_constants("1e-1000")
+ */
+VALUE
+calc_prewarm_constants(int argc, VALUE * argv, VALUE self)
+{
+    NUMBER *qepsilon;
+    VALUE epsilon;
+    int i;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "01", &epsilon);
+    qepsilon = constant_epsilon(epsilon);
+    for (i = 0; i < CONST_COUNT; i++) {
+        qfree(constant_value(i, qepsilon));
+    }
+    qfree(qepsilon);
+    return Qnil;
+}
@@ -135,6 +135,30 @@ value_to_complex(VALUE arg)
     return cresult;
 }
 
+/* convert a ruby numeric value into a Calc::Q or Calc::C object.  Allowed
+ * types are the same as value_to_complex; the result is only a Calc::C if
+ * there is a non-zero imaginary part (or arg was already a Calc::C).
+ */
+VALUE
+value_to_calc(VALUE arg)
+{
+    NUMBER *re, *im;
+    COMPLEX *c;
+
+    if (CALC_Q_P(arg) || CALC_C_P(arg)) {
+        return arg;
+    }
+    if (RB_TYPE_P(arg, T_COMPLEX)) {
+        re = value_to_number(rb_funcall(arg, rb_intern("real"), 0), 0);
+        im = value_to_number(rb_funcall(arg, rb_intern("imag"), 0), 0);
+        c = qqtoc(re, im);
+        qfree(re);
+        qfree(im);
+        return wrap_complex(c);
+    }
+    return wrap_number(value_to_number(arg, 0));
+}
+
 /* get a long out of a ruby VALUE.  if it is fractional, or too big to be
  * represented, raises an error */
 long
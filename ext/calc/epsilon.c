@@ -0,0 +1,145 @@
+#include "calc.h"
+
+/* Document-class: Calc::Epsilon
+ *
+ * A frozen Calc::Q which is used as the accuracy of a calculation.
+ *
+ * Methods which take an epsilon argument accept a String, Rational, Float
+ * etc, which would otherwise be converted to a libcalc number on every call.
+ * Instead, epsilon arguments are looked up in an intern table, so a string
+ * such as "1e-40" is parsed once.  The table holds Calc::Epsilon objects;
+ * Calc::Epsilon.new returns the same object for equal arguments, and passing
+ * one (or any Calc::Q) as an epsilon needs no conversion at all.
+ *
+ * @example
+ *  eps = Calc::Epsilon.new("1e-40") #=> Calc::Epsilon(1e-40)
+ *  Calc::Q(2).sqrt(eps)              #=> Calc::Q(1.4142135623730950488016887242096980785697)
+ */
+VALUE cEpsilon;
+
+/* interned values, keyed by the argument they were created from */
+static VALUE epsilon_table = Qnil;
+
+/* the table is cleared when it gets this big, in case a program uses lots
+ * of distinct epsilons (eg, computed ones) */
+#define EPSILON_TABLE_MAX 256
+
+/* returns a new Calc::Epsilon for q (which is linked) */
+static VALUE
+epsilon_new(NUMBER * q)
+{
+    VALUE result;
+
+    result = cq_alloc(cEpsilon);
+    DATA_PTR(result) = qlink(q);
+    return rb_obj_freeze(result);
+}
+
+/* returns the interned Calc::Epsilon for arg, or nil if arg isn't a valid
+ * epsilon (not positive).  arg must not be a Calc::Q. */
+static VALUE
+epsilon_intern(VALUE arg)
+{
+    VALUE result;
+    NUMBER *q;
+
+    result = rb_hash_lookup2(epsilon_table, arg, Qundef);
+    if (result != Qundef) {
+        return result;
+    }
+    q = value_to_number(arg, 1);
+    if (qisneg(q) || qiszero(q)) {
+        qfree(q);
+        return Qnil;
+    }
+    result = epsilon_new(q);
+    qfree(q);
+    if (RHASH_SIZE(epsilon_table) >= EPSILON_TABLE_MAX) {
+        rb_hash_clear(epsilon_table);
+    }
+    /* rb_hash_aset stores a frozen copy of string keys */
+    rb_hash_aset(epsilon_table, arg, result);
+    return result;
+}
+
+/* converts an epsilon argument to a NUMBER*, like value_to_number(arg, 1).
+ * Calc::Q values (including Calc::Epsilon) and small integers are used
+ * directly; anything else is looked up in the intern table.  the caller is
+ * responsible for freeing the result. */
+NUMBER *
+value_to_epsilon(VALUE arg)
+{
+    VALUE e;
+
+    if (CALC_Q_P(arg)) {
+        return qlink((NUMBER *) DATA_PTR(arg));
+    }
+    if (FIXNUM_P(arg)) {
+        return itoq(FIX2LONG(arg));
+    }
+    if (RB_TYPE_P(arg, T_STRING) || RB_TYPE_P(arg, T_RATIONAL) || RB_TYPE_P(arg, T_FLOAT)
+        || RB_TYPE_P(arg, T_BIGNUM)) {
+        e = epsilon_intern(arg);
+        if (!NIL_P(e)) {
+            return qlink((NUMBER *) DATA_PTR(e));
+        }
+    }
+    /* invalid values are converted normally, the caller decides if they are
+     * an error */
+    return value_to_number(arg, 1);
+}
+
+/* Returns a frozen epsilon value
+ *
+ * Equal arguments (other than Calc::Q objects) return the same object.
+ *
+ * @param value [String,Numeric,Calc::Q] a number greater than zero
+ * @return [Calc::Epsilon]
+ * @raise [Calc::MathError] if value is not greater than zero
+ * @example
+ *  Calc::Epsilon.new("1e-40") #=> Calc::Epsilon(1e-40)
+ *  Calc::Epsilon.new(Rational(1, 1000)).equal?(Calc::Epsilon.new(Rational(1, 1000))) #=> true
+ */
+static VALUE
+ce_s_new(VALUE klass, VALUE value)
+{
+    VALUE result;
+    NUMBER *q;
+    setup_math_error();
+
+    if (rb_obj_is_kind_of(value, cEpsilon)) {
+        return value;
+    }
+    if (CALC_Q_P(value)) {
+        q = DATA_PTR(value);
+        result = (qisneg(q) || qiszero(q)) ? Qnil : epsilon_new(q);
+    }
+    else {
+        result = epsilon_intern(value);
+    }
+    if (NIL_P(result)) {
+        rb_raise(e_MathError, "Epsilon value must be greater than zero");
+    }
+    return result;
+}
+
+/* Returns the number of values in the epsilon intern table
+ *
+ * @return [Integer]
+ */
+static VALUE
+ce_s_interned(VALUE klass)
+{
+    return LONG2NUM(RHASH_SIZE(epsilon_table));
+}
+
+void
+define_calc_epsilon(VALUE m)
+{
+    cEpsilon = rb_define_class_under(m, "Epsilon", cQ);
+    rb_define_singleton_method(cEpsilon, "interned", ce_s_interned, 0);
+    rb_define_singleton_method(cEpsilon, "new", ce_s_new, 1);
+
+    epsilon_table = rb_hash_new();
+    rb_gc_register_address(&epsilon_table);
+}
@@ -26,4 +26,15 @@ else
   end
 end
 
+# native threads for splitting up large calculations (eg, Calc.matmul).  if
+# these aren't available, the work is done in ruby's thread.
+have_func("rb_thread_call_without_gvl", "ruby/thread.h")
+if have_header("pthread.h")
+  have_library("pthread", "pthread_create")
+end
+
+# mmap for sharing bernoulli and euler tables between processes.  without it,
+# loaded tables are read into memory.
+have_header("sys/mman.h")
+
 create_makefile("calc/calc")
@@ -0,0 +1,763 @@
+#include <stdlib.h>
+#include <string.h>
+#include "calc.h"
+
+/* complete factorization of integers for Calc::Q#factorize.
+ *
+ * small factors are removed by trial division.  each remaining part is then
+ * either prime (by zprimetest), a perfect power (split with zroot), or split
+ * in two by pollard-brent rho, which finds factors of up to about 40 bits, or
+ * else by the elliptic curve method (ecm), whose time depends on the size of
+ * the factor found rather than of the number.  parts are split until they are
+ * all prime.
+ *
+ * rho and ecm do their arithmetic directly on the HALF digits of the number n
+ * being split, in montgomery form (see mont.c), so there is no division in a
+ * multiplication mod n.
+ *
+ * ecm curves are independent of each other, so a batch of them is given to
+ * calc_parallel_run.  like all tasks run that way (see parallel.c), curves
+ * only do plain C work on malloc()ed memory; each one leaves two residues
+ * whose gcd with n is taken once the batch has finished.
+ */
+
+/* trial division by primes below this */
+#define TRIAL_LIMIT 65536
+
+/* rho steps before giving up on a value of c, and steps between gcds */
+#define RHO_ITERATIONS (1L << 18)
+#define RHO_BATCH 128
+
+/* values of c tried by rho */
+#define RHO_TRIES 3
+
+/* ecm stage 2 covers primes up to ECM_B2_MULT * B1, in steps of ECM_D */
+#define ECM_B2_MULT 50
+#define ECM_D 2310
+
+/* ways of splitting parts which trial division leaves */
+#define FACTORIZE_ECM 0         /* rho then ecm */
+#define FACTORIZE_QS 1          /* the quadratic sieve (see qs.c) */
+
+/* suyama parameter of the first curve */
+#define ECM_FIRST_SIGMA 6
+
+/* stage 1 bound and number of curves for finding factors of about 15, 20,
+ * 25, 30, 35 and 40 digits.  the last level is repeated until a factor is
+ * found (or the thread is interrupted). */
+static const struct {
+    long b1;
+    long curves;
+} ecm_levels[] = {
+    {2000, 25},
+    {11000, 90},
+    {50000, 300},
+    {250000, 700},
+    {1000000, 1800},
+    {3000000, 5100},
+};
+
+#define ECM_LEVELS ((long) (sizeof(ecm_levels) / sizeof(ecm_levels[0])))
+
+/* primes below TRIAL_LIMIT */
+static HALF trial_primes[6542];
+static long trial_count = 0;
+
+typedef struct {
+    ZVALUE z;
+    long e;
+} factor_entry;
+
+typedef struct {
+    factor_entry *v;
+    long n;
+    long size;
+} factor_list;
+
+typedef struct {
+    factor_list primes;         /* the result */
+    factor_list todo;           /* parts not yet known to be prime */
+    long nthreads;
+    int method;
+    mont_t m;                   /* modulus for rho and ecm */
+    HALF *work;                 /* rho's variables */
+    unsigned char *composite;   /* ecm: bit i set if 2i+1 is composite */
+    long b1, b2;                /* ecm: bounds of the current level */
+    long sigma;                 /* ecm: suyama parameter of the batch's first curve */
+    HALF *out;                  /* ecm: 2 residues of m.len HALFs per curve */
+    char *failed;               /* ecm: set for curves which ran out of memory */
+} factorize_state;
+
+static void
+init_trial_primes(void)
+{
+    unsigned char composite[TRIAL_LIMIT];
+    long i, j;
+
+    if (trial_count) {
+        return;
+    }
+    memset(composite, 0, sizeof(composite));
+    for (i = 2; i < TRIAL_LIMIT; i++) {
+        if (composite[i]) {
+            continue;
+        }
+        trial_primes[trial_count++] = (HALF) i;
+        for (j = i * i; j < TRIAL_LIMIT; j += i) {
+            composite[j] = 1;
+        }
+    }
+}
+
+/* adds z^e to list, which takes ownership of z.  if the list already has z,
+ * its exponent is increased. */
+static void
+list_add(factor_list * list, ZVALUE z, long e)
+{
+    long i;
+
+    for (i = 0; i < list->n; i++) {
+        if (!zcmp(list->v[i].z, z)) {
+            list->v[i].e += e;
+            zfree(z);
+            return;
+        }
+    }
+    if (list->n == list->size) {
+        list->size = list->size ? list->size * 2 : 16;
+        REALLOC_N(list->v, factor_entry, list->size);
+    }
+    list->v[list->n].z = z;
+    list->v[list->n].e = e;
+    list->n++;
+}
+
+static void
+list_free(factor_list * list)
+{
+    long i;
+
+    for (i = 0; i < list->n; i++) {
+        zfree(list->v[i].z);
+    }
+    xfree(list->v);
+    list->v = NULL;
+    list->n = list->size = 0;
+}
+
+static int
+compare_factors(const void *a, const void *b)
+{
+    return zrel(((const factor_entry *) a)->z, ((const factor_entry *) b)->z);
+}
+
+/* the next rho step: x = x^2 + c */
+static void
+rho_step(const mont_t * m, HALF * x, const HALF * c, HALF * t)
+{
+    mont_mul(m, x, x, x, t);
+    mont_add(m, x, c, x);
+}
+
+/* pollard-brent rho with x -> x^2 + c.  returns TRUE and sets f to a factor
+ * of n (1 < f < n) if one is found in RHO_ITERATIONS steps. */
+static BOOL
+rho(factorize_state * s, ZVALUE n, HALF c, ZVALUE * f)
+{
+    const mont_t *m = &s->m;
+    LEN len = m->len;
+    HALF *x, *y, *ys, *q, *d, *cc, *t;
+    long r, k, i, lim, steps = 0;
+    ZVALUE g;
+    BOOL found = FALSE;         /* g holds a gcd other than 1 */
+
+    x = s->work;
+    y = x + len;
+    ys = y + len;
+    q = ys + len;
+    d = q + len;
+    cc = d + len;
+    t = cc + len;
+    mont_small(m, c, cc, t);
+    mont_small(m, 2, y, t);
+    memcpy(q, m->one, len * sizeof(HALF));
+    for (r = 1; !found && steps < RHO_ITERATIONS; r *= 2) {
+        memcpy(x, y, len * sizeof(HALF));
+        for (i = 0; i < r; i++) {
+            rho_step(m, y, cc, t);
+        }
+        for (k = 0; k < r && !found; k += lim) {
+            memcpy(ys, y, len * sizeof(HALF));
+            lim = r - k < RHO_BATCH ? r - k : RHO_BATCH;
+            for (i = 0; i < lim; i++) {
+                rho_step(m, y, cc, t);
+                mont_sub(m, x, y, d);
+                mont_mul(m, q, d, q, t);
+            }
+            limbs_gcd(q, len, n, &g);
+            found = !zisunit(g);
+            if (!found) {
+                zfree(g);
+            }
+        }
+        steps += 2 * r;
+        if (!found) {
+            rb_thread_check_ints();
+        }
+    }
+    if (!found) {
+        return FALSE;
+    }
+    if (!zcmp(g, n)) {
+        /* overshot: go back to the last gcd and take one step at a time */
+        do {
+            zfree(g);
+            rho_step(m, ys, cc, t);
+            mont_sub(m, x, ys, d);
+            limbs_gcd(d, len, n, &g);
+        } while (zisunit(g));
+    }
+    if (!zcmp(g, n)) {
+        zfree(g);
+        return FALSE;
+    }
+    *f = g;
+    return TRUE;
+}
+
+/* a point on a montgomery curve b y^2 = x^3 + a x^2 + x, as X:Z */
+typedef struct {
+    HALF *x;
+    HALF *z;
+} ecm_point;
+
+typedef struct {
+    const mont_t *m;
+    HALF *t;                    /* scratch space for mont_mul */
+    HALF *u, *v, *w, *y;        /* temporaries */
+    HALF *a24n, *a24d;          /* (a + 2) / 4 = a24n / a24d */
+} ecm_curve;
+
+/* r = 2p.  r may be p. */
+static void
+ecm_dbl(const ecm_curve * c, ecm_point p, ecm_point r)
+{
+    const mont_t *m = c->m;
+
+    mont_add(m, p.x, p.z, c->u);
+    mont_mul(m, c->u, c->u, c->u, c->t);
+    mont_sub(m, p.x, p.z, c->v);
+    mont_mul(m, c->v, c->v, c->v, c->t);
+    mont_sub(m, c->u, c->v, c->w);
+    mont_mul(m, c->v, c->a24d, c->v, c->t);
+    mont_mul(m, c->u, c->v, r.x, c->t);
+    mont_mul(m, c->w, c->a24n, c->u, c->t);
+    mont_add(m, c->u, c->v, c->u);
+    mont_mul(m, c->w, c->u, r.z, c->t);
+}
+
+/* r = p + q, where d = p - q.  r may be p or q but not d. */
+static void
+ecm_add(const ecm_curve * c, ecm_point p, ecm_point q, ecm_point d, ecm_point r)
+{
+    const mont_t *m = c->m;
+
+    mont_sub(m, p.x, p.z, c->u);
+    mont_add(m, q.x, q.z, c->v);
+    mont_mul(m, c->u, c->v, c->u, c->t);
+    mont_add(m, p.x, p.z, c->v);
+    mont_sub(m, q.x, q.z, c->w);
+    mont_mul(m, c->v, c->w, c->v, c->t);
+    mont_add(m, c->u, c->v, c->w);
+    mont_mul(m, c->w, c->w, c->w, c->t);
+    mont_sub(m, c->u, c->v, c->y);
+    mont_mul(m, c->y, c->y, c->y, c->t);
+    mont_mul(m, d.z, c->w, r.x, c->t);
+    mont_mul(m, d.x, c->y, r.z, c->t);
+}
+
+/* r0 = k p and r1 = (k + 1) p by montgomery's ladder (k >= 1).  p must not be
+ * r0 or r1. */
+static void
+ecm_ladder(const ecm_curve * c, ecm_point p, unsigned long k, ecm_point r0, ecm_point r1)
+{
+    LEN len = c->m->len;
+    int bit;
+
+    memcpy(r0.x, p.x, len * sizeof(HALF));
+    memcpy(r0.z, p.z, len * sizeof(HALF));
+    ecm_dbl(c, p, r1);
+    for (bit = 0; (k >> bit) > 1; bit++);
+    while (--bit >= 0) {
+        if ((k >> bit) & 1) {
+            ecm_add(c, r0, r1, p, r0);
+            ecm_dbl(c, r1, r1);
+        }
+        else {
+            ecm_add(c, r0, r1, p, r1);
+            ecm_dbl(c, r0, r0);
+        }
+    }
+}
+
+/* whether the odd number k is prime, from the state's sieve */
+#define ecm_prime(s, k) (!((s)->composite[(k) >> 4] & (1 << (((k) >> 1) & 7))))
+
+/* HALFs of working memory needed by a curve */
+#define ECM_WORK(len) ((len) * (10 + 2 * 6 + 2 * (ECM_D / 4 + 1)))
+
+/* one curve, with suyama's parameterization for sigma.  leaves the Z
+ * coordinate after stage 1 in out, and the product for stage 2 in out + len.
+ * runs without the GVL. */
+static void
+ecm_task(calc_parallel_t * par, long id)
+{
+    factorize_state *s = (factorize_state *) par->data;
+    const mont_t *m = &s->m;
+    LEN len = m->len;
+    HALF *ws, *sigma, *k, *z1, *acc;
+    ecm_curve c;
+    ecm_point p, r0, r1, dq, g0, g1, *baby;
+    long q, j, kd, kmin, kmax, b1 = s->b1, b2 = s->b2;
+    unsigned long pk;
+    int i;
+
+    ws = malloc(ECM_WORK(len) * sizeof(HALF));
+    baby = malloc((ECM_D / 4 + 1) * sizeof(ecm_point));
+    if (!ws || !baby) {
+        free(ws);
+        free(baby);
+        s->failed[id] = 1;
+        return;
+    }
+    c.m = m;
+    c.t = ws;
+    c.u = c.t + len + 2;
+    c.v = c.u + len;
+    c.w = c.v + len;
+    c.y = c.w + len;
+    c.a24n = c.y + len;
+    c.a24d = c.a24n + len;
+    sigma = c.a24d + len;
+    k = sigma + len;
+    p.x = k + len;
+    p.z = p.x + len;
+    r0.x = p.z + len;
+    r0.z = r0.x + len;
+    r1.x = r0.z + len;
+    r1.z = r1.x + len;
+    dq.x = r1.z + len;
+    dq.z = dq.x + len;
+    g0.x = dq.z + len;
+    g0.z = g0.x + len;
+    g1.x = g0.z + len;
+    g1.z = g1.x + len;
+    for (i = 0; i < ECM_D / 4 + 1; i++) {
+        baby[i].x = g1.z + len * (1 + 2 * i);
+        baby[i].z = baby[i].x + len;
+    }
+
+    /* u = sigma^2 - 5, v = 4 sigma, x = u^3, z = v^3,
+     * (a + 2) / 4 = (v - u)^3 (3u + v) / (16 u^3 v) */
+    mont_small(m, (HALF) (s->sigma + id), sigma, c.t);
+    mont_mul(m, sigma, sigma, c.u, c.t);
+    mont_small(m, 5, k, c.t);
+    mont_sub(m, c.u, k, c.u);
+    mont_small(m, 4, k, c.t);
+    mont_mul(m, sigma, k, c.v, c.t);
+    mont_mul(m, c.u, c.u, p.x, c.t);
+    mont_mul(m, p.x, c.u, p.x, c.t);
+    mont_mul(m, c.v, c.v, p.z, c.t);
+    mont_mul(m, p.z, c.v, p.z, c.t);
+    mont_sub(m, c.v, c.u, c.w);
+    mont_mul(m, c.w, c.w, c.a24n, c.t);
+    mont_mul(m, c.a24n, c.w, c.a24n, c.t);
+    mont_small(m, 3, k, c.t);
+    mont_mul(m, c.u, k, c.w, c.t);
+    mont_add(m, c.w, c.v, c.w);
+    mont_mul(m, c.a24n, c.w, c.a24n, c.t);
+    mont_small(m, 16, k, c.t);
+    mont_mul(m, p.x, k, c.a24d, c.t);
+    mont_mul(m, c.a24d, c.v, c.a24d, c.t);
+
+    /* stage 1: p = (product of prime powers up to b1) p */
+    for (q = 2; q <= b1; q = q == 2 ? 3 : q + 2) {
+        if (q > 2 && !ecm_prime(s, q)) {
+            continue;
+        }
+        for (pk = q; pk <= (unsigned long) (b1 / q); pk *= q);
+        ecm_ladder(&c, p, pk, r0, r1);
+        memcpy(p.x, r0.x, len * sizeof(HALF));
+        memcpy(p.z, r0.z, len * sizeof(HALF));
+    }
+    z1 = s->out + 2 * len * id;
+    acc = z1 + len;
+    memcpy(z1, p.z, len * sizeof(HALF));
+
+    /* stage 2: for each prime q = kd D +- j in (b1, b2], acc is multiplied by
+     * the difference of the x coordinates of (kd D) p and j p, which is 0 mod
+     * a factor for which q p is the point at infinity */
+    ecm_dbl(&c, p, r1);
+    memcpy(baby[0].x, p.x, len * sizeof(HALF));
+    memcpy(baby[0].z, p.z, len * sizeof(HALF));
+    ecm_add(&c, r1, p, p, baby[1]);
+    for (i = 2; i < ECM_D / 4 + 1; i++) {
+        ecm_add(&c, baby[i - 1], r1, baby[i - 2], baby[i]);
+    }
+    ecm_ladder(&c, p, ECM_D, dq, r1);
+    kmin = b1 / ECM_D > 1 ? b1 / ECM_D : 1;
+    kmax = b2 / ECM_D + 1;
+    ecm_ladder(&c, dq, kmin, g0, g1);
+    memcpy(acc, m->one, len * sizeof(HALF));
+    for (kd = kmin; kd <= kmax; kd++) {
+        for (i = 0; i < ECM_D / 4 + 1; i++) {
+            j = 2 * i + 1;
+            q = kd * ECM_D - j;
+            if ((q <= b1 || q > b2 || !ecm_prime(s, q))
+                && (q + 2 * j <= b1 || q + 2 * j > b2 || !ecm_prime(s, q + 2 * j))) {
+                continue;
+            }
+            mont_mul(m, g0.x, baby[i].z, c.u, c.t);
+            mont_mul(m, baby[i].x, g0.z, c.v, c.t);
+            mont_sub(m, c.u, c.v, c.u);
+            mont_mul(m, acc, c.u, acc, c.t);
+        }
+        /* g0, g1 = g1, g1 + D p */
+        ecm_add(&c, g1, dq, g0, r0);
+        memcpy(g0.x, g1.x, len * sizeof(HALF));
+        memcpy(g0.z, g1.z, len * sizeof(HALF));
+        memcpy(g1.x, r0.x, len * sizeof(HALF));
+        memcpy(g1.z, r0.z, len * sizeof(HALF));
+    }
+    free(ws);
+    free(baby);
+}
+
+/* sets s->composite for the odd numbers up to limit */
+static void
+ecm_sieve(factorize_state * s, long limit)
+{
+    long i, j, bytes;
+
+    xfree(s->composite);
+    bytes = limit / 16 + 1;
+    s->composite = ZALLOC_N(unsigned char, bytes);
+    s->composite[0] = 1;        /* 1 isn't prime */
+    for (i = 3; i * i <= limit; i += 2) {
+        if (!ecm_prime(s, i)) {
+            continue;
+        }
+        for (j = i * i; j <= limit; j += 2 * i) {
+            s->composite[j >> 4] |= 1 << ((j >> 1) & 7);
+        }
+    }
+}
+
+/* finds a factor f of n (1 < f < n) with ecm, trying curves until one works */
+static void
+ecm(factorize_state * s, ZVALUE n, ZVALUE * f)
+{
+    calc_parallel_t par;
+    ZVALUE g;
+    LEN len = s->m.len;
+    long level, curves, done, i;
+    int stage;
+
+    s->out = ALLOC_N(HALF, 2 * len * s->nthreads);
+    s->failed = ALLOC_N(char, s->nthreads);
+    s->sigma = ECM_FIRST_SIGMA;
+    for (level = 0;; level++) {
+        if (level < ECM_LEVELS) {
+            s->b1 = ecm_levels[level].b1;
+            s->b2 = s->b1 * ECM_B2_MULT;
+            ecm_sieve(s, s->b2 + ECM_D);
+        }
+        curves = ecm_levels[level < ECM_LEVELS ? level : ECM_LEVELS - 1].curves;
+        for (done = 0; done < curves; done += s->nthreads) {
+            memset(s->failed, 0, s->nthreads);
+            par.ntasks = s->nthreads;
+            par.task = ecm_task;
+            par.data = s;
+            calc_parallel_run(&par, s->nthreads);
+            for (i = 0; i < s->nthreads; i++) {
+                if (s->failed[i]) {
+                    rb_raise(rb_eNoMemError, "failed to allocate memory for factorize");
+                }
+            }
+            for (i = 0; i < s->nthreads; i++) {
+                /* the stage 1 residue, then stage 2's.  if stage 1 found
+                 * every factor of n at once, stage 2 has too. */
+                for (stage = 0; stage < 2; stage++) {
+                    limbs_gcd(s->out + (2 * i + stage) * len, len, n, &g);
+                    if (zisunit(g)) {
+                        zfree(g);
+                        continue;
+                    }
+                    if (zcmp(g, n)) {
+                        *f = g;
+                        xfree(s->out);
+                        xfree(s->failed);
+                        s->out = NULL;
+                        s->failed = NULL;
+                        return;
+                    }
+                    zfree(g);
+                    break;
+                }
+            }
+            s->sigma += s->nthreads;
+        }
+    }
+}
+
+/* whether n is (probably) prime, as by ptest(20) */
+static BOOL
+is_prime(ZVALUE n)
+{
+    ZVALUE skip;
+    BOOL result;
+
+    itoz(1, &skip);
+    result = zprimetest(n, 20, skip);
+    zfree(skip);
+    return result;
+}
+
+/* splits todo entries until all are prime */
+static void
+factorize_todo(factorize_state * s)
+{
+    ZVALUE n, f, r, t, zk;
+    long e, k, i;
+    BOOL found;
+
+    while (s->todo.n > 0) {
+        /* the list owns n until it's removed */
+        n = s->todo.v[s->todo.n - 1].z;
+        e = s->todo.v[s->todo.n - 1].e;
+
+        /* anything below TRIAL_LIMIT^2 without a factor below TRIAL_LIMIT is
+         * prime */
+        if (zhighbit(n) < 32 || is_prime(n)) {
+            s->todo.n--;
+            list_add(&s->primes, n, e);
+            continue;
+        }
+
+        /* perfect powers r^k: k prime, and r >= TRIAL_LIMIT */
+        found = FALSE;
+        for (i = 0; !found && trial_primes[i] * 16 <= zhighbit(n) + 1; i++) {
+            k = trial_primes[i];
+            itoz(k, &zk);
+            zroot(n, zk, &r);
+            zpowi(r, zk, &t);
+            zfree(zk);
+            found = !zcmp(t, n);
+            zfree(t);
+            if (found) {
+                s->todo.n--;
+                list_add(&s->todo, r, e * k);
+                zfree(n);
+            }
+            else {
+                zfree(r);
+            }
+        }
+        if (found) {
+            continue;
+        }
+
+        found = s->method == FACTORIZE_QS && qs_split(n, s->nthreads, &f);
+        if (!found) {
+            mont_init(&s->m, n);
+            s->work = ALLOC_N(HALF, 7 * n.len + 2);
+            for (i = 1; !found && i <= RHO_TRIES; i++) {
+                found = rho(s, n, (HALF) i, &f);
+            }
+            xfree(s->work);
+            s->work = NULL;
+            if (!found) {
+                ecm(s, n, &f);
+            }
+            mont_free(&s->m);
+        }
+
+        zquo(n, f, &r, 0);
+        s->todo.n--;
+        zfree(n);
+        list_add(&s->todo, f, e);
+        list_add(&s->todo, r, e);
+    }
+}
+
+typedef struct {
+    factorize_state *s;
+    ZVALUE n;
+    VALUE result;
+} factorize_args;
+
+static VALUE
+factorize_body(VALUE arg)
+{
+    factorize_args *a = (factorize_args *) arg;
+    factorize_state *s = a->s;
+    ZVALUE n, t;
+    NUMBER *q;
+    VALUE pair;
+    long i, e;
+
+    init_trial_primes();
+    zcopy(a->n, &n);
+    n.sign = 0;
+    for (i = 0; i < trial_count && !zisunit(n); i++) {
+        if (zmodi(n, (long) trial_primes[i])) {
+            if (zhighbit(n) < 32 && (FULL) trial_primes[i] * trial_primes[i] > ztou(n)) {
+                break;
+            }
+            continue;
+        }
+        e = 0;
+        do {
+            zdivi(n, (long) trial_primes[i], &t);
+            zfree(n);
+            n = t;
+            e++;
+        } while (zmodi(n, (long) trial_primes[i]) == 0);
+        itoz((long) trial_primes[i], &t);
+        list_add(&s->primes, t, e);
+    }
+    if (zisunit(n)) {
+        zfree(n);
+    }
+    else {
+        list_add(&s->todo, n, 1);
+        factorize_todo(s);
+    }
+
+    qsort(s->primes.v, s->primes.n, sizeof(factor_entry), compare_factors);
+    if (zisneg(a->n)) {
+        rb_ary_push(a->result, rb_ary_new3(2, wrap_number(qlink(&_qnegone_)),
+                                           wrap_number(qlink(&_qone_))));
+    }
+    for (i = 0; i < s->primes.n; i++) {
+        q = qalloc();
+        zcopy(s->primes.v[i].z, &q->num);
+        pair = rb_ary_new3(2, wrap_number(q), wrap_number(itoq(s->primes.v[i].e)));
+        rb_ary_push(a->result, pair);
+    }
+    return Qnil;
+}
+
+static VALUE
+factorize_cleanup(VALUE arg)
+{
+    factorize_state *s = ((factorize_args *) arg)->s;
+
+    list_free(&s->primes);
+    list_free(&s->todo);
+    if (s->m.n) {
+        mont_free(&s->m);
+    }
+    xfree(s->work);
+    xfree(s->composite);
+    xfree(s->out);
+    xfree(s->failed);
+    return Qnil;
+}
+
+/* parses factorize's options hash */
+static void
+factorize_args_parse(int argc, VALUE * argv, VALUE * threads, int *method)
+{
+    VALUE opts, rest, m;
+
+    *threads = Qnil;
+    *method = FACTORIZE_ECM;
+    if (rb_scan_args(argc, argv, "01", &opts) == 0 || NIL_P(opts)) {
+        return;
+    }
+    Check_Type(opts, T_HASH);
+    rest = rb_hash_dup(opts);
+    *threads = rb_hash_delete(rest, ID2SYM(rb_intern("threads")));
+    m = rb_hash_delete(rest, ID2SYM(rb_intern("method")));
+    if (RHASH_SIZE(rest) > 0) {
+        rb_raise(rb_eArgError, "Unknown keywords: %" PRIsVALUE,
+                 rb_ary_join(rb_funcall(rest, rb_intern("keys"), 0), rb_str_new2(", ")));
+    }
+    if (m == ID2SYM(rb_intern("qs"))) {
+        *method = FACTORIZE_QS;
+    }
+    else if (!NIL_P(m) && m != ID2SYM(rb_intern("ecm"))) {
+        rb_raise(rb_eArgError, "Unknown factorize method: %" PRIsVALUE, rb_inspect(m));
+    }
+}
+
+/* Returns the prime factorization of self
+ *
+ * Returns an array of [prime, exponent] pairs in increasing order of prime,
+ * whose product is self.  A negative number starts with [-1, 1], and 1 has
+ * no factors.
+ *
+ * Factors below 65536 are found by trial division, then what is left is
+ * split by Pollard-Brent rho (good for factors of up to about 12 digits) and
+ * then by the elliptic curve method, whose time grows with the size of the
+ * factor found rather than of self: a product of two 60 bit primes takes
+ * about a second (see bench/factorize.rb).  Batches of curves are run on
+ * native threads.  Parts are considered prime when they pass Calc::Q#ptest
+ * with count 20.
+ *
+ * This can take a very long time if self has two or more large prime
+ * factors (more than 40 digits); it can be interrupted (eg, by Timeout).
+ *
+ * With method: :qs, composite parts of 64 bits or more are split by the
+ * self-initialising quadratic sieve instead, whose time depends only on the
+ * size of the part: about a second at 50 digits and a minute at 65 (on one
+ * thread).  This is much faster than the default for products of two
+ * primes of similar size, but slower when one factor is much smaller than
+ * the others (see bench/factorize.rb).  If a block is given it is called
+ * after each batch of sieving with the number of relations found so far and
+ * the number needed; breaking out of the block (or interrupting) abandons
+ * the factorization.
+ *
+ * @param opts [Hash] (optional) options:
+ *  threads: maximum number of native threads to use, defaults to
+ *  Calc.config(:threads)
+ *  method: :ecm (the default) or :qs
+ * @yield [found, needed] quadratic sieve progress (method: :qs only)
+ * @return [Array<Array<Calc::Q>>]
+ * @raise [Calc::MathError] if self is not an integer, or is zero
+ * @raise [ArgumentError] for unknown options or methods
+ * @example
+ *  Calc::Q(360).factorize                    #=> [[Calc::Q(2), Calc::Q(3)], [Calc::Q(3), Calc::Q(2)], [Calc::Q(5), Calc::Q(1)]]
+ *  Calc::Q(-(2**67 - 1)).factorize           #=> [[Calc::Q(-1), Calc::Q(1)], [Calc::Q(193707721), Calc::Q(1)], [Calc::Q(761838257287), Calc::Q(1)]]
+ *  Calc::Q(2**64 + 1).factorize(threads: 2)  #=> [[Calc::Q(274177), Calc::Q(1)], [Calc::Q(67280421310721), Calc::Q(1)]]
+ *  Calc::Q(2**128 + 1).factorize(method: :qs) #=> [[Calc::Q(59649589127497217), Calc::Q(1)], [Calc::Q(5704689200685129054721), Calc::Q(1)]]
+ * @see factor
+ */
+VALUE
+cq_factorize(int argc, VALUE * argv, VALUE self)
+{
+    factorize_state s;
+    factorize_args a;
+    NUMBER *qself;
+    VALUE threads;
+    int method;
+    setup_math_error();
+
+    factorize_args_parse(argc, argv, &threads, &method);
+    qself = DATA_PTR(self);
+    if (qisfrac(qself)) {
+        rb_raise(e_MathError, "non-integer for factorize");
+    }
+    if (qiszero(qself)) {
+        rb_raise(e_MathError, "zero argument for factorize");
+    }
+    memset(&s, 0, sizeof(s));
+    s.nthreads = calc_thread_count(threads);
+    s.method = method;
+    a.s = &s;
+    a.n = qself->num;
+    a.result = rb_ary_new();
+    rb_ensure(factorize_body, (VALUE) & a, factorize_cleanup, (VALUE) & a);
+    return a.result;
+}
@@ -0,0 +1,572 @@
+#include "calc.h"
+
+/* exact matrix multiplication.
+ *
+ * each row of the left matrix and each column of the right matrix is scaled
+ * to a common denominator, turning them into integer vectors.  an element of
+ * the product is then the integer dot product of a row and a column divided
+ * by the product of their denominators, so only one gcd reduction is needed
+ * per element of the result.
+ *
+ * the integer dot products are done with our own limb arithmetic instead of
+ * libcalc's zmul/zadd (which are not thread safe), so that tiles of the
+ * result can be computed by native threads without the GVL.
+ */
+
+#define TILE 8                  /* result is computed in TILE x TILE blocks */
+#define KBLOCK 32               /* inner dimension block size */
+
+/* one element of the result, before conversion to a NUMBER */
+typedef struct {
+    HALF *v;                    /* magnitude (malloc'd) */
+    LEN len;
+    BOOL sign;
+} cell;
+
+typedef struct {
+    VALUE aflat, bflat;         /* elements of a and b as Calc::Q/Calc::C */
+    VALUE threads;
+    long n, m, p;               /* (n x m) * (m x p) */
+    int planes;                 /* 1 if all real, 2 if anything is complex */
+    ZVALUE *a;                  /* scaled a, [plane][row][k] */
+    ZVALUE *b;                  /* scaled b, [plane][col][k] (transposed) */
+    ZVALUE *aden;               /* denominator of each row of a */
+    ZVALUE *bden;               /* denominator of each column of b */
+    LEN *alen;                  /* longest scaled value in each row of a */
+    LEN *blen;                  /* longest scaled value in each column of b */
+    cell *result;               /* [plane][row][col] */
+    long tcols;                 /* number of tiles across the result */
+    int failed;                 /* a worker couldn't allocate memory */
+} matmul_state;
+
+/* convert m (an Array of Arrays, or something with #to_a, like a Matrix) to
+ * an Array of rows.  every row must be the same length. */
+static VALUE
+matrix_rows(VALUE m, long *rows, long *cols)
+{
+    VALUE row;
+    long i;
+
+    if (!RB_TYPE_P(m, T_ARRAY)) {
+        m = rb_convert_type(m, T_ARRAY, "Array", "to_a");
+    }
+    *rows = RARRAY_LEN(m);
+    *cols = -1;
+    for (i = 0; i < *rows; i++) {
+        row = rb_check_array_type(RARRAY_AREF(m, i));
+        if (NIL_P(row)) {
+            rb_raise(rb_eArgError, "matrix rows must be arrays");
+        }
+        if (*cols == -1) {
+            *cols = RARRAY_LEN(row);
+        }
+        else if (*cols != RARRAY_LEN(row)) {
+            rb_raise(rb_eArgError, "matrix rows must all be the same length");
+        }
+    }
+    if (*rows == 0 || *cols <= 0) {
+        rb_raise(rb_eArgError, "empty matrix");
+    }
+    return m;
+}
+
+/* the real or imaginary part of a converted element */
+static NUMBER *
+element_part(VALUE x, int plane)
+{
+    if (CALC_C_P(x)) {
+        return plane ? ((COMPLEX *) DATA_PTR(x))->imag : ((COMPLEX *) DATA_PTR(x))->real;
+    }
+    return plane ? &_qzero_ : (NUMBER *) DATA_PTR(x);
+}
+
+/* scale a line of elements (a row of a, or a column of b) to integers over a
+ * common denominator.  elements are at elems[first + k * stride].  the scaled
+ * integers are written to out[plane * plane_stride + k]. */
+static void
+scale_line(VALUE elems, long first, long stride, long count, int planes,
+           ZVALUE * out, long plane_stride, ZVALUE * den, LEN * maxlen)
+{
+    ZVALUE lcm, tmp, factor;
+    NUMBER *q;
+    long k;
+    int plane;
+
+    zcopy(_one_, &lcm);
+    for (plane = 0; plane < planes; plane++) {
+        for (k = 0; k < count; k++) {
+            q = element_part(RARRAY_AREF(elems, first + k * stride), plane);
+            if (!zisunit(q->den) && !zisunit(lcm)) {
+                zlcm(lcm, q->den, &tmp);
+                zfree(lcm);
+                lcm = tmp;
+            }
+            else if (!zisunit(q->den)) {
+                zfree(lcm);
+                zcopy(q->den, &lcm);
+            }
+        }
+    }
+    *maxlen = 1;
+    for (plane = 0; plane < planes; plane++) {
+        for (k = 0; k < count; k++) {
+            q = element_part(RARRAY_AREF(elems, first + k * stride), plane);
+            if (zcmp(q->den, lcm) == 0) {
+                zcopy(q->num, &out[plane * plane_stride + k]);
+            }
+            else {
+                zequo(lcm, q->den, &factor);
+                zmul(q->num, factor, &out[plane * plane_stride + k]);
+                zfree(factor);
+            }
+            if (out[plane * plane_stride + k].len > *maxlen)
+                *maxlen = out[plane * plane_stride + k].len;
+        }
+    }
+    *den = lcm;
+}
+
+/* acc += x * y, where acc is an unsigned integer of acclen limbs */
+static void
+mac(HALF * acc, LEN acclen, ZVALUE x, ZVALUE y)
+{
+    FULL t, xi;
+    HALF carry;
+    LEN i, j;
+
+    if (ziszero(x) || ziszero(y))
+        return;
+    for (i = 0; i < x.len; i++) {
+        xi = x.v[i];
+        if (xi == 0)
+            continue;
+        carry = 0;
+        for (j = 0; j < y.len; j++) {
+            t = xi * y.v[j] + acc[i + j] + carry;
+            acc[i + j] = (HALF) t;
+            carry = (HALF) (t >> BASEB);
+        }
+        for (j = i + y.len; carry && j < acclen; j++) {
+            t = (FULL) acc[j] + carry;
+            acc[j] = (HALF) t;
+            carry = (HALF) (t >> BASEB);
+        }
+    }
+}
+
+/* c = pos - neg as sign and magnitude.  returns 0 if out of memory. */
+static int
+finish_cell(cell * c, HALF * pos, HALF * neg, LEN len)
+{
+    HALF *big, *small, borrow;
+    FULL t;
+    LEN i;
+    int cmp = 0;
+
+    for (i = len - 1; i >= 0 && cmp == 0; i--) {
+        if (pos[i] != neg[i])
+            cmp = pos[i] > neg[i] ? 1 : -1;
+    }
+    c->sign = (cmp < 0);
+    big = cmp < 0 ? neg : pos;
+    small = cmp < 0 ? pos : neg;
+    borrow = 0;
+    for (i = 0; i < len; i++) {
+        t = (FULL) big[i] - small[i] - borrow;
+        big[i] = (HALF) t;
+        borrow = (HALF) ((t >> BASEB) & 1);
+    }
+    while (len > 1 && big[len - 1] == 0)
+        len--;
+    c->v = malloc(len * sizeof(HALF));
+    if (c->v == NULL)
+        return 0;
+    memcpy(c->v, big, len * sizeof(HALF));
+    c->len = len;
+    return 1;
+}
+
+/* computes one TILE x TILE block of the result.  runs without the GVL. */
+static void
+matmul_tile(calc_parallel_t * par, long id)
+{
+    matmul_state *s = (matmul_state *) par->data;
+    long i0, j0, i1, j1, i, j, k, k0, k1, c;
+    long outplanes = s->planes;
+    long ncells, cellsize, offset;
+    LEN *acclen;
+    HALF **acc, *buf;
+    ZVALUE *ar, *ai, *br, *bi;
+
+    i0 = (id / s->tcols) * TILE;
+    j0 = (id % s->tcols) * TILE;
+    i1 = i0 + TILE < s->n ? i0 + TILE : s->n;
+    j1 = j0 + TILE < s->p ? j0 + TILE : s->p;
+    ncells = (i1 - i0) * (j1 - j0);
+
+    /* accumulators: for each cell and output plane, a positive and negative
+     * sum.  two extra limbs leave room for carries from adding m terms. */
+    acclen = malloc(ncells * sizeof(LEN));
+    acc = malloc(ncells * outplanes * 2 * sizeof(HALF *));
+    if (acclen == NULL || acc == NULL) {
+        free(acclen);
+        free(acc);
+        s->failed = 1;
+        return;
+    }
+    cellsize = 0;
+    for (i = i0, c = 0; i < i1; i++) {
+        for (j = j0; j < j1; j++, c++) {
+            acclen[c] = s->alen[i] + s->blen[j] + 2;
+            cellsize += acclen[c];
+        }
+    }
+    buf = calloc(cellsize * outplanes * 2, sizeof(HALF));
+    if (buf == NULL) {
+        free(acclen);
+        free(acc);
+        s->failed = 1;
+        return;
+    }
+    offset = 0;
+    for (c = 0; c < ncells * outplanes * 2; c++) {
+        acc[c] = buf + offset;
+        offset += acclen[c / (outplanes * 2)];
+    }
+
+    for (k0 = 0; k0 < s->m; k0 += KBLOCK) {
+        k1 = k0 + KBLOCK < s->m ? k0 + KBLOCK : s->m;
+        for (i = i0, c = 0; i < i1; i++) {
+            ar = s->a + i * s->m;
+            ai = ar + s->n * s->m;
+            for (j = j0; j < j1; j++, c++) {
+                br = s->b + j * s->m;
+                bi = br + s->p * s->m;
+                for (k = k0; k < k1; k++) {
+                    /* real part: ar * br - ai * bi */
+                    mac(acc[c * outplanes * 2 + (ar[k].sign != br[k].sign)], acclen[c], ar[k],
+                        br[k]);
+                    if (outplanes == 2) {
+                        mac(acc[c * 4 + (ai[k].sign == bi[k].sign)], acclen[c], ai[k], bi[k]);
+                        /* imaginary part: ar * bi + ai * br */
+                        mac(acc[c * 4 + 2 + (ar[k].sign != bi[k].sign)], acclen[c], ar[k],
+                            bi[k]);
+                        mac(acc[c * 4 + 2 + (ai[k].sign != br[k].sign)], acclen[c], ai[k],
+                            br[k]);
+                    }
+                }
+            }
+        }
+    }
+
+    for (i = i0, c = 0; i < i1; i++) {
+        for (j = j0; j < j1; j++, c++) {
+            for (k = 0; k < outplanes; k++) {
+                if (!finish_cell(&s->result[k * s->n * s->p + i * s->p + j],
+                                 acc[c * outplanes * 2 + k * 2],
+                                 acc[c * outplanes * 2 + k * 2 + 1], acclen[c])) {
+                    s->failed = 1;
+                }
+            }
+        }
+    }
+    free(buf);
+    free(acc);
+    free(acclen);
+}
+
+/* convert a computed cell to a reduced NUMBER */
+static NUMBER *
+cell_to_number(cell * c, ZVALUE den1, ZVALUE den2)
+{
+    NUMBER *q;
+    ZVALUE num, den, gcd, tmp;
+
+    if (c->len == 1 && c->v[0] == 0)
+        return qlink(&_qzero_);
+    num.v = alloc(c->len);
+    memcpy(num.v, c->v, c->len * sizeof(HALF));
+    num.len = c->len;
+    num.sign = c->sign;
+    q = qalloc();
+    if (zisunit(den1) && zisunit(den2)) {
+        q->num = num;
+        return q;
+    }
+    zmul(den1, den2, &den);
+    zgcd(num, den, &gcd);
+    if (zisunit(gcd)) {
+        q->num = num;
+        q->den = den;
+    }
+    else {
+        zequo(num, gcd, &tmp);
+        zfree(num);
+        q->num = tmp;
+        zequo(den, gcd, &tmp);
+        zfree(den);
+        q->den = tmp;
+    }
+    zfree(gcd);
+    return q;
+}
+
+static VALUE
+matmul_body(VALUE arg)
+{
+    matmul_state *s = (matmul_state *) arg;
+    VALUE result, row;
+    NUMBER *re, *im;
+    calc_parallel_t par;
+    long i, j;
+
+    s->a = calloc(s->planes * s->n * s->m, sizeof(ZVALUE));
+    s->b = calloc(s->planes * s->p * s->m, sizeof(ZVALUE));
+    s->aden = calloc(s->n, sizeof(ZVALUE));
+    s->bden = calloc(s->p, sizeof(ZVALUE));
+    s->alen = calloc(s->n, sizeof(LEN));
+    s->blen = calloc(s->p, sizeof(LEN));
+    s->result = calloc(s->planes * s->n * s->p, sizeof(cell));
+    if (!s->a || !s->b || !s->aden || !s->bden || !s->alen || !s->blen || !s->result) {
+        rb_raise(rb_eNoMemError, "failed to allocate memory for matmul");
+    }
+    for (i = 0; i < s->n; i++) {
+        scale_line(s->aflat, i * s->m, 1, s->m, s->planes, s->a + i * s->m, s->n * s->m,
+                   &s->aden[i], &s->alen[i]);
+    }
+    for (j = 0; j < s->p; j++) {
+        scale_line(s->bflat, j, s->p, s->m, s->planes, s->b + j * s->m, s->p * s->m,
+                   &s->bden[j], &s->blen[j]);
+    }
+
+    s->tcols = (s->p + TILE - 1) / TILE;
+    par.ntasks = ((s->n + TILE - 1) / TILE) * s->tcols;
+    par.task = matmul_tile;
+    par.data = s;
+    calc_parallel_run(&par, calc_thread_count(s->threads));
+    if (s->failed) {
+        rb_raise(rb_eNoMemError, "failed to allocate memory for matmul");
+    }
+
+    result = rb_ary_new2(s->n);
+    for (i = 0; i < s->n; i++) {
+        row = rb_ary_new2(s->p);
+        for (j = 0; j < s->p; j++) {
+            re = cell_to_number(&s->result[i * s->p + j], s->aden[i], s->bden[j]);
+            if (s->planes == 1) {
+                rb_ary_push(row, wrap_number(re));
+            }
+            else {
+                im = cell_to_number(&s->result[s->n * s->p + i * s->p + j], s->aden[i],
+                                    s->bden[j]);
+                rb_ary_push(row, wrap_complex(qqtoc(re, im)));
+                qfree(re);
+                qfree(im);
+            }
+        }
+        rb_ary_push(result, row);
+    }
+    return result;
+}
+
+static void
+free_zvalues(ZVALUE * z, long count)
+{
+    long i;
+
+    if (z) {
+        for (i = 0; i < count; i++) {
+            if (z[i].v)
+                zfree(z[i]);
+        }
+        free(z);
+    }
+}
+
+static VALUE
+matmul_cleanup(VALUE arg)
+{
+    matmul_state *s = (matmul_state *) arg;
+    long i, cells = s->planes * s->n * s->p;
+
+    free_zvalues(s->a, s->planes * s->n * s->m);
+    free_zvalues(s->b, s->planes * s->p * s->m);
+    free_zvalues(s->aden, s->n);
+    free_zvalues(s->bden, s->p);
+    free(s->alen);
+    free(s->blen);
+    if (s->result) {
+        for (i = 0; i < cells; i++) {
+            free(s->result[i].v);
+        }
+        free(s->result);
+    }
+    return Qnil;
+}
+
+/* Multiplies two matrices exactly
+ *
+ * The matrices can be Arrays of row Arrays, or anything which converts to
+ * one with `to_a` (such as a ruby Matrix).  Elements can be any numeric type
+ * accepted by Calc::Q or Calc::C.
+ *
+ * Each row of `a` and column of `b` is brought to a common denominator so
+ * that every element of the product is an integer dot product followed by a
+ * single reduction.  The work is split into blocks which are computed by
+ * native threads, without holding ruby's global lock.
+ *
+ * @param a [Array<Array>] left matrix (n rows of m elements)
+ * @param b [Array<Array>] right matrix (m rows of p elements)
+ * @param threads [Integer] (optional) maximum number of native threads to use,
+ *  defaults to Calc.config(:threads)
+ * @return [Array<Array>] product (n rows of p elements, Calc::Q or Calc::C)
+ * @raise [ArgumentError] if either matrix is empty or not rectangular
+ * @raise [Calc::MathError] if the matrices have incompatible dimensions
+ * @example
+ *  Calc.matmul([[1, 2], [3, 4]], [[5, 6], [7, 8]])
+ *    #=> [[Calc::Q(19), Calc::Q(22)], [Calc::Q(43), Calc::Q(50)]]
+ *  Calc.matmul([[Rational(1, 2), Complex(0, 1)]], [[2], [3]])
+ *    #=> [[Calc::C(1+3i)]]
+ */
+VALUE
+calc_matmul(int argc, VALUE * argv, VALUE self)
+{
+    matmul_state s;
+    VALUE a, b, threads, aflat, bflat, x, result;
+    long arows, acols, brows, bcols, i, j;
+    int complex = 0;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "21", &a, &b, &threads);
+    a = matrix_rows(a, &arows, &acols);
+    b = matrix_rows(b, &brows, &bcols);
+    if (acols != brows) {
+        rb_raise(e_MathError, "Incompatible dimensions for matrix multiplication");
+    }
+
+    /* flatten both matrices into arrays of Calc::Q/Calc::C (the arrays keep
+     * them safe from the GC) */
+    aflat = rb_ary_new2(arows * acols);
+    for (i = 0; i < arows; i++) {
+        for (j = 0; j < acols; j++) {
+            x = value_to_calc(rb_ary_entry(RARRAY_AREF(a, i), j));
+            complex |= CALC_C_P(x);
+            rb_ary_push(aflat, x);
+        }
+    }
+    bflat = rb_ary_new2(brows * bcols);
+    for (i = 0; i < brows; i++) {
+        for (j = 0; j < bcols; j++) {
+            x = value_to_calc(rb_ary_entry(RARRAY_AREF(b, i), j));
+            complex |= CALC_C_P(x);
+            rb_ary_push(bflat, x);
+        }
+    }
+
+    memset(&s, 0, sizeof(s));
+    s.aflat = aflat;
+    s.bflat = bflat;
+    s.threads = threads;
+    s.n = arows;
+    s.m = acols;
+    s.p = bcols;
+    s.planes = complex ? 2 : 1;
+    result = rb_ensure(matmul_body, (VALUE) & s, matmul_cleanup, (VALUE) & s);
+    RB_GC_GUARD(aflat);
+    RB_GC_GUARD(bflat);
+    return result;
+}
+
+/* convert v (an Array, or something with #to_a, like a Vector) to an Array */
+static VALUE
+vector_elements(VALUE v)
+{
+    if (!RB_TYPE_P(v, T_ARRAY)) {
+        v = rb_convert_type(v, T_ARRAY, "Array", "to_a");
+    }
+    return v;
+}
+
+/* Dot product of two vectors
+ *
+ * Computes `as[0] * bs[0] + as[1] * bs[1] + ...` exactly.  The products are
+ * added over a common denominator without reducing any intermediate values,
+ * so there is only one reduction at the end (instead of one for every
+ * multiplication and addition when done with Calc::Q#* and Calc::Q#+).
+ *
+ * The vectors can be Arrays, or anything which converts to one with `to_a`
+ * (such as a ruby Vector).  Elements can be any numeric type accepted by
+ * Calc::Q or Calc::C.
+ *
+ * @param as [Array]
+ * @param bs [Array]
+ * @return [Calc::Q,Calc::C]
+ * @raise [Calc::MathError] if the vectors are different sizes
+ * @example
+ *  Calc.dot([1, 2, 3], [4, 5, 6])                   #=> Calc::Q(32)
+ *  Calc.dot([Rational(1, 2), Rational(1, 3)], [2, 3]) #=> Calc::Q(2)
+ *  Calc.dot([Complex(0, 1), 1], [Complex(0, 1), 2])  #=> Calc::Q(1)
+ */
+VALUE
+calc_dot(VALUE self, VALUE as, VALUE bs)
+{
+    calc_accum re, im;
+    VALUE aelems, belems, x, y;
+    NUMBER *ar, *ai, *br, *bi, *qre, *qim;
+    ZVALUE neg;
+    long n, i;
+    int complex = 0;
+    setup_math_error();
+
+    as = vector_elements(as);
+    bs = vector_elements(bs);
+    n = RARRAY_LEN(as);
+    if (RARRAY_LEN(bs) != n) {
+        rb_raise(e_MathError, "Incompatible dimensions for dot product");
+    }
+
+    /* convert everything first so nothing can raise while accumulating */
+    aelems = rb_ary_new2(n);
+    belems = rb_ary_new2(n);
+    for (i = 0; i < n; i++) {
+        x = value_to_calc(RARRAY_AREF(as, i));
+        y = value_to_calc(RARRAY_AREF(bs, i));
+        complex |= CALC_C_P(x) || CALC_C_P(y);
+        rb_ary_push(aelems, x);
+        rb_ary_push(belems, y);
+    }
+
+    accum_init(&re);
+    accum_init(&im);
+    for (i = 0; i < n; i++) {
+        x = RARRAY_AREF(aelems, i);
+        y = RARRAY_AREF(belems, i);
+        ar = element_part(x, 0);
+        br = element_part(y, 0);
+        accum_addmul(&re, ar->num, ar->den, br->num, br->den);
+        if (complex) {
+            ai = element_part(x, 1);
+            bi = element_part(y, 1);
+            /* re -= ai * bi */
+            neg = ai->num;
+            neg.sign = !neg.sign;
+            accum_addmul(&re, neg, ai->den, bi->num, bi->den);
+            accum_addmul(&im, ar->num, ar->den, bi->num, bi->den);
+            accum_addmul(&im, ai->num, ai->den, br->num, br->den);
+        }
+    }
+    RB_GC_GUARD(aelems);
+    RB_GC_GUARD(belems);
+    qre = accum_to_number(&re);
+    accum_free(&re);
+    if (!complex) {
+        accum_free(&im);
+        return wrap_number(qre);
+    }
+    qim = accum_to_number(&im);
+    accum_free(&im);
+    x = wrap_complex(qqtoc(qre, qim));
+    qfree(qre);
+    qfree(qim);
+    return x;
+}
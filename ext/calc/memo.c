@@ -0,0 +1,370 @@
+#include "calc.h"
+
+/* optional memo of the results of transcendental functions.
+ *
+ * when enabled (config "memo" > 0), trans_function and trans_function2 in q.c
+ * and c.c, log_function and sqrt in numeric.c look up their arguments here
+ * before calling libcalc.  a key is the libcalc function, its operands, the
+ * epsilon and an optional long (eg, the sqrt rounding mode); operands are
+ * compared by value, so equal numbers from different objects share entries.
+ *
+ * the memo is bounded by a number of entries (config "memo") and optionally
+ * by the memory held by keys, results and the hash table (config
+ * "memo_bytes").  the least recently used entries are evicted first.  the
+ * hash table starts small and doubles as entries are added, up to the first
+ * power of 2 >= the capacity, so a large capacity costs nothing until it is
+ * used.
+ *
+ * the memo is only used with the GVL held (like libcalc itself), so no other
+ * locking is needed.  when disabled nothing here is called beyond the
+ * memo_enabled() check.
+ */
+
+typedef struct memo_entry {
+    struct memo_entry *next;    /* hash chain */
+    struct memo_entry *newer;   /* LRU list */
+    struct memo_entry *older;
+    memo_key key;               /* numbers are linked */
+    NUMBER *q;                  /* result; exactly one of q and c is set */
+    COMPLEX *c;
+    size_t bytes;
+} memo_entry;
+
+long memo_capacity = 0;         /* max entries, 0 to disable */
+static long memo_max_bytes = 0; /* 0 for no limit */
+static long memo_count = 0;
+static long memo_bytes = 0;
+static long memo_hits = 0;
+static long memo_misses = 0;
+static long memo_evictions = 0;
+
+static memo_entry **buckets = NULL;
+static long nbuckets = 0;       /* a power of 2 */
+static long max_buckets = 0;    /* nbuckets grows up to this */
+static memo_entry *newest = NULL;
+static memo_entry *oldest = NULL;
+
+#define MEMO_MIN_BUCKETS 16
+
+/* FNV-1a */
+#define MEMO_HASH_BASIS 2166136261UL
+#define MEMO_HASH_PRIME 16777619UL
+
+static unsigned long
+hash_long(unsigned long h, unsigned long n)
+{
+    return (h ^ n) * MEMO_HASH_PRIME;
+}
+
+static unsigned long
+hash_zvalue(unsigned long h, ZVALUE z)
+{
+    LEN i;
+
+    h = hash_long(h, (unsigned long) z.len);
+    h = hash_long(h, (unsigned long) z.sign);
+    for (i = 0; i < z.len; i++) {
+        h = hash_long(h, (unsigned long) z.v[i]);
+    }
+    return h;
+}
+
+static size_t
+number_bytes(NUMBER * q)
+{
+    return sizeof(NUMBER) + (q->num.len + q->den.len) * sizeof(HALF);
+}
+
+/*****************************************************************************
+ * keys                                                                      *
+ *****************************************************************************/
+
+void
+memo_key_init(memo_key * key, memo_fn fn, long extra)
+{
+    key->fn = fn;
+    key->extra = extra;
+    key->n = 0;
+    key->hash = hash_long(hash_long(MEMO_HASH_BASIS, (unsigned long) (size_t) fn),
+                          (unsigned long) extra);
+}
+
+/* adds a real operand to key */
+void
+memo_key_number(memo_key * key, NUMBER * q)
+{
+    key->k[key->n++] = q;
+    key->hash = hash_zvalue(hash_zvalue(key->hash, q->num), q->den);
+}
+
+/* adds a complex operand (as its real and imaginary parts) to key */
+void
+memo_key_complex(memo_key * key, COMPLEX * c)
+{
+    memo_key_number(key, c->real);
+    memo_key_number(key, c->imag);
+}
+
+/* adds a Calc::Q or Calc::C operand to key */
+void
+memo_key_value(memo_key * key, VALUE x)
+{
+    if (CALC_Q_P(x)) {
+        memo_key_number(key, DATA_PTR(x));
+    }
+    else {
+        memo_key_complex(key, DATA_PTR(x));
+    }
+}
+
+static BOOL
+memo_key_equal(memo_key * a, memo_key * b)
+{
+    int i;
+
+    if (a->hash != b->hash || a->fn != b->fn || a->extra != b->extra || a->n != b->n) {
+        return FALSE;
+    }
+    for (i = 0; i < a->n; i++) {
+        if (a->k[i] != b->k[i] && qcmp(a->k[i], b->k[i])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*****************************************************************************
+ * entries                                                                   *
+ *****************************************************************************/
+
+static void
+lru_unlink(memo_entry * e)
+{
+    if (e->newer)
+        e->newer->older = e->older;
+    else
+        newest = e->older;
+    if (e->older)
+        e->older->newer = e->newer;
+    else
+        oldest = e->newer;
+    e->newer = e->older = NULL;
+}
+
+static void
+lru_push(memo_entry * e)
+{
+    e->older = newest;
+    e->newer = NULL;
+    if (newest)
+        newest->newer = e;
+    newest = e;
+    if (!oldest)
+        oldest = e;
+}
+
+static void
+memo_remove(memo_entry * e)
+{
+    memo_entry **p;
+    int i;
+
+    for (p = &buckets[e->key.hash & (nbuckets - 1)]; *p != e; p = &(*p)->next);
+    *p = e->next;
+    lru_unlink(e);
+    for (i = 0; i < e->key.n; i++) {
+        qfree(e->key.k[i]);
+    }
+    if (e->q)
+        qfree(e->q);
+    if (e->c)
+        comfree(e->c);
+    memo_count--;
+    memo_bytes -= e->bytes;
+    xfree(e);
+}
+
+/* doubles the hash table, if it is smaller than max_buckets */
+static void
+memo_grow(void)
+{
+    memo_entry **old = buckets, *e, *next;
+    long i, n = nbuckets;
+
+    if (nbuckets >= max_buckets) {
+        return;
+    }
+    buckets = ALLOC_N(memo_entry *, 2 * n);
+    MEMZERO(buckets, memo_entry *, 2 * n);
+    nbuckets = 2 * n;
+    for (i = 0; i < n; i++) {
+        for (e = old[i]; e; e = next) {
+            next = e->next;
+            e->next = buckets[e->key.hash & (nbuckets - 1)];
+            buckets[e->key.hash & (nbuckets - 1)] = e;
+        }
+    }
+    xfree(old);
+    memo_bytes += n * sizeof(memo_entry *);
+}
+
+static void
+memo_clear(void)
+{
+    while (oldest) {
+        memo_remove(oldest);
+    }
+}
+
+/* looks up key.  returns a new Calc::Q or Calc::C if found, otherwise Qundef.
+ * the memo must be enabled. */
+VALUE
+memo_lookup(memo_key * key)
+{
+    memo_entry *e;
+
+    for (e = buckets[key->hash & (nbuckets - 1)]; e; e = e->next) {
+        if (memo_key_equal(&e->key, key)) {
+            memo_hits++;
+            if (e != newest) {
+                lru_unlink(e);
+                lru_push(e);
+            }
+            return e->q ? wrap_number(qlink(e->q)) : wrap_complex(clink(e->c));
+        }
+    }
+    memo_misses++;
+    return Qundef;
+}
+
+/* remembers result (a Calc::Q or Calc::C) for key, evicting the least
+ * recently used entries if the memo is full.  the memo must be enabled. */
+void
+memo_store(memo_key * key, VALUE result)
+{
+    memo_entry *e, **bucket;
+    int i;
+
+    if (memo_count >= nbuckets) {
+        memo_grow();
+    }
+    e = ALLOC(memo_entry);
+    e->key = *key;
+    e->bytes = sizeof(memo_entry);
+    for (i = 0; i < key->n; i++) {
+        e->key.k[i] = qlink(key->k[i]);
+        e->bytes += number_bytes(key->k[i]);
+    }
+    if (CALC_Q_P(result)) {
+        e->q = qlink((NUMBER *) DATA_PTR(result));
+        e->c = NULL;
+        e->bytes += number_bytes(e->q);
+    }
+    else {
+        e->q = NULL;
+        e->c = clink((COMPLEX *) DATA_PTR(result));
+        e->bytes += sizeof(COMPLEX) + number_bytes(e->c->real) + number_bytes(e->c->imag);
+    }
+    bucket = &buckets[key->hash & (nbuckets - 1)];
+    e->next = *bucket;
+    *bucket = e;
+    lru_push(e);
+    memo_count++;
+    memo_bytes += e->bytes;
+
+    while (memo_count > memo_capacity
+           || (memo_max_bytes && memo_bytes > memo_max_bytes && memo_count > 1)) {
+        memo_remove(oldest);
+        memo_evictions++;
+    }
+}
+
+/*****************************************************************************
+ * configuration                                                             *
+ *****************************************************************************/
+
+long
+memo_get_capacity(void)
+{
+    return memo_capacity;
+}
+
+/* sets the maximum number of entries (0 disables the memo).  existing
+ * entries are discarded. */
+void
+memo_set_capacity(long n)
+{
+    memo_clear();
+    if (buckets) {
+        xfree(buckets);
+        buckets = NULL;
+    }
+    nbuckets = max_buckets = 0;
+    memo_bytes = 0;
+    memo_capacity = n;
+    if (n > 0) {
+        for (max_buckets = MEMO_MIN_BUCKETS; max_buckets < n; max_buckets <<= 1);
+        nbuckets = MEMO_MIN_BUCKETS;
+        buckets = ALLOC_N(memo_entry *, nbuckets);
+        MEMZERO(buckets, memo_entry *, nbuckets);
+        memo_bytes = nbuckets * sizeof(memo_entry *);
+    }
+}
+
+long
+memo_get_max_bytes(void)
+{
+    return memo_max_bytes;
+}
+
+/* sets the maximum memory held by the memo (0 for no limit) */
+void
+memo_set_max_bytes(long n)
+{
+    memo_max_bytes = n;
+    while (memo_max_bytes && memo_bytes > memo_max_bytes && oldest) {
+        memo_remove(oldest);
+        memo_evictions++;
+    }
+}
+
+/* Returns statistics about the memo of transcendental function results
+ *
+ * The memo is enabled by setting the number of entries it can hold with
+ * `Calc.config(:memo, n)`; `Calc.config(:memo_bytes, n)` additionally limits
+ * the memory used by its keys, results and hash table.
+ *
+ * @return [Hash]
+ * @example
+ *  Calc.config(:memo, 1000)
+ *  Calc::Q(2).exp; Calc::Q(2).exp
+ *  Calc.memo_stats #=> {:capacity=>1000, :max_bytes=>0, :entries=>1, :bytes=>440, :hits=>1, :misses=>1, :evictions=>0}
+ */
+VALUE
+calc_memo_stats(VALUE self)
+{
+    VALUE result;
+
+    result = rb_hash_new();
+    rb_hash_aset(result, ID2SYM(rb_intern("capacity")), LONG2NUM(memo_capacity));
+    rb_hash_aset(result, ID2SYM(rb_intern("max_bytes")), LONG2NUM(memo_max_bytes));
+    rb_hash_aset(result, ID2SYM(rb_intern("entries")), LONG2NUM(memo_count));
+    rb_hash_aset(result, ID2SYM(rb_intern("bytes")), LONG2NUM(memo_bytes));
+    rb_hash_aset(result, ID2SYM(rb_intern("hits")), LONG2NUM(memo_hits));
+    rb_hash_aset(result, ID2SYM(rb_intern("misses")), LONG2NUM(memo_misses));
+    rb_hash_aset(result, ID2SYM(rb_intern("evictions")), LONG2NUM(memo_evictions));
+    return result;
+}
+
+/* Discards all entries in the memo of transcendental function results, and
+ * resets its counters
+ *
+ * @return [nil]
+ */
+VALUE
+calc_memo_clear(VALUE self)
+{
+    memo_clear();
+    memo_hits = memo_misses = memo_evictions = 0;
+    return Qnil;
+}
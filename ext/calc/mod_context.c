@@ -0,0 +1,470 @@
+#include <string.h>
+#include "calc.h"
+
+/* Document-class: Calc::ModContext
+ *
+ * Arithmetic modulo a fixed odd modulus, in montgomery form.
+ *
+ * Calc::Q#pmod and Calc::Q#minv work out everything they need about the
+ * modulus on every call, and convert their result back to an ordinary
+ * integer.  A context does that work once, when it is created, and its
+ * methods return Calc::ModContext::Residue objects which stay in montgomery
+ * form (x R mod m, R a power of 2) until they are read with Residue#to_q.  A
+ * multiplication then needs no division, which makes long chains of modular
+ * multiplications and powers much cheaper.
+ *
+ * Wherever a residue is expected, an integer may be given instead; it is
+ * reduced first.  Residues can only be combined with other residues of the
+ * same context.
+ *
+ * @example
+ *  ctx = Calc::ModContext.new(1_000_000_007)
+ *  y = ctx.pow(3, 10**18)  #=> Calc::ModContext::Residue(246336683 mod 1000000007)
+ *  ctx.mul(y, 5).to_q      #=> Calc::Q(231683408)
+ *  ctx.inv(y) * y          #=> Calc::ModContext::Residue(1 mod 1000000007)
+ */
+VALUE cModContext;
+
+/* Document-class: Calc::ModContext::Residue
+ *
+ * An element of the integers modulo the modulus of a Calc::ModContext, held
+ * in montgomery form.  Residues are created by the methods of the context.
+ */
+VALUE cResidue;
+
+typedef struct {
+    NUMBER *modulus;            /* NULL until initialized */
+    mont_t m;
+} calc_modctx;
+
+typedef struct {
+    VALUE context;
+    HALF *v;                    /* m.len HALFs, in montgomery form */
+} calc_residue;
+
+static void
+mc_free(void *p)
+{
+    calc_modctx *c = p;
+
+    if (c->modulus) {
+        mont_free(&c->m);
+        qfree(c->modulus);
+    }
+    xfree(p);
+}
+
+static size_t
+mc_memsize(const void *p)
+{
+    const calc_modctx *c = p;
+
+    if (!c->modulus) {
+        return sizeof(calc_modctx);
+    }
+    return sizeof(calc_modctx) + (c->modulus->num.len + 3 * c->m.len) * sizeof(HALF);
+}
+
+const rb_data_type_t calc_mod_context_type = {
+    "Calc::ModContext",
+    {0, mc_free, mc_memsize},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY   /* flags is in 2.1+ */
+#endif
+};
+
+static void
+mr_mark(void *p)
+{
+    rb_gc_mark(((calc_residue *) p)->context);
+}
+
+static void
+mr_free(void *p)
+{
+    xfree(((calc_residue *) p)->v);
+    xfree(p);
+}
+
+static size_t
+mr_memsize(const void *p)
+{
+    const calc_residue *r = p;
+    const calc_modctx *c = DATA_PTR(r->context);
+
+    return sizeof(calc_residue) + c->m.len * sizeof(HALF);
+}
+
+const rb_data_type_t calc_residue_type = {
+    "Calc::ModContext::Residue",
+    {mr_mark, mr_free, mr_memsize},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY   /* flags is in 2.1+ */
+#endif
+};
+
+/*****************************************************************************
+ * conversions                                                               *
+ *****************************************************************************/
+
+static calc_modctx *
+get_context(VALUE self)
+{
+    calc_modctx *c = rb_check_typeddata(self, &calc_mod_context_type);
+
+    if (!c->modulus) {
+        rb_raise(rb_eArgError, "uninitialized ModContext");
+    }
+    return c;
+}
+
+/* a new residue of the context ctx, with undefined value */
+static VALUE
+residue_new(VALUE ctx, calc_residue ** rp)
+{
+    calc_residue *r;
+    VALUE obj;
+
+    obj = TypedData_Make_Struct(cResidue, calc_residue, &calc_residue_type, r);
+    r->context = ctx;
+    r->v = ALLOC_N(HALF, get_context(ctx)->m.len);
+    *rp = r;
+    return obj;
+}
+
+/* r = z in montgomery form */
+static void
+mc_encode(calc_modctx * c, ZVALUE z, HALF * r)
+{
+    HALF *t;
+    ZVALUE tmp;
+
+    if (!zisneg(z) && zrel(z, c->modulus->num) < 0) {
+        limbs_from_z(z, r, c->m.len);
+    }
+    else {
+        zmod_nonneg(z, c->modulus->num, &tmp);
+        limbs_from_z(tmp, r, c->m.len);
+        zfree(tmp);
+    }
+    t = ALLOC_N(HALF, c->m.len + 2);
+    mont_mul(&c->m, r, c->m.r2, r, t);
+    xfree(t);
+}
+
+/* res = the ordinary value of the montgomery form a */
+static void
+mc_decode(calc_modctx * c, const HALF * a, ZVALUE * res)
+{
+    HALF *t, *u;
+
+    /* a / R is the product of a with 1 */
+    t = ALLOC_N(HALF, 2 * c->m.len + 2);
+    u = t + c->m.len + 2;
+    memset(u, 0, c->m.len * sizeof(HALF));
+    u[0] = 1;
+    mont_mul(&c->m, a, u, u, t);
+    limbs_to_z(u, c->m.len, res);
+    xfree(t);
+}
+
+/* returns x as a residue of ctx, converting integers */
+static VALUE
+to_residue(VALUE ctx, VALUE x)
+{
+    calc_residue *r;
+    NUMBER *q;
+    VALUE obj;
+
+    if (rb_typeddata_is_kind_of(x, &calc_residue_type)) {
+        if (((calc_residue *) DATA_PTR(x))->context != ctx) {
+            rb_raise(rb_eArgError, "residue belongs to a different ModContext");
+        }
+        return x;
+    }
+    q = value_to_number(x, 0);
+    if (qisfrac(q)) {
+        qfree(q);
+        rb_raise(e_MathError, "non-integer value for ModContext");
+    }
+    obj = residue_new(ctx, &r);
+    mc_encode(DATA_PTR(ctx), q->num, r->v);
+    qfree(q);
+    return obj;
+}
+
+#define RESIDUE_V(obj) (((calc_residue *) DATA_PTR(obj))->v)
+
+/* returns the inverse of the residue a, or Qnil if it has none */
+static VALUE
+mc_invert(VALUE ctx, VALUE a)
+{
+    calc_modctx *c = DATA_PTR(ctx);
+    calc_residue *r;
+    NUMBER *qa, *qinv;
+    ZVALUE z;
+    VALUE obj;
+
+    qa = qalloc();
+    mc_decode(c, RESIDUE_V(a), &qa->num);
+    qinv = qminv(qa, c->modulus);
+    qfree(qa);
+    if (qiszero(qinv)) {
+        qfree(qinv);
+        return Qnil;
+    }
+    z = qinv->num;
+    obj = residue_new(ctx, &r);
+    mc_encode(c, z, r->v);
+    qfree(qinv);
+    return obj;
+}
+
+/*****************************************************************************
+ * Calc::ModContext                                                          *
+ *****************************************************************************/
+
+static VALUE
+mc_alloc(VALUE klass)
+{
+    calc_modctx *c;
+
+    return TypedData_Make_Struct(klass, calc_modctx, &calc_mod_context_type, c);
+}
+
+/* Creates a new context for arithmetic modulo m
+ *
+ * @param m [Integer,Calc::Q] the modulus, an odd integer greater than 1
+ * @return [Calc::ModContext]
+ * @raise [Calc::MathError] if m is not an odd integer greater than 1
+ * @example
+ *  Calc::ModContext.new(101)  #=> Calc::ModContext(101)
+ */
+static VALUE
+mc_initialize(VALUE self, VALUE m)
+{
+    calc_modctx *c;
+    NUMBER *q;
+    setup_math_error();
+
+    c = rb_check_typeddata(self, &calc_mod_context_type);
+    if (c->modulus) {
+        rb_raise(rb_eArgError, "ModContext already initialized");
+    }
+    q = value_to_number(m, 1);
+    if (qisfrac(q) || qiseven(q) || qisneg(q) || qisone(q)) {
+        qfree(q);
+        rb_raise(e_MathError, "ModContext modulus must be an odd integer greater than 1");
+    }
+    mont_init(&c->m, q->num);
+    c->modulus = q;
+    return self;
+}
+
+/* Returns the modulus
+ *
+ * @return [Calc::Q]
+ * @example
+ *  Calc::ModContext.new(101).modulus  #=> Calc::Q(101)
+ */
+static VALUE
+mc_modulus(VALUE self)
+{
+    return wrap_number(qlink(get_context(self)->modulus));
+}
+
+/* Reduces an integer modulo the modulus
+ *
+ * @param x [Integer,Calc::Q,Calc::ModContext::Residue]
+ * @return [Calc::ModContext::Residue]
+ * @raise [Calc::MathError] if x is not an integer
+ * @example
+ *  Calc::ModContext.new(7).reduce(-1)  #=> Calc::ModContext::Residue(6 mod 7)
+ */
+static VALUE
+mc_reduce(VALUE self, VALUE x)
+{
+    setup_math_error();
+
+    get_context(self);
+    return to_residue(self, x);
+}
+
+/* Modular multiplication
+ *
+ * @param a [Integer,Calc::Q,Calc::ModContext::Residue]
+ * @param b [Integer,Calc::Q,Calc::ModContext::Residue]
+ * @return [Calc::ModContext::Residue] a * b mod m
+ * @raise [Calc::MathError] if a or b is not an integer
+ * @example
+ *  Calc::ModContext.new(7).mul(3, 5)  #=> Calc::ModContext::Residue(1 mod 7)
+ */
+static VALUE
+mc_mul(VALUE self, VALUE a, VALUE b)
+{
+    calc_modctx *c;
+    calc_residue *r;
+    HALF *t;
+    VALUE obj;
+    setup_math_error();
+
+    c = get_context(self);
+    a = to_residue(self, a);
+    b = to_residue(self, b);
+    obj = residue_new(self, &r);
+    t = ALLOC_N(HALF, c->m.len + 2);
+    mont_mul(&c->m, RESIDUE_V(a), RESIDUE_V(b), r->v, t);
+    xfree(t);
+    RB_GC_GUARD(a);
+    RB_GC_GUARD(b);
+    return obj;
+}
+
+/* Modular exponentiation
+ *
+ * A negative exponent raises the inverse of a to the power -e.
+ *
+ * @param a [Integer,Calc::Q,Calc::ModContext::Residue]
+ * @param e [Integer,Calc::Q] exponent
+ * @return [Calc::ModContext::Residue] a ** e mod m
+ * @raise [Calc::MathError] if a or e is not an integer, or e is negative and
+ *  a has no inverse
+ * @example
+ *  ctx = Calc::ModContext.new(101)
+ *  ctx.pow(2, 100)  #=> Calc::ModContext::Residue(1 mod 101)
+ *  ctx.pow(2, -1)   #=> Calc::ModContext::Residue(51 mod 101)
+ */
+static VALUE
+mc_pow(VALUE self, VALUE a, VALUE e)
+{
+    calc_modctx *c;
+    calc_residue *r;
+    NUMBER *qe;
+    HALF *w;
+    VALUE obj;
+    setup_math_error();
+
+    c = get_context(self);
+    a = to_residue(self, a);
+    qe = value_to_number(e, 0);
+    if (qisfrac(qe)) {
+        qfree(qe);
+        rb_raise(e_MathError, "non-integer exponent for ModContext#pow");
+    }
+    if (qisneg(qe)) {
+        a = mc_invert(self, a);
+        if (NIL_P(a)) {
+            qfree(qe);
+            rb_raise(e_MathError, "no inverse for negative power in ModContext#pow");
+        }
+    }
+    obj = residue_new(self, &r);
+    w = ALLOC_N(HALF, MONT_POW_WORK(c->m.len));
+    mont_pow(&c->m, RESIDUE_V(a), qe->num.v, qe->num.len, r->v, w);
+    xfree(w);
+    qfree(qe);
+    RB_GC_GUARD(a);
+    return obj;
+}
+
+/* Modular inverse
+ *
+ * @param a [Integer,Calc::Q,Calc::ModContext::Residue]
+ * @return [Calc::ModContext::Residue] x such that a * x = 1 mod m
+ * @raise [Calc::MathError] if a is not an integer or has no inverse
+ * @example
+ *  Calc::ModContext.new(101).inv(2)  #=> Calc::ModContext::Residue(51 mod 101)
+ */
+static VALUE
+mc_inv(VALUE self, VALUE a)
+{
+    VALUE result;
+    setup_math_error();
+
+    get_context(self);
+    result = mc_invert(self, to_residue(self, a));
+    if (NIL_P(result)) {
+        rb_raise(e_MathError, "no inverse for ModContext#inv");
+    }
+    return result;
+}
+
+/*****************************************************************************
+ * Calc::ModContext::Residue                                                 *
+ *****************************************************************************/
+
+/* Returns the context this residue belongs to
+ *
+ * @return [Calc::ModContext]
+ */
+static VALUE
+mr_context(VALUE self)
+{
+    return ((calc_residue *) rb_check_typeddata(self, &calc_residue_type))->context;
+}
+
+/* Returns the value of the residue as an integer
+ *
+ * @return [Calc::Q] an integer in the range 0 <= x < modulus
+ * @example
+ *  Calc::ModContext.new(7).reduce(10).to_q  #=> Calc::Q(3)
+ */
+static VALUE
+mr_to_q(VALUE self)
+{
+    calc_residue *r = rb_check_typeddata(self, &calc_residue_type);
+    NUMBER *q;
+    setup_math_error();
+
+    q = qalloc();
+    mc_decode(DATA_PTR(r->context), r->v, &q->num);
+    return wrap_number(q);
+}
+
+/* Equality
+ *
+ * Residues are equal if they belong to the same context and have the same
+ * value.  Anything else is compared with the value of the residue.
+ *
+ * @param y [Object]
+ * @return [Boolean]
+ * @example
+ *  ctx = Calc::ModContext.new(7)
+ *  ctx.reduce(10) == ctx.reduce(3)  #=> true
+ *  ctx.reduce(10) == 3              #=> true
+ */
+static VALUE
+mr_equal(VALUE self, VALUE y)
+{
+    calc_residue *r = rb_check_typeddata(self, &calc_residue_type), *o;
+
+    if (rb_typeddata_is_kind_of(y, &calc_residue_type)) {
+        o = DATA_PTR(y);
+        if (o->context != r->context) {
+            return Qfalse;
+        }
+        return memcmp(r->v, o->v, get_context(r->context)->m.len * sizeof(HALF)) ? Qfalse : Qtrue;
+    }
+    return rb_equal(mr_to_q(self), y);
+}
+
+void
+define_calc_mod_context(VALUE m)
+{
+    cModContext = rb_define_class_under(m, "ModContext", rb_cObject);
+    rb_define_alloc_func(cModContext, mc_alloc);
+    rb_define_method(cModContext, "initialize", mc_initialize, 1);
+    rb_define_method(cModContext, "inv", mc_inv, 1);
+    rb_define_method(cModContext, "modulus", mc_modulus, 0);
+    rb_define_method(cModContext, "mul", mc_mul, 2);
+    rb_define_method(cModContext, "pow", mc_pow, 2);
+    rb_define_method(cModContext, "reduce", mc_reduce, 1);
+
+    cResidue = rb_define_class_under(cModContext, "Residue", rb_cObject);
+    rb_undef_alloc_func(cResidue);
+    rb_define_method(cResidue, "==", mr_equal, 1);
+    rb_define_method(cResidue, "context", mr_context, 0);
+    rb_define_method(cResidue, "to_q", mr_to_q, 0);
+}
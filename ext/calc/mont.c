@@ -0,0 +1,292 @@
+#include <string.h>
+#include "calc.h"
+
+/* arithmetic on numbers stored as little-endian arrays of HALF digits, and
+ * in montgomery form modulo an odd n: x is represented by x R mod n, where
+ * R = 2^(BASEB len) and len is the length of n.  a product then needs no
+ * division, only multiples of n which clear the low digits (redc).
+ *
+ * used by factorize.c, mod_context.c and ptest.c.  apart from mont_init,
+ * mont_free, limbs_to_z and limbs_gcd, which use ruby or libcalc, everything
+ * here is plain C and may be called by tasks run without the GVL (see
+ * parallel.c).
+ */
+
+/* whether a < b, both len HALFs */
+int
+limbs_less(const HALF * a, const HALF * b, LEN len)
+{
+    while (len-- > 0) {
+        if (a[len] != b[len]) {
+            return a[len] < b[len];
+        }
+    }
+    return 0;
+}
+
+/* r = a - b, returning the borrow */
+HALF
+limbs_sub(const HALF * a, const HALF * b, HALF * r, LEN len)
+{
+    FULL t;
+    HALF borrow = 0;
+    LEN i;
+
+    for (i = 0; i < len; i++) {
+        t = (FULL) a[i] - b[i] - borrow;
+        r[i] = (HALF) t;
+        borrow = (HALF) ((t >> BASEB) & 1);
+    }
+    return borrow;
+}
+
+/* r = a + b, returning the carry */
+HALF
+limbs_add(const HALF * a, const HALF * b, HALF * r, LEN len)
+{
+    FULL t;
+    HALF carry = 0;
+    LEN i;
+
+    for (i = 0; i < len; i++) {
+        t = (FULL) a[i] + b[i] + carry;
+        r[i] = (HALF) t;
+        carry = (HALF) (t >> BASEB);
+    }
+    return carry;
+}
+
+/* copies z (0 <= z < 2^(BASEB len)) to len HALFs */
+void
+limbs_from_z(ZVALUE z, HALF * r, LEN len)
+{
+    memset(r, 0, len * sizeof(HALF));
+    memcpy(r, z.v, z.len * sizeof(HALF));
+}
+
+/* res = the len HALFs of a as a new (non-negative) ZVALUE */
+void
+limbs_to_z(const HALF * a, LEN len, ZVALUE * res)
+{
+    while (len > 1 && a[len - 1] == 0) {
+        len--;
+    }
+    res->v = alloc(len);
+    memcpy(res->v, a, len * sizeof(HALF));
+    res->len = len;
+    res->sign = 0;
+}
+
+/* g = gcd(a, n), a being len HALFs */
+void
+limbs_gcd(const HALF * a, LEN len, ZVALUE n, ZVALUE * g)
+{
+    ZVALUE z;
+
+    /* z is a view of a, not to be freed */
+    while (len > 1 && a[len - 1] == 0) {
+        len--;
+    }
+    z.v = (HALF *) a;
+    z.len = len;
+    z.sign = 0;
+    zgcd(z, n, g);
+}
+
+/* r = a + b mod n */
+void
+mont_add(const mont_t * m, const HALF * a, const HALF * b, HALF * r)
+{
+    if (limbs_add(a, b, r, m->len) || !limbs_less(r, m->n, m->len)) {
+        limbs_sub(r, m->n, r, m->len);
+    }
+}
+
+/* r = a - b mod n */
+void
+mont_sub(const mont_t * m, const HALF * a, const HALF * b, HALF * r)
+{
+    if (limbs_sub(a, b, r, m->len)) {
+        limbs_add(r, m->n, r, m->len);
+    }
+}
+
+/* x = x / 2 mod n */
+void
+mont_half(const mont_t * m, HALF * x)
+{
+    HALF carry = 0;
+    LEN i;
+
+    if (x[0] & 1) {
+        carry = limbs_add(x, m->n, x, m->len);
+    }
+    for (i = 0; i + 1 < m->len; i++) {
+        x[i] = (x[i] >> 1) | (x[i + 1] << (BASEB - 1));
+    }
+    x[m->len - 1] = (x[m->len - 1] >> 1) | (carry << (BASEB - 1));
+}
+
+/* r = a b / R mod n.  t is scratch space of len + 2 HALFs.  r may be a or b. */
+void
+mont_mul(const mont_t * m, const HALF * a, const HALF * b, HALF * r, HALF * t)
+{
+    LEN len = m->len, i, j;
+    FULL f;
+    HALF q, carry;
+
+    memset(t, 0, (len + 2) * sizeof(HALF));
+    for (i = 0; i < len; i++) {
+        /* t += a b[i] */
+        carry = 0;
+        for (j = 0; j < len; j++) {
+            f = (FULL) a[j] * b[i] + t[j] + carry;
+            t[j] = (HALF) f;
+            carry = (HALF) (f >> BASEB);
+        }
+        f = (FULL) t[len] + carry;
+        t[len] = (HALF) f;
+        t[len + 1] = (HALF) (f >> BASEB);
+
+        /* t = (t + q n) / 2^BASEB, with q chosen to make that exact */
+        q = (HALF) (t[0] * m->ninv);
+        f = (FULL) q * m->n[0] + t[0];
+        carry = (HALF) (f >> BASEB);
+        for (j = 1; j < len; j++) {
+            f = (FULL) q * m->n[j] + t[j] + carry;
+            t[j - 1] = (HALF) f;
+            carry = (HALF) (f >> BASEB);
+        }
+        f = (FULL) t[len] + carry;
+        t[len - 1] = (HALF) f;
+        t[len] = t[len + 1] + (HALF) (f >> BASEB);
+    }
+    /* t < 2n */
+    if (t[len] || !limbs_less(t, m->n, len)) {
+        limbs_sub(t, m->n, r, len);
+    }
+    else {
+        memcpy(r, t, len * sizeof(HALF));
+    }
+}
+
+/* r = the small value c in montgomery form */
+void
+mont_small(const mont_t * m, HALF c, HALF * r, HALF * t)
+{
+    memset(r, 0, m->len * sizeof(HALF));
+    r[0] = c;
+    mont_mul(m, r, m->r2, r, t);
+}
+
+/* fills in the rest of m, whose len HALFs of n (odd, > 1) are already set and
+ * whose one and r2 point to len HALFs each.  plain C, so it can be used by
+ * tasks run without the GVL. */
+void
+mont_setup(mont_t * m)
+{
+    LEN len = m->len;
+    HALF x;
+    long i;
+    int j;
+
+    /* R mod n and R^2 mod n by doubling 1, which costs less than a
+     * multiplication for the sizes we use */
+    memset(m->one, 0, len * sizeof(HALF));
+    m->one[0] = 1;
+    for (i = 0; i < BASEB * (long) len; i++) {
+        mont_add(m, m->one, m->one, m->one);
+    }
+    memcpy(m->r2, m->one, len * sizeof(HALF));
+    for (i = 0; i < BASEB * (long) len; i++) {
+        mont_add(m, m->r2, m->r2, m->r2);
+    }
+
+    /* newton's iteration for 1/n mod 2^BASEB, each step doubling the number
+     * of correct bits (n n = 1 mod 8, so x starts with 3) */
+    x = m->n[0];
+    for (j = 0; j < 5; j++) {
+        x *= 2 - m->n[0] * x;
+    }
+    m->ninv = (HALF) (0 - x);
+}
+
+/* sets up m for arithmetic mod n (n odd, n > 1) */
+void
+mont_init(mont_t * m, ZVALUE n)
+{
+    m->len = n.len;
+    m->n = ALLOC_N(HALF, 3 * n.len);
+    m->one = m->n + n.len;
+    m->r2 = m->one + n.len;
+    limbs_from_z(n, m->n, n.len);
+    mont_setup(m);
+}
+
+void
+mont_free(mont_t * m)
+{
+    xfree(m->n);
+    m->n = NULL;
+}
+
+#define EBIT(e, i) (((e)[(i) / BASEB] >> ((i) % BASEB)) & 1)
+
+/* r = a^e, where e has elen HALFs, by left to right sliding windows of up to
+ * MONT_WINDOW bits.  w is scratch space of MONT_POW_WORK(len) HALFs.  r may
+ * not be a. */
+void
+mont_pow(const mont_t * m, const HALF * a, const HALF * e, LEN elen, HALF * r, HALF * w)
+{
+    LEN len = m->len;
+    HALF *t = w + (1 << (MONT_WINDOW - 1)) * len;
+    long i, j, k, bits;
+    int first = 1, window;
+    unsigned long v;
+
+    /* the top bit of e */
+    for (i = BASEB * (long) elen - 1; i >= 0 && !EBIT(e, i); i--) {
+    }
+    if (i < 0) {
+        memcpy(r, m->one, len * sizeof(HALF));
+        return;
+    }
+
+    /* w holds a, a^3, a^5, ... (fewer for short exponents) */
+    window = i < 32 ? 2 : i < 256 ? MONT_WINDOW - 1 : MONT_WINDOW;
+    memcpy(w, a, len * sizeof(HALF));
+    if (window > 1) {
+        mont_mul(m, a, a, r, t);
+        for (k = 1; k < (1L << (window - 1)); k++) {
+            mont_mul(m, w + (k - 1) * len, r, w + k * len, t);
+        }
+    }
+
+    while (i >= 0) {
+        if (!EBIT(e, i)) {
+            mont_mul(m, r, r, r, t);
+            i--;
+            continue;
+        }
+        /* the longest window ending in a set bit */
+        j = i - window + 1 < 0 ? 0 : i - window + 1;
+        while (!EBIT(e, j)) {
+            j++;
+        }
+        for (v = 0, k = i; k >= j; k--) {
+            v = (v << 1) | EBIT(e, k);
+        }
+        bits = i - j + 1;
+        if (first) {
+            memcpy(r, w + (v >> 1) * len, len * sizeof(HALF));
+            first = 0;
+        }
+        else {
+            while (bits-- > 0) {
+                mont_mul(m, r, r, r, t);
+            }
+            mont_mul(m, r, w + (v >> 1) * len, r, t);
+        }
+        i = j - 1;
+    }
+}
@@ -0,0 +1,243 @@
+#include "calc.h"
+
+/* square roots and nth roots of large numbers by newton's method, doubling
+ * the precision at each step.
+ *
+ * libcalc's qsqrt, qroot, qisqrt and qiroot iterate at the full precision
+ * of the result from the start.  here the integer root of n is found by first
+ * finding the root of n / 2^(mk) (about half as many bits), recursively, and
+ * using it as the starting point for newton's method on n:
+ *   x' = ((m - 1) x + n / x^(m-1)) / m
+ * started above the root, this decreases until it reaches floor(n^(1/m)), so
+ * only the last two or three steps are at full precision.
+ *
+ * sqrt and root of rationals are integer roots of the number scaled by
+ * epsilon.  the result is then rounded using qmappr, so rounding is exactly
+ * as libcalc does it (config "sqrt" for sqrt, to nearest for root).  cases
+ * where the root is an exact rational (so config "sqrt" bit 32 matters), and
+ * anything small, are passed to libcalc.
+ *
+ * everything runs with the GVL held, like the rest of libcalc.
+ */
+
+/* roots with fewer bits than this are left to libcalc */
+#define NEWTON_MIN_BITS 4096
+
+/* roots with fewer bits than this are found directly, without recursing */
+#define NEWTON_BASE_BITS 64
+
+/* res = z^e */
+static void
+zpowl(ZVALUE z, long e, ZVALUE * res)
+{
+    ZVALUE ze;
+
+    itoz(e, &ze);
+    zpowi(z, ze, res);
+    zfree(ze);
+}
+
+/* x is a starting value >= floor(n^(1/m)); replaces it with floor(n^(1/m)) */
+static void
+newton_descend(ZVALUE n, long m, ZVALUE * x)
+{
+    ZVALUE t1, t2, t3, y;
+
+    for (;;) {
+        /* y = ((m - 1) x + n / x^(m-1)) / m */
+        if (m == 2) {
+            zquo(n, *x, &t2, 0);
+        }
+        else {
+            zpowl(*x, m - 1, &t1);
+            zquo(n, t1, &t2, 0);
+            zfree(t1);
+        }
+        zmuli(*x, m - 1, &t1);
+        zadd(t1, t2, &t3);
+        zfree(t1);
+        zfree(t2);
+        zdivi(t3, m, &y);
+        zfree(t3);
+        if (zrel(y, *x) >= 0) {
+            zfree(y);
+            return;
+        }
+        zfree(*x);
+        *x = y;
+    }
+}
+
+/* res = floor(n^(1/m)), n >= 0, m >= 2 */
+static void
+newton_iroot_z(ZVALUE n, long m, ZVALUE * res)
+{
+    ZVALUE t, r;
+    long bits, k;
+
+    if (ziszero(n)) {
+        itoz(0, res);
+        return;
+    }
+    /* n < 2^bits, so the root is < 2^ceil(bits/m) */
+    bits = zhighbit(n) + 1;
+    k = (bits + m - 1) / m;
+    if (k <= NEWTON_BASE_BITS) {
+        zbitvalue(k, res);
+    }
+    else {
+        /* r = floor((n / 2^(mk))^(1/m)), so the root is < (r + 1) 2^k */
+        k /= 2;
+        zshift(n, -m * k, &t);
+        newton_iroot_z(t, m, &r);
+        zfree(t);
+        zadd(r, _one_, &t);
+        zfree(r);
+        zshift(t, k, res);
+        zfree(t);
+    }
+    newton_descend(n, m, res);
+}
+
+/* approximate number of bits in q^(1/m) / epsilon */
+static long
+root_bits(NUMBER * q, long m, NUMBER * epsilon)
+{
+    return qilog2(q) / m - qilog2(epsilon);
+}
+
+/* returns a multiple of epsilon close to q^(1/m) (q > 0, epsilon > 0),
+ * rounded with qmappr(rnd) */
+static NUMBER *
+newton_root_number(NUMBER * q, long m, NUMBER * epsilon, long rnd)
+{
+    ZVALUE n, d, t1, t2, r;
+    NUMBER *y, *v, *result;
+    long quarters;
+
+    /* q^(1/m) / epsilon = (n/d)^(1/m) with n = num(q) den(eps)^m,
+     * d = den(q) num(eps)^m */
+    zpowl(epsilon->den, m, &t1);
+    zmul(q->num, t1, &n);
+    zfree(t1);
+    zpowl(epsilon->num, m, &t1);
+    zmul(q->den, t1, &d);
+    zfree(t1);
+    zquo(n, d, &t1, 0);
+    newton_iroot_z(t1, m, &r);
+    zfree(t1);
+
+    /* the exact root is r + f where 0 <= f < 1.  qmappr only needs to know
+     * whether f is 0, below 1/2, 1/2 or above, so round r + 0, 1/4, 2/4 or
+     * 3/4 instead. */
+    zpowl(r, m, &t1);
+    zmul(t1, d, &t2);
+    zfree(t1);
+    if (!zcmp(t2, n)) {
+        quarters = 0;
+    }
+    else {
+        /* compare 2^m n with (2r + 1)^m d */
+        zfree(t2);
+        zshift(r, 1, &t1);
+        zadd(t1, _one_, &t2);
+        zfree(t1);
+        zpowl(t2, m, &t1);
+        zfree(t2);
+        zmul(t1, d, &t2);
+        zfree(t1);
+        zshift(n, m, &t1);
+        quarters = 2 + zrel(t1, t2);
+        zfree(t1);
+    }
+    zfree(t2);
+    zfree(n);
+    zfree(d);
+
+    zshift(r, 2, &t1);
+    zfree(r);
+    itoz(quarters, &t2);
+    y = qalloc();
+    zadd(t1, t2, &y->num);
+    zfree(t1);
+    zfree(t2);
+    v = qscale(y, -2);
+    qfree(y);
+    y = qmul(v, epsilon);
+    qfree(v);
+    result = qmappr(y, epsilon, rnd);
+    qfree(y);
+    return result;
+}
+
+/* sqrt(q) rounded to epsilon as specified by R (like qsqrt) */
+NUMBER *
+newton_sqrt(NUMBER * q, NUMBER * epsilon, long R)
+{
+    /* bit 64 (negative root) and exact rational roots are left to libcalc,
+     * as is the sign of epsilon */
+    if (qisneg(q) || qiszero(q) || qisneg(epsilon) || qiszero(epsilon) || (R & 64)
+        || root_bits(q, 2, epsilon) < NEWTON_MIN_BITS
+        || (zissquare(q->num) && zissquare(q->den))) {
+        return qsqrt(q, epsilon, R);
+    }
+    return newton_root_number(q, 2, epsilon, R & 31);
+}
+
+/* q^(1/n) to within epsilon (like qroot) */
+NUMBER *
+newton_root(NUMBER * q, NUMBER * n, NUMBER * epsilon)
+{
+    long m;
+
+    if (qisneg(q) || qiszero(q) || qisneg(epsilon) || qiszero(epsilon) || qisfrac(n)
+        || qisneg(n) || qiszero(n) || zge31b(n->num)) {
+        return qroot(q, n, epsilon);
+    }
+    m = qtoi(n);
+    if (m < 2 || root_bits(q, m, epsilon) < NEWTON_MIN_BITS) {
+        return qroot(q, n, epsilon);
+    }
+    /* qroot returns a multiple of epsilon close to the root; this is the
+     * nearest one */
+    return newton_root_number(q, m, epsilon, 24L);
+}
+
+/* floor(q^(1/m)) if q is big enough for newton's method, otherwise NULL */
+static NUMBER *
+newton_iroot_number(NUMBER * q, long m)
+{
+    NUMBER *result;
+    ZVALUE t;
+
+    if (qisneg(q) || qiszero(q) || qilog2(q) / m < NEWTON_MIN_BITS) {
+        return NULL;
+    }
+    zquo(q->num, q->den, &t, 0);
+    result = qalloc();
+    newton_iroot_z(t, m, &result->num);
+    zfree(t);
+    return result;
+}
+
+/* floor(sqrt(q)) (like qisqrt) */
+NUMBER *
+newton_isqrt(NUMBER * q)
+{
+    NUMBER *result;
+
+    result = newton_iroot_number(q, 2);
+    return result ? result : qisqrt(q);
+}
+
+/* floor(q^(1/n)) (like qiroot) */
+NUMBER *
+newton_iroot(NUMBER * q, NUMBER * n)
+{
+    NUMBER *result = NULL;
+
+    if (qisint(n) && !qisneg(n) && !zge31b(n->num) && qtoi(n) >= 2) {
+        result = newton_iroot_number(q, qtoi(n));
+    }
+    return result ? result : qiroot(q, n);
+}
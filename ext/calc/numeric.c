@@ -6,6 +6,47 @@
  */
 VALUE cNumeric;
 
+/* parses the optional epsilon argument of sincos, sinhcosh and cis */
+static NUMBER *
+trig_epsilon(int argc, VALUE * argv)
+{
+    VALUE epsilon;
+    NUMBER *qepsilon;
+
+    rb_scan_args(argc, argv, "01", &epsilon);
+    qepsilon = NIL_P(epsilon) ? qlink(conf->epsilon) : value_to_epsilon(epsilon);
+    if (qisneg(qepsilon) || qiszero(qepsilon)) {
+        qfree(qepsilon);
+        rb_raise(e_MathError, "Epsilon value must be greater than zero");
+    }
+    return qepsilon;
+}
+
+/* implements sincos and sinhcosh, which return a pair of values computed
+ * together by the functions in trig.c */
+static VALUE
+pair_function(int argc, VALUE * argv, VALUE self,
+              void (*fq) (NUMBER *, NUMBER *, NUMBER **, NUMBER **),
+              void (*fc) (COMPLEX *, NUMBER *, COMPLEX **, COMPLEX **))
+{
+    VALUE result;
+    NUMBER *qepsilon, *qa, *qb;
+    COMPLEX *ca, *cb;
+    setup_math_error();
+
+    qepsilon = trig_epsilon(argc, argv);
+    if (CALC_Q_P(self)) {
+        (*fq) (DATA_PTR(self), qepsilon, &qa, &qb);
+        result = rb_assoc_new(wrap_number(qa), wrap_number(qb));
+    }
+    else {
+        (*fc) (DATA_PTR(self), qepsilon, &ca, &cb);
+        result = rb_assoc_new(wrap_complex(ca), wrap_complex(cb));
+    }
+    qfree(qepsilon);
+    return result;
+}
+
 /* similar to trans_function, but for ln and log; the rational versions (qln,
  * qlog) return wrong results for self < 0, so call the complex version in that
  * case.
@@ -18,13 +59,26 @@ log_function(int argc, VALUE * argv, VALUE self, NUMBER * (fq) (NUMBER *, NUMBER
     VALUE epsilon, result;
     NUMBER *qepsilon, *qself;
     COMPLEX *cself;
+    memo_key key;
     setup_math_error();
 
     if (rb_scan_args(argc, argv, "01", &epsilon) == 0) {
         qepsilon = NULL;
     }
     else {
-        qepsilon = value_to_number(epsilon, 1);
+        qepsilon = value_to_epsilon(epsilon);
+    }
+    if (memo_enabled()) {
+        memo_key_init(&key, CALC_Q_P(self) ? (memo_fn) fq : (memo_fn) fc, 0);
+        memo_key_value(&key, self);
+        memo_key_number(&key, qepsilon ? qepsilon : conf->epsilon);
+        result = memo_lookup(&key);
+        if (result != Qundef) {
+            if (qepsilon) {
+                qfree(qepsilon);
+            }
+            return result;
+        }
     }
     if (CALC_Q_P(self)) {
         qself = DATA_PTR(self);
@@ -47,6 +101,9 @@ log_function(int argc, VALUE * argv, VALUE self, NUMBER * (fq) (NUMBER *, NUMBER
     else {
         rb_raise(e_MathError, "log_function called with invalid receiver");
     }
+    if (memo_enabled()) {
+        memo_store(&key, result);
+    }
     if (qepsilon) {
         qfree(qepsilon);
     }
@@ -121,6 +178,40 @@ cn_shift_right(VALUE self, VALUE other)
     return shift(self, other, TRUE);
 }
 
+/* Returns cos(self) + sin(self)i
+ *
+ * This is the same as (self * 1i).exp, but computes the sine and cosine
+ * together.
+ *
+ * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C,Calc::Q]
+ * @raise [Calc::MathError] if eps is not greater than zero
+ * @example
+ *  Calc::Q(1).cis    #=> Calc::C(0.5403023058681397174+0.84147098480789650665i)
+ *  Calc::C(1, 1).cis #=> Calc::C(0.19876611034641294063+0.30955987565311219844i)
+ */
+static VALUE
+cn_cis(int argc, VALUE * argv, VALUE self)
+{
+    NUMBER *qepsilon;
+    COMPLEX *cself, *cresult;
+    setup_math_error();
+
+    qepsilon = trig_epsilon(argc, argv);
+    if (CALC_Q_P(self)) {
+        cself = comalloc();
+        qfree(cself->real);
+        cself->real = qlink((NUMBER *) DATA_PTR(self));
+        cresult = cis_complex(cself, qepsilon);
+        comfree(cself);
+    }
+    else {
+        cresult = cis_complex(DATA_PTR(self), qepsilon);
+    }
+    qfree(qepsilon);
+    return wrap_complex(cresult);
+}
+
 /* Compare 2 values.
  *
  * If x and y are both real, returns -1, 0 or 1 according as x < y, x == y or
@@ -335,7 +426,7 @@ cn_ilog(VALUE self, VALUE base)
 static VALUE
 cn_ln(int argc, VALUE * argv, VALUE self)
 {
-    return log_function(argc, argv, self, &qln, &c_ln);
+    return log_function(argc, argv, self, &agm_ln, &c_ln);
 }
 
 /* Base 10 logarithm
@@ -355,7 +446,186 @@ cn_ln(int argc, VALUE * argv, VALUE self)
 static VALUE
 cn_log(int argc, VALUE * argv, VALUE self)
 {
-    return log_function(argc, argv, self, &qlog, &c_log);
+    return log_function(argc, argv, self, &agm_log, &c_log);
+}
+
+/* ln(base) for logn and log2, cached by (base, epsilon) since a program
+ * typically uses a few fixed bases.  entries are replaced round robin. */
+#define LOGN_CACHE_SIZE 8
+
+typedef struct {
+    NUMBER *base;
+    NUMBER *epsilon;
+    COMPLEX *ln;                /* real unless base < 0 */
+} logn_entry;
+
+static logn_entry logn_cache[LOGN_CACHE_SIZE];
+static int logn_next;
+
+/* returns ln(qbase) as a new reference.  qbase must be real and not 0 or 1. */
+static COMPLEX *
+logn_base_ln(NUMBER * qbase, NUMBER * qepsilon)
+{
+    logn_entry *e;
+    COMPLEX *cbase, *cresult;
+    int i;
+
+    for (i = 0; i < LOGN_CACHE_SIZE; i++) {
+        e = &logn_cache[i];
+        if (e->base && !qcmp(e->base, qbase) && !qcmp(e->epsilon, qepsilon)) {
+            return clink(e->ln);
+        }
+    }
+    if (qisneg(qbase)) {
+        cbase = comalloc();
+        qfree(cbase->real);
+        cbase->real = qlink(qbase);
+        cresult = c_ln(cbase, qepsilon);
+        comfree(cbase);
+    }
+    else {
+        cresult = comalloc();
+        qfree(cresult->real);
+        if (!qcmp(qbase, &_qtwo_)) {
+            cresult->real = constant_value(CONST_LN2, qepsilon);
+        }
+        else if (!qcmp(qbase, &_qten_)) {
+            cresult->real = constant_value(CONST_LN10, qepsilon);
+        }
+        else {
+            cresult->real = agm_ln(qbase, qepsilon);
+        }
+    }
+    e = &logn_cache[logn_next];
+    logn_next = (logn_next + 1) % LOGN_CACHE_SIZE;
+    if (e->base) {
+        qfree(e->base);
+        qfree(e->epsilon);
+        comfree(e->ln);
+    }
+    e->base = qlink(qbase);
+    e->epsilon = qlink(qepsilon);
+    e->ln = clink(cresult);
+    return cresult;
+}
+
+/* ln(self) / lnbase.  like log_function, uses the complex version of ln if
+ * self <= 0. */
+static VALUE
+log_quotient(VALUE self, COMPLEX * lnbase, NUMBER * qepsilon)
+{
+    NUMBER *qself, *qtmp, *qresult;
+    COMPLEX *cself, *ctmp, *cresult;
+
+    if (CALC_Q_P(self)) {
+        qself = DATA_PTR(self);
+        if (!qisneg(qself) && !qiszero(qself) && cisreal(lnbase)) {
+            qtmp = agm_ln(qself, qepsilon);
+            qresult = qqdiv(qtmp, lnbase->real);
+            qfree(qtmp);
+            return wrap_number(qresult);
+        }
+        cself = comalloc();
+        qfree(cself->real);
+        cself->real = qlink(qself);
+        ctmp = c_ln(cself, qepsilon);
+        comfree(cself);
+    }
+    else if (CALC_C_P(self)) {
+        ctmp = c_ln(DATA_PTR(self), qepsilon);
+    }
+    else {
+        rb_raise(e_MathError, "log_quotient called with invalid receiver");
+    }
+    if (cisreal(lnbase)) {
+        cresult = c_divq(ctmp, lnbase->real);
+    }
+    else {
+        cresult = c_div(ctmp, lnbase);
+    }
+    comfree(ctmp);
+    return wrap_complex(cresult);
+}
+
+/* Base 2 logarithm
+ *
+ * This is ln(self) / ln(2), where both logarithms are calculated to eps.
+ * ln(2) is only calculated once for each eps.
+ *
+ * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
+ * @return [Calc::Q,Calc::C]
+ * @raise [Calc::MathError] if self is zero
+ * @example
+ *  Calc::Q(1).log2    #=> Calc::Q(0)
+ *  Calc::Q(2).log2    #=> Calc::Q(1)
+ *  Calc::Q(10).log2   #=> Calc::Q(~3.32192809488736234786)
+ *  Calc::Q(-2).log2   #=> Calc::C(1+~4.53236014182719380961i)
+ *  Calc::C(1, 2).log2 #=> Calc::C(~1.16096404744368117393+~1.59727796468810880664i)
+ */
+static VALUE
+cn_log2(int argc, VALUE * argv, VALUE self)
+{
+    VALUE epsilon, result;
+    NUMBER *qepsilon;
+    COMPLEX *lnbase;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "01", &epsilon);
+    qepsilon = NIL_P(epsilon) ? qlink(conf->epsilon) : value_to_epsilon(epsilon);
+    lnbase = logn_base_ln(&_qtwo_, qepsilon);
+    result = log_quotient(self, lnbase, qepsilon);
+    comfree(lnbase);
+    qfree(qepsilon);
+    return result;
+}
+
+/* Logarithm to an arbitrary base
+ *
+ * This is ln(self) / ln(base), where both logarithms are calculated to eps.
+ * ln(base) is cached for recently used real bases, so repeated calls with
+ * the same base and eps only calculate one logarithm.
+ *
+ * @param base [Numeric,Calc::Numeric] base of the logarithm, not 0 or 1
+ * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
+ * @return [Calc::Q,Calc::C]
+ * @raise [Calc::MathError] if self is zero or base is 0 or 1
+ * @example
+ *  Calc::Q(9).logn(3)             #=> Calc::Q(~1.99999999999999999999)
+ *  Calc::Q(10).logn(3)            #=> Calc::Q(~2.09590327428938460429)
+ *  Calc::Q(-8).logn(2)            #=> Calc::C(~2.99999999999999999999+~4.53236014182719380961i)
+ *  Calc::C(0, 1).logn(Complex::I) #=> Calc::Q(1)
+ */
+static VALUE
+cn_logn(int argc, VALUE * argv, VALUE self)
+{
+    VALUE base, epsilon, result;
+    NUMBER *qepsilon, *qbase;
+    COMPLEX *lnbase;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "11", &base, &epsilon);
+    base = value_to_calc(base);
+    if (CALC_C_P(base) && !cisreal((COMPLEX *) DATA_PTR(base))) {
+        qbase = NULL;
+    }
+    else {
+        qbase = CALC_Q_P(base) ? DATA_PTR(base) : ((COMPLEX *) DATA_PTR(base))->real;
+        if (qiszero(qbase) || qisone(qbase)) {
+            rb_raise(e_MathError, "base for logn must not be 0 or 1");
+        }
+    }
+    qepsilon = NIL_P(epsilon) ? qlink(conf->epsilon) : value_to_epsilon(epsilon);
+    if (qbase) {
+        lnbase = logn_base_ln(qbase, qepsilon);
+    }
+    else {
+        lnbase = c_ln(DATA_PTR(base), qepsilon);
+    }
+    result = log_quotient(self, lnbase, qepsilon);
+    comfree(lnbase);
+    qfree(qepsilon);
+    RB_GC_GUARD(base);
+    return result;
 }
 
 /* Compute integer quotient of a value by a real number (integer division)
@@ -430,7 +700,7 @@ cn_root(int argc, VALUE * argv, VALUE self)
     setup_math_error();
 
     if (rb_scan_args(argc, argv, "11", &n, &epsilon) > 1) {
-        qepsilon = value_to_number(epsilon, 1);
+        qepsilon = value_to_epsilon(epsilon);
         if (qiszero(qepsilon)) {
             qfree(qepsilon);
             rb_raise(e_MathError, "zero epsilon for root");
@@ -448,7 +718,7 @@ cn_root(int argc, VALUE * argv, VALUE self)
     if (CALC_Q_P(self)) {
         qself = DATA_PTR(self);
         if (!qisneg(qself)) {
-            result = wrap_number(qroot(qself, qn, qepsilon));
+            result = wrap_number(newton_root(qself, qn, qepsilon));
         }
         else {
             ctmp.real = qself;
@@ -539,6 +809,44 @@ cn_sgn(VALUE self)
     return wrap_complex(cresult);
 }
 
+/* Returns the sine and cosine of self
+ *
+ * This is faster than calling sin and cos separately, as most of the work
+ * is shared.
+ *
+ * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
+ * @return [Array] sine and cosine
+ * @raise [Calc::MathError] if eps is not greater than zero
+ * @example
+ *  Calc::Q(1).sincos    #=> [Calc::Q(0.84147098480789650665), Calc::Q(0.5403023058681397174)]
+ *  Calc::C(1, 1).sincos #=> [Calc::C(1.29845758141597729483+0.63496391478473610826i),
+ *                       #    Calc::C(0.83373002513114904888-0.98889770576286509638i)]
+ */
+static VALUE
+cn_sincos(int argc, VALUE * argv, VALUE self)
+{
+    return pair_function(argc, argv, self, sincos_number, sincos_complex);
+}
+
+/* Returns the hyperbolic sine and cosine of self
+ *
+ * This is faster than calling sinh and cosh separately, as both are
+ * calculated from a single exp.
+ *
+ * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
+ * @return [Array] hyperbolic sine and cosine
+ * @raise [Calc::MathError] if eps is not greater than zero
+ * @example
+ *  Calc::Q(1).sinhcosh    #=> [Calc::Q(1.17520119364380145688), Calc::Q(1.54308063481524377848)]
+ *  Calc::C(1, 1).sinhcosh #=> [Calc::C(0.63496391478473610826+1.29845758141597729483i),
+ *                         #    Calc::C(0.83373002513114904888+0.98889770576286509638i)]
+ */
+static VALUE
+cn_sinhcosh(int argc, VALUE * argv, VALUE self)
+{
+    return pair_function(argc, argv, self, sinhcosh_number, sinhcosh_complex);
+}
+
 /* Square root
  *
  * Calculates the square root of self (rational or complex).  If eps
@@ -561,13 +869,14 @@ cn_sqrt(int argc, VALUE * argv, VALUE self)
     VALUE result, epsilon, z;
     NUMBER *qtmp, *qepsilon;
     COMPLEX *cresult;
+    memo_key key;
     long R;
     int n;
     setup_math_error();
 
     n = rb_scan_args(argc, argv, "02", &epsilon, &z);
     if (n >= 1) {
-        qepsilon = value_to_number(epsilon, 1);
+        qepsilon = value_to_epsilon(epsilon);
     }
     else {
         qepsilon = conf->epsilon;
@@ -578,10 +887,22 @@ cn_sqrt(int argc, VALUE * argv, VALUE self)
     else {
         R = conf->sqrt;
     }
+    if (memo_enabled()) {
+        memo_key_init(&key, CALC_Q_P(self) ? (memo_fn) qsqrt : (memo_fn) c_sqrt, R);
+        memo_key_value(&key, self);
+        memo_key_number(&key, qepsilon);
+        result = memo_lookup(&key);
+        if (result != Qundef) {
+            if (n >= 1) {
+                qfree(qepsilon);
+            }
+            return result;
+        }
+    }
     if (CALC_Q_P(self) && !qisneg((NUMBER *) DATA_PTR(self))) {
         /* non-negative rational */
         result = cq_new();
-        DATA_PTR(result) = qsqrt(DATA_PTR(self), qepsilon, R);
+        DATA_PTR(result) = newton_sqrt(DATA_PTR(self), qepsilon, R);
     }
     else {
         if (CALC_Q_P(self)) {
@@ -589,7 +910,7 @@ cn_sqrt(int argc, VALUE * argv, VALUE self)
             qtmp = qneg(DATA_PTR(self));
             cresult = comalloc();
             qfree(cresult->imag);
-            cresult->imag = qsqrt(qtmp, qepsilon, R);
+            cresult->imag = newton_sqrt(qtmp, qepsilon, R);
             qfree(qtmp);
         }
         else {
@@ -598,6 +919,9 @@ cn_sqrt(int argc, VALUE * argv, VALUE self)
         }
         result = wrap_complex(cresult);
     }
+    if (memo_enabled()) {
+        memo_store(&key, result);
+    }
     if (n >= 1) {
         qfree(qepsilon);
     }
@@ -608,16 +932,22 @@ void
 define_calc_numeric(VALUE m)
 {
     cNumeric = rb_define_class_under(m, "Numeric", rb_cData);
+    rb_define_singleton_method(cNumeric, "many", cn_s_many, -1);
     rb_define_method(cNumeric, "<<", cn_shift_left, 1);
     rb_define_method(cNumeric, ">>", cn_shift_right, 1);
+    rb_define_method(cNumeric, "cis", cn_cis, -1);
     rb_define_method(cNumeric, "cmp", cn_cmp, 1);
     rb_define_method(cNumeric, "comb", cn_comb, 1);
     rb_define_method(cNumeric, "ilog", cn_ilog, 1);
     rb_define_method(cNumeric, "ln", cn_ln, -1);
     rb_define_method(cNumeric, "log", cn_log, -1);
+    rb_define_method(cNumeric, "log2", cn_log2, -1);
+    rb_define_method(cNumeric, "logn", cn_logn, -1);
     rb_define_method(cNumeric, "quo", cn_quo, -1);
     rb_define_method(cNumeric, "root", cn_root, -1);
     rb_define_method(cNumeric, "scale", cn_scale, 1);
     rb_define_method(cNumeric, "sgn", cn_sgn, 0);
+    rb_define_method(cNumeric, "sincos", cn_sincos, -1);
+    rb_define_method(cNumeric, "sinhcosh", cn_sinhcosh, -1);
     rb_define_method(cNumeric, "sqrt", cn_sqrt, -1);
 }
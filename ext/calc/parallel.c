@@ -0,0 +1,184 @@
+#include "calc.h"
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+#include "ruby/thread.h"
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+/* support for splitting work across native threads.
+ *
+ * libcalc is not thread safe (it keeps a free list of NUMBERs and static
+ * temporary buffers for multiplication, and math_error raises a ruby
+ * exception), so tasks run by calc_parallel_run must only do plain C work on
+ * data prepared beforehand: no libcalc calls, no ruby API and no
+ * allocations which could raise.  memory should come from malloc(), not
+ * libcalc's alloc().  results are turned into NUMBERs afterwards, when the
+ * GVL is held again.
+ */
+
+#define MAX_THREADS 256
+
+/* configured number of threads, 0 means one per online processor */
+static long threads_config = 0;
+
+static long
+online_processors(void)
+{
+    long n = 1;
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1)
+        n = 1;
+    if (n > MAX_THREADS)
+        n = MAX_THREADS;
+    return n;
+}
+
+long
+calc_get_threads(void)
+{
+    return threads_config;
+}
+
+void
+calc_set_threads(long n)
+{
+    threads_config = n > MAX_THREADS ? MAX_THREADS : n;
+}
+
+/* number of threads to use for a call.  v is the optional "threads"
+ * parameter given by the user; if nil, use the configured default. */
+long
+calc_thread_count(VALUE v)
+{
+    long n;
+
+    if (NIL_P(v)) {
+        return threads_config > 0 ? threads_config : online_processors();
+    }
+    n = value_to_long(v);
+    if (n < 1) {
+        rb_raise(rb_eArgError, "number of threads must be positive");
+    }
+    return n > MAX_THREADS ? MAX_THREADS : n;
+}
+
+/* returns the next task id, or -1 if there are none left (or ruby has asked
+ * us to stop) */
+static long
+parallel_next(calc_parallel_t * p)
+{
+    long id = -1;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&p->lock);
+#endif
+    if (!p->cancelled && p->next < p->ntasks) {
+        id = p->next++;
+    }
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&p->lock);
+#endif
+    return id;
+}
+
+static void *
+parallel_worker(void *arg)
+{
+    calc_parallel_t *p = (calc_parallel_t *) arg;
+    long id;
+
+    while ((id = parallel_next(p)) >= 0) {
+        p->task(p, id);
+    }
+    return NULL;
+}
+
+#if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+
+/* runs with the GVL released.  the calling thread does its share of the work
+ * too, so nthreads - 1 extra threads are started. */
+static void *
+parallel_nogvl(void *arg)
+{
+    calc_parallel_t *p = (calc_parallel_t *) arg;
+#ifdef HAVE_PTHREAD_H
+    pthread_t *tids;
+    long i, started = 0;
+
+    tids = p->nthreads > 1 ? malloc(sizeof(pthread_t) * (p->nthreads - 1)) : NULL;
+    for (i = 0; tids && i < p->nthreads - 1; i++) {
+        if (pthread_create(&tids[i], NULL, parallel_worker, p) != 0)
+            break;
+        started++;
+    }
+    parallel_worker(p);
+    for (i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+#else
+    parallel_worker(p);
+#endif
+    return NULL;
+}
+
+/* called by ruby (from another thread) when this thread is interrupted.
+ * workers finish the task they are on then stop picking up new ones. */
+static void
+parallel_ubf(void *arg)
+{
+    calc_parallel_t *p = (calc_parallel_t *) arg;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&p->lock);
+#endif
+    p->cancelled = 1;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&p->lock);
+#endif
+}
+
+#endif                          /* HAVE_RB_THREAD_CALL_WITHOUT_GVL */
+
+/* run p->task for every id in 0 .. p->ntasks-1, using up to nthreads native
+ * threads.  the GVL is released while the tasks run.
+ *
+ * if the ruby thread is interrupted (eg, Thread#raise or ^C) the pending
+ * exception is raised from here once the workers have stopped; callers which
+ * hold memory should use rb_ensure to free it.  if the interrupt didn't
+ * raise, the remaining tasks are run.
+ */
+void
+calc_parallel_run(calc_parallel_t * p, long nthreads)
+{
+    if (nthreads > p->ntasks)
+        nthreads = p->ntasks;
+    if (nthreads < 1)
+        nthreads = 1;
+    p->nthreads = nthreads;
+    p->next = 0;
+
+    while (p->next < p->ntasks) {
+        p->cancelled = 0;
+#if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_init(&p->lock, NULL);
+#endif
+        rb_thread_call_without_gvl(parallel_nogvl, p, parallel_ubf, p);
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_destroy(&p->lock);
+#endif
+        if (p->cancelled) {
+            rb_thread_check_ints();
+        }
+#else
+        /* no way to release the GVL; run everything in this thread, checking
+         * for interrupts between tasks */
+        p->task(p, p->next++);
+        rb_thread_check_ints();
+#endif
+    }
+}
@@ -0,0 +1,579 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "calc.h"
+
+/* prime counting for Calc::Q#pix, by the Lagarias-Miller-Odlyzko version of
+ * the Meissel-Lehmer method.  libcalc's zpix sieves up to its argument and
+ * stops at 2^32; this takes about x^(2/3) time and x^(1/3) memory.
+ *
+ * with y >= x^(1/3), a = pi(y) and phi(x, b) the count of numbers <= x with
+ * no prime factor among the first b primes:
+ *   pi(x) = phi(x, a) + a - 1 - P2
+ *   P2 = sum over primes y < p <= sqrt(x) of pi(x/p) - pi(p) + 1
+ *   phi(x, a) = S1 + S2
+ *   S1 = sum over n <= y of mu(n) floor(x/n)
+ *   S2 = -sum over primes p <= y, and m <= y < mp with no prime factor
+ *        <= p, of mu(m) phi(x/(mp), pi(p) - 1)
+ * (Deleglise and Rivat, "Computing pi(x): the Meissel, Lehmer, Lagarias,
+ * Miller, Odlyzko method", Math. Comp. 65 (1996)).
+ *
+ * the terms of S2 ("leaves") are found in four ways:
+ *  - p <= 13: phi(n, b) from a table of its values mod 2*3*5*7*11*13.
+ *  - x/(mp) < p: phi = 1, counted in bulk.
+ *  - p > sqrt(y) and x/(mp) <= y (so x/(mp) < p^2): phi = pi(x/(mp)) - b + 1.
+ *  - the rest, with a segmented sieve of [0, x/y].  crossing off the first b
+ *    primes leaves phi(n, b) as the count of unsieved numbers up to n, which
+ *    is kept quick to find by a counter per PIX_BLOCK bits.
+ * after the primes needed by S2, the rest of the primes up to the square root
+ * of the segment are crossed off, leaving the primes in it for P2.  the sieve
+ * only holds odd numbers, and each segment starts as a copy of a pattern
+ * without the multiples of 3, 5, 7, 11 and 13.
+ *
+ * sums are done modulo 2^64, as only the final result has to be in range.
+ */
+
+/* numbers per segment (one bit per odd number) */
+#define PIX_SEGMENT (1L << 19)
+
+/* bits per counter */
+#define PIX_BLOCK 256
+
+#define PIX_WORDS (PIX_SEGMENT / 128)
+#define PIX_COUNTERS (PIX_SEGMENT / 2 / PIX_BLOCK)
+
+/* primes in the wheel (2, 3, 5, 7, 11, 13) and their product */
+#define PIX_WHEEL 6
+#define PIX_PRIMORIAL 30030
+
+/* words in the pattern: 64 repeats of 15015 odd numbers */
+#define PIX_PATTERN 15015
+
+/* pi(n) for n < 64(i+1) is base + the number of bits of primes up to n % 64 */
+typedef struct {
+    uint64_t primes;
+    uint64_t base;
+} pix_pi_entry;
+
+typedef struct {
+    uint64_t x, y, z, sqrtx;
+    uint32_t a;                 /* pi(y) */
+    uint32_t c;                 /* primes[1..c] are those with leaves */
+    uint32_t *primes;           /* primes[1..a] are the primes <= y */
+    pix_pi_entry *pi;           /* pi(n) for n <= y, see pix_pi */
+    uint32_t *lpf;              /* least prime factor of n <= y */
+    signed char *mu;            /* moebius function of n <= y */
+    uint16_t *wheel_phi;        /* phi(r, b) at [b * PIX_PRIMORIAL + r] */
+    uint64_t *pattern;          /* odd numbers without factors 3 .. 13 */
+    uint64_t *mult;             /* next multiple of each prime to cross off */
+    uint64_t *phi;              /* phi(low - 1, b) for b < c */
+    uint32_t *big;              /* primes in (y, sqrt(x)] */
+    uint64_t nbig;
+    uint64_t *bits;             /* bit i is low + 2i + 1; 1 if not crossed off */
+    uint32_t *counters;         /* set bits per PIX_BLOCK */
+    uint64_t low, high;         /* the segment is [low, high), low even */
+    uint64_t unsieved;          /* set bits in the segment */
+    uint64_t cursor, before;    /* sum of counters before block cursor */
+    uint64_t result;
+} pix_state;
+
+static int
+popcount64(uint64_t w)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(w);
+#else
+    int n;
+
+    for (n = 0; w; n++) {
+        w &= w - 1;
+    }
+    return n;
+#endif
+}
+
+/* floor(sqrt(n)) */
+static uint64_t
+isqrt_u64(uint64_t n)
+{
+    uint64_t r;
+
+    r = (uint64_t) sqrt((double) n);
+    while (r > 0 && (r > UINT32_MAX || r * r > n)) {
+        r--;
+    }
+    while (r < UINT32_MAX && (r + 1) * (r + 1) <= n) {
+        r++;
+    }
+    return r;
+}
+
+/* floor(cbrt(n)) */
+static uint64_t
+icbrt_u64(uint64_t n)
+{
+    uint64_t r;
+
+    r = (uint64_t) cbrt((double) n);
+    while (r > 0 && r * r * r > n) {
+        r--;
+    }
+    while ((r + 1) * (r + 1) * (r + 1) <= n) {
+        r++;
+    }
+    return r;
+}
+
+/* y, the split between the parts of the sum.  the sieve is over x/y numbers
+ * and the leaves grow with y^2, so y is x^(1/3) times a factor growing with
+ * log x. */
+static uint64_t
+pix_choose_y(uint64_t x, uint64_t sqrtx)
+{
+    uint64_t y, cbrtx;
+    double alpha;
+
+    cbrtx = icbrt_u64(x);
+    alpha = log((double) x) / 2.5 - 4;
+    if (alpha < 1) {
+        alpha = 1;
+    }
+    y = (uint64_t) (alpha * cbrtx);
+    if (y <= cbrtx) {
+        y = cbrtx + 1;
+    }
+    if (y >= sqrtx) {
+        y = sqrtx - 1;
+    }
+    return y;
+}
+
+/* pi(n) for n <= y.  the table is small enough to stay in cache, unlike
+ * one with an entry per number. */
+static uint32_t
+pix_pi(pix_state * s, uint64_t n)
+{
+    pix_pi_entry *e;
+
+    e = &s->pi[n / 64];
+    return (uint32_t) e->base + popcount64(e->primes & (~(uint64_t) 0 >> (63 - n % 64)));
+}
+
+/* primes, pi, least prime factors and the moebius function up to y (a
+ * linear sieve) */
+static void
+pix_tables(pix_state * s)
+{
+    uint64_t i, j, y;
+    uint32_t a, p;
+
+    y = s->y;
+    s->lpf = ZALLOC_N(uint32_t, y + 1);
+    s->mu = ALLOC_N(signed char, y + 1);
+    s->pi = ZALLOC_N(pix_pi_entry, y / 64 + 1);
+    s->primes = ALLOC_N(uint32_t, (size_t) (1.26 * y / log((double) y)) + 2);
+    a = 0;
+    s->mu[1] = 1;
+    for (i = 2; i <= y; i++) {
+        if (i % 64 == 0) {
+            s->pi[i / 64].base = a;
+        }
+        if (s->lpf[i] == 0) {
+            s->lpf[i] = (uint32_t) i;
+            s->primes[++a] = (uint32_t) i;
+            s->pi[i / 64].primes |= (uint64_t) 1 << (i % 64);
+        }
+        for (j = 1; j <= a; j++) {
+            p = s->primes[j];
+            if (p > s->lpf[i] || i * p > y) {
+                break;
+            }
+            s->lpf[i * p] = p;
+        }
+        j = i / s->lpf[i];
+        s->mu[i] = (j > 1 && s->lpf[j] == s->lpf[i]) ? 0 : -s->mu[j];
+    }
+    s->lpf[1] = UINT32_MAX;
+    s->a = a;
+}
+
+/* phi(r, b) for r < PIX_PRIMORIAL and b <= PIX_WHEEL, and the sieve pattern */
+static void
+pix_wheel(pix_state * s)
+{
+    static const int wheel[PIX_WHEEL] = { 2, 3, 5, 7, 11, 13 };
+    uint64_t i;
+    uint32_t count[PIX_WHEEL + 1];
+    int b, r;
+
+    s->wheel_phi = ALLOC_N(uint16_t, (PIX_WHEEL + 1) * PIX_PRIMORIAL);
+    memset(count, 0, sizeof(count));
+    for (r = 0; r < PIX_PRIMORIAL; r++) {
+        /* r is counted for b up to its least prime factor */
+        for (b = 0; b <= PIX_WHEEL; b++) {
+            if (r == 0 || (b > 0 && r % wheel[b - 1] == 0)) {
+                break;
+            }
+            count[b]++;
+            s->wheel_phi[b * PIX_PRIMORIAL + r] = (uint16_t) count[b];
+        }
+        for (; b <= PIX_WHEEL; b++) {
+            s->wheel_phi[b * PIX_PRIMORIAL + r] = (uint16_t) count[b];
+        }
+    }
+
+    s->pattern = ZALLOC_N(uint64_t, PIX_PATTERN);
+    for (i = 0; i < PIX_PATTERN * 64; i++) {
+        r = (int) ((2 * i + 1) % PIX_PRIMORIAL);
+        if (r % 3 && r % 5 && r % 7 && r % 11 && r % 13) {
+            s->pattern[i / 64] |= (uint64_t) 1 << (i % 64);
+        }
+    }
+}
+
+/* phi(n, b) for b <= PIX_WHEEL */
+static uint64_t
+pix_wheel_phi(pix_state * s, uint64_t n, int b)
+{
+    if (b == 0) {
+        return n;
+    }
+    return n / PIX_PRIMORIAL * s->wheel_phi[b * PIX_PRIMORIAL + PIX_PRIMORIAL - 1]
+        + s->wheel_phi[b * PIX_PRIMORIAL + n % PIX_PRIMORIAL];
+}
+
+/* number of unsieved numbers in the segment up to and including n.  calls
+ * between pix_rewind must ask for increasing n. */
+static uint64_t
+pix_count(pix_state * s, uint64_t n)
+{
+    uint64_t k, w, last, count;
+
+    /* bits 0 .. k-1 are the odd numbers up to n */
+    k = (n + 1 - s->low) / 2;
+    while (s->cursor < k / PIX_BLOCK) {
+        s->before += s->counters[s->cursor++];
+    }
+    count = s->before;
+    last = k >> 6;
+    for (w = s->cursor * (PIX_BLOCK / 64); w < last; w++) {
+        count += popcount64(s->bits[w]);
+    }
+    if (k & 63) {
+        count += popcount64(s->bits[last] & (((uint64_t) 1 << (k & 63)) - 1));
+    }
+    return count;
+}
+
+static void
+pix_rewind(pix_state * s)
+{
+    s->cursor = 0;
+    s->before = 0;
+}
+
+/* starts a segment from the pattern */
+static void
+pix_segment(pix_state * s)
+{
+    uint64_t n, i, w;
+
+    n = (s->high - s->low) / 2;
+    w = (s->low / 128) % PIX_PATTERN;
+    for (i = 0; i < PIX_WORDS; i++) {
+        s->bits[i] = s->pattern[w];
+        if (++w == PIX_PATTERN) {
+            w = 0;
+        }
+    }
+    if (n % 64) {
+        s->bits[n / 64] &= ((uint64_t) 1 << (n % 64)) - 1;
+    }
+    for (i = n / 64 + (n % 64 != 0); i < PIX_WORDS; i++) {
+        s->bits[i] = 0;
+    }
+    s->unsieved = 0;
+    for (i = 0; i < PIX_COUNTERS; i++) {
+        s->counters[i] = 0;
+        for (w = i * (PIX_BLOCK / 64); w < (i + 1) * (PIX_BLOCK / 64); w++) {
+            s->counters[i] += popcount64(s->bits[w]);
+        }
+        s->unsieved += s->counters[i];
+    }
+}
+
+/* crosses off the odd multiples of primes[b] (b > PIX_WHEEL) in the
+ * segment, returning 1 if that included the prime itself */
+static int
+pix_cross(pix_state * s, uint32_t b)
+{
+    uint64_t p, m, i, w, set, unsieved;
+    int itself;
+
+    p = s->primes[b];
+    m = s->mult[b];
+    if (m < s->low || m == 0) {
+        /* skipped since the last segment */
+        m = (s->low + p - 1) / p * p;
+        if (!(m & 1)) {
+            m += p;
+        }
+    }
+    itself = (m == p && m < s->high);
+    unsieved = s->unsieved;
+    /* without branches, as whether a bit is still set is unpredictable */
+    for (; m < s->high; m += 2 * p) {
+        i = (m - s->low) >> 1;
+        w = s->bits[i >> 6];
+        set = (w >> (i & 63)) & 1;
+        s->bits[i >> 6] = w & ~((uint64_t) 1 << (i & 63));
+        s->counters[i / PIX_BLOCK] -= (uint32_t) set;
+        unsieved -= set;
+    }
+    s->unsieved = unsieved;
+    s->mult[b] = m;
+    return itself;
+}
+
+/* the leaves with p <= 13 */
+static uint64_t
+pix_wheel_leaves(pix_state * s)
+{
+    uint64_t p, m, n, sum;
+    int b;
+
+    sum = 0;
+    for (b = 0; b < PIX_WHEEL; b++) {
+        p = s->primes[b + 1];
+        for (m = s->y; m > s->y / p; m--) {
+            if (s->mu[m] && s->lpf[m] > p) {
+                n = pix_wheel_phi(s, s->x / (p * m), b);
+                sum += s->mu[m] > 0 ? -n : n;
+            }
+        }
+    }
+    return sum;
+}
+
+/* the leaves with x/(mp) < p, which have phi = 1 */
+static uint64_t
+pix_trivial_leaves(pix_state * s)
+{
+    uint64_t p, m, sum;
+    uint32_t b;
+
+    sum = 0;
+    for (b = 1; b <= s->a; b++) {
+        p = s->primes[b];
+        if (p * p <= s->y) {
+            continue;
+        }
+        m = s->x / (p * p);
+        if (m < p) {
+            m = p;
+        }
+        if (m < s->y) {
+            sum += s->a - pix_pi(s, m);
+        }
+    }
+    return sum;
+}
+
+/* the leaves with p > sqrt(y) and p <= x/(mp) <= y.  as y < p^2,
+ * phi(x/(mp), b) = pi(x/(mp)) - b + 1. */
+static uint64_t
+pix_easy_leaves(pix_state * s)
+{
+    uint64_t x, p, lo, hi, sum;
+    uint32_t b, i, last;
+
+    x = s->x;
+    sum = 0;
+    for (b = 1; b <= s->c; b++) {
+        p = s->primes[b];
+        if (p * p <= s->y) {
+            continue;
+        }
+        hi = x / (p * p);
+        lo = x / (p * (s->y + 1));
+        if (hi > s->y) {
+            hi = s->y;
+        }
+        if (lo < p) {
+            lo = p;
+        }
+        if (hi <= lo) {
+            continue;
+        }
+        for (i = pix_pi(s, lo) + 1, last = pix_pi(s, hi); i <= last; i++) {
+            sum += pix_pi(s, x / (p * s->primes[i])) - (b - 1) + 1;
+        }
+    }
+    return sum;
+}
+
+/* the leaves for p = primes[b + 1] (b >= PIX_WHEEL) with y < x/(mp) in the
+ * segment, which has the first b primes crossed off */
+static uint64_t
+pix_leaves(pix_state * s, uint32_t b)
+{
+    uint64_t x, y, p, m, lo, hi, n, sum;
+    uint32_t i, first;
+
+    x = s->x;
+    y = s->y;
+    p = s->primes[b + 1];
+    sum = 0;
+    hi = s->low ? x / (p * s->low) : y;
+    lo = x / (p * s->high);
+    pix_rewind(s);
+    if (p * p <= y) {
+        /* m is any squarefree number with no prime factor <= p */
+        if (hi > y) {
+            hi = y;
+        }
+        if (lo < y / p) {
+            lo = y / p;
+        }
+        for (m = hi; m > lo; m--) {
+            if (s->mu[m] && s->lpf[m] > p) {
+                n = s->phi[b] + pix_count(s, x / (p * m));
+                sum += s->mu[m] > 0 ? -n : n;
+            }
+        }
+    }
+    else {
+        /* m is a prime > p */
+        if (hi > x / (p * (y + 1))) {
+            hi = x / (p * (y + 1));
+        }
+        if (hi > y) {
+            hi = y;
+        }
+        if (lo < p) {
+            lo = p;
+        }
+        if (hi <= lo) {
+            return sum;
+        }
+        for (i = pix_pi(s, hi), first = pix_pi(s, lo); i > first; i--) {
+            sum += s->phi[b] + pix_count(s, x / (p * s->primes[i]));
+        }
+    }
+    return sum;
+}
+
+/* S2 and P2 from the sieve of [0, z] */
+static VALUE
+pix_body(VALUE arg)
+{
+    pix_state *s = (pix_state *) arg;
+    uint64_t s1, s2, p2, pi_low, p, n, i, start, end;
+    uint32_t b, crossed;
+    long j;
+
+    pix_tables(s);
+    pix_wheel(s);
+    s->c = pix_pi(s, icbrt_u64(s->x - 1));
+    if (s->c < pix_pi(s, isqrt_u64(s->y))) {
+        s->c = pix_pi(s, isqrt_u64(s->y));
+    }
+    s->mult = ZALLOC_N(uint64_t, s->a + 1);
+    s->phi = ZALLOC_N(uint64_t, s->c + 1);
+    s->big = ALLOC_N(uint32_t, (size_t) (1.26 * s->sqrtx / log((double) s->sqrtx)) + 2);
+    s->bits = ALLOC_N(uint64_t, PIX_WORDS);
+    s->counters = ALLOC_N(uint32_t, PIX_COUNTERS);
+
+    s1 = 0;
+    for (n = 1; n <= s->y; n++) {
+        if (s->mu[n]) {
+            s1 += s->mu[n] > 0 ? s->x / n : -(s->x / n);
+        }
+    }
+    s2 = pix_wheel_leaves(s) + pix_trivial_leaves(s) + pix_easy_leaves(s);
+    p2 = 0;
+    pi_low = 0;
+    j = -1;
+    for (s->low = 0; s->low <= s->z; s->low = s->high) {
+        rb_thread_check_ints();
+        s->high = s->z + 1 - s->low > PIX_SEGMENT ? s->low + PIX_SEGMENT : s->z + 1;
+        pix_segment(s);
+
+        /* S2: phi(n, b) for the primes with leaves left.  the pattern has
+         * crossed off 3 .. 13, and counts 1 where 2 should be. */
+        crossed = s->low == 0 ? PIX_WHEEL - 1 : 0;
+        for (b = PIX_WHEEL; b < s->c; b++) {
+            p = s->primes[b + 1];
+            if (p * p > s->y && s->x / (p * p) < s->low) {
+                break;
+            }
+            if (b > PIX_WHEEL) {
+                crossed += pix_cross(s, b);
+            }
+            s2 += pix_leaves(s, b);
+            s->phi[b] += s->unsieved;
+        }
+
+        /* the rest of the primes up to sqrt(high) */
+        for (b = b > PIX_WHEEL ? b : PIX_WHEEL + 1; b <= s->a; b++) {
+            p = s->primes[b];
+            if (p * p >= s->high) {
+                break;
+            }
+            crossed += pix_cross(s, b);
+        }
+
+        /* the primes in (y, sqrt(x)], and the values of pi(x/p) for them */
+        start = (s->y + 1 > s->low ? s->y + 1 : s->low) | 1;
+        end = s->sqrtx < s->high - 1 ? s->sqrtx : s->high - 1;
+        for (n = start; n <= end; n += 2) {
+            i = (n - s->low) >> 1;
+            if (s->bits[i >> 6] & ((uint64_t) 1 << (i & 63))) {
+                s->big[s->nbig++] = (uint32_t) n;
+                j++;
+            }
+        }
+        pix_rewind(s);
+        for (; j >= 0 && s->x / s->big[j] < s->high; j--) {
+            n = pi_low + pix_count(s, s->x / s->big[j]) + crossed;
+            p2 += n - (s->a + j + 1) + 1;
+        }
+        pi_low += s->unsieved + crossed;
+    }
+    s->result = s1 + s2 + s->a - 1 - p2;
+    return Qnil;
+}
+
+static VALUE
+pix_cleanup(VALUE arg)
+{
+    pix_state *s = (pix_state *) arg;
+
+    xfree(s->primes);
+    xfree(s->pi);
+    xfree(s->lpf);
+    xfree(s->mu);
+    xfree(s->wheel_phi);
+    xfree(s->pattern);
+    xfree(s->mult);
+    xfree(s->phi);
+    xfree(s->big);
+    xfree(s->bits);
+    xfree(s->counters);
+    return Qnil;
+}
+
+/* returns pi(x), for 2^24 <= x < 2^63 */
+uint64_t
+pix_lmo(uint64_t x)
+{
+    pix_state s;
+
+    memset(&s, 0, sizeof(s));
+    s.x = x;
+    s.sqrtx = isqrt_u64(x);
+    s.y = pix_choose_y(x, s.sqrtx);
+    s.z = x / s.y;
+    rb_ensure(pix_body, (VALUE) & s, pix_cleanup, (VALUE) & s);
+    return s.result;
+}
@@ -0,0 +1,796 @@
+#include <stdlib.h>
+#include <string.h>
+#include "calc.h"
+
+/* batch primality testing for Calc.ptest_many.
+ *
+ * the values are copied into one array of HALF digits while the GVL is held,
+ * then tested in chunks by tasks run with calc_parallel_run.  like all such
+ * tasks (see parallel.c), they only do plain C work: values below 2^32 are
+ * tested exactly with 64 bit arithmetic, and larger ones are rejected if they
+ * share a factor with one of a few word sized products of small primes, then
+ * given Miller-Rabin tests in montgomery form (see mont.c).
+ */
+
+/* a task gets at most PTEST_CHUNK values, and stops taking more once the sum
+ * of len^3 (len being a value's length) reaches PTEST_TASK_WORK, so that
+ * tasks with large values are short enough to interrupt */
+#define PTEST_CHUNK 256
+#define PTEST_TASK_WORK (1L << 20)
+
+/* the prefilter's products are of the odd primes below this */
+#define PTEST_TRIAL_LIMIT 4096
+
+/* bases for skip 1 are the primes below this */
+#define PTEST_PRIME_LIMIT 65536
+
+/* ways of choosing bases, from skip */
+#define PTEST_RANDOM 0          /* random in [2, n - 2] */
+#define PTEST_PRIMES 1          /* 2, 3, 5, 7, ... */
+#define PTEST_FROM 2            /* skip, skip + 1, skip + 2, ... */
+#define PTEST_BPSW 3            /* not a base: the baillie-psw test instead */
+
+/* values of D tried for the lucas test before checking whether n is a
+ * square, for which there is no suitable D */
+#define LUCAS_SQUARE_CHECK 32
+
+/* result of ptest_bpsw_limbs when it needs to know whether n is a square */
+#define BPSW_SQUARE (-1)
+
+/* primes below PTEST_PRIME_LIMIT */
+static HALF ptest_primes[6542];
+static long ptest_prime_count = 0;
+
+/* products of consecutive odd primes below PTEST_TRIAL_LIMIT, each less than
+ * 2^32 */
+static HALF ptest_products[PTEST_TRIAL_LIMIT / 2];
+static long ptest_product_count = 0;
+
+typedef struct {
+    long n;                     /* number of values */
+    HALF *v;                    /* their digits (absolute values), one after another */
+    size_t *offset;             /* where each value starts in v */
+    LEN *len;                   /* and its length */
+    long *first;                /* first value of each task, and one past the last */
+    size_t used, size;          /* HALFs used and allocated in v */
+    long count;                 /* miller-rabin rounds */
+    int mode;                   /* one of PTEST_* */
+    HALF skip;                  /* first base for PTEST_FROM */
+    uint64_t seed;              /* for PTEST_RANDOM */
+    char *result;               /* 1 if probably prime */
+    char *failed;               /* set for tasks which ran out of memory */
+} ptest_state;
+
+static void
+init_ptest_primes(void)
+{
+    unsigned char composite[PTEST_PRIME_LIMIT];
+    FULL p;
+    long i, j;
+
+    if (ptest_prime_count) {
+        return;
+    }
+    memset(composite, 0, sizeof(composite));
+    for (i = 2; i < PTEST_PRIME_LIMIT; i++) {
+        if (composite[i]) {
+            continue;
+        }
+        ptest_primes[ptest_prime_count++] = (HALF) i;
+        for (j = i * i; j < PTEST_PRIME_LIMIT; j += i) {
+            composite[j] = 1;
+        }
+    }
+    p = 1;
+    for (i = 1; ptest_primes[i] < PTEST_TRIAL_LIMIT; i++) {
+        if (p * ptest_primes[i] > (FULL) 0xffffffff) {
+            ptest_products[ptest_product_count++] = (HALF) p;
+            p = 1;
+        }
+        p *= ptest_primes[i];
+    }
+    ptest_products[ptest_product_count++] = (HALF) p;
+}
+
+/* a b mod n, for n < 2^32 */
+static FULL
+mulmod32(FULL a, FULL b, FULL n)
+{
+    return a * b % n;
+}
+
+/* one strong test of n < 2^32 (odd, > base) to base b, where n - 1 = d 2^s */
+static BOOL
+strong32(FULL n, FULL b, FULL d, int s)
+{
+    FULL x = 1;
+
+    for (; d; d >>= 1) {
+        if (d & 1) {
+            x = mulmod32(x, b, n);
+        }
+        b = mulmod32(b, b, n);
+    }
+    if (x == 1 || x == n - 1) {
+        return TRUE;
+    }
+    while (--s > 0) {
+        x = mulmod32(x, x, n);
+        if (x == n - 1) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* whether n < 2^32 is prime.  bases 2, 7 and 61 are enough below
+ * 4759123141. */
+static BOOL
+prime32(FULL n)
+{
+    static const FULL bases[] = { 2, 7, 61 };
+    FULL d;
+    int i, s;
+
+    for (i = 0; i < 11; i++) {
+        if (n == ptest_primes[i]) {
+            return TRUE;
+        }
+        if (n % ptest_primes[i] == 0) {
+            return FALSE;
+        }
+    }
+    if (n < 37 * 37) {
+        return n > 1;
+    }
+    for (d = n - 1, s = 0; !(d & 1); d >>= 1, s++) {
+    }
+    for (i = 0; i < 3; i++) {
+        if (!strong32(n, bases[i], d, s)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* v mod p for a HALF p */
+static HALF
+limbs_modi(const HALF * v, LEN len, HALF p)
+{
+    FULL r = 0;
+
+    while (len-- > 0) {
+        r = ((r << BASEB) | v[len]) % p;
+    }
+    return (HALF) r;
+}
+
+static HALF
+gcd32(HALF a, HALF b)
+{
+    HALF t;
+
+    while (b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static uint64_t
+ptest_random(uint64_t * x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+/* HALFs of working memory for a value of len HALFs (enough for either
+ * ptest_strong or ptest_lucas) */
+#define PTEST_WORK(len) (7 * (len) + MONT_POW_WORK(len))
+
+/* the jacobi symbol (a/m), m odd and positive */
+static int
+jacobi32(HALF a, HALF m)
+{
+    HALF t;
+    int j = 1;
+
+    a %= m;
+    while (a) {
+        while (!(a & 1)) {
+            a >>= 1;
+            if ((m & 7) == 3 || (m & 7) == 5) {
+                j = -j;
+            }
+        }
+        t = a;
+        a = m;
+        m = t;
+        if ((a & 3) == 3 && (m & 3) == 3) {
+            j = -j;
+        }
+        a %= m;
+    }
+    return m == 1 ? j : 0;
+}
+
+/* whether n (len > 1 HALFs) has no factor among the first products of small
+ * primes.  fewer products are used for short values, whose strong tests are
+ * cheap. */
+static BOOL
+ptest_prefilter(const HALF * n, LEN len)
+{
+    long j, products = 2 * (long) len * len;
+
+    if (!(n[0] & 1)) {
+        return FALSE;
+    }
+    if (products > ptest_product_count) {
+        products = ptest_product_count;
+    }
+    for (j = 0; j < products; j++) {
+        if (gcd32(ptest_products[j], limbs_modi(n, len, ptest_products[j])) != 1) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* whether the odd number n (len > 1 HALFs, the top one non-zero) passes
+ * count strong tests, with bases chosen by mode (and skip, for PTEST_FROM).
+ * ws is PTEST_WORK(len) HALFs. */
+static BOOL
+ptest_strong(const HALF * n, LEN len, long count, int mode, HALF skip, HALF * ws,
+             uint64_t * rng)
+{
+    mont_t m;
+    HALF *t, *x, *b, *d, *minus_one;
+    long i, k, zeros;
+    FULL base;
+
+    m.len = len;
+    m.n = ws;
+    m.one = ws + len;
+    m.r2 = ws + 2 * len;
+    x = ws + 3 * len;
+    b = ws + 4 * len;
+    d = ws + 5 * len;
+    minus_one = ws + 6 * len;
+    t = ws + 7 * len;
+    memcpy(m.n, n, len * sizeof(HALF));
+    mont_setup(&m);
+    limbs_sub(m.n, m.one, minus_one, len);
+
+    /* n - 1 = d 2^zeros */
+    memcpy(d, n, len * sizeof(HALF));
+    d[0]--;
+    for (zeros = 0; !((d[zeros / BASEB] >> (zeros % BASEB)) & 1); zeros++) {
+    }
+    for (i = 0; i < (long) len; i++) {
+        k = i + zeros / BASEB;
+        d[i] = k < (long) len ? d[k] >> (zeros % BASEB) : 0;
+        if (zeros % BASEB && k + 1 < (long) len) {
+            d[i] |= d[k + 1] << (BASEB - zeros % BASEB);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (mode == PTEST_RANDOM) {
+            /* 1 < b < n */
+            for (k = 0; k < (long) len; k++) {
+                b[k] = (HALF) ptest_random(rng);
+            }
+            b[len - 1] %= n[len - 1];
+            if (b[0] < 2) {
+                b[0] = 2;
+            }
+            mont_mul(&m, b, m.r2, b, t);
+        }
+        else {
+            if (mode == PTEST_PRIMES) {
+                if (i >= ptest_prime_count) {
+                    break;
+                }
+                base = ptest_primes[i];
+            }
+            else {
+                base = (FULL) skip + i;
+                if (base > (FULL) 0xffffffff) {
+                    break;
+                }
+            }
+            mont_small(&m, (HALF) base, b, t);
+        }
+
+        mont_pow(&m, b, d, len, x, t);
+        if (!memcmp(x, m.one, len * sizeof(HALF)) || !memcmp(x, minus_one, len * sizeof(HALF))) {
+            continue;
+        }
+        for (k = 1; k < zeros; k++) {
+            mont_mul(&m, x, x, x, t);
+            if (!memcmp(x, minus_one, len * sizeof(HALF)) || !memcmp(x, m.one, len * sizeof(HALF))) {
+                break;
+            }
+        }
+        if (k == zeros || memcmp(x, minus_one, len * sizeof(HALF))) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+#define LIMBS_ZERO(x, len) (!(x)[0] && !memcmp((x), (x) + 1, ((len) - 1) * sizeof(HALF)))
+
+/* whether the odd number n (len > 1 HALFs, the top one non-zero, not a
+ * square) is a strong lucas probable prime for P = 1 and Q = (1 - D) / 4,
+ * with D the first of 5, -7, 9, -11, ... for which (D/n) = -1 (selfridge's
+ * method A).  if there is no such D among the first LUCAS_SQUARE_CHECK
+ * values and square_checked isn't set, returns BPSW_SQUARE.  ws is
+ * PTEST_WORK(len) HALFs. */
+static int
+ptest_lucas(const HALF * n, LEN len, BOOL square_checked, HALF * ws)
+{
+    mont_t m;
+    HALF *u, *v, *qk, *dm, *qm, *x, *d, *t;
+    long i, k, zeros, tries;
+    long dd;
+    int j;
+
+    /* D */
+    for (dd = 5, tries = 0;; dd = dd > 0 ? -dd - 2 : -dd + 2, tries++) {
+        if (tries == LUCAS_SQUARE_CHECK && !square_checked) {
+            return BPSW_SQUARE;
+        }
+        k = labs(dd);
+        j = jacobi32(limbs_modi(n, len, (HALF) k), (HALF) k);
+        if (j == 0) {
+            /* k < n shares a factor with n */
+            return FALSE;
+        }
+        /* reciprocity, and (-1/n) for negative D */
+        if ((k & 3) == 3 && (n[0] & 3) == 3) {
+            j = -j;
+        }
+        if (dd < 0 && (n[0] & 3) == 3) {
+            j = -j;
+        }
+        if (j == -1) {
+            break;
+        }
+    }
+
+    m.len = len;
+    m.n = ws;
+    m.one = ws + len;
+    m.r2 = ws + 2 * len;
+    u = ws + 3 * len;
+    v = ws + 4 * len;
+    qk = ws + 5 * len;
+    dm = ws + 6 * len;
+    qm = ws + 7 * len;
+    x = ws + 8 * len;
+    d = ws + 9 * len;           /* len + 1 HALFs */
+    t = ws + 10 * len + 1;
+    memcpy(m.n, n, len * sizeof(HALF));
+    mont_setup(&m);
+
+    /* D and Q in montgomery form */
+    mont_small(&m, (HALF) labs(dd), dm, t);
+    if (dd < 0) {
+        limbs_sub(m.n, dm, dm, len);
+    }
+    k = (1 - dd) / 4;
+    mont_small(&m, (HALF) labs(k), qm, t);
+    if (k < 0) {
+        limbs_sub(m.n, qm, qm, len);
+    }
+
+    /* n + 1 = d 2^zeros */
+    memcpy(d, n, len * sizeof(HALF));
+    d[len] = 0;
+    for (i = 0; ++d[i] == 0; i++) {
+    }
+    for (zeros = 0; !((d[zeros / BASEB] >> (zeros % BASEB)) & 1); zeros++) {
+    }
+    for (i = 0; i <= (long) len; i++) {
+        k = i + zeros / BASEB;
+        d[i] = k <= (long) len ? d[k] >> (zeros % BASEB) : 0;
+        if (zeros % BASEB && k + 1 <= (long) len) {
+            d[i] |= d[k + 1] << (BASEB - zeros % BASEB);
+        }
+    }
+
+    /* U_1 = 1, V_1 = P = 1, Q^1 */
+    memcpy(u, m.one, len * sizeof(HALF));
+    memcpy(v, m.one, len * sizeof(HALF));
+    memcpy(qk, qm, len * sizeof(HALF));
+    for (i = BASEB * ((long) len + 1) - 1; !((d[i / BASEB] >> (i % BASEB)) & 1); i--) {
+    }
+    for (i--; i >= 0; i--) {
+        /* U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k */
+        mont_mul(&m, u, v, u, t);
+        mont_mul(&m, v, v, v, t);
+        mont_add(&m, qk, qk, x);
+        mont_sub(&m, v, x, v);
+        mont_mul(&m, qk, qk, qk, t);
+        if ((d[i / BASEB] >> (i % BASEB)) & 1) {
+            /* U_k+1 = (P U_k + V_k) / 2, V_k+1 = (D U_k + P V_k) / 2 */
+            mont_mul(&m, dm, u, x, t);
+            mont_add(&m, u, v, u);
+            mont_half(&m, u);
+            mont_add(&m, x, v, v);
+            mont_half(&m, v);
+            mont_mul(&m, qk, qm, qk, t);
+        }
+    }
+    if (LIMBS_ZERO(u, len) || LIMBS_ZERO(v, len)) {
+        return TRUE;
+    }
+    for (k = 1; k < zeros; k++) {
+        /* V_2k = V_k^2 - 2 Q^k */
+        mont_mul(&m, v, v, v, t);
+        mont_add(&m, qk, qk, x);
+        mont_sub(&m, v, x, v);
+        if (LIMBS_ZERO(v, len)) {
+            return TRUE;
+        }
+        mont_mul(&m, qk, qk, qk, t);
+    }
+    return FALSE;
+}
+
+/* the baillie-psw test of n (len > 1 HALFs, the top one non-zero): the small
+ * prime prefilter, a strong test to base 2 and a strong lucas test.  returns
+ * TRUE, FALSE or BPSW_SQUARE (see ptest_lucas).  plain C. */
+static int
+ptest_bpsw_limbs(const HALF * n, LEN len, BOOL square_checked, HALF * ws)
+{
+    if (!ptest_prefilter(n, len) || !ptest_strong(n, len, 1, PTEST_PRIMES, 0, ws, NULL)) {
+        return FALSE;
+    }
+    return ptest_lucas(n, len, square_checked, ws);
+}
+
+/* the baillie-psw test of n (len > 1 HALFs) on ruby's thread */
+static BOOL
+ptest_bpsw_z(ZVALUE z)
+{
+    HALF *ws;
+    int result;
+
+    ws = ALLOC_N(HALF, PTEST_WORK(z.len));
+    result = ptest_bpsw_limbs(z.v, z.len, FALSE, ws);
+    if (result == BPSW_SQUARE) {
+        result = !zissquare(z) && ptest_bpsw_limbs(z.v, z.len, TRUE, ws);
+    }
+    xfree(ws);
+    return result;
+}
+
+/* whether abs(z) passes the baillie-psw test.  values below 2^32 are tested
+ * exactly. */
+BOOL
+ptest_bpsw(ZVALUE z)
+{
+    init_ptest_primes();
+    if (z.len == 1) {
+        return prime32(z.v[0]);
+    }
+    return ptest_bpsw_z(z);
+}
+
+/* r = a mod m, 0 <= r < m (m > 0).  also used by mod_context.c */
+void
+zmod_nonneg(ZVALUE a, ZVALUE m, ZVALUE * r)
+{
+    ZVALUE t;
+
+    zmod(a, m, r, 0);
+    if (zisneg(*r)) {
+        zadd(*r, m, &t);
+        zfree(*r);
+        *r = t;
+    }
+}
+
+/* finds the least integer greater than abs(z) (or the greatest positive one
+ * less than abs(z), if next is FALSE) which is residue mod modulus and
+ * passes ptest_bpsw.  returns FALSE if there isn't one. */
+BOOL
+ptest_bpsw_cand(ZVALUE z, ZVALUE residue, ZVALUE modulus, BOOL next, ZVALUE * cand)
+{
+    ZVALUE r, g, i, t;
+    BOOL found = FALSE;
+
+    z.sign = 0;
+    modulus.sign = 0;
+    if (ziszero(modulus)) {
+        /* residue is the only value */
+        if ((next ? zrel(residue, z) > 0 : zrel(residue, z) < 0 && zispos(residue))
+            && ptest_bpsw(residue)) {
+            zcopy(residue, cand);
+            return TRUE;
+        }
+        return FALSE;
+    }
+    zmod_nonneg(residue, modulus, &r);
+    zgcd(r, modulus, &g);
+    if (!zisunit(g)) {
+        /* every candidate is a multiple of g, so only g itself can be prime,
+         * if it is a candidate: g = r, or r = 0 and g = modulus */
+        found = (!zcmp(g, r) || ziszero(r)) && (next ? zrel(g, z) > 0 : zrel(g, z) < 0) && ptest_bpsw(g);
+        zfree(r);
+        if (found) {
+            *cand = g;
+        }
+        else {
+            zfree(g);
+        }
+        return found;
+    }
+    zfree(g);
+
+    /* the first candidate: z + 1 + ((r - z - 1) mod modulus) going up, or
+     * z - 1 - ((z - 1 - r) mod modulus) going down */
+    if (next) {
+        zadd(z, _one_, &i);
+        zsub(r, i, &t);
+        zfree(r);
+        zmod_nonneg(t, modulus, &r);
+        zfree(t);
+        zadd(i, r, &t);
+    }
+    else {
+        zsub(z, _one_, &i);
+        zsub(i, r, &t);
+        zfree(r);
+        zmod_nonneg(t, modulus, &r);
+        zfree(t);
+        zsub(i, r, &t);
+    }
+    zfree(i);
+    zfree(r);
+    i = t;
+    for (;;) {
+        if (!next && zisleone(i)) {
+            break;
+        }
+        if (ptest_bpsw(i)) {
+            found = TRUE;
+            break;
+        }
+        if (next) {
+            zadd(i, modulus, &t);
+        }
+        else {
+            zsub(i, modulus, &t);
+        }
+        zfree(i);
+        i = t;
+    }
+    if (found) {
+        *cand = i;
+    }
+    else {
+        zfree(i);
+    }
+    return found;
+}
+
+/* tests one chunk of values.  runs without the GVL. */
+static void
+ptest_task(calc_parallel_t * par, long id)
+{
+    ptest_state *s = (ptest_state *) par->data;
+    long i, first = s->first[id], last = s->first[id + 1];
+    LEN len, maxlen = 1;
+    HALF *n, *ws;
+    uint64_t rng = s->seed ^ ((uint64_t) (id + 1) * 0x9e3779b97f4a7c15ULL);
+
+    for (i = first; i < last; i++) {
+        if (s->len[i] > maxlen) {
+            maxlen = s->len[i];
+        }
+    }
+    ws = malloc(PTEST_WORK(maxlen) * sizeof(HALF));
+    if (!ws) {
+        s->failed[id] = 1;
+        return;
+    }
+    for (i = first; i < last; i++) {
+        n = s->v + s->offset[i];
+        len = s->len[i];
+        if (len == 1) {
+            s->result[i] = prime32(n[0]);
+            continue;
+        }
+        if (s->mode == PTEST_BPSW) {
+            /* squares are sorted out afterwards */
+            s->result[i] = (char) ptest_bpsw_limbs(n, len, FALSE, ws);
+        }
+        else {
+            s->result[i] = ptest_prefilter(n, len)
+                && ptest_strong(n, len, s->count, s->mode, s->skip, ws, &rng);
+        }
+    }
+    free(ws);
+}
+
+/* appends the absolute value of z to s->v */
+static void
+ptest_add(ptest_state * s, long i, ZVALUE z)
+{
+    if (s->used + z.len > s->size) {
+        s->size = (s->used + z.len) * 2;
+        REALLOC_N(s->v, HALF, s->size);
+    }
+    memcpy(s->v + s->used, z.v, z.len * sizeof(HALF));
+    s->offset[i] = s->used;
+    s->len[i] = z.len;
+    s->used += z.len;
+}
+
+typedef struct {
+    ptest_state *s;
+    VALUE values;
+    long nthreads;
+    VALUE result;
+} ptest_args;
+
+static VALUE
+ptest_body(VALUE arg)
+{
+    ptest_args *a = (ptest_args *) arg;
+    ptest_state *s = a->s;
+    calc_parallel_t par;
+    NUMBER *q;
+    ZVALUE z;
+    VALUE v;
+    long i, ntasks, work;
+
+    s->offset = ALLOC_N(size_t, s->n);
+    s->len = ALLOC_N(LEN, s->n);
+    s->result = ALLOC_N(char, s->n);
+    s->first = ALLOC_N(long, s->n + 1);
+    for (i = 0; i < s->n; i++) {
+        v = RARRAY_AREF(a->values, i);
+        if (CALC_Q_P(v)) {
+            q = qlink((NUMBER *) DATA_PTR(v));
+        }
+        else {
+            q = value_to_number(v, 0);
+        }
+        if (qisfrac(q)) {
+            qfree(q);
+            rb_raise(e_MathError, "non-integer value for ptest_many");
+        }
+        ptest_add(s, i, q->num);
+        qfree(q);
+    }
+
+    ntasks = 0;
+    work = 0;
+    for (i = 0; i < s->n; i++) {
+        if (i == 0 || i - s->first[ntasks - 1] == PTEST_CHUNK || work >= PTEST_TASK_WORK) {
+            s->first[ntasks++] = i;
+            work = 0;
+        }
+        work += (long) s->len[i] * s->len[i] * s->len[i];
+    }
+    s->first[ntasks] = s->n;
+    s->failed = ZALLOC_N(char, ntasks + 1);
+
+    par.ntasks = ntasks;
+    par.task = ptest_task;
+    par.data = s;
+    calc_parallel_run(&par, a->nthreads);
+    for (i = 0; i < ntasks; i++) {
+        if (s->failed[i]) {
+            rb_raise(rb_eNoMemError, "failed to allocate memory for ptest_many");
+        }
+    }
+
+    for (i = 0; i < s->n; i++) {
+        if (s->result[i] == BPSW_SQUARE) {
+            /* z is a view of the value's digits, not to be freed */
+            z.v = s->v + s->offset[i];
+            z.len = s->len[i];
+            z.sign = 0;
+            s->result[i] = (char) ptest_bpsw_z(z);
+        }
+    }
+
+    a->result = rb_ary_new2(s->n);
+    for (i = 0; i < s->n; i++) {
+        rb_ary_push(a->result, s->result[i] ? Qtrue : Qfalse);
+    }
+    return Qnil;
+}
+
+static VALUE
+ptest_cleanup(VALUE arg)
+{
+    ptest_state *s = ((ptest_args *) arg)->s;
+
+    xfree(s->v);
+    xfree(s->offset);
+    xfree(s->len);
+    xfree(s->first);
+    xfree(s->result);
+    xfree(s->failed);
+    return Qnil;
+}
+
+/* Probabilistic test of primality for many values at once
+ *
+ * Returns an array of booleans, true for each value which ptest?(count, skip)
+ * would consider probably prime.  The values are tested on native threads,
+ * which is much faster than calling ptest? for each one when there are many
+ * of them.
+ *
+ * As with ptest?, values below 2**32 are tested exactly, and larger values
+ * get abs(count) strong pseudoprime tests, or the Baillie-PSW test if count
+ * is :bpsw.  Before those, larger values are checked for small factors (up
+ * to 4096 for values of a few hundred bits or more, rather than 101 as
+ * ptest? does), so a few composites which ptest? would pass can be rejected.
+ * With skip 0, bases are random but not from libcalc's random number
+ * generator.
+ *
+ * @param values [Array<Integer,Calc::Q>] integers to test
+ * @param count [Integer,Symbol] (optional: default 1) number of tests of
+ *  each value, or :bpsw
+ * @param skip [Integer] (optional: default 1) base selection mode, as for
+ *  ptest?; other than 0 and 1, must be less than 2**32
+ * @param threads [Integer] (optional) maximum number of native threads to use,
+ *  defaults to Calc.config(:threads)
+ * @return [Array<Boolean>]
+ * @raise [Calc::MathError] if a value isn't an integer, or skip is out of
+ *  range
+ * @example
+ *  Calc.ptest_many([2**61 - 1, 2**62 - 1, 2**89 - 1], 20)     #=> [true, false, true]
+ *  Calc.ptest_many([2**61 - 1, 2**62 - 1, 2**89 - 1], :bpsw)  #=> [true, false, true]
+ * @see Calc::Q#ptest?
+ */
+VALUE
+calc_ptest_many(int argc, VALUE * argv, VALUE self)
+{
+    VALUE values, count, skip, threads;
+    ptest_state s;
+    ptest_args a;
+    NUMBER *qskip;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "13", &values, &count, &skip, &threads);
+    Check_Type(values, T_ARRAY);
+    memset(&s, 0, sizeof(s));
+    if (count == ID2SYM(rb_intern("bpsw"))) {
+        s.mode = PTEST_BPSW;
+    }
+    else {
+        s.count = NIL_P(count) ? 1 : labs(value_to_long(count));
+    }
+    qskip = NIL_P(skip) ? qlink(&_qone_) : value_to_number(skip, 0);
+    if (qisfrac(qskip) || qisneg(qskip) || zge32b(qskip->num)) {
+        qfree(qskip);
+        rb_raise(e_MathError, "skip out of range for ptest_many");
+    }
+    s.skip = (HALF) ztou(qskip->num);
+    qfree(qskip);
+    if (s.mode != PTEST_BPSW) {
+        s.mode = s.skip < 2 ? (int) s.skip : PTEST_FROM;
+    }
+    s.seed = ((uint64_t) rb_genrand_int32() << 32) | rb_genrand_int32() | 1;
+    a.nthreads = calc_thread_count(threads);
+
+    init_ptest_primes();
+    /* a copy, so the values can't change under us */
+    a.values = rb_ary_dup(values);
+    s.n = RARRAY_LEN(a.values);
+    a.s = &s;
+    a.result = Qnil;
+    rb_ensure(ptest_body, (VALUE) & a, ptest_cleanup, (VALUE) & a);
+    return a.result;
+}
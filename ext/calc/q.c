@@ -11,6 +11,7 @@
  * Wraps the libcalc C type NUMBER*.
  */
 VALUE cQ;
+VALUE cArithmeticSequence;
 
 /*****************************************************************************
  * functions related to memory allocation and object initialization          *
@@ -18,6 +19,7 @@ VALUE cQ;
 
 static ID id_add;
 static ID id_and;
+static ID id_by;
 static ID id_coerce;
 static ID id_divide;
 static ID id_multiply;
@@ -25,6 +27,7 @@ static ID id_new;
 static ID id_or;
 static ID id_spaceship;
 static ID id_subtract;
+static ID id_to;
 static ID id_xor;
 
 void
@@ -187,13 +190,26 @@ trans_function(int argc, VALUE * argv, VALUE self, NUMBER * (*f) (NUMBER *, NUMB
     NUMBER *qepsilon, *qresult;
     COMPLEX *cself, *cresult;
     VALUE epsilon, result;
+    memo_key key;
     setup_math_error();
 
     if (rb_scan_args(argc, argv, "01", &epsilon) == 0) {
         qepsilon = NULL;
     }
     else {
-        qepsilon = value_to_number(epsilon, 1);
+        qepsilon = value_to_epsilon(epsilon);
+    }
+    if (memo_enabled()) {
+        memo_key_init(&key, (memo_fn) f, 0);
+        memo_key_number(&key, DATA_PTR(self));
+        memo_key_number(&key, qepsilon ? qepsilon : conf->epsilon);
+        result = memo_lookup(&key);
+        if (result != Qundef) {
+            if (qepsilon) {
+                qfree(qepsilon);
+            }
+            return result;
+        }
     }
     qresult = (*f) (DATA_PTR(self), qepsilon ? qepsilon : conf->epsilon);
     if (qresult) {
@@ -221,6 +237,9 @@ trans_function(int argc, VALUE * argv, VALUE self, NUMBER * (*f) (NUMBER *, NUMB
         }
         rb_raise(e_MathError, "Unhandled NULL from transcendental function");
     }
+    if (memo_enabled()) {
+        memo_store(&key, result);
+    }
     if (qepsilon) {
         qfree(qepsilon);
     }
@@ -234,25 +253,38 @@ trans_function2(int argc, VALUE * argv, VALUE self,
                 NUMBER * (*f) (NUMBER *, NUMBER *, NUMBER *))
 {
     NUMBER *qarg, *qepsilon, *qresult;
-    VALUE arg, epsilon;
+    VALUE arg, epsilon, result;
+    memo_key key;
     setup_math_error();
 
-    if (rb_scan_args(argc, argv, "11", &arg, &epsilon) == 1) {
-        qarg = value_to_number(arg, 0);
-        qresult = (*f) (DATA_PTR(self), qarg, conf->epsilon);
-        qfree(qarg);
+    rb_scan_args(argc, argv, "11", &arg, &epsilon);
+    qarg = value_to_number(arg, 0);
+    qepsilon = NIL_P(epsilon) ? qlink(conf->epsilon) : value_to_epsilon(epsilon);
+    if (memo_enabled()) {
+        memo_key_init(&key, (memo_fn) f, 0);
+        memo_key_number(&key, DATA_PTR(self));
+        memo_key_number(&key, qarg);
+        memo_key_number(&key, qepsilon);
+        result = memo_lookup(&key);
+        if (result != Qundef) {
+            qfree(qarg);
+            qfree(qepsilon);
+            return result;
+        }
     }
-    else {
-        qarg = value_to_number(arg, 0);
-        qepsilon = value_to_number(epsilon, 1);
-        qresult = (*f) (DATA_PTR(self), qarg, qepsilon);
+    qresult = (*f) (DATA_PTR(self), qarg, qepsilon);
+    if (!qresult) {
         qfree(qarg);
         qfree(qepsilon);
-    }
-    if (!qresult) {
         rb_raise(e_MathError, "Transcendental function returned NULL");
     }
-    return wrap_number(qresult);
+    result = wrap_number(qresult);
+    if (memo_enabled()) {
+        memo_store(&key, result);
+    }
+    qfree(qarg);
+    qfree(qepsilon);
+    return result;
 }
 
 static VALUE
@@ -268,6 +300,31 @@ rounding_function(int argc, VALUE * argv, VALUE self, NUMBER * (f) (NUMBER *, lo
     return wrap_number((*f) (DATA_PTR(self), p, r));
 }
 
+/* nextcand/prevcand with the baillie-psw test */
+static VALUE
+bpsw_navigation(NUMBER * qself, VALUE residue, VALUE modulus, BOOL next)
+{
+    NUMBER *qresidue, *qmodulus, *qresult = NULL;
+    ZVALUE tmp;
+    BOOL error = FALSE;
+
+    qresidue = NIL_P(residue) ? qlink(&_qzero_) : value_to_number(residue, 1);
+    qmodulus = NIL_P(modulus) ? qlink(&_qone_) : value_to_number(modulus, 1);
+    if (!qisint(qself) || !qisint(qresidue) || !qisint(qmodulus)) {
+        error = TRUE;
+    }
+    else if (ptest_bpsw_cand(qself->num, qresidue->num, qmodulus->num, next, &tmp)) {
+        qresult = qalloc();
+        qresult->num = tmp;
+    }
+    qfree(qresidue);
+    qfree(qmodulus);
+    if (error) {
+        rb_raise(e_MathError, "receiver and all arguments must be integers");
+    }
+    return qresult ? wrap_number(qresult) : Qnil;
+}
+
 static VALUE
 cand_navigation(int argc, VALUE * argv, VALUE self,
                 BOOL(f) (ZVALUE, long, ZVALUE, ZVALUE, ZVALUE, ZVALUE *))
@@ -281,6 +338,10 @@ cand_navigation(int argc, VALUE * argv, VALUE self,
 
     n = rb_scan_args(argc, argv, "04", &count, &skip, &residue, &modulus);
     qself = DATA_PTR(self);
+    if (n >= 1 && count == ID2SYM(rb_intern("bpsw"))) {
+        return bpsw_navigation(qself, n >= 3 ? residue : Qnil, n >= 4 ? modulus : Qnil,
+                               f == &znextcand);
+    }
     qcount = (n >= 1) ? value_to_number(count, 1) : qlink(&_qone_);
     qskip = (n >= 2) ? value_to_number(skip, 1) : qlink(&_qone_);
     qresidue = (n >= 3) ? value_to_number(residue, 1) : qlink(&_qzero_);
@@ -316,6 +377,113 @@ cand_navigation(int argc, VALUE * argv, VALUE self,
     return Qnil;
 }
 
+/* true if q is an integer which fits in a long */
+static int
+qfitslong(NUMBER * q)
+{
+    return qisint(q) && !zgtmaxlong(q->num);
+}
+
+/* convert a step/limit argument to a Calc::Q (like Calc::Q.new) */
+static VALUE
+step_value(VALUE v)
+{
+    return CALC_Q_P(v) ? v : wrap_number(value_to_number(v, 1));
+}
+
+/* work out what the caller meant with their args to #step.  sets *to (nil
+ * if there is no limit) and *by to Calc::Q values. */
+static void
+step_args(int argc, VALUE * argv, VALUE * to, VALUE * by)
+{
+    VALUE a1, a2, rest;
+    int n;
+
+    n = rb_scan_args(argc, argv, "02", &a1, &a2);
+    if (n >= 1 && RB_TYPE_P(a1, T_HASH)) {
+        /* fake keywords style */
+        rest = rb_hash_dup(a1);
+        *to = rb_hash_delete(rest, ID2SYM(id_to));
+        *by = rb_hash_lookup2(a1, ID2SYM(id_by), Qundef);
+        rb_hash_delete(rest, ID2SYM(id_by));
+        if (RHASH_SIZE(rest) > 0) {
+            rb_raise(rb_eArgError, "Unknown keywords: %" PRIsVALUE,
+                     rb_ary_join(rb_funcall(rest, rb_intern("keys"), 0), rb_str_new2(", ")));
+        }
+    }
+    else {
+        /* positional style (limit, step) */
+        *to = a1;
+        *by = (n == 2) ? a2 : Qundef;
+    }
+    *to = RTEST(*to) ? step_value(*to) : Qnil;
+    *by = (*by == Qundef) ? wrap_number(qlink(&_qone_)) : step_value(*by);
+}
+
+/* yields self, self + by, self + 2*by ... until the value passes to (or
+ * forever if to is nil).  to and by are Calc::Q values.
+ *
+ * while the values fit in a long they are counted in a long instead of by
+ * adding NUMBERs. */
+static void
+step_loop(VALUE self, VALUE to, VALUE by)
+{
+    NUMBER *qto, *qby, *qtmp;
+    VALUE i;
+    long li, lto = 0, lby;
+    int sign;
+
+    qby = DATA_PTR(by);
+    qto = NIL_P(to) ? NULL : DATA_PTR(to);
+    sign = qrel(qby, &_qzero_);
+    if (sign == 0) {
+        for (;;) {
+            rb_yield(self);
+        }
+    }
+    i = self;
+    if (qfitslong(DATA_PTR(self)) && qfitslong(qby) && (!qto || qfitslong(qto))) {
+        li = qtoi(DATA_PTR(self));
+        lby = qtoi(qby);
+        if (qto) {
+            lto = qtoi(qto);
+        }
+        for (;;) {
+            if (qto && (sign > 0 ? li > lto : li < lto)) {
+                i = Qnil;       /* finished */
+                break;
+            }
+            rb_yield(wrap_number(itoq(li)));
+            if (sign > 0 ? li > LONG_MAX - lby : li < LONG_MIN - lby) {
+                /* next value doesn't fit, carry on below */
+                qtmp = itoq(li);
+                i = wrap_number(qqadd(qtmp, qby));
+                qfree(qtmp);
+                break;
+            }
+            li += lby;
+        }
+    }
+    while (!NIL_P(i)) {
+        if (qto && (sign > 0 ? qrel(DATA_PTR(i), qto) > 0 : qrel(DATA_PTR(i), qto) < 0)) {
+            break;
+        }
+        rb_yield(i);
+        i = wrap_number(qqadd(DATA_PTR(i), qby));
+    }
+    /* qto and qby are used across every rb_yield; the callers' values may
+     * not be referenced anywhere else */
+    RB_GC_GUARD(to);
+    RB_GC_GUARD(by);
+}
+
+/* returns a lazy Calc::ArithmeticSequence */
+static VALUE
+step_sequence(VALUE self, VALUE to, VALUE by)
+{
+    return rb_funcall(cArithmeticSequence, id_new, 3, self, to, by);
+}
+
 static VALUE
 trunc_function(int argc, VALUE * argv, VALUE self, NUMBER * (f) (NUMBER *, NUMBER *))
 {
@@ -653,7 +821,7 @@ cq_appr(int argc, VALUE * argv, VALUE self)
         R = conf->appr;
     }
     if (n >= 1) {
-        qepsilon = value_to_number(epsilon, 1);
+        qepsilon = value_to_epsilon(epsilon);
     }
     else {
         qepsilon = NULL;
@@ -728,7 +896,7 @@ cq_asinh(int argc, VALUE * argv, VALUE self)
 static VALUE
 cq_atan(int argc, VALUE * argv, VALUE self)
 {
-    return trans_function(argc, argv, self, &qatan, NULL);
+    return trans_function(argc, argv, self, &bsplit_atan, NULL);
 }
 
 /* Angle to point (arctangent with 2 arguments)
@@ -765,6 +933,10 @@ cq_atanh(int argc, VALUE * argv, VALUE self)
 /* Returns the bernoulli number with index self.  Self must be an integer,
  * and < 2^31 if even.
  *
+ * Calculated values are stored so that later calls are executed quickly (see
+ * `Calc.freebernoulli`).  Tables can be saved with `Calc.export_bernoulli` and
+ * loaded by other processes with `Calc.load_bernoulli`.
+ *
  * @return [Calc::Q]
  * @raise [Calc::MathError] if self is fractional or even and >= 2^31
  * @example
@@ -780,7 +952,7 @@ cq_bernoulli(VALUE self)
     if (qisfrac(qself)) {
         rb_raise(e_MathError, "Non-integer argument for bernoulli");
     }
-    qresult = qbern(qself->num);
+    qresult = table_bernoulli(qself->num);
     if (!qresult) {
         rb_raise(e_MathError, "Bad argument for bern");
     }
@@ -920,7 +1092,7 @@ cq_cfappr(int argc, VALUE * argv, VALUE self)
     setup_math_error();
 
     n = rb_scan_args(argc, argv, "02", &eps, &rnd);
-    q = (n >= 1) ? value_to_number(eps, 1) : conf->epsilon;
+    q = (n >= 1) ? value_to_epsilon(eps) : conf->epsilon;
     R = (n == 2) ? value_to_long(rnd) : conf->cfappr;
     result = wrap_number(qcfappr(DATA_PTR(self), q, R));
     if (n >= 1) {
@@ -1138,6 +1310,33 @@ cq_digits(int argc, VALUE * argv, VALUE self)
     return wrap_number(qresult);
 }
 
+/* Iterates the given block, yielding values from `self` decreasing by 1
+ * down to and including `limit`
+ *
+ * x.downto(limit) is equivalent to x.step(by: -1, to: limit)
+ *
+ * If no block is given, a Calc::ArithmeticSequence is returned instead.
+ *
+ * @param limit [Numeric] lowest value to return
+ * @return [Calc::ArithmeticSequence,nil]
+ * @example
+ *  Calc::Q(10).downto(5) { |i| print i, " " } #=> 10 9 8 7 6 5
+ */
+static VALUE
+cq_downto(VALUE self, VALUE limit)
+{
+    VALUE to, by;
+    setup_math_error();
+
+    to = step_value(limit);
+    by = wrap_number(qlink(&_qnegone_));
+    if (!rb_block_given_p()) {
+        return step_sequence(self, to, by);
+    }
+    step_loop(self, to, by);
+    return Qnil;
+}
+
 /* Euler number
  *
  * Returns the euler number of a specified index.
@@ -1145,7 +1344,8 @@ cq_digits(int argc, VALUE * argv, VALUE self)
  * Considerable runtime and memory are required for calculating the euler
  * number for large even indices.  Calculated values are stored in a table so
  * that later calls are executed quickly.  This memory can be freed with
- * `Calc.freeeuler`.
+ * `Calc.freeeuler`.  Tables can be saved with `Calc.export_euler` and loaded
+ * by other processes with `Calc.load_euler`.
  *
  * @example
  *  Calc::Q(18).euler   #=> Calc::Q(-2404879675441)
@@ -1162,7 +1362,7 @@ cq_euler(VALUE self)
     if (qisfrac(qself)) {
         rb_raise(e_MathError, "non-integer value for euler");
     }
-    qresult = qeuler(qself->num);
+    qresult = table_euler(qself->num);
     if (qresult == NULL) {
         rb_raise(e_MathError, "number too big or out of memory for euler");
     }
@@ -1193,7 +1393,7 @@ cq_evenp(VALUE self)
 static VALUE
 cq_exp(int argc, VALUE * argv, VALUE self)
 {
-    return trans_function(argc, argv, self, &qexp, NULL);
+    return trans_function(argc, argv, self, &bsplit_exp, NULL);
 }
 
 /* Returns the factorial of a number.
@@ -1510,7 +1710,7 @@ cq_iroot(VALUE self, VALUE other)
     setup_math_error();
 
     qother = value_to_number(other, 0);
-    qresult = qiroot(DATA_PTR(self), qother);
+    qresult = newton_iroot(DATA_PTR(self), qother);
     qfree(qother);
     return wrap_number(qresult);
 }
@@ -1530,7 +1730,7 @@ static VALUE
 cq_isqrt(VALUE self)
 {
     setup_math_error();
-    return wrap_number(qisqrt(DATA_PTR(self)));
+    return wrap_number(newton_isqrt(DATA_PTR(self)));
 }
 
 /* Compute the Jacobi function (x = self / y)
@@ -1682,7 +1882,7 @@ cq_ltol(int argc, VALUE * argv, VALUE self)
         qresult = qlegtoleg(DATA_PTR(self), conf->epsilon, FALSE);
     }
     else {
-        qepsilon = value_to_number(epsilon, 1);
+        qepsilon = value_to_epsilon(epsilon);
         qresult = qlegtoleg(DATA_PTR(self), qepsilon, FALSE);
         qfree(qepsilon);
     }
@@ -1773,6 +1973,93 @@ cq_mod(int argc, VALUE * argv, VALUE self)
     return wrap_number(qresult);
 }
 
+/* Multiply-add: returns self * y + z
+ *
+ * The product and sum are taken over a common denominator and reduced once,
+ * instead of reducing the intermediate product.  If y or z is complex, this
+ * is the same as `self * y + z`.
+ *
+ * @param y [Numeric,Calc::Q]
+ * @param z [Numeric,Calc::Q]
+ * @return [Calc::Q,Calc::C]
+ * @example
+ *  Calc::Q(2).muladd(3, 4)                            #=> Calc::Q(10)
+ *  Calc::Q(1, 3).muladd(Calc::Q(3, 4), Calc::Q(1, 2)) #=> Calc::Q(0.75)
+ */
+static VALUE
+cq_muladd(VALUE self, VALUE y, VALUE z)
+{
+    NUMBER *qself, *qy, *qz, *qresult;
+    ZVALUE pn, pd, t1, t2, num, den, g;
+    setup_math_error();
+
+    if (CALC_C_P(y) || RB_TYPE_P(y, T_COMPLEX) || CALC_C_P(z) || RB_TYPE_P(z, T_COMPLEX)) {
+        return rb_funcall(rb_funcall(self, id_multiply, 1, y), id_add, 1, z);
+    }
+    qself = DATA_PTR(self);
+    qy = value_to_number(y, 0);
+    qz = value_to_number(z, 0);
+    if (qiszero(qself) || qiszero(qy)) {
+        qfree(qy);
+        return wrap_number(qz);
+    }
+
+    /* (pn/pd) = self * y, unreduced */
+    zmul(qself->num, qy->num, &pn);
+    if (qisint(qself) && qisint(qy)) {
+        zcopy(_one_, &pd);
+    }
+    else {
+        zmul(qself->den, qy->den, &pd);
+    }
+
+    /* num/den = pn/pd + z, reduced once */
+    if (qisint(qz)) {
+        zmul(qz->num, pd, &t1);
+        zadd(pn, t1, &num);
+        zfree(t1);
+        zfree(pn);
+        den = pd;
+    }
+    else {
+        zmul(pn, qz->den, &t1);
+        zmul(qz->num, pd, &t2);
+        zadd(t1, t2, &num);
+        zfree(t1);
+        zfree(t2);
+        zmul(pd, qz->den, &den);
+        zfree(pn);
+        zfree(pd);
+    }
+    qfree(qz);
+    qfree(qy);
+
+    if (ziszero(num)) {
+        zfree(num);
+        zfree(den);
+        return wrap_number(qlink(&_qzero_));
+    }
+    qresult = qalloc();
+    if (zisunit(den)) {
+        zfree(den);
+        qresult->num = num;
+        return wrap_number(qresult);
+    }
+    zgcd(num, den, &g);
+    if (zisunit(g)) {
+        qresult->num = num;
+        qresult->den = den;
+    }
+    else {
+        zequo(num, g, &qresult->num);
+        zequo(den, g, &qresult->den);
+        zfree(num);
+        zfree(den);
+    }
+    zfree(g);
+    return wrap_number(qresult);
+}
+
 /* Returns true if self exactly divides y, otherwise return false.
  *
  * @return [Boolean]
@@ -1818,7 +2105,7 @@ cq_near(int argc, VALUE * argv, VALUE self)
 
     n = rb_scan_args(argc, argv, "11", &other, &epsilon);
     qother = value_to_number(other, 1);
-    qepsilon = (n == 2) ? value_to_number(epsilon, 1) : conf->epsilon;
+    qepsilon = (n == 2) ? value_to_epsilon(epsilon) : conf->epsilon;
     qresult = itoq((long) qnear(DATA_PTR(self), qother, qepsilon));
     qfree(qother);
     if (n == 2)
@@ -1834,17 +2121,19 @@ cq_near(int argc, VALUE * argv, VALUE self)
  *
  * See `ptest?` for a description of `count` and `skip`.  For basic purposes,
  * use default values and count > 1.  Higher counts increase the probability
- * that the returned value is prime.
+ * that the returned value is prime.  With count :bpsw, candidates are given
+ * the Baillie-PSW test (and skip is ignored).
  *
- * @param count [Integer] number of tests for ptest (default 1)
+ * @param count [Integer,Symbol] number of tests for ptest, or :bpsw (default 1)
  * @param skip [Integer] base selection mode for ptest (default 1)
  * @param residue [Integer] (default 0)
  * @param modulus [Integer] (default 1)
  * @return [Calc::Q]
  * @raise [Calc::MathError] if self or any parameter is not an integer
  * @example
- *  Calc::Q(100).nextcand(10)        #=> Calc::Q(101)
- *  Calc::Q(5000000000).nextcand(10) #=> Calc::Q(5000000029)
+ *  Calc::Q(100).nextcand(10)           #=> Calc::Q(101)
+ *  Calc::Q(5000000000).nextcand(10)    #=> Calc::Q(5000000029)
+ *  Calc::Q(2**64).nextcand(:bpsw)      #=> Calc::Q(18446744073709551629)
  */
 static VALUE
 cq_nextcand(int argc, VALUE * argv, VALUE self)
@@ -1973,30 +2262,46 @@ cq_pfact(VALUE self)
 }
 
 /* Number of primes not exceeded specified number
+ *
+ * Values below 2^24 are left to libcalc, which sieves up to self; larger
+ * ones use the Lagarias-Miller-Odlyzko method, which takes time proportional
+ * to about self^(2/3) (10^15 takes a few seconds; see bench/pix.rb).
  *
  * @return [Calc::Q]
- * @raise [Calc::MathError] if self is >= 2**32
+ * @raise [Calc::MathError] if self is not an integer, or is >= 2**63
  * @example
- *  Calc::Q(10).pix    #=> Calc::Q(4)
- *  Calc::Q(100).pix   #=> Calc::Q(25)
- *  Calc::Q(10**9).pix #=> Calc::Q(50847534)
+ *  Calc::Q(10).pix     #=> Calc::Q(4)
+ *  Calc::Q(100).pix    #=> Calc::Q(25)
+ *  Calc::Q(10**9).pix  #=> Calc::Q(50847534)
+ *  Calc::Q(10**15).pix #=> Calc::Q(29844570422669)
  */
 static VALUE
 cq_pix(VALUE self)
 {
     NUMBER *qself;
+    uint64_t x;
     long value;
+    LEN i;
     setup_math_error();
 
     qself = DATA_PTR(self);
     if (qisfrac(qself)) {
         rb_raise(e_MathError, "non-integer value for pix");
     }
-    value = zpix(qself->num);
-    if (value >= 0) {
-        return wrap_number(utoq(value));
+    if (qisneg(qself) || zhighbit(qself->num) < 24) {
+        value = zpix(qself->num);
+        if (value >= 0) {
+            return wrap_number(utoq(value));
+        }
+    }
+    if (zhighbit(qself->num) >= 63) {
+        rb_raise(e_MathError, "pix arg is >= 2^63");
     }
-    rb_raise(e_MathError, "pix arg is >= 2^32");
+    x = 0;
+    for (i = qself->num.len; i-- > 0;) {
+        x = (x << (sizeof(HALF) * 8)) | qself->num.v[i];
+    }
+    return wrap_number(utoq((FULL) pix_lmo(x)));
 }
 
 /* Number of decimal (or other) places in fractional part
@@ -2128,7 +2433,7 @@ cq_power(int argc, VALUE * argv, VALUE self)
         qepsilon = NULL;
     }
     else {
-        qepsilon = value_to_number(epsilon, 1);
+        qepsilon = value_to_epsilon(epsilon);
     }
     qself = DATA_PTR(self);
     if (CALC_C_P(arg) || RB_TYPE_P(arg, T_COMPLEX) || qisneg(qself)) {
@@ -2166,17 +2471,19 @@ cq_power(int argc, VALUE * argv, VALUE self)
  *
  * See `ptest?` for a description of `count` and `skip`.  For basic purposes,
  * use default values and count > 1.  Higher counts increase the probability
- * that the returned value is prime.
+ * that the returned value is prime.  With count :bpsw, candidates are given
+ * the Baillie-PSW test (and skip is ignored).
  *
- * @param count [Integer] number of tests for ptest (default 1)
+ * @param count [Integer,Symbol] number of tests for ptest, or :bpsw (default 1)
  * @param skip [Integer] base selection mode for ptest (default 1)
  * @param residue [Integer] (default 0)
  * @param modulus [Integer] (default 1)
  * @return [Calc::Q]
  * @raise [Calc::MathError] if self or any parameter is not an integer
  * @example
- *  Calc::Q(100).prevcand(10)        #=> Calc::Q(97)
- *  Calc::Q(5000000000).prevcand(10) #=> Calc::Q(4999999937)
+ *  Calc::Q(100).prevcand(10)           #=> Calc::Q(97)
+ *  Calc::Q(5000000000).prevcand(10)    #=> Calc::Q(4999999937)
+ *  Calc::Q(2**64).prevcand(:bpsw)      #=> Calc::Q(18446744073709551557)
  */
 static VALUE
 cq_prevcand(int argc, VALUE * argv, VALUE self)
@@ -2276,11 +2583,19 @@ cq_primep(VALUE self)
  * than once in a million numbers; ptest(20) incorrectly returns true less
  * than once in a quadrillion numbers.
  *
- * @param count [Integer] (optional: default 1)
+ * If count is :bpsw, the Baillie-PSW test is used instead (and skip is
+ * ignored): small prime divisors are checked, then one strong test to base
+ * 2 and a strong Lucas test (with parameters chosen by Selfridge's method).
+ * No composite is known to pass it, and it is deterministic, and costs about
+ * as much as 3 or 4 strong tests.
+ *
+ * @param count [Integer,Symbol] (optional: default 1)
  * @param skip [Integer] (optional: default 1)
  * @return [Boolean]
+ * @raise [Calc::MathError] if self is not an integer
  * @example
- *  Calc::Q(4294967291).ptest?(10) #=> true
+ *  Calc::Q(4294967291).ptest?(10)  #=> true
+ *  Calc::Q(2**89 - 1).ptest?(:bpsw) #=> true
  */
 static VALUE
 cq_ptestp(int argc, VALUE * argv, VALUE self)
@@ -2291,6 +2606,12 @@ cq_ptestp(int argc, VALUE * argv, VALUE self)
     setup_math_error();
 
     n = rb_scan_args(argc, argv, "02", &count, &skip);
+    if (n >= 1 && count == ID2SYM(rb_intern("bpsw"))) {
+        if (qisfrac((NUMBER *) DATA_PTR(self))) {
+            rb_raise(e_MathError, "non-integer for ptest");
+        }
+        return ptest_bpsw(((NUMBER *) DATA_PTR(self))->num) ? Qtrue : Qfalse;
+    }
     qcount = (n >= 1) ? value_to_number(count, 0) : qlink(&_qone_);
     qskip = (n >= 2) ? value_to_number(skip, 0) : qlink(&_qone_);
     result = qprimetest(DATA_PTR(self), qcount, qskip) ? Qtrue : Qfalse;
@@ -2485,6 +2806,51 @@ cq_sqp(VALUE self)
     return qissquare(DATA_PTR(self)) ? Qtrue : Qfalse;
 }
 
+/* Invokes the given block with the sequence of numbers starting at self
+ * incrementing by step (default 1) on each call.
+ *
+ * In the first format, uses keyword parameters:
+ *   x.step(by: step, to: limit)
+ *
+ * In the second format, uses positional parameters:
+ *   x.step(limit = nil, step = 1)
+ *
+ * If step is negative, the sequence decrements instead of incrementing.
+ * If step is zero, the sequence will yield self forever.
+ *
+ * If limit exists, the sequence will stop once the next item yielded would
+ * be higher than limit (if step is positive) or lower than limit (if step
+ * is negative).  If limit is nil, the sequence never stops.
+ *
+ * If no block is given, a Calc::ArithmeticSequence is returned instead.
+ *
+ * This method was added for ruby Numeric compatibiliy; unlike Numeric#step,
+ * it is not an error for step to be zero in the positional format.
+ *
+ * @param by [Numeric] amount to add to sequence each iteration
+ * @param to [Numeric] end of sequence value
+ * @return [Calc::ArithmeticSequence,nil]
+ * @example
+ *  Calc::Q(1).step(10, 3).to_a      #=> [Calc::Q(1), Calc::Q(4), Calc::Q(7), Calc::Q(10)]
+ *  Calc::Q(10).step(by: -2).take(4) #=> [Calc::Q(10), Calc::Q(8), Calc::Q(6), Calc::Q(4)]
+ *  Calc::Q(1).exp.step(to: Calc.pi, by: "0.2") { |q| print q, " " } #=> nil
+ * prints:
+ *  2.71828182845904523536 2.91828182845904523536 3.11828182845904523536
+ */
+static VALUE
+cq_step(int argc, VALUE * argv, VALUE self)
+{
+    VALUE to, by;
+    setup_math_error();
+
+    step_args(argc, argv, &to, &by);
+    if (!rb_block_given_p()) {
+        return step_sequence(self, to, by);
+    }
+    step_loop(self, to, by);
+    return Qnil;
+}
+
 /* Trigonometric tangent
  *
  * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
@@ -2511,6 +2877,47 @@ cq_tanh(int argc, VALUE * argv, VALUE self)
     return trans_function(argc, argv, self, &qtanh, NULL);
 }
 
+/* Iterates the given block `self` times, passing in values from zero to
+ * self - 1
+ *
+ * If no block is given, a Calc::ArithmeticSequence is returned instead.
+ *
+ * @return [Calc::ArithmeticSequence,nil]
+ * @example
+ *  Calc::Q(5).times { |i| print i, " " }
+ *  #=> 0 1 2 3 4
+ */
+static VALUE
+cq_times(VALUE self)
+{
+    NUMBER *qself, *qlast;
+    VALUE last, zero, one;
+    setup_math_error();
+
+    /* last value is the largest integer < self */
+    qself = DATA_PTR(self);
+    if (qisint(qself)) {
+        qlast = qdec(qself);
+    }
+    else if (qisneg(qself)) {
+        qlast = qlink(&_qnegone_);
+    }
+    else {
+        qlast = qint(qself);
+    }
+    last = wrap_number(qlast);
+    zero = wrap_number(qlink(&_qzero_));
+    one = wrap_number(qlink(&_qone_));
+    if (!rb_block_given_p()) {
+        return step_sequence(zero, last, one);
+    }
+    step_loop(zero, last, one);
+    RB_GC_GUARD(last);
+    RB_GC_GUARD(zero);
+    RB_GC_GUARD(one);
+    return Qnil;
+}
+
 /* Converts this number to a core ruby Integer.
  *
  * If self is a fraction, the fractional part is truncated.
@@ -2622,6 +3029,33 @@ cq_trunc(int argc, VALUE * argv, VALUE self)
     return trunc_function(argc, argv, self, &qtrunc);
 }
 
+/* Iterates the given block, yielding values from `self` increasing by 1
+ * up to and including `limit`
+ *
+ * x.upto(limit) is equivalent to x.step(by: 1, to: limit)
+ *
+ * If no block is given, a Calc::ArithmeticSequence is returned instead.
+ *
+ * @param limit [Numeric] highest value to return
+ * @return [Calc::ArithmeticSequence,nil]
+ * @example
+ *  Calc::Q(5).upto(10) { |i| print i, " " } #=> 5 6 7 8 9 10
+ */
+static VALUE
+cq_upto(VALUE self, VALUE limit)
+{
+    VALUE to, by;
+    setup_math_error();
+
+    to = step_value(limit);
+    by = wrap_number(qlink(&_qone_));
+    if (!rb_block_given_p()) {
+        return step_sequence(self, to, by);
+    }
+    step_loop(self, to, by);
+    return Qnil;
+}
+
 /* Returns true if self is zero
  *
  * @param eps [Numeric,Calc::Q] (optional) calculation accuracy
@@ -2643,6 +3077,7 @@ void
 define_calc_q(VALUE m)
 {
     cQ = rb_define_class_under(m, "Q", cNumeric);
+    cArithmeticSequence = rb_define_class_under(m, "ArithmeticSequence", rb_cEnumerator);
     rb_define_alloc_func(cQ, cq_alloc);
     rb_define_method(cQ, "initialize", cq_initialize, -1);
     rb_define_method(cQ, "initialize_copy", cq_initialize_copy, 1);
@@ -2688,11 +3123,13 @@ define_calc_q(VALUE m)
     rb_define_method(cQ, "den", cq_den, 0);
     rb_define_method(cQ, "digit", cq_digit, -1);
     rb_define_method(cQ, "digits", cq_digits, -1);
+    rb_define_method(cQ, "downto", cq_downto, 1);
     rb_define_method(cQ, "euler", cq_euler, 0);
     rb_define_method(cQ, "even?", cq_evenp, 0);
     rb_define_method(cQ, "exp", cq_exp, -1);
     rb_define_method(cQ, "fact", cq_fact, 0);
     rb_define_method(cQ, "factor", cq_factor, -1);
+    rb_define_method(cQ, "factorize", cq_factorize, -1);
     rb_define_method(cQ, "fcnt", cq_fcnt, 1);
     rb_define_method(cQ, "frac", cq_frac, 0);
     rb_define_method(cQ, "frem", cq_frem, 1);
@@ -2715,6 +3152,7 @@ define_calc_q(VALUE m)
     rb_define_method(cQ, "meq?", cq_meqp, 2);
     rb_define_method(cQ, "minv", cq_minv, 1);
     rb_define_method(cQ, "mod", cq_mod, -1);
+    rb_define_method(cQ, "muladd", cq_muladd, 2);
     rb_define_method(cQ, "mult?", cq_multp, 1);
     rb_define_method(cQ, "near", cq_near, -1);
     rb_define_method(cQ, "nextcand", cq_nextcand, -1);
@@ -2742,11 +3180,14 @@ define_calc_q(VALUE m)
     rb_define_method(cQ, "sinh", cq_sinh, -1);
     rb_define_method(cQ, "size", cq_size, 0);
     rb_define_method(cQ, "sq?", cq_sqp, 0);
+    rb_define_method(cQ, "step", cq_step, -1);
     rb_define_method(cQ, "tan", cq_tan, -1);
     rb_define_method(cQ, "tanh", cq_tanh, -1);
+    rb_define_method(cQ, "times", cq_times, 0);
     rb_define_method(cQ, "to_i", cq_to_i, 0);
     rb_define_method(cQ, "to_s", cq_to_s, -1);
     rb_define_method(cQ, "trunc", cq_trunc, -1);
+    rb_define_method(cQ, "upto", cq_upto, 1);
     rb_define_method(cQ, "zero?", cq_zerop, 0);
 
     /* include Comparable */
@@ -2758,6 +3199,7 @@ define_calc_q(VALUE m)
 
     id_add = rb_intern("+");
     id_and = rb_intern("&");
+    id_by = rb_intern("by");
     id_coerce = rb_intern("coerce");
     id_divide = rb_intern("/");
     id_multiply = rb_intern("*");
@@ -2765,5 +3207,6 @@ define_calc_q(VALUE m)
     id_or = rb_intern("|");
     id_spaceship = rb_intern("<=>");
     id_subtract = rb_intern("-");
+    id_to = rb_intern("to");
     id_xor = rb_intern("^");
 }
@@ -0,0 +1,1224 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calc.h"
+
+/* self-initialising quadratic sieve (siqs) for Calc::Q#factorize(method: :qs).
+ *
+ * looks for x where (a x + b)^2 - k n = a q(x) and q(x) factors over a factor
+ * base of primes p for which k n is a square mod p (the small multiplier k is
+ * chosen by the knuth-schroeppel function to make that happen for lots of
+ * small primes).  such relations have (a x + b)^2 = a q(x) mod n; once there
+ * are more than there are primes, gaussian elimination over GF(2) finds sets
+ * whose product of a q(x) has all exponents even, which gives x^2 = y^2 mod n
+ * and, half of the time, a factor gcd(x - y, n).
+ *
+ * each a is the product of s factor base primes and has 2^(s-1) values of b
+ * which differ only in the signs of s - 1 terms, so moving to the next b only
+ * needs an addition per prime to find where q(x) is divisible by each of the
+ * primes (the "self initialising" part).  a task given to calc_parallel_run
+ * sieves all of the polynomials for one a over [-m, m), a QS_BLOCK at a time
+ * so that the sieve stays in L1 cache, and lists the x whose sieve value
+ * passes a threshold, with the sieved primes dividing q(x).  that is all done
+ * with C ints on malloc()ed memory (see parallel.c).  the candidates are
+ * checked with libcalc once the batch has finished: those which factor
+ * completely over the factor base are full relations, those leaving a single
+ * prime below QS_LARGE_MULT times the largest in the factor base are
+ * partial ones, and two partials with the same large prime make a full one.
+ *
+ * the matrix is dense after singleton columns have been removed, so memory
+ * and time for the elimination grow with the square and cube of the factor
+ * base size; in practice that limits this to about 90 digits.
+ */
+
+/* bytes of sieve processed at a time, about the size of L1 cache */
+#define QS_BLOCK 32768
+
+/* factor base primes below this aren't sieved */
+#define QS_SMALL 30
+
+/* relations wanted beyond the number of columns of the matrix */
+#define QS_EXTRA 64
+
+/* partial relations may have a large prime up to this times the largest prime
+ * in the factor base */
+#define QS_LARGE_MULT 64
+
+/* bits of slack in the sieve threshold, for the unsieved small primes and
+ * prime powers */
+#define QS_FUDGE 10
+
+/* values of a given to each thread in a batch */
+#define QS_BATCH 2
+
+/* most primes in a */
+#define QS_MAX_S 20
+
+/* attempts at finding an unused value of a */
+#define QS_A_TRIES 1000
+
+/* smallest number (in bits) split by the sieve */
+#define QS_MIN_BITS 64
+
+/* root of a prime which isn't sieved */
+#define QS_NONE UINT32_MAX
+
+/* size of the factor base and half the sieve interval (in blocks) by the
+ * size of n, interpolated between rows */
+static const struct {
+    long bits;
+    long fb;
+    long blocks;
+} qs_params[] = {
+    {64, 100, 1},
+    {100, 240, 1},
+    {132, 480, 1},
+    {166, 1400, 2},
+    {200, 3200, 3},
+    {232, 6000, 4},
+    {266, 11000, 6},
+    {300, 20000, 8},
+    {332, 32000, 10},
+};
+
+#define QS_PARAMS ((long) (sizeof(qs_params) / sizeof(qs_params[0])))
+
+/* odd squarefree multipliers tried by the knuth-schroeppel function */
+static const long qs_multipliers[] = {
+    1, 3, 5, 7, 11, 13, 15, 17, 19, 21, 23, 29, 31, 33, 35, 37, 39, 41, 43, 47,
+    51, 53, 55, 57, 59, 61, 65, 67, 69, 71, 73
+};
+
+#define QS_MULTIPLIERS ((long) (sizeof(qs_multipliers) / sizeof(qs_multipliers[0])))
+
+/* one value of a and its polynomials */
+typedef struct {
+    int s;
+    long q[QS_MAX_S];           /* factor base indexes of the primes in a */
+    uint32_t gamma[QS_MAX_S];   /* b[l] = (a / q[l]) gamma[l] */
+    ZVALUE a;
+    ZVALUE b[QS_MAX_S];
+    uint32_t *out;              /* candidates: poly, position, count, indexes */
+    long nout;
+    long size;
+    int failed;
+} qs_poly;
+
+typedef struct {
+    ZVALUE v;                   /* a x + b mod n */
+    uint64_t large;             /* large prime, or 1 */
+    long start;                 /* columns of the primes in a q(x) in cols */
+    long len;
+} qs_relation;
+
+typedef struct {
+    ZVALUE n;
+    ZVALUE kn;
+    long nthreads;
+
+    /* factor base.  column 0 of the matrix is -1, column i + 1 is p[i]. */
+    long fb_size;
+    long first_sieved;
+    uint32_t *p;
+    uint32_t *t;                /* square root of kn mod p (0 if p divides k) */
+    unsigned char *logp;
+    long *unsieved;             /* indexes of primes checked by division */
+    long nunsieved;
+
+    /* sieving */
+    long m;                     /* the interval is [-m, m) */
+    unsigned char threshold;
+    uint64_t large;
+    int s;
+    double log_a;               /* log2 of the best a */
+    long qlo, qhi;              /* range of indexes for a's primes */
+    uint64_t rng;
+    uint64_t *used;             /* hashes of values of a already used */
+    long nused, usedsize;
+    qs_poly *polys;             /* the batch */
+    long npolys;
+
+    /* relations, and rows of the matrix as pairs of them (-1 for none) */
+    qs_relation *rels;
+    long nrels, relsize;
+    uint32_t *cols;
+    long ncols, colsize;
+    long *rows;
+    long nrows, rowsize;
+    uint64_t *lp_key;           /* hash of large prime -> relation */
+    long *lp_rel;
+    long lp_size, lp_count;
+
+    /* linear algebra */
+    uint64_t *matrix;
+    long *row_map;
+    uint32_t *counts;
+} qs_state;
+
+/* b^e mod p */
+static uint32_t
+qs_powmod(uint32_t b, uint32_t e, uint32_t p)
+{
+    uint64_t r = 1, x = b % p;
+
+    while (e) {
+        if (e & 1) {
+            r = r * x % p;
+        }
+        x = x * x % p;
+        e >>= 1;
+    }
+    return (uint32_t) r;
+}
+
+/* 1/a mod p, for a not divisible by p */
+static uint32_t
+qs_inverse(uint32_t a, uint32_t p)
+{
+    int64_t r0 = p, r1 = a % p, s0 = 0, s1 = 1, q, t;
+
+    while (r1) {
+        q = r0 / r1;
+        t = r0 - q * r1;
+        r0 = r1;
+        r1 = t;
+        t = s0 - q * s1;
+        s0 = s1;
+        s1 = t;
+    }
+    return (uint32_t) (s0 < 0 ? s0 + p : s0);
+}
+
+/* a square root of a mod the odd prime p, where a is a square (tonelli-shanks) */
+static uint32_t
+qs_sqrtmod(uint32_t a, uint32_t p)
+{
+    uint32_t q, z, c, r, t, b;
+    int e, i, j;
+
+    a %= p;
+    if (a == 0) {
+        return 0;
+    }
+    if ((p & 3) == 3) {
+        return qs_powmod(a, (p + 1) / 4, p);
+    }
+    for (q = p - 1, e = 0; !(q & 1); q >>= 1, e++);
+    for (z = 2; qs_powmod(z, (p - 1) / 2, p) != p - 1; z++);
+    c = qs_powmod(z, q, p);
+    r = qs_powmod(a, (q + 1) / 2, p);
+    t = qs_powmod(a, q, p);
+    while (t != 1) {
+        for (i = 0, b = t; b != 1; i++) {
+            b = (uint32_t) ((uint64_t) b * b % p);
+        }
+        b = c;
+        for (j = 0; j < e - i - 1; j++) {
+            b = (uint32_t) ((uint64_t) b * b % p);
+        }
+        r = (uint32_t) ((uint64_t) r * b % p);
+        c = (uint32_t) ((uint64_t) b * b % p);
+        t = (uint32_t) ((uint64_t) t * c % p);
+        e = i;
+    }
+    return r;
+}
+
+static uint64_t
+qs_random(qs_state * s)
+{
+    /* xorshift64 */
+    s->rng ^= s->rng << 13;
+    s->rng ^= s->rng >> 7;
+    s->rng ^= s->rng << 17;
+    return s->rng;
+}
+
+/* log2 of z (z > 0), to a few decimal places */
+static double
+qs_log2(ZVALUE z)
+{
+    double top;
+
+    top = z.v[z.len - 1];
+    if (z.len == 1) {
+        return log2(top);
+    }
+    top = ldexp(top, BASEB) + z.v[z.len - 2];
+    return log2(top) + (double) (z.len - 2) * BASEB;
+}
+
+/* returns the multiplier k for which the factor base will be best, by the
+ * knuth-schroeppel function */
+static long
+qs_multiplier(ZVALUE n)
+{
+    uint32_t primes[200], nmod[200];
+    double score, best = -1e9;
+    long i, j, k, np = 0, result = 1;
+    uint32_t p, kn;
+
+    for (p = 3; np < 200; p += 2) {
+        for (j = 0; j < np && primes[j] * primes[j] <= p && p % primes[j]; j++);
+        if (j < np && primes[j] * primes[j] <= p) {
+            continue;
+        }
+        primes[np] = p;
+        nmod[np++] = (uint32_t) zmodi(n, (long) p);
+    }
+    for (i = 0; i < QS_MULTIPLIERS; i++) {
+        k = qs_multipliers[i];
+        score = -0.5 * log((double) k);
+        switch ((k * zmodi(n, 8)) & 7) {
+        case 1:
+            score += 2 * M_LN2;
+            break;
+        case 5:
+            score += M_LN2;
+            break;
+        default:
+            score += 0.5 * M_LN2;
+        }
+        for (j = 0; j < np; j++) {
+            p = primes[j];
+            kn = (uint32_t) ((uint64_t) k * nmod[j] % p);
+            if (kn == 0) {
+                score += log((double) p) / p;
+            }
+            else if (qs_powmod(kn, (p - 1) / 2, p) == 1) {
+                score += 2 * log((double) p) / (p - 1);
+            }
+        }
+        if (score > best) {
+            best = score;
+            result = k;
+        }
+    }
+    return result;
+}
+
+/* finds the factor base.  returns FALSE and sets f if a prime in it divides
+ * n. */
+static BOOL
+qs_factor_base(qs_state * s, ZVALUE * f)
+{
+    unsigned char *composite;
+    long limit, i, j, n;
+    uint32_t r;
+
+    s->p = ALLOC_N(uint32_t, s->fb_size);
+    s->t = ALLOC_N(uint32_t, s->fb_size);
+    s->logp = ALLOC_N(unsigned char, s->fb_size);
+    s->unsieved = ALLOC_N(long, s->fb_size);
+    s->p[0] = 2;
+    s->t[0] = (uint32_t) (zmodi(s->kn, 2));
+    n = 1;
+    /* about half of the primes are in the factor base */
+    limit = (long) (2.5 * s->fb_size * log(2.5 * s->fb_size + 10)) + 100;
+    for (;;) {
+        composite = ZALLOC_N(unsigned char, limit + 1);
+        for (i = 3; i <= limit && n < s->fb_size; i += 2) {
+            if (composite[i]) {
+                continue;
+            }
+            for (j = i * i; j <= limit; j += 2 * i) {
+                composite[j] = 1;
+            }
+            if (zmodi(s->n, i) == 0) {
+                xfree(composite);
+                itoz(i, f);
+                return FALSE;
+            }
+            r = (uint32_t) zmodi(s->kn, i);
+            if (r != 0 && qs_powmod(r, (uint32_t) (i - 1) / 2, (uint32_t) i) != 1) {
+                continue;
+            }
+            s->p[n] = (uint32_t) i;
+            s->t[n] = qs_sqrtmod(r, (uint32_t) i);
+            n++;
+        }
+        xfree(composite);
+        if (n == s->fb_size) {
+            break;
+        }
+        /* start again with more */
+        n = 1;
+        limit *= 2;
+    }
+    s->first_sieved = s->fb_size;
+    s->nunsieved = 0;
+    for (i = 0; i < s->fb_size; i++) {
+        s->logp[i] = (unsigned char) (log2((double) s->p[i]) + 0.5);
+        if (s->p[i] >= QS_SMALL && s->first_sieved == s->fb_size) {
+            s->first_sieved = i;
+        }
+        if (s->p[i] < QS_SMALL || s->t[i] == 0) {
+            s->unsieved[s->nunsieved++] = i;
+        }
+    }
+    return TRUE;
+}
+
+/* sets the sizes of things from the size of n */
+static void
+qs_params_for(qs_state * s)
+{
+    long bits = zhighbit(s->n) + 1, i;
+    double f;
+
+    for (i = 0; i < QS_PARAMS - 1 && qs_params[i + 1].bits <= bits; i++);
+    if (i == QS_PARAMS - 1 || bits <= qs_params[0].bits) {
+        s->fb_size = qs_params[i].fb;
+    }
+    else {
+        f = (double) (bits - qs_params[i].bits) / (qs_params[i + 1].bits - qs_params[i].bits);
+        s->fb_size = qs_params[i].fb + (long) (f * (qs_params[i + 1].fb - qs_params[i].fb));
+    }
+    s->m = qs_params[i].blocks * QS_BLOCK;
+}
+
+/* works out the sieve threshold and how to choose a */
+static void
+qs_setup(qs_state * s)
+{
+    double log_q, qe, pmax;
+    long i;
+
+    pmax = s->p[s->fb_size - 1];
+    s->large = (uint64_t) pmax * QS_LARGE_MULT;
+    /* |q(x)| is at most about m sqrt(kn / 2) */
+    log_q = log2((double) s->m) + 0.5 * qs_log2(s->kn) - 0.5;
+    i = (long) (log_q - log2((double) s->large) - QS_FUDGE + 0.5);
+    s->threshold = (unsigned char) (i < 1 ? 1 : i > 255 ? 255 : i);
+
+    /* a should be about sqrt(2 kn) / m, a product of s primes of similar size
+     * from the factor base */
+    s->log_a = 0.5 * (qs_log2(s->kn) + 1) - log2((double) s->m);
+    qe = log2(s->p[s->fb_size / 2] < 2000 ? (double) s->p[s->fb_size / 2] : 2000.0);
+    s->s = (int) (s->log_a / qe + 0.5);
+    if (s->s < 2) {
+        s->s = 2;
+    }
+    if (s->s > QS_MAX_S) {
+        s->s = QS_MAX_S;
+    }
+    qe = s->log_a / s->s;
+    for (s->qlo = s->first_sieved; s->qlo < s->fb_size - 1
+         && log2((double) s->p[s->qlo]) < qe - 1; s->qlo++);
+    for (s->qhi = s->qlo; s->qhi < s->fb_size && log2((double) s->p[s->qhi]) < qe + 1; s->qhi++);
+    while (s->qhi - s->qlo < 2 * s->s + 4 && (s->qlo > s->first_sieved || s->qhi < s->fb_size)) {
+        if (s->qhi < s->fb_size) {
+            s->qhi++;
+        }
+        if (s->qlo > s->first_sieved) {
+            s->qlo--;
+        }
+    }
+}
+
+/* chooses an unused value of a for poly, and works out its values of b.
+ * returns FALSE if none can be found. */
+static BOOL
+qs_new_a(qs_state * s, qs_poly * poly)
+{
+    long tries, i, j, l, best;
+    double rem, d, bestd;
+    uint64_t hash;
+    uint32_t ql, aq, gamma;
+    ZVALUE t, t2;
+    long sorted[QS_MAX_S];
+
+    poly->s = s->s;
+    for (tries = 0; tries < QS_A_TRIES; tries++) {
+        rem = s->log_a;
+        for (i = 0; i < s->s - 1; i++) {
+            do {
+                poly->q[i] = s->qlo + (long) (qs_random(s) % (uint64_t) (s->qhi - s->qlo));
+                for (j = 0; j < i && poly->q[j] != poly->q[i]; j++);
+            } while (j < i || s->t[poly->q[i]] == 0);
+            rem -= log2((double) s->p[poly->q[i]]);
+        }
+        /* the last prime makes a as close to its best size as possible */
+        best = -1;
+        bestd = 1e9;
+        for (l = s->first_sieved; l < s->fb_size; l++) {
+            d = fabs(log2((double) s->p[l]) - rem);
+            if (d >= bestd || s->t[l] == 0) {
+                continue;
+            }
+            for (j = 0; j < s->s - 1 && poly->q[j] != l; j++);
+            if (j == s->s - 1) {
+                best = l;
+                bestd = d;
+            }
+        }
+        if (best < 0) {
+            continue;
+        }
+        poly->q[s->s - 1] = best;
+
+        /* reject values of a used before */
+        memcpy(sorted, poly->q, s->s * sizeof(long));
+        for (i = 1; i < s->s; i++) {
+            for (j = i; j > 0 && sorted[j - 1] > sorted[j]; j--) {
+                l = sorted[j];
+                sorted[j] = sorted[j - 1];
+                sorted[j - 1] = l;
+            }
+        }
+        hash = 14695981039346656037ULL;
+        for (i = 0; i < s->s; i++) {
+            hash = (hash ^ (uint64_t) sorted[i]) * 1099511628211ULL;
+        }
+        for (i = 0; i < s->nused && s->used[i] != hash; i++);
+        if (i < s->nused) {
+            continue;
+        }
+        if (s->nused == s->usedsize) {
+            s->usedsize = s->usedsize ? s->usedsize * 2 : 64;
+            REALLOC_N(s->used, uint64_t, s->usedsize);
+        }
+        s->used[s->nused++] = hash;
+        break;
+    }
+    if (tries == QS_A_TRIES) {
+        return FALSE;
+    }
+
+    itoz(1, &poly->a);
+    for (l = 0; l < s->s; l++) {
+        zmuli(poly->a, (long) s->p[poly->q[l]], &t);
+        zfree(poly->a);
+        poly->a = t;
+    }
+    /* b[l] = (a / q[l]) gamma where gamma = sqrt(kn) / (a / q[l]) mod q[l],
+     * so b[l]^2 = kn mod q[l] and b[l] = 0 mod the other primes */
+    for (l = 0; l < s->s; l++) {
+        ql = s->p[poly->q[l]];
+        aq = 1;
+        for (j = 0; j < s->s; j++) {
+            if (j != l) {
+                aq = (uint32_t) ((uint64_t) aq * (s->p[poly->q[j]] % ql) % ql);
+            }
+        }
+        gamma = (uint32_t) ((uint64_t) s->t[poly->q[l]] * qs_inverse(aq, ql) % ql);
+        if (gamma > ql / 2) {
+            gamma = ql - gamma;
+        }
+        poly->gamma[l] = gamma;
+        zdivi(poly->a, (long) ql, &t);
+        zmuli(t, (long) gamma, &t2);
+        zfree(t);
+        poly->b[l] = t2;
+    }
+    return TRUE;
+}
+
+static void
+qs_free_poly(qs_poly * poly)
+{
+    int l;
+
+    if (poly->s) {
+        zfree(poly->a);
+        for (l = 0; l < poly->s; l++) {
+            zfree(poly->b[l]);
+        }
+        poly->s = 0;
+    }
+    free(poly->out);
+    poly->out = NULL;
+    poly->nout = poly->size = 0;
+}
+
+/* appends x to poly's candidates */
+static void
+qs_push(qs_poly * poly, uint32_t x)
+{
+    uint32_t *out;
+
+    if (poly->failed) {
+        return;
+    }
+    if (poly->nout == poly->size) {
+        out = realloc(poly->out, (poly->size ? poly->size * 2 : 1024) * sizeof(uint32_t));
+        if (!out) {
+            poly->failed = 1;
+            return;
+        }
+        poly->out = out;
+        poly->size = poly->size ? poly->size * 2 : 1024;
+    }
+    poly->out[poly->nout++] = x;
+}
+
+/* sieves all of the polynomials of one value of a.  runs without the GVL. */
+static void
+qs_task(calc_parallel_t * par, long id)
+{
+    qs_state *s = (qs_state *) par->data;
+    qs_poly *poly = &s->polys[id];
+    long fb = s->fb_size, m2 = 2 * s->m, npoly, i, j, l, b0, pos, k, start;
+    uint32_t *mem, *root1, *root2, *next1, *next2, *bainv, p, amod, ainv, bl, bsum, d;
+    unsigned char *block, lp, threshold = s->threshold;
+    int v, minus;
+
+    mem = malloc((4 + poly->s) * fb * sizeof(uint32_t));
+    block = malloc(QS_BLOCK);
+    if (!mem || !block) {
+        free(mem);
+        free(block);
+        poly->failed = 1;
+        return;
+    }
+    root1 = mem;
+    root2 = root1 + fb;
+    next1 = root2 + fb;
+    next2 = next1 + fb;
+    bainv = next2 + fb;
+
+    /* roots of the first polynomial (with b the sum of all the b[l]) */
+    for (j = s->first_sieved; j < fb; j++) {
+        p = s->p[j];
+        root1[j] = QS_NONE;
+        if (s->t[j] == 0) {
+            continue;
+        }
+        for (l = 0; l < poly->s && poly->q[l] != j; l++);
+        if (l < poly->s) {
+            continue;
+        }
+        amod = 1;
+        for (l = 0; l < poly->s; l++) {
+            amod = (uint32_t) ((uint64_t) amod * (s->p[poly->q[l]] % p) % p);
+        }
+        ainv = qs_inverse(amod, p);
+        bsum = 0;
+        for (l = 0; l < poly->s; l++) {
+            /* b[l] mod p = (a / q[l]) gamma[l] mod p */
+            bl = poly->gamma[l] % p;
+            for (k = 0; k < poly->s; k++) {
+                if (k != l) {
+                    bl = (uint32_t) ((uint64_t) bl * (s->p[poly->q[k]] % p) % p);
+                }
+            }
+            bsum = (bsum + bl) % p;
+            bainv[l * fb + j] = (uint32_t) (2 * (uint64_t) bl * ainv % p);
+        }
+        /* x = (+-t - b) / a, shifted by m */
+        root1[j] = (uint32_t) (((uint64_t) (s->t[j] + p - bsum) * ainv + s->m) % p);
+        root2[j] = (uint32_t) (((uint64_t) (2 * p - s->t[j] - bsum) * ainv + s->m) % p);
+    }
+
+    npoly = 1L << (poly->s - 1);
+    for (i = 0; i < npoly && !par->cancelled; i++) {
+        if (i > 0) {
+            /* gray code: bit v of the sign pattern of b[1..] flips */
+            for (v = 0; !((i >> v) & 1); v++);
+            minus = ((i ^ (i >> 1)) >> v) & 1;
+            l = v + 1;
+            for (j = s->first_sieved; j < fb; j++) {
+                if (root1[j] == QS_NONE) {
+                    continue;
+                }
+                p = s->p[j];
+                d = bainv[l * fb + j];
+                if (minus) {
+                    /* b -= 2 b[l], so roots += 2 b[l] / a */
+                    root1[j] = root1[j] + d >= p ? root1[j] + d - p : root1[j] + d;
+                    root2[j] = root2[j] + d >= p ? root2[j] + d - p : root2[j] + d;
+                }
+                else {
+                    root1[j] = root1[j] >= d ? root1[j] - d : root1[j] + p - d;
+                    root2[j] = root2[j] >= d ? root2[j] - d : root2[j] + p - d;
+                }
+            }
+        }
+        memcpy(next1 + s->first_sieved, root1 + s->first_sieved,
+               (fb - s->first_sieved) * sizeof(uint32_t));
+        memcpy(next2 + s->first_sieved, root2 + s->first_sieved,
+               (fb - s->first_sieved) * sizeof(uint32_t));
+        for (b0 = 0; b0 < m2; b0 += QS_BLOCK) {
+            memset(block, 0, QS_BLOCK);
+            for (j = s->first_sieved; j < fb; j++) {
+                if (root1[j] == QS_NONE) {
+                    continue;
+                }
+                p = s->p[j];
+                lp = s->logp[j];
+                for (pos = next1[j]; pos < b0 + QS_BLOCK; pos += p) {
+                    block[pos - b0] += lp;
+                }
+                next1[j] = (uint32_t) pos;
+                for (pos = next2[j]; pos < b0 + QS_BLOCK; pos += p) {
+                    block[pos - b0] += lp;
+                }
+                next2[j] = (uint32_t) pos;
+            }
+            for (k = 0; k < QS_BLOCK; k++) {
+                if (block[k] < threshold) {
+                    continue;
+                }
+                pos = b0 + k;
+                qs_push(poly, (uint32_t) i);
+                qs_push(poly, (uint32_t) pos);
+                start = poly->nout;
+                qs_push(poly, 0);
+                for (j = s->first_sieved; j < fb; j++) {
+                    if (root1[j] != QS_NONE
+                        && ((uint32_t) (pos % s->p[j]) == root1[j]
+                            || (uint32_t) (pos % s->p[j]) == root2[j])) {
+                        qs_push(poly, (uint32_t) j);
+                    }
+                }
+                if (!poly->failed) {
+                    poly->out[start] = (uint32_t) (poly->nout - start - 1);
+                }
+            }
+        }
+    }
+    free(mem);
+    free(block);
+}
+
+/* adds column c to the relation being built */
+static void
+qs_push_col(qs_state * s, uint32_t c)
+{
+    if (s->ncols == s->colsize) {
+        s->colsize = s->colsize ? s->colsize * 2 : 4096;
+        REALLOC_N(s->cols, uint32_t, s->colsize);
+    }
+    s->cols[s->ncols++] = c;
+}
+
+static void
+qs_add_row(qs_state * s, long r1, long r2)
+{
+    if (s->nrows == s->rowsize) {
+        s->rowsize = s->rowsize ? s->rowsize * 2 : 1024;
+        REALLOC_N(s->rows, long, 2 * s->rowsize);
+    }
+    s->rows[2 * s->nrows] = r1;
+    s->rows[2 * s->nrows + 1] = r2;
+    s->nrows++;
+}
+
+/* slot in the large prime hash for key: where it is, or an empty slot */
+static long
+qs_lp_slot(const uint64_t * keys, long size, uint64_t key)
+{
+    long i;
+
+    for (i = (long) ((key * 0x9e3779b97f4a7c15ULL) >> 32) & (size - 1); keys[i] && keys[i] != key;
+         i = (i + 1) & (size - 1));
+    return i;
+}
+
+/* pairs the partial relation r with an earlier one with the same large
+ * prime, or remembers it */
+static void
+qs_add_partial(qs_state * s, long r)
+{
+    uint64_t *old_key;
+    long i, h, old_size, *old_rel;
+
+    if (2 * (s->lp_count + 1) > s->lp_size) {
+        old_key = s->lp_key;
+        old_rel = s->lp_rel;
+        old_size = s->lp_size;
+        s->lp_size = old_size ? old_size * 2 : 1024;
+        s->lp_key = ZALLOC_N(uint64_t, s->lp_size);
+        s->lp_rel = ALLOC_N(long, s->lp_size);
+        for (i = 0; i < old_size; i++) {
+            if (old_key[i]) {
+                h = qs_lp_slot(s->lp_key, s->lp_size, old_key[i]);
+                s->lp_key[h] = old_key[i];
+                s->lp_rel[h] = old_rel[i];
+            }
+        }
+        xfree(old_key);
+        xfree(old_rel);
+    }
+    h = qs_lp_slot(s->lp_key, s->lp_size, s->rels[r].large);
+    if (s->lp_key[h]) {
+        qs_add_row(s, s->lp_rel[h], r);
+        return;
+    }
+    s->lp_key[h] = s->rels[r].large;
+    s->lp_rel[h] = r;
+    s->lp_count++;
+}
+
+/* checks candidate x = pos - m of polynomial i of poly, whose sieved primes
+ * dividing q(x) are idx[0 .. nidx-1].  adds it if it's a relation. */
+static void
+qs_check(qs_state * s, qs_poly * poly, long i, long pos, const uint32_t * idx, long nidx)
+{
+    ZVALUE b, v, q, t1, t2;
+    long g, l, j, start = s->ncols, r;
+    uint64_t large;
+    uint32_t p;
+
+    /* b = b[0] +- b[1] +- ... with the signs from the gray code of i */
+    g = i ^ (i >> 1);
+    zcopy(poly->b[0], &b);
+    for (l = 1; l < poly->s; l++) {
+        if ((g >> (l - 1)) & 1) {
+            zsub(b, poly->b[l], &t1);
+        }
+        else {
+            zadd(b, poly->b[l], &t1);
+        }
+        zfree(b);
+        b = t1;
+    }
+    zmuli(poly->a, pos - s->m, &t1);
+    zadd(t1, b, &v);
+    zfree(t1);
+    zfree(b);
+
+    /* q(x) = (v^2 - kn) / a */
+    zsquare(v, &t1);
+    zsub(t1, s->kn, &t2);
+    zfree(t1);
+    zquo(t2, poly->a, &q, 0);
+    zfree(t2);
+    if (zisneg(q)) {
+        qs_push_col(s, 0);
+        q.sign = 0;
+    }
+    for (l = 0; l < poly->s; l++) {
+        qs_push_col(s, (uint32_t) poly->q[l] + 1);
+    }
+
+    /* divide out the factor base primes: the small ones and those which
+     * aren't sieved, a's, and those found by the sieve */
+    for (j = 0; j < s->nunsieved + poly->s + nidx && !zisunit(q); j++) {
+        if (j < s->nunsieved) {
+            r = s->unsieved[j];
+        }
+        else if (j < s->nunsieved + poly->s) {
+            r = poly->q[j - s->nunsieved];
+        }
+        else {
+            r = idx[j - s->nunsieved - poly->s];
+        }
+        p = s->p[r];
+        while (zmodi(q, (long) p) == 0) {
+            zdivi(q, (long) p, &t1);
+            zfree(q);
+            q = t1;
+            qs_push_col(s, (uint32_t) r + 1);
+        }
+    }
+    if (zisunit(q)) {
+        large = 1;
+    }
+    else if (zhighbit(q) < 63 && (uint64_t) ztou(q) <= s->large) {
+        large = (uint64_t) ztou(q);
+    }
+    else {
+        /* not smooth enough */
+        zfree(q);
+        zfree(v);
+        s->ncols = start;
+        return;
+    }
+    zfree(q);
+
+    if (s->nrels == s->relsize) {
+        s->relsize = s->relsize ? s->relsize * 2 : 1024;
+        REALLOC_N(s->rels, qs_relation, s->relsize);
+    }
+    r = s->nrels++;
+    zmod(v, s->n, &s->rels[r].v, 0);
+    zfree(v);
+    s->rels[r].large = large;
+    s->rels[r].start = start;
+    s->rels[r].len = s->ncols - start;
+    if (large == 1) {
+        qs_add_row(s, r, -1);
+    }
+    else {
+        qs_add_partial(s, r);
+    }
+}
+
+/* sieves a batch of values of a, adding the relations found.  returns FALSE
+ * if no more values of a could be found. */
+static BOOL
+qs_batch(qs_state * s)
+{
+    calc_parallel_t par;
+    qs_poly *poly;
+    long i, k, n;
+
+    for (i = 0; i < s->npolys; i++) {
+        qs_free_poly(&s->polys[i]);
+        s->polys[i].failed = 0;
+        if (!qs_new_a(s, &s->polys[i])) {
+            return FALSE;
+        }
+    }
+    par.ntasks = s->npolys;
+    par.task = qs_task;
+    par.data = s;
+    calc_parallel_run(&par, s->nthreads);
+    for (i = 0; i < s->npolys; i++) {
+        if (s->polys[i].failed) {
+            rb_raise(rb_eNoMemError, "failed to allocate memory for factorize");
+        }
+    }
+    for (i = 0; i < s->npolys; i++) {
+        poly = &s->polys[i];
+        for (k = 0; k < poly->nout; k += 3 + n) {
+            n = poly->out[k + 2];
+            qs_check(s, poly, poly->out[k], poly->out[k + 1], poly->out + k + 3, n);
+        }
+    }
+    return TRUE;
+}
+
+#define qs_bit(row, c) (((row)[(c) >> 6] >> ((c) & 63)) & 1)
+#define qs_flip(row, c) ((row)[(c) >> 6] ^= (uint64_t) 1 << ((c) & 63))
+
+/* for the rows in dependency dep (a list of row numbers), tries
+ * gcd(x - y, n) where x^2 = y^2 mod n.  returns TRUE and sets f if it is a
+ * proper factor. */
+static BOOL
+qs_sqrt(qs_state * s, const long *dep, long ndep, ZVALUE * f)
+{
+    ZVALUE x, y, t1, t2, z;
+    long i, j, k, r;
+    qs_relation *rel;
+
+    memset(s->counts, 0, (s->fb_size + 1) * sizeof(uint32_t));
+    itoz(1, &x);
+    itoz(1, &y);
+    for (i = 0; i < ndep; i++) {
+        for (k = 0; k < 2; k++) {
+            r = s->rows[2 * dep[i] + k];
+            if (r < 0) {
+                continue;
+            }
+            rel = &s->rels[r];
+            zmul(x, rel->v, &t1);
+            zfree(x);
+            zmod(t1, s->n, &x, 0);
+            zfree(t1);
+            for (j = 0; j < rel->len; j++) {
+                s->counts[s->cols[rel->start + j]]++;
+            }
+        }
+        if (s->rows[2 * dep[i] + 1] >= 0) {
+            /* the large prime appears twice */
+            utoz((FULL) s->rels[s->rows[2 * dep[i]]].large, &z);
+            zmul(y, z, &t1);
+            zfree(z);
+            zfree(y);
+            zmod(t1, s->n, &y, 0);
+            zfree(t1);
+        }
+    }
+    for (j = 1; j <= s->fb_size; j++) {
+        if (s->counts[j] < 2) {
+            continue;
+        }
+        utoz((FULL) s->p[j - 1], &z);
+        utoz((FULL) (s->counts[j] / 2), &t2);
+        zpowermod(z, t2, s->n, &t1);
+        zfree(z);
+        zfree(t2);
+        zmul(y, t1, &t2);
+        zfree(t1);
+        zfree(y);
+        zmod(t2, s->n, &y, 0);
+        zfree(t2);
+    }
+    zsub(x, y, &t1);
+    zfree(x);
+    zfree(y);
+    zgcd(t1, s->n, f);
+    zfree(t1);
+    if (zisunit(*f) || !zcmp(*f, s->n)) {
+        zfree(*f);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* puts the columns in which row r has an odd exponent in list, returning how
+ * many there are.  odd is scratch space, all 0. */
+static long
+qs_row_parity(qs_state * s, long r, unsigned char *odd, uint32_t * list)
+{
+    qs_relation *rel;
+    long j, k, n = 0;
+    uint32_t c;
+
+    for (k = 0; k < 2; k++) {
+        if (s->rows[2 * r + k] < 0) {
+            continue;
+        }
+        rel = &s->rels[s->rows[2 * r + k]];
+        for (j = 0; j < rel->len; j++) {
+            odd[s->cols[rel->start + j]] ^= 1;
+        }
+    }
+    for (k = 0; k < 2; k++) {
+        if (s->rows[2 * r + k] < 0) {
+            continue;
+        }
+        rel = &s->rels[s->rows[2 * r + k]];
+        for (j = 0; j < rel->len; j++) {
+            c = s->cols[rel->start + j];
+            if (odd[c]) {
+                list[n++] = c;
+                odd[c] = 0;
+            }
+        }
+    }
+    return n;
+}
+
+/* finds dependencies between the rows by gaussian elimination over GF(2) and
+ * tries each of them.  returns TRUE and sets f if one gives a factor. */
+static BOOL
+qs_solve(qs_state * s, ZVALUE * f)
+{
+    uint32_t *weight, *colmap, *list, c;
+    unsigned char *odd;
+    long *rowlist, *dep, nr, nc, words, i, j, r, pr, ndep, changed, n;
+    uint64_t *row, *prow, tmp;
+    BOOL found = FALSE;
+
+    odd = ZALLOC_N(unsigned char, s->fb_size + 1);
+    weight = ALLOC_N(uint32_t, s->fb_size + 1);
+    list = ALLOC_N(uint32_t, s->fb_size + 1);
+    s->row_map = ALLOC_N(long, s->nrows);
+    rowlist = s->row_map;
+    for (r = 0; r < s->nrows; r++) {
+        rowlist[r] = 1;
+    }
+
+    /* drop rows with a prime found in no other row, until there are none */
+    do {
+        changed = 0;
+        memset(weight, 0, (s->fb_size + 1) * sizeof(uint32_t));
+        for (r = 0; r < s->nrows; r++) {
+            if (rowlist[r]) {
+                n = qs_row_parity(s, r, odd, list);
+                for (j = 0; j < n; j++) {
+                    weight[list[j]]++;
+                }
+            }
+        }
+        for (r = 0; r < s->nrows; r++) {
+            if (rowlist[r]) {
+                n = qs_row_parity(s, r, odd, list);
+                for (j = 0; j < n && weight[list[j]] > 1; j++);
+                if (j < n) {
+                    rowlist[r] = 0;
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+
+    /* number the remaining columns and rows */
+    colmap = ALLOC_N(uint32_t, s->fb_size + 1);
+    for (c = 0, nc = 0; c <= (uint32_t) s->fb_size; c++) {
+        colmap[c] = weight[c] ? (uint32_t) nc++ : QS_NONE;
+    }
+    for (r = 0, nr = 0; r < s->nrows; r++) {
+        if (rowlist[r]) {
+            rowlist[nr++] = r;
+        }
+    }
+    xfree(weight);
+    if (nr > nc + QS_EXTRA) {
+        nr = nc + QS_EXTRA;
+    }
+    if (nr <= nc) {
+        xfree(odd);
+        xfree(list);
+        xfree(colmap);
+        xfree(s->row_map);
+        s->row_map = NULL;
+        return FALSE;
+    }
+
+    /* each row: the parities of its columns, then a bit for itself to keep
+     * track of which rows have been added together */
+    words = (nc + nr + 63) / 64;
+    s->matrix = ZALLOC_N(uint64_t, nr * words);
+    for (i = 0; i < nr; i++) {
+        row = s->matrix + i * words;
+        n = qs_row_parity(s, rowlist[i], odd, list);
+        for (j = 0; j < n; j++) {
+            qs_flip(row, colmap[list[j]]);
+        }
+        qs_flip(row, nc + i);
+    }
+    xfree(colmap);
+    xfree(odd);
+    xfree(list);
+
+    /* forward elimination */
+    pr = 0;
+    for (c = 0; c < (uint32_t) nc && pr < nr; c++) {
+        for (i = pr; i < nr && !qs_bit(s->matrix + i * words, c); i++);
+        if (i == nr) {
+            continue;
+        }
+        prow = s->matrix + pr * words;
+        if (i != pr) {
+            row = s->matrix + i * words;
+            for (j = 0; j < words; j++) {
+                tmp = row[j];
+                row[j] = prow[j];
+                prow[j] = tmp;
+            }
+        }
+        for (i = pr + 1; i < nr; i++) {
+            row = s->matrix + i * words;
+            if (qs_bit(row, c)) {
+                for (j = (long) (c >> 6); j < words; j++) {
+                    row[j] ^= prow[j];
+                }
+            }
+        }
+        pr++;
+        if ((c & 63) == 0) {
+            rb_thread_check_ints();
+        }
+    }
+
+    /* rows pr.. are now zero in the matrix part; their other bits say which
+     * of the original rows were added to make them */
+    dep = ALLOC_N(long, nr);
+    s->counts = ALLOC_N(uint32_t, s->fb_size + 1);
+    for (i = pr; i < nr && !found; i++) {
+        row = s->matrix + i * words;
+        ndep = 0;
+        for (j = 0; j < nr; j++) {
+            if (qs_bit(row, nc + j)) {
+                dep[ndep++] = rowlist[j];
+            }
+        }
+        found = qs_sqrt(s, dep, ndep, f);
+    }
+    xfree(dep);
+    xfree(s->counts);
+    s->counts = NULL;
+    xfree(s->matrix);
+    s->matrix = NULL;
+    xfree(s->row_map);
+    s->row_map = NULL;
+    return found;
+}
+
+typedef struct {
+    qs_state *s;
+    ZVALUE *f;
+    BOOL found;
+} qs_args;
+
+static VALUE
+qs_body(VALUE arg)
+{
+    qs_args *a = (qs_args *) arg;
+    qs_state *s = a->s;
+    ZVALUE t;
+    long needed;
+
+    zmuli(s->n, qs_multiplier(s->n), &t);
+    zfree(s->kn);
+    s->kn = t;
+    qs_params_for(s);
+    if (!qs_factor_base(s, a->f)) {
+        a->found = TRUE;
+        return Qnil;
+    }
+    qs_setup(s);
+    s->npolys = s->nthreads * QS_BATCH;
+    s->polys = ZALLOC_N(qs_poly, s->npolys);
+    needed = s->fb_size + 1 + QS_EXTRA;
+    for (;;) {
+        if (!qs_batch(s)) {
+            /* ran out of values of a */
+            return Qnil;
+        }
+        if (rb_block_given_p()) {
+            rb_yield_values(2, LONG2NUM(s->nrows), LONG2NUM(needed));
+        }
+        if (s->nrows < needed) {
+            continue;
+        }
+        if (qs_solve(s, a->f)) {
+            a->found = TRUE;
+            return Qnil;
+        }
+        /* unlucky, or too many rows were dropped: get some more */
+        needed = s->nrows + QS_EXTRA;
+    }
+}
+
+static VALUE
+qs_cleanup(VALUE arg)
+{
+    qs_state *s = ((qs_args *) arg)->s;
+    long i;
+
+    zfree(s->kn);
+    xfree(s->p);
+    xfree(s->t);
+    xfree(s->logp);
+    xfree(s->unsieved);
+    xfree(s->used);
+    for (i = 0; s->polys && i < s->npolys; i++) {
+        qs_free_poly(&s->polys[i]);
+    }
+    xfree(s->polys);
+    for (i = 0; i < s->nrels; i++) {
+        zfree(s->rels[i].v);
+    }
+    xfree(s->rels);
+    xfree(s->cols);
+    xfree(s->rows);
+    xfree(s->lp_key);
+    xfree(s->lp_rel);
+    xfree(s->matrix);
+    xfree(s->row_map);
+    xfree(s->counts);
+    return Qnil;
+}
+
+/* tries to split n (odd, composite and not a perfect power) with the
+ * quadratic sieve.  returns TRUE and sets f to a proper factor if it works;
+ * FALSE if n is too small for the sieve or no factor was found.
+ *
+ * if a block was given to the ruby method, it is yielded the number of
+ * relations found and the number needed after each batch of polynomials. */
+BOOL
+qs_split(ZVALUE n, long nthreads, ZVALUE * f)
+{
+    qs_state s;
+    qs_args a;
+
+    if (zhighbit(n) + 1 < QS_MIN_BITS) {
+        return FALSE;
+    }
+    memset(&s, 0, sizeof(s));
+    s.n = n;
+    s.nthreads = nthreads;
+    s.rng = 0x2545f4914f6cdd1dULL;
+    itoz(0, &s.kn);
+    a.s = &s;
+    a.f = f;
+    a.found = FALSE;
+    rb_ensure(qs_body, (VALUE) & a, qs_cleanup, (VALUE) & a);
+    return a.found;
+}
@@ -0,0 +1,522 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calc.h"
+
+/* segmented sieve of eratosthenes for Calc.each_prime, Calc.primes and
+ * Calc.count_primes.
+ *
+ * only odd numbers are stored, one byte each (1 for prime).  a segment of
+ * SIEVE_SEGMENT bytes fits in L1 cache; segments are grouped into blocks,
+ * which are the tasks given to calc_parallel_run.  each block works out
+ * where each sieving prime's multiples start once, then carries the offsets
+ * from segment to segment.
+ *
+ * the wheel: multiples of 3, 5, 7, 11 and 13 repeat every 30030 numbers, so
+ * each segment starts as a copy of a precomputed pattern and only primes from
+ * 17 are sieved.  the wheel primes themselves (and 2) are handled separately.
+ *
+ * sieving primes (up to the square root of the end of the range) are found
+ * the same way, from primes up to the fourth root found by a plain sieve.
+ *
+ * tasks only do plain C work with malloc()ed memory (see parallel.c); primes
+ * are turned into ruby values afterwards, a batch of blocks at a time.
+ */
+
+/* odd numbers per segment (bytes), about the size of L1 cache */
+#define SIEVE_SEGMENT 32768
+
+/* odd numbers per block (one task) */
+#define SIEVE_BLOCK (SIEVE_SEGMENT * 64)
+
+/* blocks per thread in each batch when listing primes */
+#define SIEVE_BATCH 4
+
+/* 3 * 5 * 7 * 11 * 13: the pattern of odd numbers repeats after this many */
+#define PATTERN_LEN 15015
+
+/* smallest prime which isn't in the wheel */
+#define FIRST_SIEVING_PRIME 17
+
+static const uint64_t wheel_primes[] = { 2, 3, 5, 7, 11, 13 };
+
+/* pattern[i] is 0 if 2i+1 is a multiple of 3, 5, 7, 11 or 13, otherwise 1 */
+static unsigned char pattern[PATTERN_LEN];
+static int pattern_ready = 0;
+
+typedef struct {
+    uint32_t *p;
+    long n;
+} prime_list;
+
+/* output of one block */
+typedef struct {
+    uint64_t count;
+    uint64_t *primes;           /* NULL when only counting */
+    long n;
+    long size;
+    int failed;
+} sieve_output;
+
+enum { SIEVE_EACH, SIEVE_ARRAY, SIEVE_COUNT, SIEVE_BASE };
+
+typedef struct {
+    int mode;
+    VALUE result;               /* array for SIEVE_ARRAY */
+    uint64_t count;             /* for SIEVE_COUNT */
+    long nthreads;
+    prime_list small;           /* primes for finding base */
+    prime_list base;            /* sieving primes */
+    long base_size;
+    /* the current range: odd numbers lo .. lo + 2 (nodd - 1) */
+    const prime_list *sieving;
+    uint64_t lo;
+    uint64_t nodd;
+    long first_block;
+    sieve_output *out;
+    long nout;
+} sieve_state;
+
+static void
+init_pattern(void)
+{
+    long i, k;
+
+    if (pattern_ready) {
+        return;
+    }
+    memset(pattern, 1, sizeof(pattern));
+    for (k = 1; k < 6; k++) {
+        /* 2i+1 = p, 3p, 5p, ... */
+        for (i = (long) (wheel_primes[k] / 2); i < PATTERN_LEN; i += (long) wheel_primes[k]) {
+            pattern[i] = 0;
+        }
+    }
+    pattern_ready = 1;
+}
+
+/* appends x to out; sets out->failed if out of memory */
+static void
+output_push(sieve_output * out, uint64_t x)
+{
+    uint64_t *p;
+    long size;
+
+    if (out->n == out->size) {
+        size = out->size ? out->size * 2 : 1024;
+        p = realloc(out->primes, size * sizeof(uint64_t));
+        if (!p) {
+            out->failed = 1;
+            return;
+        }
+        out->primes = p;
+        out->size = size;
+    }
+    out->primes[out->n++] = x;
+}
+
+/* sieves the odd numbers lo, lo + 2, ... lo + 2 (len - 1) with the primes in
+ * base (lo >= FIRST_SIEVING_PRIME).  if collect, the primes are added to
+ * out->primes, otherwise they are only counted. */
+static void
+sieve_block(const prime_list * base, uint64_t lo, uint64_t len, int collect,
+            sieve_output * out)
+{
+    unsigned char *buf;
+    uint64_t *next, m, d, p, s, off, i, n, start, pos;
+    long k;
+
+    buf = malloc(SIEVE_SEGMENT);
+    next = malloc((base->n ? base->n : 1) * sizeof(uint64_t));
+    if (!buf || !next) {
+        free(buf);
+        free(next);
+        out->failed = 1;
+        return;
+    }
+
+    /* index (from lo) of the first odd multiple of each prime to cross off,
+     * starting from its square.  lo + d is the first odd multiple >= lo
+     * (worked out as an offset so that nothing overflows near 2^64). */
+    for (k = 0; k < base->n; k++) {
+        p = base->p[k];
+        m = p * p;
+        if (m >= lo) {
+            next[k] = (m - lo) / 2;
+        }
+        else {
+            d = (p - lo % p) % p;
+            if (d & 1) {
+                d += p;
+            }
+            next[k] = d / 2;
+        }
+    }
+
+    start = ((lo - 1) / 2) % PATTERN_LEN;
+    for (s = 0; s < len && !out->failed; s += SIEVE_SEGMENT) {
+        n = len - s < SIEVE_SEGMENT ? len - s : SIEVE_SEGMENT;
+        /* copy the wheel pattern */
+        pos = (start + s) % PATTERN_LEN;
+        for (i = 0; i < n; i += m) {
+            m = PATTERN_LEN - pos < n - i ? PATTERN_LEN - pos : n - i;
+            memcpy(buf + i, pattern + pos, m);
+            pos = 0;
+        }
+        for (k = 0; k < base->n; k++) {
+            p = base->p[k];
+            for (off = next[k]; off < s + n; off += p) {
+                buf[off - s] = 0;
+            }
+            next[k] = off;
+        }
+        if (collect) {
+            for (i = 0; i < n; i++) {
+                if (buf[i]) {
+                    output_push(out, lo + 2 * (s + i));
+                }
+            }
+        }
+        for (i = 0; i < n; i++) {
+            out->count += buf[i];
+        }
+    }
+    free(buf);
+    free(next);
+}
+
+static void
+sieve_task(calc_parallel_t * par, long id)
+{
+    sieve_state *s = (sieve_state *) par->data;
+    uint64_t first, len;
+
+    first = (uint64_t) (s->first_block + id) * SIEVE_BLOCK;
+    len = s->nodd - first < SIEVE_BLOCK ? s->nodd - first : SIEVE_BLOCK;
+    sieve_block(s->sieving, s->lo + 2 * first, len, s->mode != SIEVE_COUNT, &s->out[id]);
+}
+
+/* handles a prime found by the sieve, with the GVL held */
+static void
+sieve_emit(sieve_state * s, uint64_t p)
+{
+    switch (s->mode) {
+    case SIEVE_EACH:
+        rb_yield(wrap_number(utoq((FULL) p)));
+        break;
+    case SIEVE_ARRAY:
+        rb_ary_push(s->result, wrap_number(utoq((FULL) p)));
+        break;
+    case SIEVE_COUNT:
+        s->count++;
+        break;
+    default:
+        if (s->base.n == s->base_size) {
+            s->base_size = s->base_size ? s->base_size * 2 : 1024;
+            REALLOC_N(s->base.p, uint32_t, s->base_size);
+        }
+        s->base.p[s->base.n++] = (uint32_t) p;
+    }
+}
+
+/* runs the sieve over the odd numbers from lo to hi (lo >= 17) using the
+ * primes in sieving, handing the primes found to sieve_emit in order */
+static void
+sieve_range(sieve_state * s, const prime_list * sieving, uint64_t lo, uint64_t hi)
+{
+    calc_parallel_t par;
+    sieve_output *out;
+    long nblocks, batch, i, j;
+
+    if (!(lo & 1)) {
+        lo++;
+    }
+    if (!(hi & 1)) {
+        hi--;
+    }
+    if (lo > hi) {
+        return;
+    }
+    s->sieving = sieving;
+    s->lo = lo;
+    s->nodd = (hi - lo) / 2 + 1;
+    nblocks = (long) ((s->nodd + SIEVE_BLOCK - 1) / SIEVE_BLOCK);
+    /* counts don't need to be in order, so can be done all at once */
+    batch = s->mode == SIEVE_COUNT ? nblocks : s->nthreads * SIEVE_BATCH;
+
+    for (s->first_block = 0; s->first_block < nblocks; s->first_block += batch) {
+        s->nout = nblocks - s->first_block < batch ? nblocks - s->first_block : batch;
+        s->out = calloc(s->nout, sizeof(sieve_output));
+        if (!s->out) {
+            rb_raise(rb_eNoMemError, "failed to allocate memory for sieve");
+        }
+        par.ntasks = s->nout;
+        par.task = sieve_task;
+        par.data = s;
+        calc_parallel_run(&par, s->nthreads);
+        out = s->out;
+        for (i = 0; i < s->nout; i++) {
+            if (out[i].failed) {
+                rb_raise(rb_eNoMemError, "failed to allocate memory for sieve");
+            }
+        }
+        for (i = 0; i < s->nout; i++) {
+            if (s->mode == SIEVE_COUNT) {
+                s->count += out[i].count;
+                continue;
+            }
+            for (j = 0; j < out[i].n; j++) {
+                sieve_emit(s, out[i].primes[j]);
+            }
+            /* done with this block (sieve_cleanup frees the rest if the block
+             * given to each_prime raises) */
+            free(out[i].primes);
+            out[i].primes = NULL;
+        }
+        free(out);
+        s->out = NULL;
+    }
+}
+
+/* floor(sqrt(n)) */
+static uint64_t
+isqrt64(uint64_t n)
+{
+    uint64_t r;
+
+    r = (uint64_t) sqrt((double) n);
+    while (r > 0 && (r > UINT32_MAX || r * r > n)) {
+        r--;
+    }
+    while (r < UINT32_MAX && (r + 1) * (r + 1) <= n) {
+        r++;
+    }
+    return r;
+}
+
+/* sets s->base to the primes from 17 to sqrt(hi) */
+static void
+find_base_primes(sieve_state * s, uint64_t hi)
+{
+    unsigned char *composite;
+    uint64_t r, r2, i, j;
+    int mode;
+
+    r = isqrt64(hi);
+    if (r < FIRST_SIEVING_PRIME) {
+        return;
+    }
+    /* primes from 17 up to sqrt(r), by a plain sieve */
+    r2 = isqrt64(r);
+    composite = ALLOC_N(unsigned char, r2 + 1);
+    memset(composite, 0, r2 + 1);
+    s->small.p = ALLOC_N(uint32_t, r2 + 1);
+    for (i = 2; i <= r2; i++) {
+        if (composite[i]) {
+            continue;
+        }
+        if (i >= FIRST_SIEVING_PRIME) {
+            s->small.p[s->small.n++] = (uint32_t) i;
+        }
+        for (j = i * i; j <= r2; j += i) {
+            composite[j] = 1;
+        }
+    }
+    xfree(composite);
+
+    /* then the rest by sieving up to r with those */
+    mode = s->mode;
+    s->mode = SIEVE_BASE;
+    sieve_range(s, &s->small, FIRST_SIEVING_PRIME, r);
+    s->mode = mode;
+}
+
+typedef struct {
+    sieve_state *s;
+    uint64_t from;
+    uint64_t to;
+} sieve_args;
+
+static VALUE
+sieve_body(VALUE arg)
+{
+    sieve_args *a = (sieve_args *) arg;
+    sieve_state *s = a->s;
+    long i;
+
+    init_pattern();
+    for (i = 0; i < 6; i++) {
+        if (wheel_primes[i] >= a->from && wheel_primes[i] <= a->to) {
+            sieve_emit(s, wheel_primes[i]);
+        }
+    }
+    if (a->to < FIRST_SIEVING_PRIME) {
+        return Qnil;
+    }
+    find_base_primes(s, a->to);
+    sieve_range(s, &s->base, a->from > FIRST_SIEVING_PRIME ? a->from : FIRST_SIEVING_PRIME,
+                a->to);
+    return Qnil;
+}
+
+static VALUE
+sieve_cleanup(VALUE arg)
+{
+    sieve_state *s = ((sieve_args *) arg)->s;
+    long i;
+
+    if (s->out) {
+        for (i = 0; i < s->nout; i++) {
+            free(s->out[i].primes);
+        }
+        free(s->out);
+        s->out = NULL;
+    }
+    xfree(s->small.p);
+    xfree(s->base.p);
+    return Qnil;
+}
+
+/* converts v to an unsigned 64 bit bound.  negative values are clamped to
+ * 0; *negative is set if v was negative. */
+static uint64_t
+value_to_bound(VALUE v, const char *name, int *negative)
+{
+    NUMBER *q;
+    uint64_t result;
+    LEN i;
+
+    q = value_to_number(v, 0);
+    if (qisfrac(q)) {
+        qfree(q);
+        rb_raise(e_MathError, "Non-integer %s for prime sieve", name);
+    }
+    *negative = qisneg(q);
+    if (*negative) {
+        qfree(q);
+        return 0;
+    }
+    if (zhighbit(q->num) >= 64) {
+        qfree(q);
+        rb_raise(e_MathError, "Too large %s for prime sieve", name);
+    }
+    result = 0;
+    for (i = q->num.len; i-- > 0;) {
+        result = (result << (sizeof(HALF) * 8)) | q->num.v[i];
+    }
+    qfree(q);
+    return result;
+}
+
+/* runs the sieve for from .. to in the given mode */
+static void
+sieve_run(int mode, VALUE from, VALUE to, VALUE threads, VALUE result, uint64_t * count)
+{
+    sieve_state s;
+    sieve_args a;
+    int from_negative, to_negative;
+
+    memset(&s, 0, sizeof(s));
+    a.from = value_to_bound(from, "lower bound", &from_negative);
+    a.to = value_to_bound(to, "upper bound", &to_negative);
+    if (to_negative || a.to < a.from) {
+        return;
+    }
+    s.mode = mode;
+    s.result = result;
+    s.nthreads = calc_thread_count(threads);
+    a.s = &s;
+    rb_ensure(sieve_body, (VALUE) & a, sieve_cleanup, (VALUE) & a);
+    if (count) {
+        *count = s.count;
+    }
+}
+
+/* Iterates over the primes between two values
+ *
+ * The primes are found with a segmented sieve of Eratosthenes, which is much
+ * faster than calling Calc::Q#nextprime repeatedly, and works for any range
+ * below 2^64.  The time taken is proportional to (to - from) plus sqrt(to),
+ * and the memory used by the sieve grows with sqrt(to).
+ *
+ * Blocks of the range are sieved by native threads, a batch at a time, and
+ * the primes yielded in order.
+ *
+ * @param from [Integer] lower bound (inclusive)
+ * @param to [Integer] upper bound (inclusive), less than 2^64
+ * @param threads [Integer] (optional) maximum number of native threads to use,
+ *  defaults to Calc.config(:threads)
+ * @yield [p] each prime p with from <= p <= to, in increasing order
+ * @return [nil, Enumerator] nil, or an Enumerator if no block was given
+ * @raise [Calc::MathError] if from or to isn't an integer, or to >= 2^64
+ * @example
+ *  Calc.each_prime(10, 30) { |p| print p, " " } #=> nil
+ *  # 11 13 17 19 23 29
+ *  Calc.each_prime(2**40, 2**40 + 100).first    #=> Calc::Q(1099511627791)
+ * @see primes
+ * @see count_primes
+ */
+VALUE
+calc_each_prime(int argc, VALUE * argv, VALUE self)
+{
+    VALUE from, to, threads;
+    setup_math_error();
+
+    RETURN_ENUMERATOR(self, argc, argv);
+    rb_scan_args(argc, argv, "21", &from, &to, &threads);
+    sieve_run(SIEVE_EACH, from, to, threads, Qnil, NULL);
+    return Qnil;
+}
+
+/* Returns an array of the primes between two values
+ *
+ * @param from [Integer] lower bound (inclusive)
+ * @param to [Integer] upper bound (inclusive), less than 2^64
+ * @param threads [Integer] (optional) maximum number of native threads to use,
+ *  defaults to Calc.config(:threads)
+ * @return [Array<Calc::Q>]
+ * @raise [Calc::MathError] if from or to isn't an integer, or to >= 2^64
+ * @example
+ *  Calc.primes(10, 30) #=> [Calc::Q(11), Calc::Q(13), Calc::Q(17), Calc::Q(19), Calc::Q(23), Calc::Q(29)]
+ * @see each_prime
+ */
+VALUE
+calc_primes(int argc, VALUE * argv, VALUE self)
+{
+    VALUE from, to, threads, result;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "21", &from, &to, &threads);
+    result = rb_ary_new();
+    sieve_run(SIEVE_ARRAY, from, to, threads, result, NULL);
+    return result;
+}
+
+/* Returns the number of primes between two values
+ *
+ * The primes are counted by the same sieve as Calc.each_prime, with all of
+ * the range split across native threads.
+ *
+ * @param from [Integer] lower bound (inclusive)
+ * @param to [Integer] upper bound (inclusive), less than 2^64
+ * @param threads [Integer] (optional) maximum number of native threads to use,
+ *  defaults to Calc.config(:threads)
+ * @return [Calc::Q]
+ * @raise [Calc::MathError] if from or to isn't an integer, or to >= 2^64
+ * @example
+ *  Calc.count_primes(1, 10**9)               #=> Calc::Q(50847534)
+ *  Calc.count_primes(2**32, 2**32 + 10**6)   #=> Calc::Q(45252)
+ * @see each_prime
+ */
+VALUE
+calc_count_primes(int argc, VALUE * argv, VALUE self)
+{
+    VALUE from, to, threads;
+    uint64_t count = 0;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "21", &from, &to, &threads);
+    sieve_run(SIEVE_COUNT, from, to, threads, Qnil, &count);
+    return wrap_number(utoq((FULL) count));
+}
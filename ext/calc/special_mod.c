@@ -0,0 +1,604 @@
+#include <string.h>
+#include "calc.h"
+
+/* Document-class: Calc::SpecialMod
+ *
+ * Modular arithmetic modulo a number of the form h * 2^n + r.
+ *
+ * Reducing modulo such a number (see Calc.hnrmod) only needs shifts,
+ * additions and a multiplication by h, instead of a long division.  This
+ * covers Mersenne numbers (h = 1, r = -1), Proth numbers (r = 1, h odd and
+ * less than 2^n), and Fermat and generalised Fermat numbers with a power of
+ * two base (h = 1, r = 1).  A context checks and keeps h, n and r once, and
+ * its methods repeat the reduction after every multiplication, so powers with
+ * large exponents avoid both the division and the setup that Calc::Q#pmod
+ * does on each call.
+ *
+ * #lucas_lehmer? and #proth? are primality tests for Mersenne and Proth
+ * numbers built on the same arithmetic.
+ *
+ * @example
+ *  m127 = Calc::SpecialMod.new(1, 127, -1)
+ *  m127.pow(3, m127.modulus - 1)  #=> Calc::Q(1)
+ *  m127.lucas_lehmer?             #=> true
+ *  Calc::SpecialMod.new(3, 189, 1).proth?  #=> true
+ */
+VALUE cSpecialMod;
+
+typedef struct {
+    NUMBER *h, *n, *r;          /* NULL until initialized */
+    NUMBER *modulus;
+} calc_specialmod;
+
+static void
+sm_free(void *p)
+{
+    calc_specialmod *c = p;
+
+    if (c->modulus) {
+        qfree(c->h);
+        qfree(c->n);
+        qfree(c->r);
+        qfree(c->modulus);
+    }
+    xfree(p);
+}
+
+static size_t
+sm_memsize(const void *p)
+{
+    const calc_specialmod *c = p;
+
+    if (!c->modulus) {
+        return sizeof(calc_specialmod);
+    }
+    return sizeof(calc_specialmod) + (c->h->num.len + c->modulus->num.len) * sizeof(HALF);
+}
+
+const rb_data_type_t calc_special_mod_type = {
+    "Calc::SpecialMod",
+    {0, sm_free, sm_memsize},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY   /* flags is in 2.1+ */
+#endif
+};
+
+/* sm_pow_body uses fixed windows of this many bits, with a table of the
+ * base's powers up to 2^SM_WINDOW - 1 */
+#define SM_WINDOW 4
+
+/* state of a long computation, freed by sm_cleanup even if ruby interrupts
+ * it */
+typedef struct {
+    calc_specialmod *c;
+    VALUE (*body) (VALUE);
+    VALUE arg;                  /* ruby argument for base, or Qnil */
+    const char *name;           /* method name, for errors converting arg */
+    ZVALUE base;                /* arg, 0 <= base < modulus */
+    NUMBER *qe;                 /* exponent, or NULL */
+    ZVALUE e;                   /* qe->num, or set by body (not owned) */
+    ZVALUE acc;                 /* working value */
+    ZVALUE result;              /* acc, once body has finished */
+    ZVALUE table[1 << SM_WINDOW];
+} sm_state;
+
+/*****************************************************************************
+ * arithmetic                                                                *
+ *****************************************************************************/
+
+static calc_specialmod *
+get_special_mod(VALUE self)
+{
+    calc_specialmod *c = rb_check_typeddata(self, &calc_special_mod_type);
+
+    if (!c->modulus) {
+        rb_raise(rb_eArgError, "uninitialized SpecialMod");
+    }
+    return c;
+}
+
+/* res = v mod (h 2^n + r), 0 <= res < modulus */
+static void
+sm_reduce(calc_specialmod * c, ZVALUE v, ZVALUE * res)
+{
+    ZVALUE t;
+
+    if (!zisneg(v)) {
+        zhnrmod(v, c->h->num, c->n->num, c->r->num, res);
+        return;
+    }
+    v.sign = 0;
+    zhnrmod(v, c->h->num, c->n->num, c->r->num, &t);
+    if (ziszero(t)) {
+        *res = t;
+    }
+    else {
+        zsub(c->modulus->num, t, res);
+        zfree(t);
+    }
+}
+
+/* *acc = *acc * b mod modulus (b = *acc squares it) */
+static void
+sm_mul_into(calc_specialmod * c, ZVALUE * acc, ZVALUE b)
+{
+    ZVALUE t;
+
+    if (acc->v == b.v) {
+        zsquare(*acc, &t);
+    }
+    else {
+        zmul(*acc, b, &t);
+    }
+    zfree(*acc);
+    sm_reduce(c, t, acc);
+    zfree(t);
+}
+
+static VALUE
+sm_cleanup(VALUE arg)
+{
+    sm_state *s = (sm_state *) arg;
+    int i;
+
+    if (s->base.v)
+        zfree(s->base);
+    if (s->qe)
+        qfree(s->qe);
+    if (s->acc.v)
+        zfree(s->acc);
+    for (i = 0; i < (1 << SM_WINDOW); i++) {
+        if (s->table[i].v)
+            zfree(s->table[i]);
+    }
+    return Qnil;
+}
+
+#define EBIT(e, i) (((e).v[(i) / BASEB] >> ((i) % BASEB)) & 1)
+
+/* s->acc = s->base ^ s->e, with fixed windows of SM_WINDOW bits */
+static VALUE
+sm_pow_body(VALUE arg)
+{
+    sm_state *s = (sm_state *) arg;
+    long i, j, bits;
+    int k, w;
+
+    itoz(1, &s->acc);
+    if (ziszero(s->e)) {
+        return Qnil;
+    }
+    bits = zhighbit(s->e) + 1;
+
+    /* short exponents don't pay for the table */
+    w = bits < 64 ? 1 : SM_WINDOW;
+    zcopy(s->base, &s->table[1]);
+    for (k = 2; k < (1 << w); k++) {
+        zcopy(s->table[k - 1], &s->table[k]);
+        sm_mul_into(s->c, &s->table[k], s->base);
+    }
+
+    /* the top window may be short */
+    i = bits - 1 - (bits - 1) % w;
+    for (; i >= 0; i -= w) {
+        for (j = 0; j < w && !zisone(s->acc); j++) {
+            sm_mul_into(s->c, &s->acc, s->acc);
+        }
+        for (k = 0, j = w - 1; j >= 0; j--) {
+            k = (k << 1) | (i + j < bits ? (int) EBIT(s->e, i + j) : 0);
+        }
+        if (k) {
+            sm_mul_into(s->c, &s->acc, s->table[k]);
+        }
+        rb_thread_check_ints();
+    }
+    return Qnil;
+}
+
+/* lucas-lehmer: s->acc = s_(n-2), where s_0 = 4 and s_k = s_(k-1)^2 - 2 */
+static VALUE
+sm_lucas_lehmer_body(VALUE arg)
+{
+    sm_state *s = (sm_state *) arg;
+    ZVALUE t, u;
+    long i, n = qtoi(s->c->n);
+
+    itoz(4, &s->acc);
+    for (i = 0; i < n - 2; i++) {
+        zsquare(s->acc, &t);
+        zsub(t, _two_, &u);
+        zfree(t);
+        zfree(s->acc);
+        sm_reduce(s->c, u, &s->acc);
+        zfree(u);
+        if ((i & 63) == 63) {
+            rb_thread_check_ints();
+        }
+    }
+    return Qnil;
+}
+
+/* proth: s->acc = s->base ^ (h 2^(n-1)), by way of base^h */
+static VALUE
+sm_proth_body(VALUE arg)
+{
+    sm_state *s = (sm_state *) arg;
+    long i, n = qtoi(s->c->n);
+
+    s->e = s->c->h->num;
+    sm_pow_body(arg);
+    for (i = 0; i < n - 1; i++) {
+        sm_mul_into(s->c, &s->acc, s->acc);
+        if ((i & 63) == 63) {
+            rb_thread_check_ints();
+        }
+    }
+    return Qnil;
+}
+
+/* returns x (an integer) reduced mod the modulus, owned by the caller */
+static void
+sm_arg(calc_specialmod * c, VALUE x, const char *name, ZVALUE * res)
+{
+    NUMBER *q;
+
+    q = value_to_number(x, 0);
+    if (qisfrac(q)) {
+        qfree(q);
+        rb_raise(e_MathError, "non-integer argument for SpecialMod#%s", name);
+    }
+    if (!qisneg(q) && zrel(q->num, c->modulus->num) < 0) {
+        zcopy(q->num, res);
+    }
+    else {
+        sm_reduce(c, q->num, res);
+    }
+    qfree(q);
+}
+
+static VALUE
+sm_run_body(VALUE arg)
+{
+    sm_state *s = (sm_state *) arg;
+
+    if (!NIL_P(s->arg)) {
+        sm_arg(s->c, s->arg, s->name, &s->base);
+    }
+    s->body(arg);
+    s->result = s->acc;
+    s->acc.v = NULL;
+    return Qnil;
+}
+
+/* runs body with a fresh state for c, returning the final acc (owned by the
+ * caller).  base is converted from arg (unless nil) with sm_arg inside the
+ * ensure, and qe (which may be NULL) is owned by the state from here on, so
+ * nothing leaks if either raises or ruby interrupts body. */
+static ZVALUE
+sm_run(calc_specialmod * c, VALUE (*body) (VALUE), VALUE arg, const char *name, NUMBER * qe)
+{
+    sm_state s;
+
+    memset(&s, 0, sizeof(s));
+    s.c = c;
+    s.body = body;
+    s.arg = arg;
+    s.name = name;
+    s.qe = qe;
+    s.e = qe ? qe->num : _zero_;
+    rb_ensure(sm_run_body, (VALUE) & s, sm_cleanup, (VALUE) & s);
+    return s.result;
+}
+
+static VALUE
+wrap_zvalue(ZVALUE z)
+{
+    NUMBER *q;
+
+    if (ziszero(z)) {
+        zfree(z);
+        return wrap_number(qlink(&_qzero_));
+    }
+    q = qalloc();
+    q->num = z;
+    return wrap_number(q);
+}
+
+/*****************************************************************************
+ * Calc::SpecialMod                                                          *
+ *****************************************************************************/
+
+static VALUE
+sm_alloc(VALUE klass)
+{
+    calc_specialmod *c;
+
+    return TypedData_Make_Struct(klass, calc_specialmod, &calc_special_mod_type, c);
+}
+
+/* Creates a context for arithmetic modulo h * 2^n + r
+ *
+ * The arguments have the same meaning and restrictions as for Calc.hnrmod.
+ *
+ * @param h [Integer] integer > 0
+ * @param n [Integer] integer > 0 and < 2^31
+ * @param r [Integer] -1, 0 or 1
+ * @return [Calc::SpecialMod]
+ * @raise [Calc::MathError] if any argument is out of range, or the modulus
+ *  would be 1
+ * @example
+ *  Calc::SpecialMod.new(1, 127, -1)  #=> Calc::SpecialMod(2^127-1)
+ *  Calc::SpecialMod.new(3, 189, 1)   #=> Calc::SpecialMod(3*2^189+1)
+ */
+static VALUE
+sm_initialize(VALUE self, VALUE h, VALUE n, VALUE r)
+{
+    calc_specialmod *c;
+    NUMBER *qh, *qn, *qr, *qm, *t;
+    setup_math_error();
+
+    c = rb_check_typeddata(self, &calc_special_mod_type);
+    if (c->modulus) {
+        rb_raise(rb_eArgError, "SpecialMod already initialized");
+    }
+    qh = value_to_number(h, 0);
+    if (qisfrac(qh) || qisneg(qh) || qiszero(qh)) {
+        qfree(qh);
+        rb_raise(e_MathError, "1st arg of SpecialMod (h) must be an integer > 0");
+    }
+    qn = value_to_number(n, 0);
+    if (qisfrac(qn) || qisneg(qn) || qiszero(qn) || zge31b(qn->num)) {
+        qfree(qh);
+        qfree(qn);
+        rb_raise(e_MathError, "2nd arg of SpecialMod (n) must be an integer > 0 and < 2^31");
+    }
+    qr = value_to_number(r, 0);
+    if (qisfrac(qr) || !zisabsleone(qr->num)) {
+        qfree(qh);
+        qfree(qn);
+        qfree(qr);
+        rb_raise(e_MathError, "3rd arg of SpecialMod (r) must be -1, 0 or 1");
+    }
+    t = qalloc();
+    zshift(qh->num, qtoi(qn), &t->num);
+    qm = qqadd(t, qr);
+    qfree(t);
+    if (qisone(qm)) {
+        qfree(qh);
+        qfree(qn);
+        qfree(qr);
+        qfree(qm);
+        rb_raise(e_MathError, "SpecialMod modulus must be greater than 1");
+    }
+    c->h = qh;
+    c->n = qn;
+    c->r = qr;
+    c->modulus = qm;
+    return self;
+}
+
+/* Returns h
+ *
+ * @return [Calc::Q]
+ */
+static VALUE
+sm_h(VALUE self)
+{
+    return wrap_number(qlink(get_special_mod(self)->h));
+}
+
+/* Returns n
+ *
+ * @return [Calc::Q]
+ */
+static VALUE
+sm_n(VALUE self)
+{
+    return wrap_number(qlink(get_special_mod(self)->n));
+}
+
+/* Returns r
+ *
+ * @return [Calc::Q]
+ */
+static VALUE
+sm_r(VALUE self)
+{
+    return wrap_number(qlink(get_special_mod(self)->r));
+}
+
+/* Returns the modulus h * 2^n + r
+ *
+ * @return [Calc::Q]
+ * @example
+ *  Calc::SpecialMod.new(3, 4, 1).modulus  #=> Calc::Q(49)
+ */
+static VALUE
+sm_modulus(VALUE self)
+{
+    return wrap_number(qlink(get_special_mod(self)->modulus));
+}
+
+/* Reduces an integer modulo h * 2^n + r
+ *
+ * Unlike Calc.hnrmod, negative values are allowed.
+ *
+ * @param v [Integer,Calc::Q]
+ * @return [Calc::Q] 0 <= result < modulus
+ * @raise [Calc::MathError] if v is not an integer
+ * @example
+ *  Calc::SpecialMod.new(1, 5, -1).mod(100)  #=> Calc::Q(7)
+ *  Calc::SpecialMod.new(1, 5, -1).mod(-1)   #=> Calc::Q(30)
+ */
+static VALUE
+sm_mod(VALUE self, VALUE v)
+{
+    calc_specialmod *c;
+    ZVALUE z;
+    setup_math_error();
+
+    c = get_special_mod(self);
+    sm_arg(c, v, "mod", &z);
+    return wrap_zvalue(z);
+}
+
+/* Modular multiplication
+ *
+ * @param a [Integer,Calc::Q]
+ * @param b [Integer,Calc::Q]
+ * @return [Calc::Q] a * b mod (h * 2^n + r)
+ * @raise [Calc::MathError] if a or b is not an integer
+ * @example
+ *  Calc::SpecialMod.new(1, 5, -1).mul(6, 7)  #=> Calc::Q(11)
+ */
+static VALUE
+sm_mul(VALUE self, VALUE a, VALUE b)
+{
+    calc_specialmod *c;
+    ZVALUE za, zb;
+    setup_math_error();
+
+    c = get_special_mod(self);
+    sm_arg(c, a, "mul", &za);
+    sm_arg(c, b, "mul", &zb);
+    sm_mul_into(c, &za, zb);
+    zfree(zb);
+    return wrap_zvalue(za);
+}
+
+/* Modular exponentiation
+ *
+ * Equivalent to `Calc::Q(a).pmod(e, modulus)`.
+ *
+ * @param a [Integer,Calc::Q]
+ * @param e [Integer,Calc::Q] exponent >= 0
+ * @return [Calc::Q] a ** e mod (h * 2^n + r)
+ * @raise [Calc::MathError] if a or e is not an integer, or e is negative
+ * @example
+ *  Calc::SpecialMod.new(1, 127, -1).pow(3, 2**127 - 2)  #=> Calc::Q(1)
+ */
+static VALUE
+sm_pow(VALUE self, VALUE a, VALUE e)
+{
+    calc_specialmod *c;
+    NUMBER *qe;
+    ZVALUE result;
+    setup_math_error();
+
+    c = get_special_mod(self);
+    qe = value_to_number(e, 0);
+    if (qisfrac(qe) || qisneg(qe)) {
+        qfree(qe);
+        rb_raise(e_MathError, "exponent for SpecialMod#pow must be an integer >= 0");
+    }
+    result = sm_run(c, sm_pow_body, a, "pow", qe);
+    return wrap_zvalue(result);
+}
+
+/* Lucas-Lehmer test of a Mersenne number 2^n - 1
+ *
+ * Deterministic: the result is exact.  Needs n - 2 modular squarings, so
+ * this is practical for n up to some tens of thousands.
+ *
+ * @return [Boolean] true if 2^n - 1 is prime
+ * @raise [Calc::MathError] unless h = 1 and r = -1
+ * @example
+ *  Calc::SpecialMod.new(1, 521, -1).lucas_lehmer?  #=> true
+ *  Calc::SpecialMod.new(1, 523, -1).lucas_lehmer?  #=> false
+ */
+static VALUE
+sm_lucas_lehmer_p(VALUE self)
+{
+    calc_specialmod *c;
+    ZVALUE result;
+    long n, d;
+    BOOL prime;
+    setup_math_error();
+
+    c = get_special_mod(self);
+    if (!qisone(c->h) || !qisnegone(c->r)) {
+        rb_raise(e_MathError, "lucas_lehmer? needs a modulus of the form 2^n - 1");
+    }
+    n = qtoi(c->n);
+    if (n == 2) {
+        return Qtrue;
+    }
+    /* 2^n - 1 is divisible by 2^d - 1 for every divisor d of n */
+    for (d = 2; d * d <= n; d++) {
+        if (n % d == 0) {
+            return Qfalse;
+        }
+    }
+    result = sm_run(c, sm_lucas_lehmer_body, Qnil, "lucas_lehmer?", NULL);
+    prime = ziszero(result);
+    zfree(result);
+    return prime ? Qtrue : Qfalse;
+}
+
+/* Proth's test of a number h * 2^n + 1 (h odd, h < 2^n)
+ *
+ * Deterministic: finds the least a > 1 with jacobi(a, N) = -1 and checks
+ * whether a^((N - 1) / 2) = -1 mod N.  For h = 1 this is Pepin's test of a
+ * Fermat number (a = 3).
+ *
+ * @return [Boolean] true if h * 2^n + 1 is prime
+ * @raise [Calc::MathError] unless r = 1 and h is odd and less than 2^n
+ * @example
+ *  Calc::SpecialMod.new(3, 189, 1).proth?  #=> true
+ *  Calc::SpecialMod.new(1, 32, 1).proth?   #=> false
+ */
+static VALUE
+sm_proth_p(VALUE self)
+{
+    calc_specialmod *c;
+    ZVALUE a, result, nm1;
+    long i;
+    FLAG j;
+    BOOL prime;
+    setup_math_error();
+
+    c = get_special_mod(self);
+    if (!qisone(c->r) || qiseven(c->h) || zhighbit(c->h->num) >= qtoi(c->n)) {
+        rb_raise(e_MathError, "proth? needs a modulus h * 2^n + 1 with h odd and less than 2^n");
+    }
+    /* there is no quadratic non-residue modulo a square */
+    if (zissquare(c->modulus->num)) {
+        return Qfalse;
+    }
+    for (i = 2;; i++) {
+        itoz(i, &a);
+        j = zjacobi(a, c->modulus->num);
+        zfree(a);
+        if (j == -1) {
+            break;
+        }
+        if (j == 0) {
+            /* i is less than the modulus, which has a factor in common */
+            return Qfalse;
+        }
+    }
+    result = sm_run(c, sm_proth_body, LONG2NUM(i), "proth?", NULL);
+    zsub(c->modulus->num, _one_, &nm1);
+    prime = !zcmp(result, nm1);
+    zfree(nm1);
+    zfree(result);
+    return prime ? Qtrue : Qfalse;
+}
+
+void
+define_calc_special_mod(VALUE m)
+{
+    cSpecialMod = rb_define_class_under(m, "SpecialMod", rb_cObject);
+    rb_define_alloc_func(cSpecialMod, sm_alloc);
+    rb_define_method(cSpecialMod, "initialize", sm_initialize, 3);
+    rb_define_method(cSpecialMod, "h", sm_h, 0);
+    rb_define_method(cSpecialMod, "lucas_lehmer?", sm_lucas_lehmer_p, 0);
+    rb_define_method(cSpecialMod, "mod", sm_mod, 1);
+    rb_define_method(cSpecialMod, "modulus", sm_modulus, 0);
+    rb_define_method(cSpecialMod, "mul", sm_mul, 2);
+    rb_define_method(cSpecialMod, "n", sm_n, 0);
+    rb_define_method(cSpecialMod, "pow", sm_pow, 2);
+    rb_define_method(cSpecialMod, "proth?", sm_proth_p, 0);
+    rb_define_method(cSpecialMod, "r", sm_r, 0);
+}
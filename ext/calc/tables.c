@@ -0,0 +1,713 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "calc.h"
+
+/* tables of bernoulli and euler numbers which can be saved to a file and
+ * loaded back.
+ *
+ * libcalc keeps its own tables of the numbers qbern and qeuler have computed,
+ * but there is no way to get at them.  so Calc::Q#bernoulli and #euler look
+ * up their index here first, and only compute those not found (see
+ * bernoulli.c for large bernoulli numbers).
+ * results are stored in a table indexed by the (non-negative) index.
+ *
+ * Calc.export_bernoulli / export_euler write a table to a file and
+ * Calc.load_bernoulli / load_euler map it read-only (with mmap where
+ * available), so processes forked after loading share the same pages instead
+ * of each computing the same numbers.  values are copied out of the mapping
+ * when looked up, so the mapping can be replaced or removed at any time.
+ *
+ * the file format is native endian (files aren't portable between machines
+ * with different byte order or libcalc HALF size, which load checks):
+ *   header (table_header)
+ *   uint64 offsets[count], the file offset of each entry or 0 if missing
+ *   entries, each 8 byte aligned: table_entry followed by the HALFs of the
+ *   numerator then the denominator
+ *
+ * everything runs with the GVL held, like the rest of libcalc.
+ */
+
+#define TABLE_MAGIC "RCALCTB"
+#define TABLE_VERSION 1
+
+/* indexes at or above this are computed but not stored */
+#define TABLE_MAX_INDEX (1L << 20)
+
+typedef struct {
+    char magic[8];              /* TABLE_MAGIC, nul terminated */
+    uint32_t version;
+    uint32_t kind;              /* TABLE_BERNOULLI or TABLE_EULER */
+    uint32_t half_bits;         /* bits in a HALF */
+    uint32_t reserved;
+    uint64_t count;             /* indexes 0 .. count-1 */
+} table_header;
+
+typedef struct {
+    int32_t num_len;            /* in HALFs */
+    int32_t num_sign;
+    int32_t den_len;
+    int32_t reserved;
+} table_entry;
+
+enum { TABLE_BERNOULLI = 1, TABLE_EULER = 2 };
+
+typedef struct {
+    const char *name;
+    uint32_t kind;
+    NUMBER *(*compute) (ZVALUE z);      /* bernoulli_number or qeuler */
+    NUMBER **values;            /* values[i] is the number with index i, or NULL */
+    long size;                  /* allocated length of values */
+    long entries;               /* non-NULL values */
+    long bytes;                 /* memory held by values */
+    char *map;                  /* loaded file, or NULL */
+    size_t map_len;
+    BOOL mapped;                /* map is from mmap rather than malloc */
+    const uint64_t *offsets;    /* into map */
+    long map_count;
+    long map_entries;           /* non-zero offsets */
+} number_table;
+
+static number_table bernoulli_table = { "bernoulli", TABLE_BERNOULLI, bernoulli_number };
+static number_table euler_table = { "euler", TABLE_EULER, qeuler };
+
+/* rounds n up to a multiple of 8 */
+static size_t
+align8(size_t n)
+{
+    return (n + 7) & ~(size_t) 7;
+}
+
+/* bytes held by a stored number */
+static long
+number_bytes(NUMBER * q)
+{
+    return (long) (sizeof(NUMBER) + (q->num.len + q->den.len) * sizeof(HALF));
+}
+
+/* bytes used by a number in the file */
+static size_t
+entry_bytes(NUMBER * q)
+{
+    return align8(sizeof(table_entry) + (q->num.len + q->den.len) * sizeof(HALF));
+}
+
+/* copies len HALFs from the mapping into z */
+static void
+copy_zvalue(const HALF * src, int32_t len, int32_t sign, ZVALUE * z)
+{
+    z->v = alloc((LEN) len);
+    memcpy(z->v, src, len * sizeof(HALF));
+    z->len = (LEN) len;
+    z->sign = (BOOL) sign;
+}
+
+/* returns the number with index i from the loaded file, or NULL */
+static NUMBER *
+mapped_number(number_table * t, long i)
+{
+    const table_entry *e;
+    const HALF *h;
+    NUMBER *q;
+
+    if (i >= t->map_count || !t->offsets[i]) {
+        return NULL;
+    }
+    e = (const table_entry *) (t->map + t->offsets[i]);
+    h = (const HALF *) (e + 1);
+    q = qalloc();
+    copy_zvalue(h, e->num_len, e->num_sign, &q->num);
+    copy_zvalue(h + e->num_len, e->den_len, 0, &q->den);
+    return q;
+}
+
+/* stores a link to q as index i */
+static void
+table_store(number_table * t, long i, NUMBER * q)
+{
+    long size;
+
+    if (i >= t->size) {
+        size = t->size ? t->size : 64;
+        while (size <= i) {
+            size *= 2;
+        }
+        REALLOC_N(t->values, NUMBER *, size);
+        memset(t->values + t->size, 0, (size - t->size) * sizeof(NUMBER *));
+        t->size = size;
+    }
+    t->values[i] = qlink(q);
+    t->entries++;
+    t->bytes += number_bytes(q);
+}
+
+/* returns the number with index i (>= 0) if stored or loaded, otherwise NULL */
+static NUMBER *
+table_find(number_table * t, long i)
+{
+    if (i < t->size && t->values[i]) {
+        return qlink(t->values[i]);
+    }
+    return mapped_number(t, i);
+}
+
+/* returns the number with index z, or NULL if libcalc can't compute it */
+static NUMBER *
+table_lookup(number_table * t, ZVALUE z)
+{
+    NUMBER *q;
+    long i;
+
+    if (zisneg(z) || zge31b(z) || ztoi(z) >= TABLE_MAX_INDEX) {
+        return t->compute(z);
+    }
+    i = ztoi(z);
+    q = table_find(t, i);
+    if (q) {
+        return q;
+    }
+    q = t->compute(z);
+    if (q) {
+        table_store(t, i, q);
+    }
+    return q;
+}
+
+/* removes the loaded file (if any) */
+static void
+table_unmap(number_table * t)
+{
+    if (!t->map) {
+        return;
+    }
+#ifdef HAVE_SYS_MMAN_H
+    if (t->mapped) {
+        munmap(t->map, t->map_len);
+    }
+    else
+#endif
+    {
+        xfree(t->map);
+    }
+    t->map = NULL;
+    t->map_len = 0;
+    t->mapped = FALSE;
+    t->offsets = NULL;
+    t->map_count = t->map_entries = 0;
+}
+
+/* removes all stored and loaded values */
+static void
+table_free(number_table * t)
+{
+    long i;
+
+    for (i = 0; i < t->size; i++) {
+        if (t->values[i]) {
+            qfree(t->values[i]);
+        }
+    }
+    xfree(t->values);
+    t->values = NULL;
+    t->size = t->entries = t->bytes = 0;
+    table_unmap(t);
+}
+
+void
+table_free_bernoulli(void)
+{
+    table_free(&bernoulli_table);
+}
+
+void
+table_free_euler(void)
+{
+    table_free(&euler_table);
+}
+
+NUMBER *
+table_bernoulli(ZVALUE z)
+{
+    return table_lookup(&bernoulli_table, z);
+}
+
+/* returns the bernoulli number with index i (>= 0) if stored or loaded,
+ * otherwise NULL */
+NUMBER *
+table_bernoulli_stored(long i)
+{
+    return table_find(&bernoulli_table, i);
+}
+
+/* stores a link to q as the bernoulli number with index i (>= 0, and not
+ * already stored) */
+void
+table_bernoulli_store(long i, NUMBER * q)
+{
+    if (i < TABLE_MAX_INDEX) {
+        table_store(&bernoulli_table, i, q);
+    }
+}
+
+NUMBER *
+table_euler(ZVALUE z)
+{
+    return table_lookup(&euler_table, z);
+}
+
+/* highest index available, or -1 if none */
+static long
+table_highest(number_table * t)
+{
+    long i;
+
+    for (i = (t->size > t->map_count ? t->size : t->map_count) - 1; i >= 0; i--) {
+        if ((i < t->size && t->values[i]) || (i < t->map_count && t->offsets[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* number of indexes available, stored or loaded */
+static long
+table_count(number_table * t)
+{
+    long i, n;
+
+    if (!t->map) {
+        return t->entries;
+    }
+    n = t->map_entries;
+    for (i = 0; i < t->size; i++) {
+        if (t->values[i] && !(i < t->map_count && t->offsets[i])) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/* raises an error about path with the message and (if set) errno */
+static void
+table_error(number_table * t, VALUE path, const char *message)
+{
+    if (errno) {
+        rb_sys_fail_str(path);
+    }
+    rb_raise(rb_eArgError, "%s: %s %s table", StringValueCStr(path), message, t->name);
+}
+
+/* writes size bytes to f; returns FALSE on failure */
+static BOOL
+write_bytes(FILE * f, const void *p, size_t size)
+{
+    return !size || fwrite(p, 1, size, f) == size;
+}
+
+/* state of table_export, freed by export_cleanup even if a lookup raises */
+typedef struct {
+    number_table *t;
+    VALUE path;
+    long count;
+    NUMBER **values;            /* count values (NULL where missing) */
+    uint64_t *offsets;
+    long written;
+} export_state;
+
+static VALUE
+export_cleanup(VALUE arg)
+{
+    export_state *s = (export_state *) arg;
+    long i;
+
+    if (s->values) {
+        for (i = 0; i < s->count; i++) {
+            if (s->values[i])
+                qfree(s->values[i]);
+        }
+        xfree(s->values);
+    }
+    if (s->offsets)
+        xfree(s->offsets);
+    return Qnil;
+}
+
+static VALUE
+export_body(VALUE arg)
+{
+    export_state *s = (export_state *) arg;
+    number_table *t = s->t;
+    table_header header;
+    table_entry entry;
+    NUMBER *q;
+    uint64_t offset;
+    static const char zeros[8];
+    size_t n;
+    ZVALUE z;
+    FILE *f;
+    long count = s->count, i;
+    BOOL ok;
+
+    /* compute (or copy out of a loaded file) all the values first, so that
+     * nothing can fail once the file is being written */
+    s->values = ALLOC_N(NUMBER *, count ? count : 1);
+    MEMZERO(s->values, NUMBER *, count ? count : 1);
+    s->offsets = ALLOC_N(uint64_t, count ? count : 1);
+    offset = align8(sizeof(header) + count * sizeof(uint64_t));
+    for (i = 0; i < count; i++) {
+        itoz(i, &z);
+        s->values[i] = table_lookup(t, z);
+        zfree(z);
+        if (s->values[i]) {
+            s->offsets[i] = offset;
+            offset += entry_bytes(s->values[i]);
+            s->written++;
+        }
+        else {
+            s->offsets[i] = 0;
+        }
+    }
+
+    errno = 0;
+    f = fopen(StringValueCStr(s->path), "wb");
+    ok = f != NULL;
+    if (ok) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC));
+        header.version = TABLE_VERSION;
+        header.kind = t->kind;
+        header.half_bits = (uint32_t) (sizeof(HALF) * 8);
+        header.count = (uint64_t) count;
+        n = sizeof(header) + count * sizeof(uint64_t);
+        ok = write_bytes(f, &header, sizeof(header))
+            && write_bytes(f, s->offsets, count * sizeof(uint64_t))
+            && write_bytes(f, zeros, align8(n) - n);
+    }
+    for (i = 0; ok && i < count; i++) {
+        q = s->values[i];
+        if (!q) {
+            continue;
+        }
+        memset(&entry, 0, sizeof(entry));
+        entry.num_len = (int32_t) q->num.len;
+        entry.num_sign = (int32_t) q->num.sign;
+        entry.den_len = (int32_t) q->den.len;
+        n = sizeof(entry) + (q->num.len + q->den.len) * sizeof(HALF);
+        ok = write_bytes(f, &entry, sizeof(entry))
+            && write_bytes(f, q->num.v, q->num.len * sizeof(HALF))
+            && write_bytes(f, q->den.v, q->den.len * sizeof(HALF))
+            && write_bytes(f, zeros, align8(n) - n);
+    }
+    if (!f) {
+        table_error(t, s->path, "can't create");
+    }
+    if (fclose(f) != 0 || !ok) {
+        table_error(t, s->path, "can't write");
+    }
+    return Qnil;
+}
+
+/* writes indexes 0 .. max (computing any which are missing) to path; returns
+ * the number of entries written */
+static long
+table_export(number_table * t, VALUE path, VALUE max)
+{
+    export_state s;
+    long count;
+
+    count = (NIL_P(max) ? table_highest(t) : NUM2LONG(max)) + 1;
+    if (count < 0 || count > TABLE_MAX_INDEX) {
+        rb_raise(rb_eArgError, "index out of range for %s table", t->name);
+    }
+    memset(&s, 0, sizeof(s));
+    s.t = t;
+    s.path = path;
+    s.count = count;
+    rb_ensure(export_body, (VALUE) & s, export_cleanup, (VALUE) & s);
+    return s.written;
+}
+
+/* checks that the len bytes at map are a valid table of kind t; returns the
+ * number of entries, or -1 if invalid */
+static long
+table_validate(number_table * t, const char *map, size_t len)
+{
+    const table_header *header;
+    const uint64_t *offsets;
+    const table_entry *e;
+    uint64_t count, i, end;
+    long entries;
+
+    header = (const table_header *) map;
+    if (len < sizeof(*header) || memcmp(header->magic, TABLE_MAGIC, sizeof(TABLE_MAGIC))
+        || header->version != TABLE_VERSION || header->kind != t->kind
+        || header->half_bits != sizeof(HALF) * 8) {
+        return -1;
+    }
+    count = header->count;
+    if (count > TABLE_MAX_INDEX || sizeof(*header) + count * sizeof(uint64_t) > len) {
+        return -1;
+    }
+    offsets = (const uint64_t *) (header + 1);
+    entries = 0;
+    for (i = 0; i < count; i++) {
+        if (!offsets[i]) {
+            continue;
+        }
+        if (offsets[i] & 7 || offsets[i] < sizeof(*header) + count * sizeof(uint64_t)
+            || offsets[i] > len - sizeof(*e)) {
+            return -1;
+        }
+        e = (const table_entry *) (map + offsets[i]);
+        if (e->num_len < 1 || e->den_len < 1 || (e->num_sign != 0 && e->num_sign != 1)) {
+            return -1;
+        }
+        end = offsets[i] + sizeof(*e) + ((uint64_t) e->num_len + e->den_len) * sizeof(HALF);
+        if (end > len) {
+            return -1;
+        }
+        entries++;
+    }
+    return entries;
+}
+
+/* replaces the loaded file (if any) with the one at path; returns the number
+ * of entries in it */
+static long
+table_load(number_table * t, VALUE path)
+{
+    char *map;
+    size_t len;
+    long entries;
+    BOOL mapped;
+#ifdef HAVE_SYS_MMAN_H
+    struct stat st;
+    int fd;
+#else
+    FILE *f;
+    long size;
+#endif
+
+    errno = 0;
+#ifdef HAVE_SYS_MMAN_H
+    fd = open(StringValueCStr(path), O_RDONLY);
+    if (fd < 0) {
+        table_error(t, path, "can't open");
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        table_error(t, path, "can't open");
+    }
+    len = (size_t) st.st_size;
+    if (len < sizeof(table_header)) {
+        close(fd);
+        table_error(t, path, "not a");
+    }
+    map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        table_error(t, path, "can't map");
+    }
+    mapped = TRUE;
+#else
+    f = fopen(StringValueCStr(path), "rb");
+    if (!f) {
+        table_error(t, path, "can't open");
+    }
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        table_error(t, path, "can't read");
+    }
+    len = (size_t) size;
+    map = ALLOC_N(char, len ? len : 1);
+    if (fread(map, 1, len, f) != len) {
+        xfree(map);
+        fclose(f);
+        table_error(t, path, "can't read");
+    }
+    fclose(f);
+    mapped = FALSE;
+#endif
+
+    errno = 0;
+    entries = table_validate(t, map, len);
+    if (entries < 0) {
+#ifdef HAVE_SYS_MMAN_H
+        munmap(map, len);
+#else
+        xfree(map);
+#endif
+        table_error(t, path, "not a");
+    }
+    table_unmap(t);
+    t->map = map;
+    t->map_len = len;
+    t->mapped = mapped;
+    t->offsets = (const uint64_t *) (map + sizeof(table_header));
+    t->map_count = (long) ((const table_header *) map)->count;
+    t->map_entries = entries;
+    return entries;
+}
+
+/* returns a hash of statistics for t */
+static VALUE
+table_stats(number_table * t)
+{
+    VALUE result;
+
+    result = rb_hash_new();
+    rb_hash_aset(result, ID2SYM(rb_intern("entries")), LONG2NUM(table_count(t)));
+    rb_hash_aset(result, ID2SYM(rb_intern("highest")), LONG2NUM(table_highest(t)));
+    rb_hash_aset(result, ID2SYM(rb_intern("bytes")), LONG2NUM(t->bytes));
+    rb_hash_aset(result, ID2SYM(rb_intern("mapped_bytes")), SIZET2NUM(t->map_len));
+    return result;
+}
+
+/* Returns the memory (in bytes) used by bernoulli numbers stored by
+ * Calc::Q#bernoulli, not including those in a file loaded by
+ * Calc.load_bernoulli.
+ *
+ * libcalc keeps another copy of the numbers it has computed, which isn't
+ * counted.
+ *
+ * @return [Integer]
+ * @example
+ *  Calc::Q(100).bernoulli
+ *  Calc.bernoulli_cache_size #=> 10768
+ * @see bernoulli_cache_stats
+ */
+VALUE
+calc_bernoulli_cache_size(VALUE self)
+{
+    return LONG2NUM(bernoulli_table.bytes);
+}
+
+/* Returns statistics about the stored bernoulli numbers
+ *
+ * :entries is the number of indexes which can be looked up without
+ * computing them, :highest the highest of these (or -1 if there are none),
+ * :bytes the memory used by numbers stored after being computed (see
+ * bernoulli_cache_size) and :mapped_bytes the size of the file loaded by
+ * Calc.load_bernoulli (or 0).
+ *
+ * @return [Hash]
+ * @example
+ *  Calc::Q(100).bernoulli
+ *  Calc.bernoulli_cache_stats #=> {:entries=>1, :highest=>100, :bytes=>112, :mapped_bytes=>0}
+ */
+VALUE
+calc_bernoulli_cache_stats(VALUE self)
+{
+    return table_stats(&bernoulli_table);
+}
+
+/* Returns the memory (in bytes) used by euler numbers stored by
+ * Calc::Q#euler, not including those in a file loaded by Calc.load_euler.
+ *
+ * @return [Integer]
+ * @see bernoulli_cache_size
+ */
+VALUE
+calc_euler_cache_size(VALUE self)
+{
+    return LONG2NUM(euler_table.bytes);
+}
+
+/* Returns statistics about the stored euler numbers
+ *
+ * @return [Hash]
+ * @see bernoulli_cache_stats
+ */
+VALUE
+calc_euler_cache_stats(VALUE self)
+{
+    return table_stats(&euler_table);
+}
+
+/* Writes bernoulli numbers to a file which can be loaded with
+ * Calc.load_bernoulli
+ *
+ * Numbers with indexes 0 to max are written, computing any that haven't been
+ * already.  If max is not given, the highest index computed or loaded so far
+ * is used.
+ *
+ * The file is in the machine's native format, so should only be loaded on
+ * similar machines.
+ *
+ * @param path [String] file to write (replaced if it exists)
+ * @param max [Integer] (optional) highest index to write
+ * @return [Integer] number of entries written
+ * @raise [ArgumentError] if max is too large
+ * @raise [SystemCallError] if the file can't be written
+ * @example
+ *  Calc.export_bernoulli("bernoulli.tbl", 1000) #=> 1001
+ */
+VALUE
+calc_export_bernoulli(int argc, VALUE * argv, VALUE self)
+{
+    VALUE path, max;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "11", &path, &max);
+    FilePathValue(path);
+    return LONG2NUM(table_export(&bernoulli_table, path, max));
+}
+
+/* Writes euler numbers to a file which can be loaded with Calc.load_euler
+ *
+ * @param path [String] file to write (replaced if it exists)
+ * @param max [Integer] (optional) highest index to write
+ * @return [Integer] number of entries written
+ * @see export_bernoulli
+ */
+VALUE
+calc_export_euler(int argc, VALUE * argv, VALUE self)
+{
+    VALUE path, max;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "11", &path, &max);
+    FilePathValue(path);
+    return LONG2NUM(table_export(&euler_table, path, max));
+}
+
+/* Loads bernoulli numbers from a file written by Calc.export_bernoulli
+ *
+ * The file is mapped read-only rather than read into memory, so processes
+ * forked after loading it share the same memory.  Calc::Q#bernoulli then
+ * copies numbers from the file instead of computing them.  Any previously
+ * loaded file is replaced; Calc.freebernoulli removes it.
+ *
+ * @param path [String]
+ * @return [Integer] number of entries in the file
+ * @raise [ArgumentError] if the file isn't a bernoulli table for this machine
+ * @raise [SystemCallError] if the file can't be read
+ * @example
+ *  Calc.load_bernoulli("bernoulli.tbl") #=> 1001
+ */
+VALUE
+calc_load_bernoulli(VALUE self, VALUE path)
+{
+    FilePathValue(path);
+    return LONG2NUM(table_load(&bernoulli_table, path));
+}
+
+/* Loads euler numbers from a file written by Calc.export_euler
+ *
+ * @param path [String]
+ * @return [Integer] number of entries in the file
+ * @see load_bernoulli
+ */
+VALUE
+calc_load_euler(VALUE self, VALUE path)
+{
+    FilePathValue(path);
+    return LONG2NUM(table_load(&euler_table, path));
+}
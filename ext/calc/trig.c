@@ -0,0 +1,363 @@
+#include <math.h>
+#include "calc.h"
+
+/* sin and cos (or sinh and cosh) of the same argument in one pass.
+ *
+ * libcalc computes sin and cos together internally, but qsin and qcos each
+ * return only one of them, so calling both repeats the range reduction and
+ * the series.  here the argument is reduced modulo pi/2 (using the cached pi
+ * from constants.c), divided by 2^k, and the taylor series of sin and cos
+ * summed together in fixed point (integers scaled by 2^w).  the angle is then
+ * doubled k times.  sinh and cosh are both derived from a single exp.
+ *
+ * functions taking a "bits" argument return values within 2^-bits of the
+ * exact results, not yet rounded to epsilon.
+ */
+
+/* bits computed beyond those implied by epsilon */
+#define TRIG_GUARD_BITS 8
+
+/* rounding of results to epsilon (round to nearest, like qsin) */
+#define TRIG_ROUNDING 24L
+
+/* returns 2^-bits */
+static NUMBER *
+bit_epsilon(long bits)
+{
+    return qscale(&_qone_, -bits);
+}
+
+/* returns z / 2^w as a NUMBER; frees z */
+static NUMBER *
+fixed_to_number(ZVALUE z, long w)
+{
+    NUMBER *q, *result;
+
+    q = qalloc();
+    q->num = z;
+    result = qscale(q, -w);
+    qfree(q);
+    return result;
+}
+
+/* sets s and c to sin(x) and cos(x), where x = X / 2^bits and |x| < 1.  the
+ * results are also scaled by 2^bits, and are within a few units of the exact
+ * values. */
+static void
+sincos_fixed(ZVALUE x, long bits, ZVALUE * s, ZVALUE * c)
+{
+    ZVALUE y, term, t1, t2, t3;
+    long j, k, w;
+
+    /* halving x k times means fewer terms of the series, but each doubling at
+     * the end costs two multiplications and about 1.5 bits of accuracy */
+    k = (long) sqrt((double) bits / 2);
+    w = bits + 2 * k + 16;
+
+    /* y = x / 2^k at w bits */
+    zshift(x, w - bits - k, &y);
+    itoz(0, s);
+    zbitvalue(w, c);
+    zbitvalue(w, &term);
+    for (j = 1;; j++) {
+        /* term = y^j / j! */
+        zmul(term, y, &t1);
+        zfree(term);
+        zshift(t1, -w, &t2);
+        zfree(t1);
+        zdivi(t2, j, &term);
+        zfree(t2);
+        if (ziszero(term)) {
+            break;
+        }
+        switch (j & 3) {
+        case 1:
+            zadd(*s, term, &t1);
+            zfree(*s);
+            *s = t1;
+            break;
+        case 2:
+            zsub(*c, term, &t1);
+            zfree(*c);
+            *c = t1;
+            break;
+        case 3:
+            zsub(*s, term, &t1);
+            zfree(*s);
+            *s = t1;
+            break;
+        default:
+            zadd(*c, term, &t1);
+            zfree(*c);
+            *c = t1;
+        }
+    }
+    zfree(term);
+    zfree(y);
+
+    /* sin(2a) = 2 sin(a) cos(a); cos(2a) = (cos(a) + sin(a))(cos(a) - sin(a)) */
+    while (k-- > 0) {
+        zadd(*c, *s, &t1);
+        zsub(*c, *s, &t2);
+        zmul(t1, t2, &t3);
+        zfree(t1);
+        zfree(t2);
+        zmul(*s, *c, &t1);
+        zfree(*s);
+        zfree(*c);
+        zshift(t1, 1 - w, s);
+        zfree(t1);
+        zshift(t3, -w, c);
+        zfree(t3);
+    }
+
+    zshift(*s, bits - w, &t1);
+    zfree(*s);
+    *s = t1;
+    zshift(*c, bits - w, &t1);
+    zfree(*c);
+    *c = t1;
+}
+
+/* sets *s and *c to sin(x) and cos(x) within 2^-bits */
+static void
+sincos_bits(NUMBER * x, long bits, NUMBER ** s, NUMBER ** c)
+{
+    NUMBER *pi, *eps, *t1, *t2, *n, *r;
+    ZVALUE xz, t, sz, cz, a;
+    long w, quadrant;
+
+    if (qiszero(x)) {
+        *s = qlink(&_qzero_);
+        *c = qlink(&_qone_);
+        return;
+    }
+    w = bits + TRIG_GUARD_BITS;
+    quadrant = 0;
+    if (qilog2(x) >= -1) {
+        /* r = x - n * pi/2, with n the nearest integer to x / (pi/2).  pi
+         * needs enough bits that n times its error is still below 2^-w */
+        eps = bit_epsilon(w + qilog2(x) + 4);
+        pi = constant_value(CONST_PI, eps);
+        qfree(eps);
+        t1 = qscale(x, 1);
+        t2 = qqdiv(t1, pi);
+        qfree(t1);
+        t1 = qisneg(t2) ? qsub(t2, &_qonehalf_) : qqadd(t2, &_qonehalf_);
+        qfree(t2);
+        n = qint(t1);
+        qfree(t1);
+        t1 = qmul(n, pi);
+        qfree(pi);
+        t2 = qscale(t1, -1);
+        qfree(t1);
+        r = qsub(x, t2);
+        qfree(t2);
+        a = n->num;
+        a.sign = 0;
+        quadrant = zmodi(a, 4);
+        if (qisneg(n)) {
+            quadrant = (4 - quadrant) & 3;
+        }
+        qfree(n);
+    }
+    else {
+        r = qlink(x);
+    }
+
+    /* r * 2^w, truncated */
+    zshift(r->num, w, &t);
+    zquo(t, r->den, &xz, 0);
+    zfree(t);
+    qfree(r);
+
+    sincos_fixed(xz, w, &sz, &cz);
+    zfree(xz);
+    switch (quadrant) {
+    case 1:
+        /* sin(r + pi/2) = cos(r); cos(r + pi/2) = -sin(r) */
+        t = sz;
+        sz = cz;
+        cz = t;
+        cz.sign = !cz.sign;
+        break;
+    case 2:
+        sz.sign = !sz.sign;
+        cz.sign = !cz.sign;
+        break;
+    case 3:
+        t = sz;
+        sz = cz;
+        cz = t;
+        sz.sign = !sz.sign;
+    }
+    if (ziszero(sz)) {
+        sz.sign = 0;
+    }
+    if (ziszero(cz)) {
+        cz.sign = 0;
+    }
+    *s = fixed_to_number(sz, w);
+    *c = fixed_to_number(cz, w);
+}
+
+/* sets *s and *c to sinh(x) and cosh(x) within 2^-bits */
+static void
+sinhcosh_bits(NUMBER * x, long bits, NUMBER ** s, NUMBER ** c)
+{
+    NUMBER *ax, *eps, *e, *inv, *t;
+
+    if (qiszero(x)) {
+        *s = qlink(&_qzero_);
+        *c = qlink(&_qone_);
+        return;
+    }
+    /* use exp(|x|) >= 1 so that the error in 1/exp(|x|) is no bigger than the
+     * error in exp(|x|) */
+    ax = qqabs(x);
+    eps = bit_epsilon(bits + 2);
+    e = bsplit_exp(ax, eps);
+    qfree(eps);
+    qfree(ax);
+    inv = qinv(e);
+    t = qsub(e, inv);
+    *s = qscale(t, -1);
+    qfree(t);
+    if (qisneg(x)) {
+        t = qneg(*s);
+        qfree(*s);
+        *s = t;
+    }
+    t = qqadd(e, inv);
+    *c = qscale(t, -1);
+    qfree(t);
+    qfree(inv);
+    qfree(e);
+}
+
+/* bits of accuracy needed for results to be rounded to epsilon */
+static long
+epsilon_bits(NUMBER * epsilon)
+{
+    long bits;
+
+    bits = TRIG_GUARD_BITS - qilog2(epsilon);
+    return bits < 2 * TRIG_GUARD_BITS ? 2 * TRIG_GUARD_BITS : bits;
+}
+
+/* returns q rounded to epsilon; frees q */
+static NUMBER *
+round_number(NUMBER * q, NUMBER * epsilon)
+{
+    NUMBER *result;
+
+    result = qmappr(q, epsilon, TRIG_ROUNDING);
+    qfree(q);
+    return result;
+}
+
+/* returns a new COMPLEX re + im*i, each part rounded to epsilon; frees re and
+ * im */
+static COMPLEX *
+round_complex(NUMBER * re, NUMBER * im, NUMBER * epsilon)
+{
+    COMPLEX *result;
+
+    result = comalloc();
+    qfree(result->real);
+    qfree(result->imag);
+    result->real = round_number(re, epsilon);
+    result->imag = round_number(im, epsilon);
+    return result;
+}
+
+/* sets *s and *c to sin(x) and cos(x) rounded to epsilon */
+void
+sincos_number(NUMBER * x, NUMBER * epsilon, NUMBER ** s, NUMBER ** c)
+{
+    sincos_bits(x, epsilon_bits(epsilon), s, c);
+    *s = round_number(*s, epsilon);
+    *c = round_number(*c, epsilon);
+}
+
+/* sets *s and *c to sinh(x) and cosh(x) rounded to epsilon */
+void
+sinhcosh_number(NUMBER * x, NUMBER * epsilon, NUMBER ** s, NUMBER ** c)
+{
+    sinhcosh_bits(x, epsilon_bits(epsilon), s, c);
+    *s = round_number(*s, epsilon);
+    *c = round_number(*c, epsilon);
+}
+
+/* sets *s and *c to sin(z) and cos(z) rounded to epsilon:
+ *   sin(a+bi) = sin(a)cosh(b) + cos(a)sinh(b)i
+ *   cos(a+bi) = cos(a)cosh(b) - sin(a)sinh(b)i
+ */
+void
+sincos_complex(COMPLEX * z, NUMBER * epsilon, COMPLEX ** s, COMPLEX ** c)
+{
+    NUMBER *sa, *ca, *shb, *chb, *t;
+    long bits;
+
+    bits = epsilon_bits(epsilon);
+    /* sin(a) and cos(a) are multiplied by cosh(b) >= 1, so need more bits */
+    sinhcosh_bits(z->imag, bits + 3, &shb, &chb);
+    sincos_bits(z->real, bits + qilog2(chb) + 4, &sa, &ca);
+    *s = round_complex(qmul(sa, chb), qmul(ca, shb), epsilon);
+    t = qmul(sa, shb);
+    *c = round_complex(qmul(ca, chb), qneg(t), epsilon);
+    qfree(t);
+    qfree(sa);
+    qfree(ca);
+    qfree(shb);
+    qfree(chb);
+}
+
+/* sets *s and *c to sinh(z) and cosh(z) rounded to epsilon:
+ *   sinh(a+bi) = sinh(a)cos(b) + cosh(a)sin(b)i
+ *   cosh(a+bi) = cosh(a)cos(b) + sinh(a)sin(b)i
+ */
+void
+sinhcosh_complex(COMPLEX * z, NUMBER * epsilon, COMPLEX ** s, COMPLEX ** c)
+{
+    NUMBER *sha, *cha, *sb, *cb;
+    long bits;
+
+    bits = epsilon_bits(epsilon);
+    sinhcosh_bits(z->real, bits + 3, &sha, &cha);
+    sincos_bits(z->imag, bits + qilog2(cha) + 4, &sb, &cb);
+    *s = round_complex(qmul(sha, cb), qmul(cha, sb), epsilon);
+    *c = round_complex(qmul(cha, cb), qmul(sha, sb), epsilon);
+    qfree(sha);
+    qfree(cha);
+    qfree(sb);
+    qfree(cb);
+}
+
+/* returns cis(z) = exp(zi) = cos(z) + sin(z)i rounded to epsilon.  for
+ * z = a+bi, this is exp(-b)(cos(a) + sin(a)i) */
+COMPLEX *
+cis_complex(COMPLEX * z, NUMBER * epsilon)
+{
+    NUMBER *sa, *ca, *nb, *e, *eps;
+    COMPLEX *result;
+    long bits, extra;
+
+    bits = epsilon_bits(epsilon);
+    if (qiszero(z->imag)) {
+        sincos_bits(z->real, bits, &sa, &ca);
+        return round_complex(ca, sa, epsilon);
+    }
+    nb = qneg(z->imag);
+    eps = bit_epsilon(bits + 3);
+    e = bsplit_exp(nb, eps);
+    qfree(eps);
+    qfree(nb);
+    extra = qiszero(e) ? 0 : qilog2(e) + 1;
+    sincos_bits(z->real, bits + (extra > 0 ? extra : 0) + 3, &sa, &ca);
+    result = round_complex(qmul(e, ca), qmul(e, sa), epsilon);
+    qfree(sa);
+    qfree(ca);
+    qfree(e);
+    return result;
+}
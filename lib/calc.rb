@@ -2,7 +2,13 @@ require "calc/version"
 require "calc/calc"
 require "calc/numeric"
 require "calc/q"
+require "calc/epsilon"
+require "calc/arithmetic_sequence"
 require "calc/c"
+require "calc/accumulator"
+require "calc/mod_context"
+require "calc/special_mod"
+require "calc/real"
 
 module Calc
   # builtins implemented as instance methods on Calc::Q or Calc::C
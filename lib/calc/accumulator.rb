@@ -0,0 +1,44 @@
+module Calc
+  class Accumulator
+    # Alias for add
+    #
+    # @param y [Numeric,Calc::Q]
+    # @return [Calc::Accumulator] self
+    def <<(y)
+      add(y)
+    end
+
+    def inspect
+      "Calc::Accumulator(#{ self })"
+    end
+
+    # Returns the current value as a ruby Float
+    #
+    # @return [Float]
+    def to_f
+      value.to_f
+    end
+
+    # Returns the current value as a ruby Integer (truncated towards zero)
+    #
+    # @return [Integer]
+    def to_i
+      value.to_i
+    end
+
+    # Returns the current value as a ruby Rational
+    #
+    # @return [Rational]
+    def to_r
+      value.to_r
+    end
+
+    # Returns the current value as a string
+    #
+    # @param mode [Symbol] (optional) output mode, see Calc::Q#to_s
+    # @return [String]
+    def to_s(*args)
+      value.to_s(*args)
+    end
+  end
+end
@@ -0,0 +1,129 @@
+module Calc
+  # Lazy sequence of values begin, begin + step, begin + 2 * step ... up to
+  # and including end (if end isn't nil).
+  #
+  # Returned by Calc::Q#step, #times, #upto and #downto when no block is
+  # given.  This is an Enumerator, and is compatible with ruby's
+  # Enumerator::ArithmeticSequence; size, first, last and sum are calculated
+  # directly instead of iterating over the sequence.
+  #
+  # @example
+  #  s = Calc::Q(1).step(10, 3) #=> (Calc::Q(1).step(Calc::Q(10), Calc::Q(3)))
+  #  s.size                     #=> 4
+  #  s.last                     #=> Calc::Q(10)
+  #  s.sum                      #=> Calc::Q(22)
+  class ArithmeticSequence < Enumerator
+    attr_reader :begin, :end, :step
+
+    # @param first [Calc::Q] first value
+    # @param last [Calc::Q,nil] limit, or nil for an endless sequence
+    # @param step [Calc::Q] difference between each value
+    def initialize(first, last, step)
+      @begin = first
+      @end = last
+      @step = step
+      super() { |y| first.step(last, step) { |i| y << i } }
+    end
+
+    def ==(other)
+      other.is_a?(ArithmeticSequence) && [@begin, @end, @step] == [other.begin, other.end, other.step]
+    end
+    alias eql? ==
+    alias === ==
+
+    # Iterates the given block over each value in the sequence
+    #
+    # @return [Calc::ArithmeticSequence] self
+    def each(&block)
+      return self unless block
+      @begin.step(@end, @step, &block)
+      self
+    end
+
+    # Always false, the end of the sequence is included if reached
+    #
+    # @return [Boolean]
+    def exclude_end?
+      false
+    end
+
+    # Returns the first value, or an array of the first n values
+    #
+    # @param n [Integer] (optional) number of values
+    # @return [Calc::Q,Array,nil]
+    # @example
+    #  Calc::Q(1).step(by: 2).first(3) #=> [Calc::Q(1), Calc::Q(3), Calc::Q(5)]
+    def first(*args)
+      return (size.zero? ? nil : @begin) if args.empty?
+      n = args.first.to_int
+      raise ArgumentError, "negative array size (or size too big)" if n < 0
+      count = infinite? ? n : [n, size].min
+      Array.new(count) { |i| value(i) }
+    end
+
+    def hash
+      inspect.hash
+    end
+
+    def inspect
+      args = [@end, @step].map(&:inspect).join(", ")
+      "(#{ @begin.inspect }.step(#{ args }))"
+    end
+    alias to_s inspect
+
+    # Returns the last value, or an array of the last n values
+    #
+    # @param n [Integer] (optional) number of values
+    # @return [Calc::Q,Array,nil]
+    # @raise [RangeError] if the sequence is endless
+    def last(*args)
+      raise RangeError, "cannot get the last element of endless arithmetic sequence" if infinite?
+      return (size.zero? ? nil : value(size - 1)) if args.empty?
+      n = args.first.to_int
+      raise ArgumentError, "negative array size" if n < 0
+      count = [n, size].min
+      Array.new(count) { |i| value(size - count + i) }
+    end
+
+    # Number of values in the sequence, or Float::INFINITY if it never ends
+    #
+    # @return [Integer,Float]
+    def size
+      return Float::INFINITY if infinite?
+      n = ((@end - @begin) / @step).floor + 1
+      n < 0 ? 0 : n.to_i
+    end
+
+    # Sum of the values in the sequence
+    #
+    # Without a block, this is calculated directly.  With a block, the results
+    # of the block are summed like Enumerable#sum.
+    #
+    # @param init [Numeric] (optional) value to add the sum to
+    # @return [Calc::Q]
+    def sum(init = 0, &block)
+      return super if block
+      raise RangeError, "cannot sum an endless arithmetic sequence" if infinite?
+      n = size
+      return init if n.zero?
+      (@begin + value(n - 1)) * n / 2 + init
+    end
+
+    def to_a
+      return super if infinite?
+      Array.new(size) { |i| value(i) }
+    end
+    alias entries to_a
+
+    private
+
+    def infinite?
+      @end.nil? || @step.zero?
+    end
+
+    # ith value of the sequence (starting from 0)
+    def value(i)
+      @begin + @step * i
+    end
+  end
+end
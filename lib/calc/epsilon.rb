@@ -0,0 +1,7 @@
+module Calc
+  class Epsilon < Q
+    def inspect
+      "Calc::Epsilon(#{ to_s(:exp) })"
+    end
+  end
+end
@@ -0,0 +1,44 @@
+module Calc
+  class ModContext
+    def inspect
+      "Calc::ModContext(#{ modulus })"
+    end
+
+    class Residue
+      # Modular multiplication, see Calc::ModContext#mul
+      #
+      # @param y [Integer,Calc::Q,Calc::ModContext::Residue]
+      # @return [Calc::ModContext::Residue]
+      def *(other)
+        context.mul(self, other)
+      end
+
+      # Modular exponentiation, see Calc::ModContext#pow
+      #
+      # @param e [Integer,Calc::Q]
+      # @return [Calc::ModContext::Residue]
+      def **(other)
+        context.pow(self, other)
+      end
+
+      def inspect
+        "Calc::ModContext::Residue(#{ to_q } mod #{ context.modulus })"
+      end
+
+      # Returns the value as a ruby Integer
+      #
+      # @return [Integer]
+      def to_i
+        to_q.to_i
+      end
+
+      # Returns the value as a string
+      #
+      # @param mode [Symbol] (optional) output mode, see Calc::Q#to_s
+      # @return [String]
+      def to_s(*args)
+        to_q.to_s(*args)
+      end
+    end
+  end
+end
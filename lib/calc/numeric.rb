@@ -1,5 +1,21 @@
 module Calc
   class Numeric
+    # functions with batch versions, see Calc::Numeric.many
+    MANY_FUNCTIONS = %i[
+      acos acosh acot acoth acsc acsch asec asech asin asinh atan atanh cos cosh
+      cot coth csc csch exp ln log sec sech sin sinh sqrt tan tanh
+    ].freeze
+
+    # batch versions of functions, eg Calc::Q.sin_many(values, eps) is
+    # equivalent to values.map { |x| Calc::Q(x).sin(eps) }
+    class << self
+      MANY_FUNCTIONS.each do |f|
+        define_method "#{ f }_many" do |values, *args|
+          many(values, f, *args)
+        end
+      end
+    end
+
     # Modulo operator
     #
     # x % y is equivalent to x.mod(y).  Rounding mode is determined by
@@ -148,19 +164,6 @@ module Calc
       int? ? Q::ONE : Q::ZERO
     end
 
-    # Base 2 logarithm
-    #
-    # @return [Calc::Q]
-    # @example
-    #  Calc::Q(1).log2    #=> Calc::Q(0)
-    #  Calc::Q(2).log2    #=> Calc::Q(1)
-    #  Calc::Q(10).log2   #=> Calc::Q(~3.32192809488736234786)
-    #  Calc::Q(-2).log2   #=> Calc::C(1+~4.53236014182719380961i)
-    #  Calc::C(1, 2).log2 #=> Calc::C(~1.16096404744368117393+~1.59727796468810880664i)
-    def log2(*args)
-      ln(*args) / Q::TWO.ln(*args)
-    end
-
     # least-absol;ute-value residues modulo a specified number
     #
     # x.mmin(md) is equivalent to x.mod(md, 16)
@@ -171,21 +171,6 @@ module Calc
       quomod(y, ZERO)
     end
 
-    # Iterates the given block, yielding values from `self` decreasing by 1
-    # down to and including `limit`
-    #
-    # x.downto(limit) is equivalent to x.step(by: -1, to: limit)
-    #
-    # If no block is given, an Enumerator is returned instead.
-    #
-    # @return [Enumerator,nil]
-    # @param limit [Numeric] lowest value to return
-    # @example
-    #   Calc::Q(10).downto(5) { |i| print i, " " } #=> 10 9 8 7 6 5
-    def downto(limit, &block)
-      step(limit, NEGONE, &block)
-    end
-
     # Returns a string which if evaluated creates a new object with the original value
     #
     # @return [String]
@@ -493,66 +478,6 @@ module Calc
       end
     end
 
-    # Invokes the given block with the sequence of numbers starting at self
-    # incrementing by step (default 1) on each call.
-    #
-    # In the first format, uses keyword parameters:
-    #   x.step(by: step, to: limit)
-    #
-    # In the second format, uses positional parameters:
-    #   x.step(limit = nil, step = 1)
-    #
-    # If step is negative, the sequence decrements instead of incrementing.
-    # If step is zero, the sequence will yield self forever.
-    #
-    # If limit exists, the sequence will stop once the next item yielded would
-    # be higher than limit (if step is positive) or lower than limit (if step
-    # is negative).  If limit is nil, the sequence never stops.
-    #
-    # If no block is givem, an Enumerator is returned instead.
-    #
-    # This method was added for ruby Numeric compatibiliy; unlike Numeric#step,
-    # it is not an error for step to be zero in the positional format.
-    #
-    # @param by [Numeric] amount to add to sequence each iteration
-    # @param to [Numeric] end of sequence value
-    # @return [Enumerator,nil]
-    # @example
-    #  Calc::Q(1).step(10, 3).to_a      #=> [Calc::Q(1), Calc::Q(4), Calc::Q(7), Calc::Q(10)]
-    #  Calc::Q(10).step(by: -2).take(4) #=> [Calc::Q(10), Calc::Q(8), Calc::Q(6), Calc::Q(4)]
-    #  Calc::Q(1).exp.step(to: Calc.pi, by: "0.2") { |q| print q, " " } #=> nil
-    # prints:
-    #  2.71828182845904523536 2.91828182845904523536 3.11828182845904523536
-    def step(a1 = nil, a2 = ONE)
-      return to_enum(:step, a1, a2) unless block_given?
-      to, by = step_args(a1, a2)
-      loop { yield self } if by.zero?
-      i = self
-      loop do
-        break if to && ((by.positive? && i > to) || (by.negative? && i < to))
-        yield i
-        i += by
-      end
-    end
-
-    # work out what the caller meant with their args to #step
-    # returns an array of [to, by] parameters
-    def step_args(a1, a2)
-      if a1.is_a?(Hash)
-        # fake keywords style
-        badkeys = a1.keys - %i[to by]
-        raise ArgumentError, "Unknown keywords: #{ badkeys.join(", ") }" if badkeys.any?
-        to = a1.fetch(:to, nil)
-        by = a1.fetch(:by, ONE)
-      else
-        # positional style (limit, step)
-        to = a1
-        by = a2
-      end
-      [to ? Q.new(to) : nil, Q.new(by)]
-    end
-    private :step_args
-
     # Returns one more than self.
     #
     # This method exists for ruby Integer compatibility.
@@ -565,24 +490,6 @@ module Calc
     end
     alias next succ
 
-    # Iterates the given block `self` times, passing in values from zero to
-    # self - 1
-    #
-    # If no block is given, an Enumerator is returned instead.
-    #
-    # @return [Enumerator,nil]
-    # @example
-    #   Calc::Q(5).times { |i| print i, " " }
-    #   #=> 0 1 2 3 4
-    def times
-      return to_enum(:times) unless block_given?
-      i = ZERO
-      while i < self
-        yield i
-        i += ONE
-      end
-    end
-
     # Returns a ruby Complex number with self as the real part and zero
     # imaginary part.
     #
@@ -617,21 +524,6 @@ module Calc
 
     alias truncate trunc
 
-    # Iterates the given block, yielding values from `self` increasing by 1
-    # up to and including `limit`
-    #
-    # x.upto(limit) is equivalent to x.step(by: 1, to: limit)
-    #
-    # If no block is given, an Enumerator is returned instead.
-    #
-    # @return [Enumerator,nil]
-    # @param limit [Numeric] highest value to return
-    # @example
-    #   Calc::Q(5).upto(10) { |i| print i, " " } #=> 5 6 7 8 9 10
-    def upto(limit, &block)
-      step(limit, ONE, &block)
-    end
-
     # Bitwise exclusive or of a set of integers
     #
     # xor(a, b, c, ...) is equivalent to (((a ^ b) ^ c) ... )
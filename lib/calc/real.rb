@@ -0,0 +1,415 @@
+module Calc
+  # Lazily evaluated real number
+  #
+  # A Calc::Real records an expression (made of other Calc::Real values,
+  # rationals and builtins like exp, ln and sqrt) without computing anything.
+  # When a value is asked for (with to_q, to_s, to_f etc), the expression is
+  # evaluated to the precision needed for that answer: each step works out how
+  # accurate its operands have to be, so there is no need to pick an epsilon
+  # for every intermediate step.
+  #
+  # Each node remembers its most accurate approximation, so evaluating again
+  # (or evaluating an expression which shares parts of this one) only
+  # recomputes what needs more precision.
+  #
+  # Values must be real; operations which would have a complex result raise
+  # Calc::MathError.  Values which can't be told apart from zero (such as a
+  # divisor which really is zero) raise Calc::MathError once the search for a
+  # non-zero digit has gone ZERO_BITS bits past the precision being computed.
+  #
+  # @example
+  #  x = Calc::Real(2).sqrt.exp * Calc::Real.pi #=> Calc::Real(12.92215717235987943129)
+  #  x.to_s(40)                                 #=> "12.9221571723598794312941333471281225692213"
+  #  x.to_q("1e-5")                             #=> Calc::Q(12.92216)
+  class Real
+    # see class documentation
+    ZERO_BITS = 256
+
+    # log2(e), for bounds on exp
+    LOG2_E = 1.4426950408889634
+
+    # bits per decimal digit
+    BITS_PER_DIGIT = 3.321928094887362
+
+    # Returns x as a Calc::Real
+    #
+    # @param x [Calc::Real,Calc::Q,Numeric,String]
+    # @return [Calc::Real]
+    # @raise [ArgumentError] if x is complex
+    def self.convert(x)
+      case x
+      when Real
+        x
+      when C, Complex
+        raise ArgumentError, "Calc::Real values must be real"
+      else
+        Exact.new(Q === x ? x : Calc::Q(x))
+      end
+    end
+
+    # @return [Calc::Real] pi
+    def self.pi
+      Constant.new(:pi)
+    end
+
+    # @return [Calc::Real] e
+    def self.e
+      Constant.new(:e)
+    end
+
+    # 2^-bits as a Calc::Q
+    def self.ulp(bits)
+      bits >= 0 ? Calc::Q(1, 1 << bits) : Calc::Q(1 << -bits)
+    end
+
+    # Returns an approximation within 2^-bits of the exact value
+    #
+    # @param bits [Integer]
+    # @return [Calc::Q]
+    def approx(bits)
+      return @approx if @approx_bits && @approx_bits >= bits
+      # evaluating to half the error leaves room to round to a multiple of
+      # 2^-(bits+1), which keeps the rationals from growing
+      @approx = evaluate(bits + 1).appr(Real.ulp(bits + 1), 24)
+      @approx_bits = bits
+      @approx
+    end
+
+    # Returns the number of bits of the most accurate approximation computed
+    # so far, or nil if none have been
+    #
+    # @return [Integer,nil]
+    attr_reader :approx_bits
+
+    # Returns a rational within eps of the exact value
+    #
+    # @param eps [Numeric,Calc::Q] (optional) default Calc.config(:epsilon)
+    # @return [Calc::Q]
+    # @example
+    #  Calc::Real.pi.to_q("1e-10") #=> Calc::Q(3.1415926536)
+    def to_q(eps = nil)
+      eps = Calc::Q(eps || Calc.config(:epsilon))
+      raise MathError, "Epsilon value must be greater than zero" unless eps > 0
+      approx(Real.bits_for(eps) + 1).appr(eps, 24)
+    end
+
+    # Returns the value rounded to a number of decimal places
+    #
+    # The last digit is correct unless the exact value is very close to half
+    # way between two decimals.
+    #
+    # @param digits [Integer] (optional) decimal places, default 20
+    # @return [String]
+    # @example
+    #  Calc::Real(1).exp.to_s(5) #=> "2.71828"
+    def to_s(digits = 20)
+      n = (approx((digits * BITS_PER_DIGIT).ceil + 8) * 10**digits).round.to_i
+      s = n.abs.to_s.rjust(digits + 1, "0")
+      s.insert(-digits - 1, ".") if digits > 0
+      n < 0 ? "-" + s : s
+    end
+
+    def inspect
+      "Calc::Real(#{ to_s })"
+    end
+
+    # @return [Float]
+    def to_f
+      approx(60).to_f
+    end
+
+    def coerce(other)
+      [Real.convert(other), self]
+    end
+
+    def +(other)
+      Add.new(self, Real.convert(other))
+    end
+
+    def -(other)
+      Add.new(self, Neg.new(Real.convert(other)))
+    end
+
+    def -@
+      Neg.new(self)
+    end
+
+    def *(other)
+      Mul.new(self, Real.convert(other))
+    end
+
+    def /(other)
+      Mul.new(self, Inverse.new(Real.convert(other)))
+    end
+
+    # Power
+    #
+    # Integer powers are computed by repeated multiplication; anything else
+    # as exp(other * ln(self)), which requires self to be positive.
+    #
+    # @param other [Integer,Numeric,Calc::Real]
+    # @return [Calc::Real]
+    def **(other)
+      if other.is_a?(Integer) || (Q === other && other.int?)
+        n = other.to_i
+        return Exact.new(Calc::Q(1)) if n.zero?
+        result = integer_power(n.abs)
+        n < 0 ? Inverse.new(result) : result
+      else
+        (Real.convert(other) * ln).exp
+      end
+    end
+
+    # @return [Calc::Real] reciprocal of self
+    def inverse
+      Inverse.new(self)
+    end
+
+    def abs
+      Function.new(:abs, self)
+    end
+
+    def atan
+      Function.new(:atan, self)
+    end
+
+    def cos
+      Function.new(:cos, self)
+    end
+
+    def cosh
+      Function.new(:cosh, self)
+    end
+
+    def exp
+      Function.new(:exp, self)
+    end
+
+    # natural logarithm
+    #
+    # @raise [Calc::MathError] (when evaluated) if self is not positive
+    def ln
+      Function.new(:ln, self)
+    end
+
+    # base 10 logarithm
+    def log
+      ln / Exact.new(Calc::Q(10)).ln
+    end
+
+    def sin
+      Function.new(:sin, self)
+    end
+
+    def sinh
+      Function.new(:sinh, self)
+    end
+
+    # square root
+    #
+    # @raise [Calc::MathError] (when evaluated) if self is negative
+    def sqrt
+      Sqrt.new(self)
+    end
+
+    def tan
+      sin / cos
+    end
+
+    def tanh
+      Function.new(:tanh, self)
+    end
+
+    # Returns an integer e with |self| < 2^e
+    def magnitude
+      @magnitude ||= Real.ceil_log2(approx(0).abs + 1)
+    end
+
+    # Returns an integer e with |self| >= 2^e, looking at up to bits +
+    # ZERO_BITS bits
+    #
+    # @raise [Calc::MathError] if self can't be distinguished from zero
+    def lower_bound(bits)
+      l = lower_bound_within(bits + ZERO_BITS)
+      raise MathError, "Calc::Real value is too close to zero" unless l
+      l
+    end
+
+    # Returns an integer e with |self| >= 2^e, or nil if approximations to
+    # limit bits don't show that self is not zero
+    def lower_bound_within(limit)
+      return @lower_bound if @lower_bound
+      k = 0
+      loop do
+        a = approx(k).abs
+        # |self| >= a - 2^-k, which is at least 2^-k
+        return @lower_bound = Real.floor_log2(a - Real.ulp(k)) if a > 2 * Real.ulp(k)
+        return nil if k >= limit
+        k = k < 16 ? 16 : [k * 2, limit].min
+      end
+    end
+
+    # number of bits b where 2^-b <= eps
+    def self.bits_for(eps)
+      -floor_log2(eps)
+    end
+
+    # an integer e with 2^e <= q (q > 0)
+    def self.floor_log2(q)
+      q.numerator.to_i.bit_length - q.denominator.to_i.bit_length - 1
+    end
+
+    # an integer e with q < 2^e (q > 0)
+    def self.ceil_log2(q)
+      q.numerator.to_i.bit_length - q.denominator.to_i.bit_length + 1
+    end
+
+    private
+
+    def integer_power(n)
+      result = nil
+      base = self
+      loop do
+        result = result ? result * base : base if n.odd?
+        n >>= 1
+        break if n.zero?
+        base *= base
+      end
+      result
+    end
+
+    # a rational value
+    class Exact < Real
+      def initialize(q)
+        @q = q
+      end
+
+      def approx(_bits)
+        @q
+      end
+
+      def magnitude
+        Real.ceil_log2(@q.abs + 1)
+      end
+    end
+
+    # one of the constants cached by Calc.constant
+    class Constant < Real
+      def initialize(name)
+        @name = name
+      end
+
+      def evaluate(bits)
+        Calc.constant(@name, Real.ulp(bits))
+      end
+    end
+
+    class Add < Real
+      def initialize(x, y)
+        @x = x
+        @y = y
+      end
+
+      def evaluate(bits)
+        @x.approx(bits + 1) + @y.approx(bits + 1)
+      end
+    end
+
+    class Neg < Real
+      def initialize(x)
+        @x = x
+      end
+
+      def evaluate(bits)
+        -@x.approx(bits)
+      end
+    end
+
+    class Mul < Real
+      def initialize(x, y)
+        @x = x
+        @y = y
+      end
+
+      # |ax ay - xy| <= |ax| |ay - y| + |y| |ax - x|, and |ax| < 2^(ex+1)
+      def evaluate(bits)
+        @x.approx(bits + @y.magnitude + 2) * @y.approx(bits + @x.magnitude + 2)
+      end
+    end
+
+    class Inverse < Real
+      def initialize(x)
+        @x = x
+      end
+
+      # if |x| >= 2^l and |ax - x| <= 2^(l-1), then |1/ax - 1/x| <=
+      # |ax - x| 2^(1-2l)
+      def evaluate(bits)
+        l = @x.lower_bound(bits)
+        @x.approx([bits + 1 - 2 * l, 1 - l].max).inverse
+      end
+    end
+
+    # sqrt(a) is within |a - x| / sqrt(x) of sqrt(x), or if x might be zero,
+    # within sqrt(|a - x|)
+    class Sqrt < Real
+      def initialize(x)
+        @x = x
+      end
+
+      def evaluate(bits)
+        l = @x.lower_bound_within(bits)
+        err = l ? bits + 2 + [1 - l / 2, 0].max : 2 * bits + 4
+        a = @x.approx(err)
+        if a < 0
+          raise MathError, "Square root of negative number" if -a > Real.ulp(err)
+          return Calc::Q(0)
+        end
+        a.sqrt(Real.ulp(bits + 1))
+      end
+    end
+
+    # a builtin f(x) with the result within 2^-(bits+1) of f(ax), and ax
+    # close enough to x that f(ax) is within 2^-(bits+1) of f(x)
+    class Function < Real
+      def initialize(name, x)
+        @name = name
+        @x = x
+      end
+
+      def evaluate(bits)
+        a = @x.approx(bits + 2 + lipschitz(bits))
+        return a.abs if @name == :abs
+        a.__send__(@name, Real.ulp(bits + 1))
+      end
+
+      private
+
+      # an integer L where |f'| <= 2^L between x and its approximations
+      def lipschitz(bits)
+        case @name
+        when :exp
+          # f' = exp(x), and x < ax + 1
+          [((@x.approx(0) + 2) * LOG2_E).ceil.to_i, 0].max
+        when :sinh, :cosh
+          ((@x.approx(0).abs + 2) * LOG2_E).ceil.to_i
+        when :ln
+          raise MathError, "Logarithm of non-positive number" unless positive?(bits)
+          # f' = 1/x, and ax >= 2^(l-1)
+          [1 - @x.lower_bound(bits), 0].max
+        else
+          0
+        end
+      end
+
+      def positive?(bits)
+        l = @x.lower_bound(bits)
+        @x.approx(1 - l) > 0
+      end
+    end
+  end
+
+  def self.Real(x) # rubocop:disable Style/MethodName
+    Real.convert(x)
+  end
+end
@@ -0,0 +1,17 @@
+module Calc
+  class SpecialMod
+    def inspect
+      "Calc::SpecialMod(#{ self })"
+    end
+
+    # Returns the form of the modulus as a string, eg "3*2^189+1"
+    #
+    # @return [String]
+    def to_s
+      s = h == 1 ? "2^#{ n }" : "#{ h }*2^#{ n }"
+      s << "+1" if r == 1
+      s << "-1" if r == -1
+      s
+    end
+  end
+end
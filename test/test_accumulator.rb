@@ -0,0 +1,130 @@
+require "minitest_helper"
+
+class TestAccumulator < MiniTest::Test
+  def test_class_exists
+    refute_nil Calc::Accumulator
+  end
+
+  def test_initialization
+    assert_rational_and_equal 0, Calc::Accumulator.new.value
+    assert_rational_and_equal 5, Calc::Accumulator.new(5).value
+    assert_rational_and_equal Rational(1, 3), Calc::Accumulator.new("1/3").value
+    assert_rational_and_equal Rational(-2, 7), Calc::Accumulator.new(Calc::Q(-2, 7)).value
+    assert_rational_and_equal Rational(1, 4), Calc::Accumulator.new(Rational(1, 4)).value
+    assert_raises(ArgumentError) { Calc::Accumulator.new(1, 2) }
+  end
+
+  def test_dup
+    a = Calc::Accumulator.new(Calc::Q(1, 3))
+    b = a.dup
+    a.add(1)
+    assert_rational_and_equal Rational(4, 3), a.value
+    assert_rational_and_equal Rational(1, 3), b.value
+  end
+
+  def test_frozen
+    a = Calc::Accumulator.new(1).freeze
+    assert_raises(RuntimeError) { a.add(5) }
+    assert_raises(RuntimeError) { a << 5 }
+    assert_raises(RuntimeError) { a.sub(5) }
+    assert_raises(RuntimeError) { a.mul(5) }
+    assert_raises(RuntimeError) { a.addmul(5, 2) }
+    assert_rational_and_equal 1, a.value
+    assert_rational_and_equal 6, a.dup.add(5).value
+  end
+
+  def test_add
+    a = Calc::Accumulator.new
+    assert_same a, a.add(1)
+    1.upto(10) { |i| a.add(Calc::Q(1, i)) }
+    assert_rational_and_equal Rational(9901, 2520), a.value
+    assert_same a, a << 2
+    assert_rational_and_equal Rational(14941, 2520), a.value
+
+    # mixed integers, equal and unrelated denominators, negatives
+    a = Calc::Accumulator.new(Calc::Q(1, 6))
+    a.add(Calc::Q(1, 6)).add(Calc::Q(1, 3)).add(2).add(Calc::Q(-5, 7))
+    assert_rational_and_equal Rational(1, 6) + Rational(1, 6) + Rational(1, 3) + 2 - Rational(5, 7), a.value
+
+    # big terms
+    a = Calc::Accumulator.new
+    r = 0
+    [2**70 + 1, -(3**50), Rational(2**65, 3**40 + 2), Rational(1, 2**64)].each do |x|
+      a.add(x)
+      r += x
+    end
+    assert_rational_and_equal r, a.value
+  end
+
+  def test_add_to_zero
+    a = Calc::Accumulator.new(Calc::Q(1, 3))
+    a.add(Calc::Q(-1, 3))
+    assert_rational_and_equal 0, a.value
+    a.add(Calc::Q(1, 2))
+    assert_rational_and_equal Rational(1, 2), a.value
+  end
+
+  def test_sub
+    a = Calc::Accumulator.new(1)
+    assert_same a, a.sub(Calc::Q(1, 4))
+    assert_rational_and_equal Rational(3, 4), a.value
+    a.sub(Calc::Q(-1, 12)).sub(2)
+    assert_rational_and_equal Rational(-7, 6), a.value
+  end
+
+  def test_mul
+    a = Calc::Accumulator.new(3)
+    assert_same a, a.mul(Calc::Q(2, 3))
+    assert_rational_and_equal 2, a.value
+    1.upto(20) { |i| a.mul(Calc::Q(i, i + 1)) }
+    assert_rational_and_equal Rational(2, 21), a.value
+    a.mul(-1)
+    assert_rational_and_equal Rational(-2, 21), a.value
+    a.mul(0)
+    assert_rational_and_equal 0, a.value
+    a.add(Calc::Q(1, 5))
+    assert_rational_and_equal Rational(1, 5), a.value
+  end
+
+  def test_addmul
+    a = Calc::Accumulator.new(1)
+    assert_same a, a.addmul(2, Calc::Q(1, 4))
+    assert_rational_and_equal Rational(3, 2), a.value
+    a.addmul(Calc::Q(2, 3), Calc::Q(3, 5)).addmul(0, 7).addmul(-1, 1)
+    assert_rational_and_equal Rational(9, 10), a.value
+
+    # dot product
+    xs = (1..30).map { |i| Rational(i, i + 3) }
+    ys = (1..30).map { |i| Rational(-i * i, 2 * i + 1) }
+    a = Calc::Accumulator.new
+    xs.zip(ys) { |x, y| a.addmul(x, y) }
+    assert_rational_and_equal xs.zip(ys).map { |x, y| x * y }.inject(:+), a.value
+  end
+
+  def test_reading_does_not_change_value
+    a = Calc::Accumulator.new
+    a.add(Calc::Q(1, 6)).add(Calc::Q(1, 3))
+    assert_rational_and_equal Rational(1, 2), a.value
+    assert_rational_and_equal Rational(1, 2), a.value
+    a.add(Calc::Q(1, 6))
+    assert_rational_and_equal Rational(2, 3), a.to_q
+  end
+
+  def test_conversions
+    a = Calc::Accumulator.new(Calc::Q(7, 2))
+    assert_alias a, :value, :to_q
+    assert_equal "3.5", a.to_s
+    assert_equal "7/2", a.to_s(:frac)
+    assert_equal "Calc::Accumulator(3.5)", a.inspect
+    assert_equal 3.5, a.to_f
+    assert_equal 3, a.to_i
+    assert_equal Rational(7, 2), a.to_r
+  end
+
+  def test_errors
+    a = Calc::Accumulator.new
+    assert_raises(ArgumentError) { a.add(Calc::C(1, 1)) }
+    assert_raises(ArgumentError) { a.add("1/2") }
+    assert_raises(ArgumentError) { a.mul(nil) }
+  end
+end
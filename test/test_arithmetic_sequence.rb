@@ -0,0 +1,89 @@
+require "minitest_helper"
+
+class TestArithmeticSequence < MiniTest::Test
+  def test_class_exists
+    refute_nil Calc::ArithmeticSequence
+    assert Calc::ArithmeticSequence < Enumerator
+  end
+
+  def test_attributes
+    s = Calc::Q(1).step(10, 3)
+    assert_rational_and_equal 1, s.begin
+    assert_rational_and_equal 10, s.end
+    assert_rational_and_equal 3, s.step
+    refute s.exclude_end?
+    assert_nil Calc::Q(1).step.end
+  end
+
+  def test_each
+    a = []
+    s = Calc::Q(1).step(10, 3)
+    assert_same s, s.each { |i| a << i }
+    assert_rational_array [1, 4, 7, 10], a
+    assert_rational_array [1, 4, 7, 10], s.to_a
+    assert_rational_array [2, 5, 8, 11], s.map { |i| i + 1 }
+    assert_rational_and_equal 1, s.next
+    assert_rational_and_equal 4, s.next
+  end
+
+  def test_size
+    assert_equal 4, Calc::Q(1).step(10, 3).size
+    assert_equal 3, Calc::Q(1).step(9, 3).size
+    assert_equal 0, Calc::Q(1).step(0).size
+    assert_equal 6, Calc::Q(10).downto(5).size
+    assert_equal 5, Calc::Q(5).times.size
+    assert_equal 3, Calc::Q("2.5").times.size
+    assert_equal 0, Calc::Q(-2).times.size
+    assert_equal 4, Calc::Q(1).step(2, Rational(1, 3)).size
+    assert_equal Float::INFINITY, Calc::Q(1).step.size
+    assert_equal Float::INFINITY, Calc::Q(1).step(by: 0, to: 5).size
+    assert_equal 10**30 + 1, Calc::Q(0).upto(10**30).size
+  end
+
+  def test_first
+    s = Calc::Q(1).step(10, 3)
+    assert_rational_and_equal 1, s.first
+    assert_rational_array [1, 4], s.first(2)
+    assert_rational_array [1, 4, 7, 10], s.first(10)
+    assert_nil Calc::Q(1).step(0).first
+    assert_rational_array [5, 3, 1], Calc::Q(5).step(by: -2).first(3)
+    assert_rational_array [2, 2], Calc::Q(2).step(by: 0).first(2)
+    assert_rational_array [0, 1, 2], Calc::Q(0).upto(10**30).first(3)
+    assert_raises(ArgumentError) { s.first(-1) }
+  end
+
+  def test_last
+    s = Calc::Q(1).step(10, 3)
+    assert_rational_and_equal 10, s.last
+    assert_rational_array [7, 10], s.last(2)
+    assert_rational_array [1, 4, 7, 10], s.last(10)
+    assert_rational_and_equal 4, Calc::Q(1).step(5, 3).last
+    assert_nil Calc::Q(1).step(0).last
+    assert_rational_and_equal 10**30, Calc::Q(0).upto(10**30).last
+    assert_raises(RangeError) { Calc::Q(1).step.last }
+  end
+
+  def test_sum
+    assert_rational_and_equal 22, Calc::Q(1).step(10, 3).sum
+    assert_rational_and_equal 15, Calc::Q(5).downto(1).sum
+    assert_rational_and_equal 10, Calc::Q(5).times.sum
+    assert_rational_and_equal 20, Calc::Q(5).times.sum(10)
+    assert_equal 0, Calc::Q(1).step(0).sum
+    assert_rational_and_equal Rational(5, 2), Calc::Q(0).step(1, Rational(1, 4)).sum
+    assert_rational_and_equal (10**30) * (10**30 + 1) / 2, Calc::Q(0).upto(10**30).sum
+    assert_rational_and_equal 30, Calc::Q(1).upto(4).sum { |i| i * i }
+    assert_raises(RangeError) { Calc::Q(1).step.sum }
+  end
+
+  def test_equal
+    assert_equal Calc::Q(1).step(10, 3), Calc::Q(1).step(10, 3)
+    assert_equal Calc::Q(1).upto(5), Calc::Q(1).step(5)
+    refute_equal Calc::Q(1).step(10, 3), Calc::Q(1).step(10, 2)
+    assert_equal Calc::Q(1).step(10, 3).hash, Calc::Q(1).step(10, 3).hash
+  end
+
+  def test_inspect
+    assert_equal "(Calc::Q(1).step(Calc::Q(10), Calc::Q(3)))", Calc::Q(1).step(10, 3).inspect
+    assert_equal "(Calc::Q(1).step(nil, Calc::Q(2)))", Calc::Q(1).step(by: 2).inspect
+  end
+end
@@ -197,6 +197,29 @@ class TestC < MiniTest::Test
     assert_complex_parts [-3.59056458998577995202, 0.53092108624851980526], Calc::C(2, 3).sinh
   end
 
+  def test_sincos
+    s, c = Calc::C(2, 3).sincos
+    assert_complex_parts [9.15449914691142957347, -4.16890695996656435076], s
+    assert_complex_parts [-4.18962569096880723013, -9.10922789375533659797], c
+    z = Calc::C("-0.5", 7)
+    s, c = z.sincos("1e-40")
+    assert_in_delta 0, (s - z.sin("1e-40")).abs, Calc::Q("2e-40")
+    assert_in_delta 0, (c - z.cos("1e-40")).abs, Calc::Q("2e-40")
+  end
+
+  def test_sinhcosh
+    s, c = Calc::C(2, 3).sinhcosh
+    assert_complex_parts [-3.59056458998577995202, 0.53092108624851980526], s
+    assert_complex_parts [-3.72454550491532256548, 0.51182256998738460884], c
+  end
+
+  def test_cis
+    # cis(z) = exp(zi)
+    z = Calc::C(2, 3)
+    assert_complex_parts [-0.02071873100224288389, 0.04527125315609565487], z.cis
+    assert_in_delta 0, (z.cis("1e-40") - (z * Calc::C(0, 1)).exp("1e-40")).abs, Calc::Q("2e-40")
+  end
+
   def test_asin
     assert_complex_parts [0.57065278432109940071, 1.98338702991653543235], Calc::C(2, 3).asin
   end
@@ -290,6 +313,16 @@ class TestC < MiniTest::Test
     assert_raises(Calc::MathError) { Calc::C(0, Calc.pi / 2).gd }
   end
 
+  def test_many
+    values = [Calc::C(1, 2), Complex(-1, 3), 2, Rational(1, 3), Calc::Q(-1)]
+    Calc::Numeric::MANY_FUNCTIONS.each do |f|
+      expected = values.map { |x| Calc::C(x).__send__(f, "1e-10") }
+      assert_equal expected, Calc::C.__send__("#{ f }_many", values, "1e-10"), f
+    end
+    assert_equal [Calc::C(1, 2).exp], Calc::C.many([Calc::C(1, 2)], :exp)
+    assert_equal [Calc::Q(5)], Calc::C.many([Calc::C(3, 4)], :abs)
+  end
+
   def test_inverse
     assert_complex_parts [0.12, -0.16], Calc::C(3, 4).inverse
     assert_raises(Calc::MathError) { Calc::C(0, 0).inverse }
@@ -566,6 +599,14 @@ class TestC < MiniTest::Test
     assert_complex_parts [1.1609640474, 1.5972779647], Calc::C(1, 2).log2
   end
 
+  def test_logn
+    assert_complex_parts [1.1609640474, 1.5972779647], Calc::C(1, 2).logn(2)
+    assert_complex_parts [0.73248676332, 1.00777024382], Calc::C(1, 2).logn(3)
+    assert_rational_and_equal 1, Calc::C(0, 1).logn(Complex::I)
+    assert_complex_parts [0.32596797216, -0.73870212227], Calc::Q(2).logn(Calc::C(1, 1))
+    assert_raises(Calc::MathError) { Calc::C(1, 2).logn(1) }
+  end
+
   def test_numerator
     assert_complex_parts [3, 4], Calc::C("1/2", "2/3").numerator
   end
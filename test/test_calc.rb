@@ -16,6 +16,86 @@ class TestCalc < Minitest::Test
     assert_equal Rational(314159, 100000), pi
   end
 
+  def test_constant
+    assert_equal Calc.pi, Calc.constant(:pi)
+    assert_equal Rational(271828, 100000), Calc.constant(:e, "1e-5")
+    assert_equal Rational(69315, 100000), Calc.constant("ln2", "1e-5")
+    assert_equal Rational(230259, 100000), Calc.constant(:ln10, "1e-5")
+    assert_equal Calc::Q(1).exp("1e-60"), Calc.constant(:e, "1e-60")
+    assert_equal Calc::Q(2).ln("1e-60"), Calc.constant(:ln2, "1e-60")
+    assert_equal Calc::Q(10).ln("1e-60"), Calc.constant(:ln10, "1e-60")
+    assert_raises(ArgumentError) { Calc.constant(:tau) }
+    assert_raises(Calc::MathError) { Calc.constant(:pi, 0) }
+    assert_raises(Calc::MathError) { Calc.pi(-1) }
+  end
+
+  def test_constant_cache
+    # more precision than anything else in the tests asks for
+    Calc.prewarm_constants("1e-1200")
+    before = Calc.constant_cache_stats
+    assert_equal %i[pi e ln2 ln10], before.keys
+    assert_operator before[:pi][:digits], :>=, 1200
+
+    # less precise values come from the cache and match a direct calculation
+    assert_equal Calc::Q(-1).acos("1e-1000"), Calc.pi("1e-1000")
+    assert_equal Calc::Q(-1).acos("1e-7"), Calc.pi("1e-7")
+    after = Calc.constant_cache_stats
+    assert_equal before[:pi][:bits], after[:pi][:bits]
+    assert_equal before[:pi][:misses], after[:pi][:misses]
+    assert_equal before[:pi][:hits] + 2, after[:pi][:hits]
+
+    # more precision extends the cached value
+    bits = after[:e][:bits]
+    Calc.constant(:e, Rational(1, 2**(2 * bits)))
+    assert_operator Calc.constant_cache_stats[:e][:bits], :>, 2 * bits
+  end
+
+  def test_tune_agm
+    with_config(:agm_digits, Calc.config(:agm_digits)) do
+      with_config(:agm_pi_digits, Calc.config(:agm_pi_digits)) do
+        r = Calc.tune_agm(2000)
+        assert_equal %i[agm_digits agm_pi_digits], r.keys
+        assert_equal r[:agm_digits], Calc.config(:agm_digits)
+        assert_equal r[:agm_pi_digits], Calc.config(:agm_pi_digits)
+        r.each_value { |v| assert_includes [0, 1000, 2000], v }
+      end
+    end
+  end
+
+  def test_pmap
+    values = [Calc::Q(1, 3), 2, Rational(-5, 7), 0.5, Calc::C(1, 2), Complex(0, -3), 30]
+    %i[acos acosh acot acoth acsc acsch asec asech asin asinh atan atanh cos cosh cot coth
+       csc csch exp ln log sec sech sin sinh sqrt tan tanh].each do |f|
+      xs = values
+      xs = values.reject(&:zero?) if %i[ln log].include?(f)
+      [[], ["1e-12"], [Calc::Q(1, 1000)]].each do |args|
+        expected = xs.map { |x| Calc::Q(0).+(x).__send__(f, *args) }
+        actual = Calc.pmap(xs, f, *args)
+        assert_equal expected.size, actual.size
+        expected.zip(actual) do |e, a|
+          assert_instance_of e.class, a, "#{ f }(#{ args.join }) result class"
+          assert_equal e, a, "#{ f }(#{ args.join })"
+        end
+      end
+    end
+
+    # sqrt with rounding flags
+    assert_equal [3, -2, 2].map { |x| Calc::Q(x).sqrt("0.1", 1) },
+                 Calc.pmap([3, -2, 2], "sqrt", "0.1", 1)
+
+    # methods without a direct version are called normally
+    assert_equal [Calc::Q(2), Calc::Q(3)], Calc.pmap([4, 10], :isqrt)
+    assert_equal [Calc::Q(5)], Calc.pmap([Calc::C(3, 4)], :abs)
+    assert_equal [], Calc.pmap([], :sin)
+    require "set"
+    assert_equal [Calc::Q(0)], Calc.pmap(Set[0], :sin)
+
+    assert_raises(ArgumentError) { Calc.pmap([1]) }
+    assert_raises(ArgumentError) { Calc.pmap([1, "a"], :sin) }
+    assert_raises(ArgumentError) { Calc.pmap([1], :sin, 1, 2) }
+    assert_raises(NoMethodError) { Calc.pmap([1], :nosuchmethod) }
+  end
+
   def test_polar
     assert_rational_and_equal 2, Calc.polar(2, 0)
     assert_complex_parts [-0.41615, 0.9093], Calc.polar(1, 2, "1e-5")
@@ -41,10 +121,159 @@ class TestCalc < Minitest::Test
                          Calc.avg(1, Complex(0, 1), 2, Complex(0, -2))
   end
 
+  def test_dot
+    assert_rational_and_equal 32, Calc.dot([1, 2, 3], [4, 5, 6])
+    assert_rational_and_equal 2, Calc.dot([Rational(1, 2), Rational(1, 3)], [2, 3])
+    assert_rational_and_equal 0, Calc.dot([], [])
+    assert_rational_and_equal Rational(-1, 3), Calc.dot([Calc::Q(1, 3)], [-1])
+    assert_rational_and_equal 1, Calc.dot([Complex(0, 1), 1], [Complex(0, 1), 2])
+    assert_complex_parts [Rational(1, 2), Rational(7, 3)],
+                         Calc.dot([Calc::C(Rational(1, 2), 1), 2], [1, Calc::C(0, Rational(2, 3))])
+
+    # anything with to_a
+    require "matrix"
+    assert_rational_and_equal 11, Calc.dot(Vector[1, 2], Vector[3, 4])
+
+    # compare with a ruby sum of products
+    srand(3)
+    xs = Array.new(40) { Rational(rand(-10**20..10**20), rand(1..10**8)) }
+    ys = Array.new(40) { Rational(rand(-10**20..10**20), rand(1..10**8)) }
+    assert_rational_and_equal xs.zip(ys).map { |x, y| x * y }.inject(:+), Calc.dot(xs, ys)
+
+    assert_raises(Calc::MathError) { Calc.dot([1, 2], [1]) }
+    assert_raises(ArgumentError) { Calc.dot([1, "a"], [1, 2]) }
+    assert_raises(TypeError) { Calc.dot(1, [1]) }
+  end
+
   def test_freeeuler
     assert_nil Calc.freeeuler
   end
 
+  def test_export_load_bernoulli
+    require "tempfile"
+    Calc.freebernoulli
+    assert_equal({ entries: 0, highest: -1, bytes: 0, mapped_bytes: 0 },
+                 Calc.bernoulli_cache_stats)
+    expected = (0..40).map { |i| Calc::Q(i).bernoulli }
+    assert_equal 41, Calc.bernoulli_cache_stats[:entries]
+    assert_equal 40, Calc.bernoulli_cache_stats[:highest]
+    assert_operator Calc.bernoulli_cache_size, :>, 0
+
+    file = Tempfile.new("bernoulli")
+    assert_equal 51, Calc.export_bernoulli(file.path, 50)
+    Calc.freebernoulli
+    assert_equal 0, Calc.bernoulli_cache_size
+    assert_equal 51, Calc.load_bernoulli(file.path)
+    stats = Calc.bernoulli_cache_stats
+    assert_equal 51, stats[:entries]
+    assert_equal 50, stats[:highest]
+    assert_equal File.size(file.path), stats[:mapped_bytes]
+    assert_equal expected, (0..40).map { |i| Calc::Q(i).bernoulli }
+    assert_equal Calc::Q("495057205241079648212477525/66"), Calc::Q(50).bernoulli
+    assert_equal 0, Calc.bernoulli_cache_size
+
+    assert_raises(ArgumentError) { Calc.load_euler(file.path) }
+    File.binwrite(file.path, "not a table")
+    assert_raises(ArgumentError) { Calc.load_bernoulli(file.path) }
+    assert_raises(SystemCallError) { Calc.load_bernoulli(file.path + ".missing") }
+    Calc.freebernoulli
+    assert_equal 0, Calc.bernoulli_cache_stats[:mapped_bytes]
+  ensure
+    file.close! if file
+  end
+
+  def test_export_load_euler
+    require "tempfile"
+    Calc.freeeuler
+    file = Tempfile.new("euler")
+    assert_equal 21, Calc.export_euler(file.path, 20)
+    assert_equal 20, Calc.euler_cache_stats[:highest]
+    Calc.freeeuler
+    assert_equal 21, Calc.load_euler(file.path)
+    assert_equal 370371188237525, Calc::Q(20).euler
+    assert_equal 0, Calc::Q(19).euler
+    assert_equal 0, Calc.euler_cache_size
+    assert_equal File.size(file.path), Calc.euler_cache_stats[:mapped_bytes]
+    Calc.freeeuler
+  ensure
+    file.close! if file
+  end
+
+  def test_primes
+    assert_equal [2, 3, 5, 7, 11, 13, 17, 19, 23, 29], Calc.primes(0, 30)
+    assert_instance_of Calc::Q, Calc.primes(0, 30).first
+    assert_equal [17], Calc.primes(17, 17)
+    assert_equal [11, 13], Calc.primes(-10, 16).last(2)
+    assert_equal [], Calc.primes(100, 90)
+    assert_equal [], Calc.primes(24, 28)
+    assert_equal [4294967291, 4294967311], Calc.primes(2**32 - 5, 2**32 + 15)
+
+    require "prime"
+    expected = Prime.each(3_000_000).select { |p| p >= 1_234_567 }
+    assert_equal expected, Calc.primes(1_234_567, 3_000_000)
+    assert_equal expected, Calc.primes(1_234_567, 3_000_000, 1)
+    assert_equal expected, Calc.primes(Calc::Q(1_234_567), 3_000_000, 3)
+
+    assert_raises(Calc::MathError) { Calc.primes(Rational(1, 2), 10) }
+    assert_raises(Calc::MathError) { Calc.primes(0, 2**64) }
+  end
+
+  def test_each_prime
+    found = []
+    assert_nil Calc.each_prime(10, 30) { |p| found << p }
+    assert_equal [11, 13, 17, 19, 23, 29], found
+    assert_equal Calc::Q(1099511627791), Calc.each_prime(2**40, 2**40 + 100).first
+    assert_instance_of Enumerator, Calc.each_prime(1, 10)
+    assert_equal [2, 3, 5, 7], Calc.each_prime(1, 10).to_a
+    n = 0
+    Calc.each_prime(1, 10**7) { n += 1; break if n == 5 }
+    assert_equal 5, n
+  end
+
+  def test_count_primes
+    assert_equal 25, Calc.count_primes(1, 100)
+    assert_instance_of Calc::Q, Calc.count_primes(1, 100)
+    assert_equal 0, Calc.count_primes(14, 16)
+    assert_equal 664579, Calc.count_primes(0, 10**7)
+    assert_equal 664579, Calc.count_primes(0, 10**7, 1)
+    assert_equal 5761455, Calc.count_primes(1, 10**8)
+    assert_equal Calc.primes(10**12, 10**12 + 10**5).size,
+                 Calc.count_primes(10**12, 10**12 + 10**5, 2)
+  end
+
+  def test_ptest_many
+    assert_equal [true, false, true], Calc.ptest_many([2**61 - 1, 2**62 - 1, 2**89 - 1], 20)
+    assert_equal [], Calc.ptest_many([])
+    assert_equal [false, false, true, true, false, true], Calc.ptest_many([0, 1, 2, -7, 9, Calc::Q(13)])
+
+    # exact below 2**32, whatever the count
+    assert_equal [false, true], Calc.ptest_many([3215031751, 4294967291], 0)
+    # strong pseudoprimes: 2152302898747 to bases 2 to 12, 3825123056546413051
+    # to bases 2 to 36
+    spsp = [2152302898747, 3825123056546413051]
+    assert_equal [true, true], Calc.ptest_many(spsp, 5)
+    assert_equal [false, true], Calc.ptest_many(spsp, 9)
+    assert_equal [false, false], Calc.ptest_many(spsp, 12)
+    assert_equal [false, true], Calc.ptest_many(spsp, 10, 13)
+
+    srand(1)
+    values = (2**32 - 1000..2**32 + 1000).to_a + Array.new(500) { rand(2**300) } +
+             Array.new(50) { Calc::Q(rand(2**600)).nextcand }
+    expected = values.map { |v| Calc::Q(v).ptest?(20) }
+    assert_equal expected, Calc.ptest_many(values, 20)
+    assert_equal expected, Calc.ptest_many(values, 20, 1, 3)
+    assert_equal expected, Calc.ptest_many(values, 10, 0, 2)
+    assert_equal expected, Calc.ptest_many(values, 10, 100)
+    assert_equal expected, Calc.ptest_many(values, :bpsw)
+    assert_equal [false, false], Calc.ptest_many(spsp, :bpsw, nil, 2)
+
+    assert_raises(Calc::MathError) { Calc.ptest_many([Calc::Q(1, 2)]) }
+    assert_raises(Calc::MathError) { Calc.ptest_many([7], 1, -1) }
+    assert_raises(Calc::MathError) { Calc.ptest_many([7], 1, 2**32) }
+    assert_raises(TypeError) { Calc.ptest_many(7) }
+    assert_raises(ArgumentError) { Calc.ptest_many([7], 1, 1, 0) }
+  end
+
   def test_hmean
     assert_nil Calc.hmean
     assert_rational_and_equal 1, Calc.hmean(1)
@@ -65,6 +294,51 @@ class TestCalc < Minitest::Test
     assert_rational_and_equal 33827019788296445, Calc.hnrmod(10**40, 17, 51, 1)
   end
 
+  def test_matmul
+    r = Calc.matmul([[1, 2], [3, 4]], [[5, 6], [7, 8]])
+    assert_equal 2, r.size
+    assert_rational_array [19, 22], r[0]
+    assert_rational_array [43, 50], r[1]
+    r = Calc.matmul([[Rational(1, 2), Calc::Q(1, 3)]], [[Rational(1, 2)], [Rational(3, 2)]])
+    assert_rational_array [Calc::Q("3/4")], r[0]
+    r = Calc.matmul([[0, -1], [1, 0]], [[0, -1], [1, 0]])
+    assert_rational_array [-1, 0], r[0]
+    assert_rational_array [0, -1], r[1]
+
+    # complex elements; imaginary parts which cancel give Calc::Q
+    r = Calc.matmul([[Complex(1, 2), 3]], [[Complex(0, 1), 1], [2, Calc::C(0, 1)]])
+    assert_complex_parts [4, 1], r[0][0]
+    assert_complex_parts [1, 5], r[0][1]
+    assert_rational_and_equal 5, Calc.matmul([[Complex(1, 2)]], [[Complex(1, -2)]])[0][0]
+
+    assert_raises(Calc::MathError) { Calc.matmul([[1, 2]], [[1, 2]]) }
+    assert_raises(ArgumentError) { Calc.matmul([[1, 2], [3]], [[1], [2]]) }
+    assert_raises(ArgumentError) { Calc.matmul([], []) }
+    assert_raises(ArgumentError) { Calc.matmul([[1]], [[1]], 0) }
+  end
+
+  def test_matmul_large
+    # bigger than one block, with big numerators/denominators and negatives.
+    # compare against plain ruby rationals and check the number of threads
+    # doesn't change the answer
+    srand(42)
+    rnd = -> { Rational(rand(-10**30..10**30), rand(1..10**25)) }
+    a = Array.new(13) { Array.new(21) { rnd.call } }
+    b = Array.new(21) { Array.new(17) { rnd.call } }
+    expected = a.map { |row| b.transpose.map { |col| row.zip(col).map { |x, y| x * y }.inject(:+) } }
+    [1, 2, 5].each do |threads|
+      actual = Calc.matmul(a, b, threads)
+      assert_equal 13, actual.size
+      actual.each_with_index do |row, i|
+        assert_equal 17, row.size
+        row.each_with_index do |x, j|
+          assert_instance_of Calc::Q, x
+          assert_equal expected[i][j], x.to_r
+        end
+      end
+    end
+  end
+
   def test_max
     assert_rational_and_equal 2, Calc.max(2)
     assert_rational_and_equal 2, Calc.max(2, nil)
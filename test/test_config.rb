@@ -117,4 +117,77 @@ class TestConfig < Minitest::Test
     assert_raises(Calc::MathError) { Calc.config(:sqrt, 0.5) }
     assert_raises(Calc::MathError) { Calc.config(:sqrt, -1) }
   end
+
+  def test_threads
+    assert_equal 0, Calc.config(:threads)
+    with_config(:threads, 0, 3) do
+      assert_equal 3, Calc.config(:threads)
+      r = Calc.matmul([[1, 2], [3, 4]], [[5, 6], [7, 8]])
+      assert_equal [[19, 22], [43, 50]], r
+    end
+    assert_raises(Calc::MathError) { Calc.config(:threads, -1) }
+  end
+
+  def test_memo
+    expected = [Calc::Q(2).exp, Calc::Q(2).exp("1e-5"), Calc::Q(-4).ln, Calc::C(1, 2).sqrt]
+    with_config(:memo, 0, 3) do
+      Calc.memo_clear
+      2.times do
+        actual = [Calc::Q(2).exp, Calc::Q(2).exp("1e-5"), Calc::Q(-4).ln, Calc::C(1, 2).sqrt]
+        assert_equal expected, actual
+        assert_instance_of Calc::C, actual[2]
+      end
+      stats = Calc.memo_stats
+      assert_equal 3, stats[:capacity]
+      assert_equal 3, stats[:entries]
+      assert_equal 8, stats[:misses]
+      assert_equal 0, stats[:hits]
+      assert_equal 5, stats[:evictions]
+
+      Calc.memo_clear
+      3.times { Calc::Q(2).exp }
+      assert_equal 2, Calc.memo_stats[:hits]
+
+      with_config(:memo_bytes, 0, 1) do
+        Calc::Q(3).exp
+        assert_equal 1, Calc.memo_stats[:entries]
+      end
+    end
+    assert_equal 0, Calc.memo_stats[:entries]
+    assert_raises(Calc::MathError) { Calc.config(:memo, -1) }
+
+    # the hash table grows with the entries, not the capacity
+    with_config(:memo, 0, 2**26) do
+      empty = Calc.memo_stats[:bytes]
+      assert_operator empty, :>, 0
+      assert_operator empty, :<, 4096
+      100.times { |i| Calc::Q(i + 2).exp }
+      assert_operator Calc.memo_stats[:bytes], :>, empty
+    end
+    assert_equal 0, Calc.memo_stats[:bytes]
+  end
+
+  def test_bsplit_digits
+    with_config(:bsplit_digits, 1000, 5) do
+      assert_equal 5, Calc.config(:bsplit_digits)
+    end
+    assert_raises(Calc::MathError) { Calc.config(:bsplit_digits, -1) }
+  end
+
+  def test_bernoulli_zeta
+    with_config(:bernoulli_zeta, 100, 5) do
+      assert_equal 5, Calc.config(:bernoulli_zeta)
+    end
+    assert_raises(Calc::MathError) { Calc.config(:bernoulli_zeta, -1) }
+  end
+
+  def test_agm_digits
+    with_config(:agm_digits, 100000, 5) do
+      assert_equal 5, Calc.config(:agm_digits)
+    end
+    with_config(:agm_pi_digits, 0, 5) do
+      assert_equal 5, Calc.config(:agm_pi_digits)
+    end
+    assert_raises(Calc::MathError) { Calc.config(:agm_digits, -1) }
+  end
 end
@@ -0,0 +1,55 @@
+require "minitest_helper"
+
+class TestEpsilon < MiniTest::Test
+  def test_class_exists
+    refute_nil Calc::Epsilon
+  end
+
+  def test_new
+    e = Calc::Epsilon.new("1e-40")
+    assert_instance_of Calc::Epsilon, e
+    assert_kind_of Calc::Q, e
+    assert e.frozen?
+    assert_equal Rational(1, 10**40), e
+    assert_same e, Calc::Epsilon.new("1e-40")
+    assert_same e, Calc::Epsilon.new(e)
+    assert_same Calc::Epsilon.new(Rational(1, 1000)), Calc::Epsilon.new(Rational(1, 1000))
+    assert_equal Rational(1, 1000), Calc::Epsilon.new(Calc::Q("0.001"))
+    assert_instance_of Calc::Epsilon, Calc::Epsilon.new(Calc::Q("0.001"))
+    assert_equal Rational(1, 8), Calc::Epsilon.new(0.125)
+  end
+
+  def test_invalid
+    assert_raises(Calc::MathError) { Calc::Epsilon.new(0) }
+    assert_raises(Calc::MathError) { Calc::Epsilon.new("-1e-5") }
+    assert_raises(Calc::MathError) { Calc::Epsilon.new(Calc::Q(-1)) }
+    assert_raises(ArgumentError) { Calc::Epsilon.new(nil) }
+  end
+
+  def test_arithmetic
+    e = Calc::Epsilon.new("1e-10")
+    assert_instance_of Calc::Q, e * 2
+    assert_rational_and_equal Rational(2, 10**10), e * 2
+  end
+
+  def test_as_epsilon
+    e = Calc::Epsilon.new("1e-30")
+    assert_equal Calc::Q(2).sqrt("1e-30"), Calc::Q(2).sqrt(e)
+    assert_equal Calc::Q(2).exp("1e-30"), Calc::Q(2).exp(e)
+    assert_equal Calc::Q(2).exp("1e-30"), Calc::Q(2).exp(Rational(1, 10**30))
+    assert_equal Calc::C(1, 2).sin("1e-30"), Calc::C(1, 2).sin(e)
+    assert_equal Calc::Q(2).ln("1e-30"), Calc::Q(2).ln(e)
+    assert_equal Calc.pi("1e-30"), Calc.pi(e)
+  end
+
+  def test_interned
+    Calc::Q(2).sqrt("1e-7")
+    n = Calc::Epsilon.interned
+    assert_operator n, :>=, 1
+    Calc::Q(3).sqrt("1e-7")
+    assert_equal n, Calc::Epsilon.interned
+    # unusable epsilons aren't interned, and still give the same errors
+    assert_raises(Calc::MathError) { Calc.pi("-1e-7") }
+    assert_equal n, Calc::Epsilon.interned
+  end
+end
@@ -0,0 +1,86 @@
+require "minitest_helper"
+
+class TestModContext < MiniTest::Test
+  M127 = 2**127 - 1
+
+  def test_class_exists
+    refute_nil Calc::ModContext
+    refute_nil Calc::ModContext::Residue
+  end
+
+  def test_initialization
+    ctx = Calc::ModContext.new(101)
+    assert_rational_and_equal 101, ctx.modulus
+    assert_rational_and_equal M127, Calc::ModContext.new(Calc::Q(M127)).modulus
+    assert_equal "Calc::ModContext(101)", ctx.inspect
+    [100, 1, 0, -7, Calc::Q(7, 3)].each do |m|
+      assert_raises(Calc::MathError) { Calc::ModContext.new(m) }
+    end
+    assert_raises(ArgumentError) { Calc::ModContext.allocate.reduce(1) }
+    assert_raises(TypeError) { Calc::ModContext::Residue.new }
+  end
+
+  def test_reduce
+    ctx = Calc::ModContext.new(7)
+    assert_rational_and_equal 3, ctx.reduce(10).to_q
+    assert_rational_and_equal 6, ctx.reduce(-1).to_q
+    assert_rational_and_equal 0, ctx.reduce(Calc::Q(14)).to_q
+    assert_equal 5, ctx.reduce(5).to_i
+    assert_equal "5", ctx.reduce(5).to_s
+    assert_equal "Calc::ModContext::Residue(6 mod 7)", ctx.reduce(-1).inspect
+    r = ctx.reduce(3)
+    assert_same r, ctx.reduce(r)
+    assert_same ctx, r.context
+    assert_raises(Calc::MathError) { ctx.reduce(Calc::Q(1, 2)) }
+  end
+
+  def test_equality
+    ctx = Calc::ModContext.new(7)
+    assert_equal ctx.reduce(10), ctx.reduce(3)
+    refute_equal ctx.reduce(4), ctx.reduce(3)
+    refute_equal Calc::ModContext.new(7).reduce(3), ctx.reduce(3)
+    assert ctx.reduce(10) == 3
+    refute ctx.reduce(10) == 10
+  end
+
+  def test_mul
+    ctx = Calc::ModContext.new(M127)
+    a = 3**70
+    b = -(5**50)
+    assert_rational_and_equal((a * b) % M127, ctx.mul(a, b).to_q)
+    assert_rational_and_equal((a * b) % M127, (ctx.reduce(a) * b).to_q)
+    assert_rational_and_equal 1, Calc::ModContext.new(7).mul(3, 5).to_q
+    assert_raises(ArgumentError) { ctx.mul(Calc::ModContext.new(7).reduce(1), 2) }
+  end
+
+  def test_pow
+    ctx = Calc::ModContext.new(101)
+    assert_rational_and_equal 1, ctx.pow(2, 100).to_q
+    assert_rational_and_equal 1, ctx.pow(2, 0).to_q
+    assert_rational_and_equal 51, ctx.pow(2, -1).to_q
+    assert_rational_and_equal 32, (ctx.reduce(2)**5).to_q
+    assert_rational_and_equal 246336683, Calc::ModContext.new(1_000_000_007).pow(3, 10**18).to_q
+    assert_raises(Calc::MathError) { ctx.pow(2, Calc::Q(1, 2)) }
+    assert_raises(Calc::MathError) { ctx.pow(0, -1) }
+
+    ctx = Calc::ModContext.new(M127)
+    [2**200 + 1, 3**100, 65537].each do |e|
+      assert_rational_and_equal Calc::Q(12345).pmod(e, M127), ctx.pow(12345, e).to_q
+    end
+    # fermat's little theorem, with the result staying in montgomery form
+    x = ctx.reduce(2**100 + 7)
+    assert_equal x, x**(M127 - 1) * x
+  end
+
+  def test_inv
+    ctx = Calc::ModContext.new(101)
+    assert_rational_and_equal 51, ctx.inv(2).to_q
+    assert_rational_and_equal 100, ctx.inv(-1).to_q
+    ctx = Calc::ModContext.new(M127)
+    x = ctx.pow(3, 2**100)
+    assert_equal 1, ctx.inv(x) * x
+    assert_rational_and_equal Calc::Q(3**80).minv(M127), ctx.inv(3**80).to_q
+    assert_raises(Calc::MathError) { Calc::ModContext.new(15).inv(6) }
+    assert_raises(Calc::MathError) { ctx.inv(0) }
+  end
+end
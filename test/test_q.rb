@@ -504,6 +504,32 @@ class TestQ < MiniTest::Test
     assert_rational_in_epsilon 7.38905609893065022723, Calc::Q(2).exp
   end
 
+  # binary splitting (above bsplit_digits) must agree with libcalc
+  def test_exp_ln_atan_bsplit
+    eps = Rational(1, 10**300)
+    values = [Calc::Q(1, 3), Calc::Q(-7, 2), Calc::Q(2), Calc::Q(123, 4), Calc::Q(1, 10**20)]
+    expected = with_config(:bsplit_digits, 0) do
+      values.map { |v| [v.exp(eps), v.abs.ln(eps), v.atan(eps)] }
+    end
+    actual = with_config(:bsplit_digits, 5) do
+      values.map { |v| [v.exp(eps), v.abs.ln(eps), v.atan(eps)] }
+    end
+    expected.zip(actual).each do |e, a|
+      e.zip(a).each { |x, y| assert (x - y).abs <= eps, "#{ x } != #{ y }" }
+    end
+  end
+
+  # AGM (above agm_digits) must agree with the series methods
+  def test_ln_log_agm
+    eps = Rational(1, 10**300)
+    values = [Calc::Q(10, 7), Calc::Q(3), Calc::Q(1, 2), Calc::Q(1, 10**30), Calc::Q(10**50 + 1)]
+    expected = with_config(:agm_digits, 0) { values.map { |v| [v.ln(eps), v.log(eps)] } }
+    actual = with_config(:agm_digits, 5) { values.map { |v| [v.ln(eps), v.log(eps)] } }
+    expected.zip(actual).each do |e, a|
+      e.zip(a).each { |x, y| assert (x - y).abs <= eps, "#{ x } != #{ y }" }
+    end
+  end
+
   # libcalc ln is equivalent to Math.log
   def test_ln
     assert_raises(Calc::MathError) { Calc::Q(0).ln }
@@ -528,6 +554,10 @@ class TestQ < MiniTest::Test
     assert_rational_in_epsilon 1.62658, Calc::Q(7).root(4, "1e-5")
     assert_complex_parts [1, 1.73205080756887729353], Calc::Q(-8).root(3)
     assert_complex_parts [1.05853417471250289584, 0.09808763630065831473], Calc::Q(-8).root(34)
+    x = Calc::Q(7).root(4, Rational(1, 10**2000))
+    assert (x**4 - 7).abs < Rational(1, 10**1990)
+    assert_rational_and_equal x.round(1990), Calc::Q(7).root(4, Rational(1, 10**1990))
+    assert_rational_and_equal Calc::Q(10**1000), Calc::Q(10**4000).root(4, Rational(1, 10**2000))
 
     assert_raises(Calc::MathError) { Calc::Q(1).root(0) }
     assert_raises(Calc::MathError) { Calc::Q(0).root(-1) }
@@ -553,6 +583,45 @@ class TestQ < MiniTest::Test
     assert_rational_in_epsilon 1.17520119364380145688, Calc::Q(1).sinh
   end
 
+  def test_sincos
+    s, c = Calc::Q(0).sincos
+    assert_rational_and_equal 0, s
+    assert_rational_and_equal 1, c
+    s, c = Calc::Q(1).sincos
+    assert_rational_in_epsilon 0.84147098480789650665, s
+    assert_rational_in_epsilon 0.54030230586813971740, c
+    ["1e-40", "1e-300"].each do |eps|
+      ["-1", "0.25", "355/113", "-710/113", "100", "1e20"].each do |x|
+        q = Calc::Q(x)
+        s, c = q.sincos(eps)
+        assert_in_delta q.sin(eps), s, Calc::Q(eps), "sin(#{ x })"
+        assert_in_delta q.cos(eps), c, Calc::Q(eps), "cos(#{ x })"
+      end
+    end
+    assert_raises(Calc::MathError) { Calc::Q(1).sincos(0) }
+  end
+
+  def test_sinhcosh
+    s, c = Calc::Q(0).sinhcosh
+    assert_rational_and_equal 0, s
+    assert_rational_and_equal 1, c
+    s, c = Calc::Q(1).sinhcosh
+    assert_rational_in_epsilon 1.17520119364380145688, s
+    assert_rational_in_epsilon 1.54308063481524377848, c
+    ["-3", "0.001", "40"].each do |x|
+      q = Calc::Q(x)
+      s, c = q.sinhcosh("1e-50")
+      assert_in_delta q.sinh("1e-50"), s, Calc::Q("1e-50"), "sinh(#{ x })"
+      assert_in_delta q.cosh("1e-50"), c, Calc::Q("1e-50"), "cosh(#{ x })"
+    end
+  end
+
+  def test_cis
+    assert_rational_and_equal 1, Calc::Q(0).cis
+    assert_complex_parts [0.54030230586813971740, 0.84147098480789650665], Calc::Q(1).cis
+    assert_complex_parts [-0.98999249660044545727, -0.14112000805986722210], Calc::Q(-3).cis
+  end
+
   def test_tan
     assert_rational_and_equal 0, Calc::Q(0).tan
     assert_rational_in_epsilon 1.55740772465490223051, Calc::Q(1).tan
@@ -596,6 +665,37 @@ class TestQ < MiniTest::Test
     assert_nil Calc.freebernoulli
   end
 
+  def test_bernoulli_zeta
+    b100 = "-94598037819122125295227433069493721872702841533066936133385696" \
+           "204311395415197247711/33330"
+    expected = with_config(:bernoulli_zeta, 0) do
+      Calc.freebernoulli
+      (0..160).map { |n| Calc::Q(n).bernoulli }
+    end
+    Calc.freebernoulli
+    with_config(:bernoulli_zeta, 2) do
+      assert_equal Calc::Q(b100), Calc::Q(100).bernoulli
+      (0..160).each { |n| assert_equal expected[n], Calc::Q(n).bernoulli, "B(#{ n })" }
+      Calc.freebernoulli
+      assert_equal expected, Calc.bernoulli_range(0, 160)
+      Calc.freebernoulli
+      assert_equal expected[101..160], Calc.bernoulli_range(101, 160)
+      assert_equal expected, Calc.bernoulli_range(0, 160)
+
+      # zeta_bits(5040) is larger than zeta_bits(5042)
+      singles = (5040..5042).map do |n|
+        Calc.freebernoulli
+        Calc::Q(n).bernoulli
+      end
+      Calc.freebernoulli
+      assert_equal singles, Calc.bernoulli_range(5040, 5042)
+      assert_equal singles[0], Calc::Q(5040).bernoulli
+    end
+    assert_equal [], Calc.bernoulli_range(5, 4)
+    assert_raises(Calc::MathError) { Calc.bernoulli_range(-1, 4) }
+    Calc.freebernoulli
+  end
+
   def test_agd
     assert_equal 0, Calc::Q(0).agd
     assert_instance_of Calc::Q, Calc::Q(1).agd
@@ -781,6 +881,20 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal Calc::Q(".0002"), (Calc::Q(".00015")**2).sqrt(eps, 24)
   end
 
+  # large roots use newton's method; rounding must match config("sqrt")
+  def test_sqrt_large
+    eps = Rational(1, 10**2000)
+    n = 2 * 10**4000
+    r = Integer.sqrt(n)
+    assert_rational_and_equal Calc::Q(r, 10**2000), Calc::Q(2).sqrt(eps, 0)
+    assert_rational_and_equal Calc::Q(r + 1, 10**2000), Calc::Q(2).sqrt(eps, 1)
+    nearest = 4 * n > (2 * r + 1)**2 ? r + 1 : r
+    assert_rational_and_equal Calc::Q(nearest, 10**2000), Calc::Q(2).sqrt(eps)
+    assert_complex_parts [0, Calc::Q(nearest, 10**2000)], Calc::Q(-2).sqrt(eps)
+    assert_rational_and_equal Calc::Q(10**3000), Calc::Q(10**6000).sqrt(eps)
+    assert_rational_and_equal Calc::Q(-nearest, 10**2000), Calc::Q(2).sqrt(eps, 64 + 24)
+  end
+
   def test_ceil
     assert_rational_and_equal 27, Calc::Q(27).ceil
     assert_rational_and_equal 2, Calc::Q(1.23).ceil
@@ -996,6 +1110,43 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 179951, Calc::Q(2).power(59).-(1).factor
   end
 
+  def test_factorize
+    assert_equal [], Calc::Q(1).factorize
+    assert_equal [[-1, 1]], Calc::Q(-1).factorize
+    assert_equal [[2, 3], [3, 2], [5, 1]], Calc::Q(360).factorize
+    assert_equal [[-1, 1], [2, 3], [3, 2], [5, 1]], Calc::Q(-360).factorize
+    Calc::Q(360).factorize.flatten.each { |x| assert_instance_of Calc::Q, x }
+    assert_equal [[274177, 1], [67280421310721, 1]], Calc::Q(2**64 + 1).factorize
+    assert_equal [[65537, 2]], Calc::Q(65537 * 65537).factorize
+    m61 = 2**61 - 1
+    assert_equal [[3, 7], [m61, 3]], Calc::Q(3**7 * m61**3).factorize
+    assert_equal [[1000003, 1], [m61, 2]], Calc::Q(m61 * 1000003 * m61).factorize
+
+    # needs rho, then ecm (the factors are too big for rho)
+    assert_equal [[193707721, 1], [761838257287, 1]], Calc::Q(2**67 - 1).factorize
+    f1 = 773834513718859
+    f2 = 985782597079171
+    assert_equal [[f1, 1], [f2, 1]], Calc::Q(f1 * f2).factorize
+    assert_equal [[f1, 1], [f2, 1]], Calc::Q(f1 * f2).factorize(threads: 2)
+
+    # quadratic sieve
+    assert_equal [[f1, 1], [f2, 1]], Calc::Q(f1 * f2).factorize(method: :qs)
+    assert_equal [[f1, 1], [f2, 1]], Calc::Q(f1 * f2).factorize(method: :ecm)
+    assert_equal [[2, 3], [59649589127497217, 1], [5704689200685129054721, 1]],
+                 Calc::Q(8 * (2**128 + 1)).factorize(method: :qs, threads: 2)
+    progress = []
+    Calc::Q(f1 * f2).factorize(method: :qs) { |found, needed| progress << [found, needed] }
+    refute_empty progress
+    progress.each { |found, needed| assert_operator found, :<=, needed + 64 }
+    assert_nil(Calc::Q(2**128 + 1).factorize(method: :qs) { break })
+
+    assert_raises(Calc::MathError) { Calc::Q(0).factorize }
+    assert_raises(Calc::MathError) { Calc::Q(1, 2).factorize }
+    assert_raises(ArgumentError) { Calc::Q(6).factorize(foo: 1) }
+    assert_raises(ArgumentError) { Calc::Q(6).factorize(threads: 0) }
+    assert_raises(ArgumentError) { Calc::Q(6).factorize(method: :nfs) }
+  end
+
   def test_fcnt
     assert_rational_and_equal 0, Calc::Q(7).fcnt(4)
     assert_rational_and_equal 1, Calc::Q(24).fcnt(4)
@@ -1087,12 +1238,42 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 4, Calc::Q(100).iroot(3)
     assert_rational_and_equal 6, Calc::Q(274).iroot(3)
     assert_rational_and_equal 1, Calc::Q(1).iroot(9)
+    assert_rational_and_equal 0, Calc::Q(0).iroot(3)
     assert_rational_and_equal 6, Calc.pi.**(8).iroot(5)
     assert_rational_and_equal(-3, Calc::Q(-44).iroot(3))
+    r = 3 * 10**1700 + 17
+    assert_rational_and_equal r, Calc::Q(r**5 + r).iroot(5)
+    assert_rational_and_equal r - 1, Calc::Q(r**5 - 1).iroot(5)
     assert_raises(Calc::MathError) { Calc::Q(2).iroot(0) }
     assert_raises(Calc::MathError) { Calc::Q(2).iroot(0.5) }
   end
 
+  def test_many
+    values = [Calc::Q(1, 3), 2, Rational(-5, 7), 0.5, "1/7", 30]
+    Calc::Numeric::MANY_FUNCTIONS.each do |f|
+      [[], ["1e-15"]].each do |args|
+        expected = values.map { |x| Calc::Q(x).__send__(f, *args) }
+        assert_equal expected, Calc::Q.__send__("#{ f }_many", values, *args), f
+      end
+    end
+    assert_equal [Calc::Q(2), Calc::Q(3)], Calc::Q.many([4, 10], :isqrt)
+    assert_equal [], Calc::Q.sin_many([])
+    assert_raises(ArgumentError) { Calc::Q.sin_many([Complex(1, 1)]) }
+    assert_raises(ArgumentError) { Calc::Q.many([1]) }
+  end
+
+  def test_muladd
+    assert_rational_and_equal 10, Calc::Q(2).muladd(3, 4)
+    assert_rational_and_equal Rational(3, 4), Calc::Q(1, 3).muladd(Calc::Q(3, 4), Calc::Q(1, 2))
+    assert_rational_and_equal Rational(-1, 6), Calc::Q(1, 2).muladd(Rational(-1, 3), 0)
+    assert_rational_and_equal Rational(5, 7), Calc::Q(0).muladd(3, Rational(5, 7))
+    assert_rational_and_equal 0, Calc::Q(1, 2).muladd(2, -1)
+    assert_rational_and_equal Calc::Q(BIG2) * BIG3 + Rational(1, 3), Calc::Q(BIG2).muladd(BIG3, Rational(1, 3))
+    assert_complex_parts [1, 2], Calc::Q(2).muladd(Complex(0, 1), 1)
+    assert_complex_parts [2, 1], Calc::Q(2).muladd(1, Calc::C(0, 1))
+    assert_raises(ArgumentError) { Calc::Q(1).muladd("2", 3) }
+  end
+
   def test_mult
     check_truthy Calc::Q(6), :ismult, :mult?, 2
     check_falsey Calc::Q(2), :ismult, :mult?, 6
@@ -1120,8 +1301,12 @@ class TestQ < MiniTest::Test
   def test_isqrt
     assert_rational_and_equal 2, Calc::Q("8.5").isqrt
     assert_rational_and_equal 14, Calc::Q(200).isqrt
+    assert_equal 0, Calc::Q(0).isqrt
     assert_rational_and_equal 1414, Calc::Q("2e6").isqrt
     assert_rational_and_equal 14142135623730950488016887242, Calc::Q("2e56").isqrt
+    n = 7 * 10**5000 + 12345
+    assert_rational_and_equal Integer.sqrt(n), Calc::Q(n).isqrt
+    assert_rational_and_equal Integer.sqrt(n), Calc::Q(n * 10 + 9, 10).isqrt
     assert_raises(Calc::MathError) { Calc::Q(-1).isqrt }
   end
 
@@ -1254,6 +1439,24 @@ class TestQ < MiniTest::Test
     check_falsey a, :ptest, :ptest?, 12, 1
     check_truthy a, :ptest, :ptest?, 20, 2
     check_falsey a, :ptest, :ptest?, 21, 2
+
+    # baillie-psw
+    check_falsey a, :ptest, :ptest?, :bpsw
+    check_truthy Calc::Q(4294967291), :ptest, :ptest?, :bpsw
+    check_truthy Calc::Q(2**89 - 1), :ptest, :ptest?, :bpsw
+    check_truthy Calc::Q(-(2**127 - 1)), :ptest, :ptest?, :bpsw
+    check_falsey Calc::Q(1), :ptest, :ptest?, :bpsw
+    # strong pseudoprimes to bases 2 to 12, 2 to 36 and 2 to 40
+    [2152302898747, 3825123056546413051, 3317044064679887385961981].each do |n|
+      check_falsey Calc::Q(n), :ptest, :ptest?, :bpsw
+    end
+    check_falsey Calc::Q(1590231231043178376951698401), :ptest, :ptest?, :bpsw
+    check_falsey Calc::Q((2**61 - 1)**2), :ptest, :ptest?, :bpsw
+    srand(1)
+    Array.new(200) { Calc::Q(rand(2**(33 + rand(600)))) }.each do |n|
+      assert_equal n.ptest?(20), n.ptest?(:bpsw), "#{ n }.ptest?(:bpsw)"
+    end
+    assert_raises(Calc::MathError) { Calc::Q(0.5).ptest?(:bpsw) }
   end
 
   def test_prevcand
@@ -1273,6 +1476,22 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 1999999999999999999999999999914000000000000000000000000000031,
                               Calc::Q("2e60").prevcand(1, 1, 31, "1e30")
     assert_raises(Calc::MathError) { Calc::Q(0.5).prevcand }
+
+    assert_rational_and_equal 47, Calc::Q(50).prevcand(:bpsw)
+    assert_nil Calc::Q(2).prevcand(:bpsw)
+    assert_rational_and_equal 97, Calc::Q(100).prevcand(:bpsw, nil, 1, 6)
+    assert_rational_and_equal 89, Calc::Q(100).prevcand(:bpsw, nil, -1, 6)
+    assert_rational_and_equal 2, Calc::Q(100).prevcand(:bpsw, nil, 2, 6)
+    assert_nil Calc::Q(100).prevcand(:bpsw, nil, 4, 6)
+    assert_rational_and_equal 7, Calc::Q(10).prevcand(:bpsw, nil, 0, 7)
+    assert_nil Calc::Q(7).prevcand(:bpsw, nil, 0, 7)
+    assert_nil Calc::Q(20).prevcand(:bpsw, nil, 0, 6)
+    assert_rational_and_equal 53, Calc::Q(100).prevcand(:bpsw, nil, 53, 0)
+    assert_rational_and_equal 53, Calc::Q(100).prevcand(:bpsw, nil, 53, 106)
+    assert_rational_and_equal 18446744073709551557, Calc::Q(2**64).prevcand(:bpsw)
+    assert_rational_and_equal 1999999999999999999999999999914000000000000000000000000000031,
+                              Calc::Q("2e60").prevcand(:bpsw, nil, 31, "1e30")
+    assert_raises(Calc::MathError) { Calc::Q(0.5).prevcand(:bpsw) }
   end
 
   def test_nextcand
@@ -1286,6 +1505,21 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 2000000000000000000000000000053000000000000000000000000000031,
                               Calc::Q("2e60").nextcand(1, 1, 31, "1e30")
     assert_raises(Calc::MathError) { Calc::Q(0.5).nextcand }
+
+    assert_rational_and_equal 53, Calc::Q(50).nextcand(:bpsw)
+    assert_rational_and_equal 103, Calc::Q(100).nextcand(:bpsw, nil, 1, 6)
+    assert_rational_and_equal 101, Calc::Q(100).nextcand(:bpsw, nil, -1, 6)
+    assert_nil Calc::Q(100).nextcand(:bpsw, nil, 2, 6)
+    assert_rational_and_equal 7, Calc::Q(3).nextcand(:bpsw, nil, 0, 7)
+    assert_rational_and_equal 7, Calc::Q(3).nextcand(:bpsw, nil, 14, 7)
+    assert_nil Calc::Q(7).nextcand(:bpsw, nil, 0, 7)
+    assert_rational_and_equal 101, Calc::Q(100).nextcand(:bpsw, nil, 303, 202)
+    assert_rational_and_equal 18446744073709551629, Calc::Q(2**64).nextcand(:bpsw)
+    assert_rational_and_equal 2000000000000000000000000000053000000000000000000000000000031,
+                              Calc::Q("2e60").nextcand(:bpsw, nil, 31, "1e30")
+    x = Calc::Q(10**40)
+    5.times { x = x.nextcand(:bpsw).tap { |y| assert_equal x.nextcand(20), y } }
+    assert_raises(Calc::MathError) { Calc::Q(5).nextcand(:bpsw, nil, 0.5) }
   end
 
   def test_nextprime
@@ -1335,10 +1569,24 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 9592, Calc::Q("1e5").pix
     assert_rational_and_equal 78498, Calc::Q("1e6").pix
     assert_rational_and_equal 203280221, Calc::Q(2**32 - 1).pix
-    assert_raises(Calc::MathError) { Calc::Q(2**32).pix }
+    assert_rational_and_equal 203280221, Calc::Q(2**32).pix
+    assert_rational_and_equal 203280222, Calc::Q(2**32 + 15).pix
+    assert_raises(Calc::MathError) { Calc::Q(2**63).pix }
     assert_raises(Calc::MathError) { Calc::Q(0.5).pix }
   end
 
+  def test_pix_large
+    # either side of the switch from libcalc at 2^24
+    [2**24 - 1, 2**24, 2**24 + 1, 123_456_789].each do |x|
+      assert_rational_and_equal Calc.count_primes(0, x), Calc::Q(x).pix
+    end
+    assert_rational_and_equal 5_761_455, Calc::Q("1e8").pix
+    assert_rational_and_equal 50_847_534, Calc::Q("1e9").pix
+    assert_rational_and_equal 455_052_511, Calc::Q("1e10").pix
+    assert_rational_and_equal 4_118_054_813, Calc::Q("1e11").pix
+    assert_rational_and_equal 37_607_912_018, Calc::Q("1e12").pix
+  end
+
   def test_places
     assert_rational_and_equal 0, Calc::Q(3).places
     assert_rational_and_equal 4, Calc::Q("0.0123").places
@@ -1511,7 +1759,8 @@ class TestQ < MiniTest::Test
   end
 
   def test_step
-    assert_instance_of Enumerator, Calc::Q(1).step
+    assert_kind_of Enumerator, Calc::Q(1).step
+    assert_instance_of Calc::ArithmeticSequence, Calc::Q(1).step
     assert_rational_array [1, 2, 3, 4], Calc::Q(1).step.take(4)
     assert_rational_array [1, 3, 5, 7], Calc::Q(1).step(by: 2).take(4)
     assert_rational_array [10, 9, 8, 7], Calc::Q(10).step(by: -1).take(4)
@@ -1534,6 +1783,19 @@ class TestQ < MiniTest::Test
     a = []
     Calc.pi.step(to: Calc::Q(1).exp, by: "-0.2") { |f| a << f }
     assert_rational_array [3.141592653589793, 2.941592653589793, 2.741592653589793], a
+
+    # values which don't fit in a long
+    a = []
+    Calc::Q(2**63 - 2).step(2**63 + 1) { |i| a << i }
+    assert_rational_array [2**63 - 2, 2**63 - 1, 2**63, 2**63 + 1], a
+    a = []
+    Calc::Q(-2**63 + 1).step(by: -1, to: -2**63 - 1) { |i| a << i }
+    assert_rational_array [-2**63 + 1, -2**63, -2**63 - 1], a
+    assert_rational_array [1, 3], Calc::Q(1).step(Rational(7, 2), 2).to_a
+    assert_nil Calc::Q(1).step(3) { |_| nil }
+
+    assert_raises(ArgumentError) { Calc::Q(1).step(foo: 2) { |_| nil } }
+    assert_raises(ArgumentError) { Calc::Q(1).step(5, nil) { |_| nil } }
   end
 
   def test_to_int
@@ -1602,6 +1864,24 @@ class TestQ < MiniTest::Test
     assert_complex_parts [0, 4.5323601418], Calc::Q(-1).log2
     assert_complex_parts [1, 4.5323601418], Calc::Q(-2).log2
     assert_complex_parts [1.5849625007, 4.5323601418], Calc::Q(-3).log2
+    assert_equal Calc::Q(10).ln("1e-30") / Calc::Q(2).ln("1e-30"), Calc::Q(10).log2("1e-30")
+    assert_raises(Calc::MathError) { Calc::Q(0).log2 }
+  end
+
+  def test_logn
+    assert_raises(Calc::MathError) { Calc::Q(0).logn(3) }
+    assert_raises(Calc::MathError) { Calc::Q(5).logn(0) }
+    assert_raises(Calc::MathError) { Calc::Q(5).logn(1) }
+    assert_rational_and_equal 0, Calc::Q(1).logn(3)
+    assert_rational_and_equal 1, Calc::Q(7).logn(7)
+    assert_in_epsilon Math.log(10, 3), Calc::Q(10).logn(3)
+    assert_in_epsilon Math.log(10, 0.5), Calc::Q(10).logn(Rational(1, 2))
+    assert_equal Calc::Q(10).ln("1e-30") / Calc::Q(3).ln("1e-30"), Calc::Q(10).logn(3, "1e-30")
+    # second call uses the cached ln(3)
+    assert_equal Calc::Q(20).ln("1e-30") / Calc::Q(3).ln("1e-30"), Calc::Q(20).logn(3, "1e-30")
+    assert_equal Calc::Q(10).log2, Calc::Q(10).logn(2)
+    assert_complex_parts [3.0, 4.53236014182719380961], Calc::Q(-8).logn(2)
+    assert_complex_parts [0.06874882335131485, -0.19659419488678306], Calc::Q(2).logn(-3)
   end
 
   def test_chr
@@ -1613,7 +1893,8 @@ class TestQ < MiniTest::Test
   end
 
   def test_downto
-    assert_instance_of Enumerator, Calc::Q(5).downto(1)
+    assert_kind_of Enumerator, Calc::Q(5).downto(1)
+    assert_instance_of Calc::ArithmeticSequence, Calc::Q(5).downto(1)
     assert_rational_array [5, 4, 3, 2, 1], Calc::Q(5).downto(1).to_a
     assert_rational_array [5, 4, 3], Calc::Q(5).downto(1).take(3)
     assert_rational_array [], Calc::Q(5).downto(6).to_a
@@ -1623,7 +1904,8 @@ class TestQ < MiniTest::Test
   end
 
   def test_upto
-    assert_instance_of Enumerator, Calc::Q(5).upto(10)
+    assert_kind_of Enumerator, Calc::Q(5).upto(10)
+    assert_instance_of Calc::ArithmeticSequence, Calc::Q(5).upto(10)
     assert_rational_array [5, 6, 7, 8, 9, 10], Calc::Q(5).upto(10).to_a
     assert_rational_array [5, 6, 7], Calc::Q(5).upto(10).take(3)
     assert_rational_array [], Calc::Q(5).upto(4).to_a
@@ -1664,9 +1946,13 @@ class TestQ < MiniTest::Test
   end
 
   def test_times
-    assert_instance_of Enumerator, Calc::Q(5).times
+    assert_kind_of Enumerator, Calc::Q(5).times
+    assert_instance_of Calc::ArithmeticSequence, Calc::Q(5).times
     assert_rational_array [0, 1, 2, 3, 4], Calc::Q(5).times.to_a
     assert_rational_array [], Calc::Q(0).times.to_a
+    assert_rational_array [], Calc::Q(-3).times.to_a
+    assert_rational_array [], Calc::Q(-0.5).times.to_a
+    assert_rational_array [0, 1, 2], Calc::Q(2.5).times.to_a
     assert_rational_array [0, 1, 2], Calc::Q(5).times.take(3)
     a = []
     Calc::Q(5).times { |i| a << i }
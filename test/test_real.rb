@@ -0,0 +1,78 @@
+require "minitest_helper"
+
+class TestReal < MiniTest::Test
+  def test_convert
+    assert_instance_of Calc::Real::Exact, Calc::Real(3)
+    assert_equal Calc::Q(1, 3), Calc::Real(Rational(1, 3)).approx(10)
+    assert_equal Calc::Q("0.33333"), Calc::Real(Rational(1, 3)).to_q("1e-5")
+    assert_equal Calc::Q("0.5"), Calc::Real("0.5").to_q
+    x = Calc::Real(2)
+    assert_same x, Calc::Real(x)
+    assert_raises(ArgumentError) { Calc::Real(Complex(1, 2)) }
+    assert_raises(ArgumentError) { Calc::Real(Calc::C(1, 2)) }
+  end
+
+  def test_arithmetic
+    x = Calc::Real(1) / 3
+    assert_equal "0.33333", x.to_s(5)
+    assert_equal "-0.66667", (x - 1).to_s(5)
+    assert_equal "1.33333", (1 + x).to_s(5)
+    assert_equal "0.11111", (x * x).to_s(5)
+    assert_equal "0.125", (Calc::Real(2)**-3).to_s(3)
+    assert_equal "-0.33333", (-x).to_s(5)
+    assert_equal "3.00000", x.inverse.to_s(5)
+  end
+
+  def test_functions
+    eps = Rational(1, 10**50)
+    x = Calc::Q(3, 7)
+    r = Calc::Real(x)
+    %i[atan cos cosh exp ln sin sinh sqrt tan tanh].each do |f|
+      assert (r.__send__(f).to_q(eps) - x.__send__(f, eps)).abs <= 2 * eps, f
+    end
+    assert (r.log.to_q(eps) - x.log(eps)).abs <= 2 * eps
+    assert_equal "0.42857", (-r).abs.to_s(5)
+    assert_equal Calc::Q(2).sqrt(eps), Calc::Real(2).sqrt.to_q(eps)
+    assert_equal Calc.pi(eps), Calc::Real.pi.to_q(eps)
+    assert_equal Calc.constant(:e, eps), Calc::Real.e.to_q(eps)
+  end
+
+  def test_expressions
+    # sin^2 + cos^2 == 1 to any precision asked for
+    x = Calc::Real(1) / 3
+    y = x.sin**2 + x.cos**2
+    assert_equal "1." + "0" * 100, y.to_s(100)
+    # atan(1) * 4 - pi == 0
+    assert_equal "0." + "0" * 60, (Calc::Real(1).atan * 4 - Calc::Real.pi).to_s(60)
+    assert_equal "1.41421356237309504880", (Calc::Real(2)**Rational(1, 2)).to_s
+    x = Calc::Real(2).sqrt.exp * Calc::Real.pi
+    assert_equal "12.9221571723598794312941333471281225692213", x.to_s(40)
+    assert_equal Calc::Q("12.92216"), x.to_q("1e-5")
+  end
+
+  def test_cached
+    x = Calc::Real(3).exp
+    assert_nil x.approx_bits
+    x.to_s(100)
+    bits = x.approx_bits
+    assert_operator bits, :>=, 332
+    x.to_s(50)
+    assert_equal bits, x.approx_bits
+    x.to_s(200)
+    assert_operator x.approx_bits, :>, bits
+  end
+
+  def test_errors
+    zero = Calc::Real.pi - Calc::Real.pi
+    assert_raises(Calc::MathError) { (Calc::Real(1) / zero).to_s }
+    assert_raises(Calc::MathError) { Calc::Real(-2).ln.to_s }
+    assert_raises(Calc::MathError) { Calc::Real(-2).sqrt.to_s }
+    assert_equal "0.0000000000", zero.sqrt.to_s(10)
+    assert_raises(Calc::MathError) { Calc::Real(1).to_q(0) }
+  end
+
+  def test_to_f
+    assert_in_epsilon Math.sqrt(2), Calc::Real(2).sqrt.to_f
+    assert_equal "Calc::Real(3.14159265358979323846)", Calc::Real.pi.inspect
+  end
+end
@@ -0,0 +1,94 @@
+require "minitest_helper"
+
+class TestSpecialMod < MiniTest::Test
+  M127 = 2**127 - 1
+
+  def test_class_exists
+    refute_nil Calc::SpecialMod
+  end
+
+  def test_initialization
+    sm = Calc::SpecialMod.new(3, 189, 1)
+    assert_rational_and_equal 3, sm.h
+    assert_rational_and_equal 189, sm.n
+    assert_rational_and_equal 1, sm.r
+    assert_rational_and_equal 3 * 2**189 + 1, sm.modulus
+    assert_equal "Calc::SpecialMod(3*2^189+1)", sm.inspect
+    assert_equal "2^127-1", Calc::SpecialMod.new(1, 127, -1).to_s
+    assert_equal "5*2^8", Calc::SpecialMod.new(5, 8, 0).to_s
+    [[0, 1, 1], [Calc::Q(1, 2), 1, 1], [1, 0, 1], [1, 2**31, 1], [1, 5, 2], [1, 1, -1]].each do |args|
+      assert_raises(Calc::MathError) { Calc::SpecialMod.new(*args) }
+    end
+    assert_raises(ArgumentError) { Calc::SpecialMod.allocate.modulus }
+  end
+
+  def test_mod
+    sm = Calc::SpecialMod.new(1, 5, -1)
+    assert_rational_and_equal 7, sm.mod(100)
+    assert_rational_and_equal 30, sm.mod(-1)
+    assert_rational_and_equal 0, sm.mod(-31)
+    assert_rational_and_equal Calc.hnrmod(10**40, 17, 51, 1), Calc::SpecialMod.new(17, 51, 1).mod(10**40)
+    assert_raises(Calc::MathError) { sm.mod(Calc::Q(1, 2)) }
+  end
+
+  def test_mul
+    assert_rational_and_equal 11, Calc::SpecialMod.new(1, 5, -1).mul(6, 7)
+    [[1, 127, -1], [3, 200, 1], [5, 100, 0]].each do |h, n, r|
+      sm = Calc::SpecialMod.new(h, n, r)
+      m = h * 2**n + r
+      a = 3**150
+      b = -(7**90)
+      assert_rational_and_equal((a * b) % m, sm.mul(a, b))
+    end
+  end
+
+  def test_pow
+    sm = Calc::SpecialMod.new(1, 127, -1)
+    assert_rational_and_equal 1, sm.pow(3, M127 - 1)
+    assert_rational_and_equal 1, sm.pow(5, 0)
+    assert_rational_and_equal 7.pow(37, M127), sm.pow(7, 37)
+    assert_raises(Calc::MathError) { sm.pow(2, -1) }
+    assert_raises(Calc::MathError) { sm.pow(2, Calc::Q(1, 2)) }
+    [[1, 127, -1], [3, 200, 1], [1, 256, 1], [5, 100, 0]].each do |h, n, r|
+      sm = Calc::SpecialMod.new(h, n, r)
+      m = h * 2**n + r
+      [3**200, 2**300 + 12_345, -(11**80)].each do |x|
+        e = 13**(n / 3) + 1
+        assert_rational_and_equal Calc::Q(x).pmod(e, m), sm.pow(x, e)
+      end
+    end
+  end
+
+  def test_lucas_lehmer
+    mersenne = (2..700).select { |n| Calc::SpecialMod.new(1, n, -1).lucas_lehmer? }
+    assert_equal [2, 3, 5, 7, 13, 17, 19, 31, 61, 89, 107, 127, 521, 607], mersenne
+    assert_raises(Calc::MathError) { Calc::SpecialMod.new(3, 5, -1).lucas_lehmer? }
+    assert_raises(Calc::MathError) { Calc::SpecialMod.new(1, 5, 1).lucas_lehmer? }
+  end
+
+  def test_proth
+    # fermat numbers: F0 to F4 are prime, F5 to F10 are not
+    fermat = (0..10).map { |k| Calc::SpecialMod.new(1, 2**k, 1).proth? }
+    assert_equal [true] * 5 + [false] * 6, fermat
+    assert Calc::SpecialMod.new(3, 189, 1).proth?
+    primes = []
+    1.upto(40) do |n|
+      [1, 3, 5, 7, 9].each do |h|
+        next if h >= 2**n
+        primes << h * 2**n + 1 if Calc::SpecialMod.new(h, n, 1).proth?
+      end
+    end
+    expected = []
+    1.upto(40) do |n|
+      [1, 3, 5, 7, 9].each do |h|
+        next if h >= 2**n
+        expected << h * 2**n + 1 if Calc::Q(h * 2**n + 1).ptest?(:bpsw)
+      end
+    end
+    assert_equal expected, primes
+    refute Calc::SpecialMod.new(1, 3, 1).proth? # 9 is a square
+    assert_raises(Calc::MathError) { Calc::SpecialMod.new(2, 5, 1).proth? }
+    assert_raises(Calc::MathError) { Calc::SpecialMod.new(33, 5, 1).proth? }
+    assert_raises(Calc::MathError) { Calc::SpecialMod.new(1, 5, -1).proth? }
+  end
+end